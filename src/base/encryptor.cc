@@ -30,9 +30,13 @@
 #include "base/encryptor.h"
 
 #include <algorithm>
+#include <array>
+#include <cstddef>
 #include <cstdint>
 #include <string>
+#include <thread>  // NOLINT
 #include <utility>
+#include <vector>
 
 #include "absl/log/check.h"
 #include "absl/log/log.h"
@@ -40,6 +44,7 @@
 #include "absl/strings/string_view.h"
 #include "base/password_manager.h"
 #include "base/random.h"
+#include "base/thread.h"
 #include "base/unverified_aes256.h"
 #include "base/unverified_sha1.h"
 
@@ -111,8 +116,59 @@ std::string GetMSCryptDeriveKeyWithSHA1(const absl::string_view password,
                       UnverifiedSHA1::MakeDigest(buf2));
 }
 
+// Minimum number of blocks decrypted by one thread. Buffers shorter than two
+// chunks (128 KiB) are decrypted on the calling thread.
+constexpr size_t kMinBlocksPerChunk = 64 * 1024 / Encryptor::kBlockSize;
+constexpr int kMaxDecryptionThreads = 4;
+
 }  // namespace
 
+// static
+void Encryptor::InverseTransformCBC(const Key& key, uint8_t* blocks,
+                                    size_t block_count) {
+  const size_t num_chunks = std::min<size_t>(
+      {block_count / kMinBlocksPerChunk, size_t{kMaxDecryptionThreads},
+       std::thread::hardware_concurrency()});
+  InverseTransformCBCInChunks(key, blocks, block_count, num_chunks);
+}
+
+// static
+void Encryptor::InverseTransformCBCInChunks(const Key& key, uint8_t* blocks,
+                                            size_t block_count,
+                                            size_t num_chunks) {
+  using ::mozc::internal::UnverifiedAES256;
+  using Block = std::array<uint8_t, kBlockSize>;
+
+  if (num_chunks <= 1 || block_count <= 1) {
+    UnverifiedAES256::InverseTransformCBC(key.key_, key.iv_, blocks,
+                                          block_count);
+    return;
+  }
+
+  // Unlike encryption, CBC decryption of a block depends only on the
+  // ciphertext of the block and the previous one. Large buffers are split into
+  // chunks, which are decrypted concurrently from the IVs taken before any of
+  // them is overwritten.
+  const size_t chunk_size = (block_count + num_chunks - 1) / num_chunks;
+  std::vector<Block> ivs((block_count + chunk_size - 1) / chunk_size);
+  std::copy_n(key.iv_, kBlockSize, ivs[0].begin());
+  for (size_t i = 1; i < ivs.size(); ++i) {
+    std::copy_n(blocks + (i * chunk_size - 1) * kBlockSize, kBlockSize,
+                ivs[i].begin());
+  }
+  auto decrypt_chunks = [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      const size_t first = i * chunk_size;
+      const size_t count = std::min(chunk_size, block_count - first);
+      uint8_t iv[kBlockSize];
+      std::copy(ivs[i].begin(), ivs[i].end(), iv);
+      UnverifiedAES256::InverseTransformCBC(
+          key.key_, iv, blocks + first * kBlockSize, count);
+    }
+  };
+  ParallelForRanges(ivs.size(), kMaxDecryptionThreads, decrypt_chunks);
+}
+
 size_t Encryptor::Key::GetEncryptedSize(size_t size) const {
   // Even when given size is already multples of 16, we add
   // an extra block_size as a padding.
@@ -229,8 +285,7 @@ bool Encryptor::DecryptArray(const Encryptor::Key& key, char* buf,
   size_t size = *buf_size;
 
   // For historical reasons, we are using AES256/CBC for obfuscation.
-  internal::UnverifiedAES256::InverseTransformCBC(
-      key.key_, key.iv_, reinterpret_cast<uint8_t*>(buf), size / kBlockSize);
+  InverseTransformCBC(key, reinterpret_cast<uint8_t*>(buf), size / kBlockSize);
 
   // perform PKCS#5 un-padding
   // see. http://www.chilkatsoft.com/faq/PKCS5_Padding.html
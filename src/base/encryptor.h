@@ -127,6 +127,20 @@ class Encryptor {
   // It uses CryptUnprotectData API to decrypt data on Windows.
   static bool UnprotectData(absl::string_view cipher_text,
                             std::string* plain_text);
+
+ private:
+  friend class EncryptorTestPeer;
+
+  // Decrypts AES256/CBC `blocks` in place. Large buffers are decrypted with
+  // multiple threads.
+  static void InverseTransformCBC(const Key& key, uint8_t* blocks,
+                                  size_t block_count);
+
+  // Decrypts AES256/CBC `blocks` in place, split into at most `num_chunks`
+  // chunks. The chunks are decrypted on multiple threads.
+  static void InverseTransformCBCInChunks(const Key& key, uint8_t* blocks,
+                                          size_t block_count,
+                                          size_t num_chunks);
 };
 }  // namespace mozc
 #endif  // MOZC_BASE_ENCRYPTOR_H_
@@ -37,8 +37,15 @@
 #include "base/random.h"
 #include "testing/gunit.h"
 #include "testing/mozctest.h"
+#include "testing/test_peer.h"
 
 namespace mozc {
+
+class EncryptorTestPeer : public testing::TestPeer<Encryptor> {
+ public:
+  PEER_STATIC_METHOD(InverseTransformCBCInChunks);
+};
+
 namespace {
 
 struct TestData {
@@ -172,9 +179,39 @@ TEST_F(EncryptorTest, BasicTest) {
   EXPECT_EQ(key.iv_size(), 16);
 }
 
+TEST_F(EncryptorTest, DecryptInChunks) {
+  // The number of chunks is usually limited by the number of cores, so it is
+  // forced here.
+  constexpr size_t kBlockCountTable[] = {1, 2, 3, 17, 1000, 4099};
+  constexpr size_t kNumChunksTable[] = {2, 3, 4, 7, 1000, 5000};
+
+  Random random;
+  for (const size_t block_count : kBlockCountTable) {
+    const std::string original =
+        random.ByteString(block_count * Encryptor::kBlockSize - 1);
+    Encryptor::Key key;
+    ASSERT_TRUE(key.DeriveFromPassword("test", "salt"));
+    std::string encrypted = original;
+    ASSERT_TRUE(Encryptor::EncryptString(key, &encrypted));
+    ASSERT_EQ(encrypted.size(), block_count * Encryptor::kBlockSize);
+
+    for (const size_t num_chunks : kNumChunksTable) {
+      std::string decrypted = encrypted;
+      EncryptorTestPeer::InverseTransformCBCInChunks(
+          key, reinterpret_cast<uint8_t*>(decrypted.data()), block_count,
+          num_chunks);
+      EXPECT_EQ(decrypted.substr(0, original.size()), original)
+          << "block_count = " << block_count
+          << ", num_chunks = " << num_chunks;
+    }
+  }
+}
+
 TEST_F(EncryptorTest, EncryptBatch) {
-  constexpr size_t kSizeTable[] = {1,    10,   16,    32,    100,
-                                   1000, 1600, 10000, 16000, 100000};
+  // Large sizes are decrypted in multiple chunks.
+  constexpr size_t kSizeTable[] = {1,     10,     16,      32,     100,
+                                   1000,  1600,   10000,   16000,  100000,
+                                   262144, 500000, 1000000, 1234567};
 
   Random random;
   for (size_t i = 0; i < std::size(kSizeTable); ++i) {
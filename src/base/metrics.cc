@@ -0,0 +1,173 @@
+// Copyright 2010-2021, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "base/metrics.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+
+namespace mozc {
+namespace {
+
+constinit std::array<LatencyHistogram, MetricsRegistry::NUM_STAGES>
+    stage_histograms;
+constinit std::array<LatencyHistogram, MetricsRegistry::kMaxCommandTypes>
+    command_histograms;
+constinit std::array<LatencyHistogram, MetricsRegistry::kMaxCommandTypes>
+    session_command_histograms;
+
+constexpr std::array<absl::string_view, MetricsRegistry::NUM_STAGES>
+    kStageNames = {
+        "COMPOSER",          "LATTICE_BUILD",  "VITERBI",
+        "NBEST",             "REWRITERS",      "PREDICTION_AGGREGATION",
+        "RANKING",           "OUTPUT_FILLING", "DEADLINE_EXCEEDED",
+};
+
+}  // namespace
+
+void LatencyHistogram::Record(absl::Duration latency) {
+  const uint64_t micros =
+      std::max<int64_t>(0, absl::ToInt64Microseconds(latency));
+  buckets_[GetBucketIndex(micros)].fetch_add(1, std::memory_order_relaxed);
+  count_.fetch_add(1, std::memory_order_relaxed);
+  total_us_.fetch_add(micros, std::memory_order_relaxed);
+  uint64_t max = max_us_.load(std::memory_order_relaxed);
+  while (micros > max &&
+         !max_us_.compare_exchange_weak(max, micros,
+                                        std::memory_order_relaxed)) {
+  }
+}
+
+void LatencyHistogram::Reset() {
+  for (std::atomic<uint64_t>& bucket : buckets_) {
+    bucket.store(0, std::memory_order_relaxed);
+  }
+  count_.store(0, std::memory_order_relaxed);
+  total_us_.store(0, std::memory_order_relaxed);
+  max_us_.store(0, std::memory_order_relaxed);
+}
+
+absl::Duration LatencyHistogram::Percentile(double quantile) const {
+  // Buckets are updated independently of count_, so the total is taken from
+  // the buckets themselves.
+  std::array<uint64_t, kNumBuckets> counts;
+  uint64_t total = 0;
+  for (size_t i = 0; i < kNumBuckets; ++i) {
+    counts[i] = bucket_count(i);
+    total += counts[i];
+  }
+  if (total == 0) {
+    return absl::ZeroDuration();
+  }
+
+  const uint64_t rank = std::clamp<uint64_t>(
+      static_cast<uint64_t>(std::ceil(quantile * total)), 1, total);
+  uint64_t accumulated = 0;
+  size_t index = 0;
+  for (; index < kNumBuckets; ++index) {
+    accumulated += counts[index];
+    if (accumulated >= rank) {
+      break;
+    }
+  }
+  return std::min(absl::Microseconds(GetBucketUpperBound(index)), max());
+}
+
+size_t LatencyHistogram::GetBucketIndex(uint64_t micros) {
+  if (micros < kSubBuckets) {
+    return micros;
+  }
+  const int exponent = std::bit_width(micros) - 1;
+  if (exponent >= kMaxExponent) {
+    return kNumBuckets - 1;
+  }
+  const int shift = exponent - kSubBucketBits;
+  return kSubBuckets + shift * kSubBuckets + ((micros >> shift) - kSubBuckets);
+}
+
+uint64_t LatencyHistogram::GetBucketLowerBound(size_t index) {
+  if (index < kSubBuckets) {
+    return index;
+  }
+  const size_t shift = (index - kSubBuckets) / kSubBuckets;
+  const uint64_t sub_bucket = index % kSubBuckets;
+  return (kSubBuckets + sub_bucket) << shift;
+}
+
+uint64_t LatencyHistogram::GetBucketUpperBound(size_t index) {
+  if (index + 1 >= kNumBuckets) {
+    return uint64_t{1} << kMaxExponent;
+  }
+  return GetBucketLowerBound(index + 1);
+}
+
+LatencyHistogram& MetricsRegistry::GetStage(Stage stage) {
+  return stage_histograms[stage];
+}
+
+absl::string_view MetricsRegistry::GetStageName(Stage stage) {
+  return kStageNames[stage];
+}
+
+LatencyHistogram* MetricsRegistry::GetCommand(int type) {
+  if (type < 0 || type >= kMaxCommandTypes) {
+    return nullptr;
+  }
+  return &command_histograms[type];
+}
+
+LatencyHistogram* MetricsRegistry::GetSessionCommand(int type) {
+  if (type < 0 || type >= kMaxCommandTypes) {
+    return nullptr;
+  }
+  return &session_command_histograms[type];
+}
+
+void MetricsRegistry::Reset() {
+  for (LatencyHistogram& histogram : stage_histograms) {
+    histogram.Reset();
+  }
+  for (LatencyHistogram& histogram : command_histograms) {
+    histogram.Reset();
+  }
+  for (LatencyHistogram& histogram : session_command_histograms) {
+    histogram.Reset();
+  }
+}
+
+}  // namespace mozc
@@ -0,0 +1,163 @@
+// Copyright 2010-2021, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+// Process-wide latency metrics of the engine.
+//
+// Histograms are statically allocated and updated with relaxed atomics, so
+// that recording neither locks nor allocates and can be done from any thread.
+//
+// Usage:
+//   {
+//     ScopedLatency latency(
+//         MetricsRegistry::GetStage(MetricsRegistry::VITERBI));
+//     Viterbi(...);
+//   }
+
+#ifndef MOZC_BASE_METRICS_H_
+#define MOZC_BASE_METRICS_H_
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+#include "base/stopwatch.h"
+
+namespace mozc {
+
+// Latency histogram with log-linear buckets in microseconds, similar to
+// HdrHistogram. Latencies below 2^kSubBucketBits us are recorded exactly, and
+// each larger power of two range is split into 2^kSubBucketBits buckets, so
+// the relative error of the reported percentiles is at most 12.5%.
+class LatencyHistogram {
+ public:
+  static constexpr int kSubBucketBits = 3;
+  static constexpr size_t kSubBuckets = size_t{1} << kSubBucketBits;
+  // Latencies of 2^kMaxExponent us (~70 minutes) or longer are recorded in the
+  // last bucket.
+  static constexpr int kMaxExponent = 32;
+  static constexpr size_t kNumBuckets =
+      kSubBuckets + (kMaxExponent - kSubBucketBits) * kSubBuckets;
+
+  constexpr LatencyHistogram() = default;
+
+  LatencyHistogram(const LatencyHistogram&) = delete;
+  LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+  void Record(absl::Duration latency);
+  void Reset();
+
+  uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+  absl::Duration total() const {
+    return absl::Microseconds(total_us_.load(std::memory_order_relaxed));
+  }
+  absl::Duration max() const {
+    return absl::Microseconds(max_us_.load(std::memory_order_relaxed));
+  }
+  uint64_t bucket_count(size_t index) const {
+    return buckets_[index].load(std::memory_order_relaxed);
+  }
+
+  // Returns the upper bound of the bucket where the |quantile| (0.0 to 1.0)
+  // of the recorded latencies falls, capped by max(). Returns zero if nothing
+  // is recorded.
+  absl::Duration Percentile(double quantile) const;
+
+  // Returns the bucket index of |micros| and the range of the bucket
+  // [lower, upper) in microseconds.
+  static size_t GetBucketIndex(uint64_t micros);
+  static uint64_t GetBucketLowerBound(size_t index);
+  static uint64_t GetBucketUpperBound(size_t index);
+
+ private:
+  std::array<std::atomic<uint64_t>, kNumBuckets> buckets_ = {};
+  std::atomic<uint64_t> count_ = 0;
+  std::atomic<uint64_t> total_us_ = 0;
+  std::atomic<uint64_t> max_us_ = 0;
+};
+
+// Registry of the latency histograms for each pipeline stage and for each
+// command type. The count of a histogram serves as the counter of the events.
+class MetricsRegistry {
+ public:
+  enum Stage {
+    COMPOSER,                // Composer::InsertCharacterKeyEvent
+    LATTICE_BUILD,           // ImmutableConverter::MakeLattice
+    VITERBI,                 // ImmutableConverter::(Prediction)Viterbi
+    NBEST,                   // ImmutableConverter::MakeSegments
+    REWRITERS,               // RewriterInterface::Rewrite in Converter
+    PREDICTION_AGGREGATION,  // DictionaryPredictor's result aggregation
+    RANKING,                 // DictionaryPredictor's rescoring and reranking
+    OUTPUT_FILLING,          // EngineConverter::PopOutput
+    DEADLINE_EXCEEDED,       // Overrun of ConversionOptions::deadline
+    NUM_STAGES,
+  };
+
+  // Command types larger than or equal to this value are not recorded.
+  static constexpr int kMaxCommandTypes = 64;
+
+  MetricsRegistry() = delete;
+
+  static LatencyHistogram& GetStage(Stage stage);
+  static absl::string_view GetStageName(Stage stage);
+
+  // Returns the histogram of commands::Input::CommandType |type|, or nullptr
+  // if |type| is out of range.
+  static LatencyHistogram* GetCommand(int type);
+
+  // Returns the histogram of commands::SessionCommand::CommandType |type|, or
+  // nullptr if |type| is out of range.
+  static LatencyHistogram* GetSessionCommand(int type);
+
+  // Resets all the histograms.
+  static void Reset();
+};
+
+// Records the elapsed time of its scope into |histogram|.
+class ScopedLatency {
+ public:
+  explicit ScopedLatency(LatencyHistogram& histogram)
+      : histogram_(histogram), stopwatch_(Stopwatch::StartNew()) {}
+
+  ScopedLatency(const ScopedLatency&) = delete;
+  ScopedLatency& operator=(const ScopedLatency&) = delete;
+
+  ~ScopedLatency() { histogram_.Record(stopwatch_.GetElapsed()); }
+
+ private:
+  LatencyHistogram& histogram_;
+  Stopwatch stopwatch_;
+};
+
+}  // namespace mozc
+
+#endif  // MOZC_BASE_METRICS_H_
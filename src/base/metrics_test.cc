@@ -0,0 +1,135 @@
+// Copyright 2010-2021, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "base/metrics.h"
+
+#include <cstddef>
+#include <cstdint>
+
+#include "absl/time/time.h"
+#include "base/clock.h"
+#include "base/clock_mock.h"
+#include "base/thread.h"
+#include "testing/gunit.h"
+
+namespace mozc {
+namespace {
+
+TEST(LatencyHistogramTest, BucketBoundaries) {
+  for (uint64_t micros = 0; micros < 100000; ++micros) {
+    const size_t index = LatencyHistogram::GetBucketIndex(micros);
+    ASSERT_LT(index, LatencyHistogram::kNumBuckets);
+    EXPECT_LE(LatencyHistogram::GetBucketLowerBound(index), micros);
+    EXPECT_LT(micros, LatencyHistogram::GetBucketUpperBound(index));
+  }
+  EXPECT_EQ(LatencyHistogram::GetBucketIndex(7), 7);
+  EXPECT_EQ(LatencyHistogram::GetBucketIndex(8), 8);
+  EXPECT_EQ(LatencyHistogram::GetBucketIndex(uint64_t{1} << 40),
+            LatencyHistogram::kNumBuckets - 1);
+
+  // The relative width of a bucket is at most 1 / kSubBuckets.
+  for (size_t i = LatencyHistogram::kSubBuckets;
+       i + 1 < LatencyHistogram::kNumBuckets; ++i) {
+    const uint64_t lower = LatencyHistogram::GetBucketLowerBound(i);
+    const uint64_t upper = LatencyHistogram::GetBucketUpperBound(i);
+    EXPECT_LE((upper - lower) * LatencyHistogram::kSubBuckets, lower);
+  }
+}
+
+TEST(LatencyHistogramTest, Percentile) {
+  LatencyHistogram histogram;
+  EXPECT_EQ(histogram.Percentile(0.99), absl::ZeroDuration());
+
+  for (int i = 1; i <= 100; ++i) {
+    histogram.Record(absl::Milliseconds(i));
+  }
+  EXPECT_EQ(histogram.count(), 100);
+  EXPECT_EQ(histogram.total(), absl::Milliseconds(5050));
+  EXPECT_EQ(histogram.max(), absl::Milliseconds(100));
+
+  const absl::Duration p50 = histogram.Percentile(0.5);
+  EXPECT_GE(p50, absl::Milliseconds(50));
+  EXPECT_LE(p50, absl::Milliseconds(50) * 1.125);
+  const absl::Duration p99 = histogram.Percentile(0.99);
+  EXPECT_GE(p99, absl::Milliseconds(99));
+  EXPECT_LE(p99, absl::Milliseconds(100));
+  EXPECT_EQ(histogram.Percentile(1.0), absl::Milliseconds(100));
+
+  histogram.Reset();
+  EXPECT_EQ(histogram.count(), 0);
+  EXPECT_EQ(histogram.Percentile(0.5), absl::ZeroDuration());
+}
+
+TEST(LatencyHistogramTest, ConcurrentRecord) {
+  constexpr int kNumThreads = 4;
+  constexpr size_t kNumRecords = 10000;
+  LatencyHistogram histogram;
+  ParallelForRanges(kNumRecords, kNumThreads, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      histogram.Record(absl::Microseconds(i));
+    }
+  });
+  EXPECT_EQ(histogram.count(), kNumRecords);
+  EXPECT_EQ(histogram.max(), absl::Microseconds(kNumRecords - 1));
+  EXPECT_EQ(histogram.total(),
+            absl::Microseconds(kNumRecords * (kNumRecords - 1) / 2));
+}
+
+TEST(MetricsRegistryTest, ScopedLatency) {
+  ClockMock clock(absl::UnixEpoch());
+  Clock::SetClockForUnitTest(&clock);
+  MetricsRegistry::Reset();
+
+  LatencyHistogram& viterbi =
+      MetricsRegistry::GetStage(MetricsRegistry::VITERBI);
+  {
+    ScopedLatency latency(viterbi);
+    clock.Advance(absl::Microseconds(300));
+  }
+  EXPECT_EQ(viterbi.count(), 1);
+  EXPECT_EQ(viterbi.max(), absl::Microseconds(300));
+  EXPECT_EQ(MetricsRegistry::GetStage(MetricsRegistry::NBEST).count(), 0);
+  EXPECT_EQ(MetricsRegistry::GetStageName(MetricsRegistry::VITERBI),
+            "VITERBI");
+
+  EXPECT_NE(MetricsRegistry::GetCommand(0), nullptr);
+  EXPECT_EQ(MetricsRegistry::GetCommand(-1), nullptr);
+  EXPECT_EQ(MetricsRegistry::GetCommand(MetricsRegistry::kMaxCommandTypes),
+            nullptr);
+  EXPECT_NE(MetricsRegistry::GetCommand(1),
+            MetricsRegistry::GetSessionCommand(1));
+
+  MetricsRegistry::Reset();
+  EXPECT_EQ(viterbi.count(), 0);
+  Clock::SetClockForUnitTest(nullptr);
+}
+
+}  // namespace
+}  // namespace mozc
@@ -36,14 +36,20 @@
 #endif  // _WIN32
 
 #include <cstddef>
+#include <cstdint>
 #include <cstdlib>
 #include <string>
+#include <utility>
 
 #include "absl/base/const_init.h"
+#include "absl/base/no_destructor.h"
+#include "absl/base/thread_annotations.h"
 #include "absl/log/log.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
 #include "base/file_util.h"
 #include "base/mmap.h"
 #include "base/random.h"
@@ -167,6 +173,8 @@ class PlainPasswordManager {
   static bool SetPassword(const std::string& password);
   static bool GetPassword(std::string* password);
   static bool RemovePassword();
+  // Gets the password from the content of the password file.
+  static bool DecodePassword(const std::string& data, std::string* password);
 };
 
 bool PlainPasswordManager::SetPassword(const std::string& password) {
@@ -191,16 +199,23 @@ bool PlainPasswordManager::GetPassword(std::string* password) {
 
   password->clear();
 
-  if (!LoadPassword(password)) {
+  std::string data;
+  if (!LoadPassword(&data)) {
     LOG(ERROR) << "LoadPassword failed";
     return false;
   }
 
-  if (password->size() != kPasswordSize) {
+  return DecodePassword(data, password);
+}
+
+bool PlainPasswordManager::DecodePassword(const std::string& data,
+                                          std::string* password) {
+  if (data.size() != kPasswordSize) {
     LOG(ERROR) << "Password size is invalid";
     return false;
   }
 
+  *password = data;
   return true;
 }
 
@@ -215,6 +230,8 @@ class WinMacPasswordManager {
   static bool SetPassword(const std::string& password);
   static bool GetPassword(std::string* password);
   static bool RemovePassword();
+  // Gets the password from the content of the password file.
+  static bool DecodePassword(const std::string& data, std::string* password);
 };
 
 bool WinMacPasswordManager::SetPassword(const std::string& password) {
@@ -244,6 +261,11 @@ bool WinMacPasswordManager::GetPassword(std::string* password) {
     return false;
   }
 
+  return DecodePassword(enc_password, password);
+}
+
+bool WinMacPasswordManager::DecodePassword(const std::string& enc_password,
+                                           std::string* password) {
   password->clear();
   if (!Encryptor::UnprotectData(enc_password, password)) {
     LOG(ERROR) << "UnprotectData failed";
@@ -277,6 +299,42 @@ namespace {
 
 constinit absl::Mutex g_mutex(absl::kConstInit);
 
+// Returns true if the password file can still be rewritten without changing
+// `modification_time`, as the timestamp is as new as `now` in its resolution.
+bool IsRacyModificationTime(FileTimeStamp modification_time, absl::Time now) {
+  // FAT records the modification time in 2 seconds.
+  constexpr int64_t kResolutionSec = 2;
+#ifdef _WIN32
+  // FILETIME counts 100 ns since 1601-01-01.
+  constexpr int64_t kFileTimeOfUnixEpoch = 116444736000000000;
+  const int64_t now_file_time =
+      absl::ToUnixNanos(now) / 100 + kFileTimeOfUnixEpoch;
+  return static_cast<int64_t>(modification_time) + kResolutionSec * 10000000 >=
+         now_file_time;
+#else   // _WIN32
+  return modification_time + kResolutionSec >= absl::ToTimeT(now);
+#endif  // _WIN32
+}
+
+// The password read last time. Reading the password needs file IO, and
+// decryption on Windows and macOS, so it is done again only when the password
+// file is replaced, e.g. by another process or by switching the user profile
+// directory. A file modified just before it was read can be rewritten within
+// the same timestamp, so the content of such a file is compared every time
+// until its timestamp gets old enough.
+struct PasswordCache {
+  std::string filename;
+  FileTimeStamp modification_time = 0;
+  bool racy = false;
+  std::string data;
+  std::string password;
+};
+
+PasswordCache& GetPasswordCache() ABSL_EXCLUSIVE_LOCKS_REQUIRED(g_mutex) {
+  static absl::NoDestructor<PasswordCache> cache;
+  return *cache;
+}
+
 class PasswordManagerImpl {
  public:
   PasswordManagerImpl() = delete;
@@ -289,7 +347,7 @@ class PasswordManagerImpl {
 
   static bool GetPassword(std::string* password) {
     absl::MutexLock l(g_mutex);
-    if (DefaultPasswordManager::GetPassword(password)) {
+    if (GetPasswordUnlocked(password)) {
       return true;
     }
 
@@ -300,7 +358,7 @@ class PasswordManagerImpl {
       return false;
     }
 
-    if (!DefaultPasswordManager::GetPassword(password)) {
+    if (!GetPasswordUnlocked(password)) {
       LOG(ERROR) << "Cannot get password.";
       return false;
     }
@@ -310,18 +368,68 @@ class PasswordManagerImpl {
 
   static bool RemovePassword() {
     absl::MutexLock l(g_mutex);
+    GetPasswordCache() = PasswordCache();
     return DefaultPasswordManager().RemovePassword();
   }
 
  private:
-  static bool InitPasswordUnlocked() {
+  static bool InitPasswordUnlocked() ABSL_EXCLUSIVE_LOCKS_REQUIRED(g_mutex) {
     std::string password;
     if (DefaultPasswordManager::GetPassword(&password)) {
       return true;
     }
+    GetPasswordCache() = PasswordCache();
     password = CreateRandomPassword();
     return DefaultPasswordManager::SetPassword(password);
   }
+
+  static bool GetPasswordUnlocked(std::string* password)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(g_mutex) {
+    if (password == nullptr) {
+      LOG(ERROR) << "password is nullptr";
+      return false;
+    }
+
+    PasswordCache& cache = GetPasswordCache();
+    std::string filename = GetFileName();
+    // The time is taken before the file is read, so that the file modified
+    // after that doesn't keep the timestamp.
+    const absl::Time now = absl::Now();
+    const absl::StatusOr<FileTimeStamp> modification_time =
+        FileUtil::GetModificationTime(filename);
+    const bool unchanged = modification_time.ok() &&
+                           !cache.password.empty() &&
+                           cache.filename == filename &&
+                           cache.modification_time == *modification_time;
+    if (unchanged && !cache.racy) {
+      *password = cache.password;
+      return true;
+    }
+
+    std::string data;
+    if (!LoadPassword(&data)) {
+      cache = PasswordCache();
+      return false;
+    }
+    if (unchanged && cache.data == data) {
+      cache.racy = IsRacyModificationTime(cache.modification_time, now);
+      *password = cache.password;
+      return true;
+    }
+
+    cache = PasswordCache();
+    if (!DefaultPasswordManager::DecodePassword(data, password)) {
+      return false;
+    }
+    if (modification_time.ok()) {
+      cache.filename = std::move(filename);
+      cache.modification_time = *modification_time;
+      cache.racy = IsRacyModificationTime(*modification_time, now);
+      cache.data = std::move(data);
+      cache.password = *password;
+    }
+    return true;
+  }
 };
 }  // namespace
 
@@ -29,15 +29,54 @@
 
 #include "base/password_manager.h"
 
+#ifndef _WIN32
+#include <utime.h>
+#endif  // _WIN32
+
+#include <ctime>
 #include <string>
 
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "base/file_util.h"
+#include "base/system_util.h"
+#include "testing/gmock.h"
 #include "testing/gunit.h"
 #include "testing/mozctest.h"
 
 namespace mozc {
 namespace {
 
-class PasswordManagerTest : public testing::TestWithTempUserProfile {};
+class PasswordManagerTest : public testing::TestWithTempUserProfile {
+ protected:
+#ifndef _WIN32
+  static std::string GetFileName() {
+    return FileUtil::JoinPath(SystemUtil::GetUserProfileDirectory(),
+                              ".encrypt_key.db");
+  }
+
+  // Creates a new password and returns it with the content of its file.
+  static void CreatePassword(std::string* password, std::string* data) {
+    // Fails if no password is created yet.
+    PasswordManager::RemovePassword();
+    ASSERT_TRUE(PasswordManager::InitPassword());
+    ASSERT_TRUE(PasswordManager::GetPassword(password));
+    absl::StatusOr<std::string> contents = FileUtil::GetContents(GetFileName());
+    ASSERT_OK(contents);
+    *data = *std::move(contents);
+  }
+
+  // Replaces the password file as another process does.
+  static void ReplacePasswordFile(absl::string_view data,
+                                  time_t modification_time) {
+    const std::string filename = GetFileName();
+    ASSERT_OK(FileUtil::Unlink(filename));
+    ASSERT_OK(FileUtil::SetContents(filename, data));
+    const utimbuf times = {modification_time, modification_time};
+    ASSERT_EQ(::utime(filename.c_str(), &times), 0);
+  }
+#endif  // _WIN32
+};
 
 TEST_F(PasswordManagerTest, PasswordManagerTest) {
   std::string password1, password2;
@@ -57,5 +96,62 @@ TEST_F(PasswordManagerTest, PasswordManagerTest) {
   EXPECT_EQ(password1, password2);
 }
 
+#ifndef _WIN32
+TEST_F(PasswordManagerTest, CachedPassword) {
+  std::string password1, password2, data1, data2;
+  CreatePassword(&password1, &data1);
+  CreatePassword(&password2, &data2);
+  ASSERT_NE(password1, password2);
+
+  const time_t old_time = std::time(nullptr) - 3600;
+  ReplacePasswordFile(data1, old_time);
+  std::string password;
+  EXPECT_TRUE(PasswordManager::GetPassword(&password));
+  EXPECT_EQ(password, password1);
+
+  // The file isn't read again while its old timestamp is unchanged, so even
+  // another content is not noticed.
+  ReplacePasswordFile(data2, old_time);
+  EXPECT_TRUE(PasswordManager::GetPassword(&password));
+  EXPECT_EQ(password, password1);
+}
+
+TEST_F(PasswordManagerTest, ReloadRewrittenPassword) {
+  std::string password1, password2, data1, data2;
+  CreatePassword(&password1, &data1);
+  CreatePassword(&password2, &data2);
+
+  const time_t old_time = std::time(nullptr) - 3600;
+  ReplacePasswordFile(data1, old_time);
+  std::string password;
+  EXPECT_TRUE(PasswordManager::GetPassword(&password));
+  EXPECT_EQ(password, password1);
+
+  ReplacePasswordFile(data2, old_time + 1);
+  EXPECT_TRUE(PasswordManager::GetPassword(&password));
+  EXPECT_EQ(password, password2);
+}
+
+TEST_F(PasswordManagerTest, ReloadPasswordRewrittenInSameTick) {
+  std::string password1, password2, data1, data2;
+  CreatePassword(&password1, &data1);
+  CreatePassword(&password2, &data2);
+
+  // The file of the current time can be rewritten without changing the
+  // timestamp, so its content is compared.
+  const time_t now = std::time(nullptr);
+  ReplacePasswordFile(data1, now);
+  std::string password;
+  EXPECT_TRUE(PasswordManager::GetPassword(&password));
+  EXPECT_EQ(password, password1);
+
+  ReplacePasswordFile(data2, now);
+  EXPECT_TRUE(PasswordManager::GetPassword(&password));
+  EXPECT_EQ(password, password2);
+  EXPECT_TRUE(PasswordManager::GetPassword(&password));
+  EXPECT_EQ(password, password2);
+}
+#endif  // _WIN32
+
 }  // namespace
 }  // namespace mozc
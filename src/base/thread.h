@@ -30,12 +30,15 @@
 #ifndef MOZC_BASE_THREAD_H_
 #define MOZC_BASE_THREAD_H_
 
+#include <algorithm>
 #include <atomic>
+#include <cstddef>
 #include <cstdint>
 #include <functional>
 #include <memory>
 #include <optional>
 #include <utility>
+#include <vector>
 
 #include "absl/base/internal/sysinfo.h"
 #include "absl/base/thread_annotations.h"
@@ -289,6 +292,32 @@ class TaskManager {
   mutable absl::Mutex mutex_;
 };
 
+// Splits [0, size) into at most `num_threads` contiguous ranges and invokes
+// `f(begin, end)` for each of them. The first range runs on the calling thread
+// and the others on dedicated threads. Returns after all the invocations
+// finish. Ranges never overlap, so `f` may write results to per-index slots
+// without locking, which keeps the output independent of `num_threads`.
+template <class F>
+void ParallelForRanges(size_t size, int num_threads, F&& f) {
+  const size_t num_ranges =
+      std::min<size_t>(size, static_cast<size_t>(std::max(num_threads, 1)));
+  if (num_ranges <= 1) {
+    f(size_t{0}, size);
+    return;
+  }
+  const size_t range_size = (size + num_ranges - 1) / num_ranges;
+  std::vector<Thread> threads;
+  threads.reserve(num_ranges - 1);
+  for (size_t begin = range_size; begin < size; begin += range_size) {
+    const size_t end = std::min(begin + range_size, size);
+    threads.emplace_back([&f, begin, end] { f(begin, end); });
+  }
+  f(size_t{0}, range_size);
+  for (Thread& thread : threads) {
+    thread.Join();
+  }
+}
+
 // AtomicSharedPtr is a temporary implementation using mutex until
 // std::atomic<std::shared_ptr<T>> becomes available. std::atomic_load and
 // std::atomic_store will be deprecated in the future and the interface can be
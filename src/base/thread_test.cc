@@ -30,6 +30,7 @@
 #include "base/thread.h"
 
 #include <atomic>
+#include <cstddef>
 #include <functional>
 #include <memory>
 #include <mutex>
@@ -199,6 +200,29 @@ TEST(BackgroundFutureTest, AssigningToPendingFutureDoesNotCrash) {
   g = BackgroundFuture<void>([] {});
 }
 
+TEST(ParallelForRangesTest, CoversAllIndicesExactlyOnce) {
+  for (const int num_threads : {0, 1, 3, 8, 100}) {
+    std::vector<int> visited(37, 0);
+    ParallelForRanges(visited.size(), num_threads,
+                      [&visited](size_t begin, size_t end) {
+                        for (size_t i = begin; i < end; ++i) {
+                          ++visited[i];
+                        }
+                      });
+    EXPECT_EQ(visited, std::vector<int>(visited.size(), 1))
+        << "num_threads = " << num_threads;
+  }
+}
+
+TEST(ParallelForRangesTest, EmptyRange) {
+  int num_calls = 0;
+  ParallelForRanges(0, 4, [&num_calls](size_t begin, size_t end) {
+    ++num_calls;
+    EXPECT_EQ(begin, end);
+  });
+  EXPECT_EQ(num_calls, 1);
+}
+
 TEST(AtomicSharedPtrTest, BasicTest) {
   AtomicSharedPtr<const int> f1(std::make_shared<const int>(10));
   AtomicSharedPtr<const int> f2(std::make_shared<const int>(20));
@@ -37,6 +37,7 @@
 #include <memory>
 #include <ostream>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "absl/log/check.h"
@@ -54,6 +55,7 @@
 #include "client/client_interface.h"
 #include "config/config_handler.h"
 #include "ipc/ipc.h"
+#include "protocol/candidate_window.pb.h"
 #include "protocol/commands.pb.h"
 #include "protocol/config.pb.h"
 #include "session/key_info_util.h"
@@ -441,6 +443,8 @@ void Client::set_client_capability(const commands::Capability &capability) {
 
 bool Client::CreateSession() {
   id_ = 0;
+  candidate_list_version_ = 0;
+  all_candidate_words_.Clear();
   commands::Input input;
   input.set_type(commands::Input::CREATE_SESSION);
 
@@ -646,8 +650,13 @@ bool Client::Call(const commands::Input &input, commands::Output *output) {
   }
 
   // Call IPC
-  std::unique_ptr<IPCClientInterface> client(client_factory_->NewClient(
-      kServerAddress, server_launcher_->server_program()));
+  // Reuse the connection of the previous call if possible, so that a key
+  // event does not pay for connect() and the peer validation every time.
+  const bool reused = ipc_client_ != nullptr;
+  std::unique_ptr<IPCClientInterface> client =
+      reused ? std::move(ipc_client_)
+             : client_factory_->NewClient(kServerAddress,
+                                          server_launcher_->server_program());
 
   // set client protocol version.
   // When an error occurs inside Connected() function,
@@ -686,6 +695,16 @@ bool Client::Call(const commands::Input &input, commands::Output *output) {
   }
 
   if (!client->Call(request, &response_, timeout_)) {
+    if (reused && client->GetLastIPCError() == IPC_WRITE_ERROR) {
+      // The server has closed the kept connection, e.g. it has been
+      // restarted or has too many connections. Retry once on a new one.
+      // Only a request that the server hasn't read is retried: a failure to
+      // write it, or a connection closed with the request unread. Otherwise
+      // the server may have evaluated it, and a command like SEND_KEY must
+      // not be applied twice.
+      LOG(WARNING) << "Reconnecting: " << client->GetLastIPCError();
+      return Call(input, output);
+    }
     LOG(ERROR) << "Call failure" << input.DebugString();
     if (client->GetLastIPCError() == IPC_TIMEOUT_ERROR) {
       server_status_ = SERVER_TIMEOUT;
@@ -696,12 +715,17 @@ bool Client::Call(const commands::Input &input, commands::Output *output) {
     return false;
   }
 
+  if (client->IsReusable()) {
+    ipc_client_ = std::move(client);
+  }
+
   if (!output->ParseFromString(response_)) {
     LOG(ERROR) << "Parse failure of the result of the request:"
                << input.DebugString();
     server_status_ = SERVER_BROKEN_MESSAGE;
     return false;
   }
+  ApplyCandidateListDelta(output);
 
   DCHECK(server_status_ == SERVER_OK ||
          server_status_ == SERVER_INVALID_SESSION ||
@@ -732,6 +756,64 @@ void Client::InitInput(commands::Input *input) const {
   if (preferences_ != nullptr) {
     *input->mutable_config() = *preferences_;
   }
+  if (client_capability_.candidate_list_delta() &&
+      candidate_list_version_ != 0) {
+    input->set_candidate_list_version(candidate_list_version_);
+  }
+}
+
+void Client::ApplyCandidateListDelta(commands::Output *output) {
+  if (output->has_all_candidate_words_delta()) {
+    const commands::CandidateListDelta &delta =
+        output->all_candidate_words_delta();
+    if (delta.base_version() != candidate_list_version_) {
+      // The held list was dropped after the request was made, e.g. the
+      // session was recreated.
+      LOG(ERROR) << "Unknown candidate list version: " << delta.base_version();
+      candidate_list_version_ = 0;
+      all_candidate_words_.Clear();
+      output->clear_all_candidate_words_delta();
+      FetchCandidateList(output);
+      return;
+    }
+    commands::CandidateList *candidates = output->mutable_all_candidate_words();
+    *candidates = all_candidate_words_;
+    if (delta.has_focused_index()) {
+      candidates->set_focused_index(delta.focused_index());
+    } else {
+      candidates->clear_focused_index();
+    }
+    output->clear_all_candidate_words_delta();
+    return;
+  }
+  if (output->has_all_candidate_words() &&
+      output->has_candidate_list_version()) {
+    all_candidate_words_ = output->all_candidate_words();
+    candidate_list_version_ = output->candidate_list_version();
+  }
+}
+
+void Client::FetchCandidateList(commands::Output *output) {
+  commands::Input input;
+  InitInput(&input);
+  input.set_type(commands::Input::SEND_COMMAND);
+  input.mutable_command()->set_type(
+      commands::SessionCommand::GET_CANDIDATE_LIST);
+  // Without a version, the server always sends the full list. Call() keeps it
+  // as the base of later deltas.
+  input.clear_candidate_list_version();
+  commands::Output full_output;
+  if (!Call(input, &full_output)) {
+    LOG(ERROR) << "Cannot fetch the candidate list";
+    return;
+  }
+  if (full_output.has_all_candidate_words()) {
+    *output->mutable_all_candidate_words() =
+        std::move(*full_output.mutable_all_candidate_words());
+  }
+  if (full_output.has_candidate_list_version()) {
+    output->set_candidate_list_version(full_output.candidate_list_version());
+  }
 }
 
 bool Client::CheckVersionOrRestartServerInternal(const commands::Input &input,
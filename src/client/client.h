@@ -45,6 +45,7 @@
 #include "client/client_interface.h"
 #include "composer/key_event_util.h"
 #include "ipc/ipc.h"
+#include "protocol/candidate_window.pb.h"
 #include "protocol/commands.pb.h"
 #include "protocol/config.pb.h"
 
@@ -96,6 +97,7 @@ class Client : public ClientInterface {
 
   void SetIPCClientFactory(IPCClientFactoryInterface* client_factory) override {
     client_factory_ = client_factory;
+    ipc_client_.reset();
   }
 
   // set ServerLauncher.
@@ -215,6 +217,15 @@ class Client : public ClientInterface {
   bool CallAndCheckVersion(const commands::Input& input,
                            commands::Output* output);
 
+  // Replaces all_candidate_words_delta in |output| with the full
+  // all_candidate_words, and keeps full lists as the base of later deltas.
+  // If the delta doesn't apply to the list the client holds, the full list is
+  // fetched from the server instead.
+  void ApplyCandidateListDelta(commands::Output* output);
+
+  // Fetches the full all_candidate_words of the current state into |output|.
+  void FetchCandidateList(commands::Output* output);
+
   // Making a journal inputs to restore
   // the current state even when mozc_server crashes
   void PlaybackHistory();
@@ -241,6 +252,8 @@ class Client : public ClientInterface {
 
   uint64_t id_;
   IPCClientFactoryInterface* client_factory_;
+  // The connection kept for the next Call() when it is reusable.
+  std::unique_ptr<IPCClientInterface> ipc_client_;
   std::unique_ptr<ServerLauncherInterface> server_launcher_;
   std::unique_ptr<config::Config> preferences_;
   std::unique_ptr<commands::Request> request_;
@@ -256,6 +269,9 @@ class Client : public ClientInterface {
   // Remember the composition mode of input session for playback.
   commands::CompositionMode last_mode_;
   commands::Capability client_capability_;
+  // The last all_candidate_words and its version, used to apply deltas.
+  commands::CandidateList all_candidate_words_;
+  uint64_t candidate_list_version_ = 0;
 };
 
 class ClientFactory {
@@ -49,6 +49,7 @@
 #include "config/config_handler.h"
 #include "ipc/ipc.h"
 #include "ipc/ipc_mock.h"
+#include "protocol/candidate_window.pb.h"
 #include "protocol/commands.pb.h"
 #include "protocol/config.pb.h"
 #include "testing/gunit.h"
@@ -256,6 +257,65 @@ TEST_F(ClientTest, ConnectionError) {
   EXPECT_FALSE(client_->SendCommand(command, &output));
 }
 
+TEST_F(ClientTest, CandidateListDeltaVersionMismatch) {
+  const int mock_id = 123;
+  EXPECT_TRUE(SetupConnection(mock_id));
+  commands::Capability capability;
+  capability.set_candidate_list_delta(true);
+  client_->set_client_capability(capability);
+
+  // The server sends a delta against a list the client doesn't hold.
+  commands::Output delta_output;
+  delta_output.set_id(mock_id);
+  delta_output.set_candidate_list_version(1);
+  delta_output.mutable_all_candidate_words_delta()->set_base_version(1);
+  delta_output.mutable_all_candidate_words_delta()->set_focused_index(1);
+  std::string response;
+  delta_output.SerializeToString(&response);
+  client_factory_->AddMockResponse(response);
+
+  // The full list is fetched before SendKey() returns.
+  commands::Output full_output;
+  full_output.set_id(mock_id);
+  full_output.set_candidate_list_version(2);
+  commands::CandidateList* candidates =
+      full_output.mutable_all_candidate_words();
+  candidates->set_focused_index(1);
+  for (int i = 0; i < 3; ++i) {
+    candidates->add_candidates()->set_value(absl::StrCat("value", i));
+  }
+  SetMockOutput(full_output);
+
+  commands::KeyEvent key_event;
+  key_event.set_special_key(commands::KeyEvent::SPACE);
+  commands::Output output;
+  EXPECT_TRUE(client_->SendKey(key_event, &output));
+  EXPECT_FALSE(output.has_all_candidate_words_delta());
+  EXPECT_EQ(output.all_candidate_words().candidates_size(), 3);
+  EXPECT_EQ(output.all_candidate_words().focused_index(), 1);
+  EXPECT_EQ(output.candidate_list_version(), 2);
+
+  commands::Input input;
+  GetGeneratedInput(&input);
+  EXPECT_EQ(input.type(), commands::Input::SEND_COMMAND);
+  EXPECT_EQ(input.command().type(),
+            commands::SessionCommand::GET_CANDIDATE_LIST);
+  EXPECT_FALSE(input.has_candidate_list_version());
+
+  // The fetched list is the base of the next delta.
+  delta_output.set_candidate_list_version(2);
+  delta_output.mutable_all_candidate_words_delta()->set_base_version(2);
+  delta_output.mutable_all_candidate_words_delta()->set_focused_index(2);
+  SetMockOutput(delta_output);
+  output.Clear();
+  EXPECT_TRUE(client_->SendKey(key_event, &output));
+  EXPECT_EQ(output.all_candidate_words().candidates_size(), 3);
+  EXPECT_EQ(output.all_candidate_words().focused_index(), 2);
+  GetGeneratedInput(&input);
+  EXPECT_EQ(input.type(), commands::Input::SEND_KEY);
+  EXPECT_EQ(input.candidate_list_version(), 2);
+}
+
 TEST_F(ClientTest, SendKey) {
   const int mock_id = 123;
   EXPECT_TRUE(SetupConnection(mock_id));
@@ -49,6 +49,7 @@
 #include "base/clock.h"
 #include "base/container/flat_multimap.h"
 #include "base/japanese_util.h"
+#include "base/metrics.h"
 #include "base/strings/assign.h"
 #include "base/strings/unicode.h"
 #include "base/util.h"
@@ -63,6 +64,7 @@
 #include "config/config_handler.h"
 #include "protocol/commands.pb.h"
 #include "protocol/config.pb.h"
+#include "protocol/session_snapshot.pb.h"
 #include "transliteration/transliteration.h"
 
 namespace mozc {
@@ -852,6 +854,7 @@ bool Composer::InsertCharacterKeyAndPreedit(const absl::string_view key,
 }
 
 bool Composer::InsertCharacterKeyEvent(const commands::KeyEvent& key) {
+  ScopedLatency latency(MetricsRegistry::GetStage(MetricsRegistry::COMPOSER));
   if (!EnableInsert()) {
     return false;
   }
@@ -1380,6 +1383,89 @@ bool Composer::IsToggleable() const {
   return !is_new_input_ && composition_.IsToggleable(position_);
 }
 
+namespace {
+
+bool IsValidTransliterator(int32_t transliterator) {
+  return transliterator >= Transliterators::CONVERSION_STRING &&
+         transliterator < Transliterators::LOCAL;
+}
+
+bool IsValidTransliterationType(int32_t type) {
+  return type >= 0 && type < transliteration::NUM_T13N_TYPES;
+}
+
+}  // namespace
+
+void Composer::SaveSnapshot(commands::ComposerSnapshot* snapshot) const {
+  DCHECK(snapshot);
+  snapshot->Clear();
+  for (const CharChunk& chunk : composition_.chunks()) {
+    commands::ComposerSnapshot::Chunk* out = snapshot->add_chunks();
+    out->set_raw(chunk.raw());
+    out->set_conversion(chunk.conversion());
+    out->set_pending(chunk.pending());
+    out->set_ambiguous(chunk.ambiguous());
+    out->set_transliterator(chunk.transliterator());
+    out->set_attributes(chunk.attributes());
+  }
+  snapshot->set_input_transliterator(composition_.input_t12r());
+  snapshot->set_position(position_);
+  snapshot->set_input_mode(input_mode_);
+  snapshot->set_output_mode(output_mode_);
+  snapshot->set_comeback_input_mode(comeback_input_mode_);
+  snapshot->set_input_field_type(input_field_type_);
+  snapshot->set_shifted_sequence_count(shifted_sequence_count_);
+  snapshot->set_source_text(source_text_);
+  snapshot->set_is_new_input(is_new_input_);
+}
+
+bool Composer::RestoreSnapshot(const commands::ComposerSnapshot& snapshot) {
+  Reset();
+  if (!IsValidTransliterator(snapshot.input_transliterator()) ||
+      !IsValidTransliterationType(snapshot.input_mode()) ||
+      !IsValidTransliterationType(snapshot.output_mode()) ||
+      !IsValidTransliterationType(snapshot.comeback_input_mode())) {
+    LOG(ERROR) << "Invalid modes in the composer snapshot";
+    return false;
+  }
+
+  composition_.SetInputMode(static_cast<Transliterators::Transliterator>(
+      snapshot.input_transliterator()));
+  for (const commands::ComposerSnapshot::Chunk& in : snapshot.chunks()) {
+    if (!IsValidTransliterator(in.transliterator())) {
+      LOG(ERROR) << "Invalid transliterator in the composer snapshot";
+      Reset();
+      return false;
+    }
+    CharChunk& chunk = *composition_.InsertChunk(composition_.chunks().end());
+    chunk.set_raw(in.raw());
+    chunk.set_conversion(in.conversion());
+    chunk.set_pending(in.pending());
+    chunk.set_ambiguous(in.ambiguous());
+    chunk.SetTransliterator(
+        static_cast<Transliterators::Transliterator>(in.transliterator()));
+    chunk.set_attributes(in.attributes());
+  }
+  if (snapshot.position() > composition_.GetLength()) {
+    LOG(ERROR) << "Cursor position is out of the composition";
+    Reset();
+    return false;
+  }
+
+  position_ = snapshot.position();
+  input_mode_ = static_cast<transliteration::TransliterationType>(
+      snapshot.input_mode());
+  output_mode_ = static_cast<transliteration::TransliterationType>(
+      snapshot.output_mode());
+  comeback_input_mode_ = static_cast<transliteration::TransliterationType>(
+      snapshot.comeback_input_mode());
+  input_field_type_ = snapshot.input_field_type();
+  shifted_sequence_count_ = snapshot.shifted_sequence_count();
+  source_text_ = snapshot.source_text();
+  is_new_input_ = snapshot.is_new_input();
+  return true;
+}
+
 void Composer::set_source_text(const absl::string_view source_text) {
   strings::Assign(source_text_, source_text);
 }
@@ -49,6 +49,7 @@
 #include "composer/transliterators.h"
 #include "protocol/commands.pb.h"
 #include "protocol/config.pb.h"
+#include "protocol/session_snapshot.pb.h"
 #include "transliteration/transliteration.h"
 
 namespace mozc {
@@ -353,6 +354,14 @@ class Composer final {
   // Returns true when the current character at cursor position is toggleable.
   bool IsToggleable() const;
 
+  // Records the composition and the modes into |snapshot|. The table, the
+  // request and the config are not recorded; they are owned by the session.
+  void SaveSnapshot(commands::ComposerSnapshot* snapshot) const;
+
+  // Replaces the composition and the modes with |snapshot|. Returns false and
+  // leaves this composer reset if |snapshot| is inconsistent.
+  bool RestoreSnapshot(const commands::ComposerSnapshot& snapshot);
+
   bool is_new_input() const { return is_new_input_; }
   size_t shifted_sequence_count() const { return shifted_sequence_count_; }
   absl::string_view source_text() const { return source_text_; }
@@ -29,6 +29,7 @@
 
 #include "composer/composition.h"
 
+#include <algorithm>
 #include <cstddef>
 #include <iterator>
 #include <memory>
@@ -52,7 +53,11 @@
 namespace mozc {
 namespace composer {
 
-void Composition::Erase() { chunks_.clear(); }
+void Composition::Erase() {
+  chunks_.clear();
+  local_results_.clear();
+  local_result_ends_.clear();
+}
 
 size_t Composition::InsertAt(size_t pos, std::string input) {
   CompositionInput composition_input;
@@ -79,16 +84,18 @@ size_t Composition::InsertInput(size_t pos, CompositionInput input) {
     ++right_chunk;
   }
 
+  // The right chunk always follows the left chunk below. Since insertions
+  // invalidate `right_chunk`, it is referred to as std::next(left_chunk).
   CharChunkList::iterator left_chunk = GetInsertionChunk(right_chunk);
 
-  CombinePendingChunks(left_chunk, input);
+  left_chunk = CombinePendingChunks(left_chunk, input);
 
   while (true) {
     left_chunk->AddCompositionInput(&input);
     if (input.Empty()) {
       break;
     }
-    left_chunk = InsertChunk(right_chunk);
+    left_chunk = InsertChunk(std::next(left_chunk));
     input.set_is_new_input(false);
   }
 
@@ -96,9 +103,12 @@ size_t Composition::InsertInput(size_t pos, CompositionInput input) {
   // the empty chunk.
   if (left_chunk->raw().empty() && left_chunk->conversion().empty() &&
       left_chunk->pending().empty()) {
-    chunks_.erase(left_chunk);
+    right_chunk = chunks_.erase(left_chunk);
+  } else {
+    right_chunk = std::next(left_chunk);
   }
 
+  UpdateLocalResults();
   return GetPosition(Transliterators::LOCAL, right_chunk);
 }
 
@@ -133,6 +143,7 @@ size_t Composition::DeleteAt(const size_t position) {
       LOG(WARNING) << "SplitChunk: " << left_deleted_chunk.status();
     }
   }
+  UpdateLocalResults();
   return new_position;
 }
 
@@ -221,6 +232,7 @@ void Composition::SetTransliterator(
     ++chunk_it;
   }
   end_it->SetTransliterator(transliterator);
+  UpdateLocalResults();
 }
 
 Transliterators::Transliterator Composition::GetTransliterator(
@@ -236,6 +248,41 @@ size_t Composition::GetLength() const {
   return GetPosition(Transliterators::LOCAL, chunks_.end());
 }
 
+void Composition::AppendLocalResults(const size_t end_index,
+                                     std::string* result) const {
+  const size_t cached_size = std::min(end_index, local_result_ends_.size());
+  if (cached_size > 0) {
+    const size_t bytes = local_result_ends_[cached_size - 1].bytes;
+    result->append(local_results_, 0, bytes);
+  }
+  for (size_t i = cached_size; i < end_index; ++i) {
+    chunks_[i].AppendResult(Transliterators::LOCAL, result);
+  }
+}
+
+void Composition::InvalidateLocalResults(const size_t index) {
+  if (index >= local_result_ends_.size()) {
+    return;
+  }
+  local_result_ends_.resize(index);
+  local_results_.resize(index == 0 ? 0 : local_result_ends_.back().bytes);
+}
+
+void Composition::UpdateLocalResults() {
+  LocalResultEnd end;
+  if (!local_result_ends_.empty()) {
+    end = local_result_ends_.back();
+  }
+  local_result_ends_.reserve(chunks_.size());
+  for (size_t i = local_result_ends_.size(); i < chunks_.size(); ++i) {
+    chunks_[i].AppendResult(Transliterators::LOCAL, &local_results_);
+    end.length += Util::CharsLen(
+        absl::string_view(local_results_).substr(end.bytes));
+    end.bytes = local_results_.size();
+    local_result_ends_.push_back(end);
+  }
+}
+
 std::string Composition::GetStringWithModes(
     Transliterators::Transliterator transliterator,
     const TrimMode trim_mode) const {
@@ -245,10 +292,14 @@ std::string Composition::GetStringWithModes(
     return std::string();
   }
 
-  CharChunkList::const_iterator it;
+  const CharChunkList::const_iterator it = std::prev(chunks_.end());
   std::string composition;
-  for (it = chunks_.begin(); it != std::prev(chunks_.end()); ++it) {
-    it->AppendResult(transliterator, &composition);
+  if (transliterator == Transliterators::LOCAL) {
+    AppendLocalResults(chunks_.size() - 1, &composition);
+  } else {
+    for (auto prev_it = chunks_.begin(); prev_it != it; ++prev_it) {
+      prev_it->AppendResult(transliterator, &composition);
+    }
   }
 
   switch (trim_mode) {
@@ -277,10 +328,7 @@ Composition::GetExpandedStrings() const {
   }
 
   std::string base;
-  CharChunkList::const_iterator it;
-  for (it = chunks_.begin(); it != std::prev(chunks_.end()); ++it) {
-    it->AppendResult(transliterator, &base);
-  }
+  AppendLocalResults(chunks_.size() - 1, &base);
 
   chunks_.back().AppendTrimedResult(transliterator, &base);
   // Get expanded from the last chunk
@@ -296,10 +344,7 @@ std::string Composition::GetString() const {
   }
 
   std::string composition;
-  for (CharChunkList::const_iterator it = chunks_.begin(); it != chunks_.end();
-       ++it) {
-    it->AppendResult(Transliterators::LOCAL, &composition);
-  }
+  AppendLocalResults(chunks_.size(), &composition);
   return composition;
 }
 
@@ -320,21 +365,41 @@ void Composition::GetPreedit(size_t position, std::string* left,
   Util::Utf8SubString(composition, position + 1, std::string::npos, right);
 }
 
-// This function is essentially a const function, but it cannot be const because
-// it outputs a mutable CharChunkList::iterator.  Const version is provided
-// below.
+// The caller may modify the returned chunk, so its cached result is dropped.
 CharChunkList::iterator Composition::GetChunkAt(
     const size_t position, Transliterators::Transliterator transliterator,
     size_t* inner_position) {
+  const CharChunkList::const_iterator const_it =
+      std::as_const(*this).GetChunkAt(position, transliterator, inner_position);
+  const CharChunkList::iterator it =
+      chunks_.begin() + (const_it - chunks_.cbegin());
+  InvalidateLocalResults(it);
+  return it;
+}
+
+CharChunkList::const_iterator Composition::GetChunkAt(
+    size_t position, Transliterators::Transliterator transliterator,
+    size_t* inner_position) const {
   if (chunks_.empty()) {
     *inner_position = 0;
     return chunks_.begin();
   }
 
   size_t chunk_offset = 0;
-  size_t chunk_length = 0;
-  for (auto it = chunks_.begin(); it != chunks_.end(); ++it) {
-    chunk_length = it->GetLength(transliterator);
+  CharChunkList::const_iterator it = chunks_.begin();
+  if (transliterator == Transliterators::LOCAL) {
+    // Skips the cached chunks ending before `position`.
+    const auto end_it = absl::c_lower_bound(
+        local_result_ends_, position,
+        [](const LocalResultEnd& end, size_t pos) { return end.length < pos; });
+    const size_t index = end_it - local_result_ends_.begin();
+    if (index > 0) {
+      chunk_offset = local_result_ends_[index - 1].length;
+    }
+    it += index;
+  }
+  for (; it != chunks_.end(); ++it) {
+    const size_t chunk_length = it->GetLength(transliterator);
     if (chunk_offset + chunk_length < position) {
       chunk_offset += chunk_length;
       continue;
@@ -342,25 +407,25 @@ CharChunkList::iterator Composition::GetChunkAt(
     *inner_position = position - chunk_offset;
     return it;
   }
-  auto it = std::prev(chunks_.end());
+  it = std::prev(chunks_.end());
   // Inner position here is the end of the last chunk.
-  *inner_position = chunk_length;
+  *inner_position = it->GetLength(transliterator);
   return it;
 }
 
-CharChunkList::const_iterator Composition::GetChunkAt(
-    size_t position, Transliterators::Transliterator transliterator,
-    size_t* inner_position) const {
-  // This const_cast is safe as GetChunkAt() above doesn't mutate any members.
-  return const_cast<Composition*>(this)->GetChunkAt(position, transliterator,
-                                                    inner_position);
-}
-
 size_t Composition::GetPosition(Transliterators::Transliterator transliterator,
                                 CharChunkList::const_iterator cur_it) const {
   size_t position = 0;
-  CharChunkList::const_iterator it;
-  for (it = chunks_.begin(); it != cur_it; ++it) {
+  CharChunkList::const_iterator it = chunks_.begin();
+  if (transliterator == Transliterators::LOCAL) {
+    const size_t cached_size = std::min<size_t>(cur_it - chunks_.begin(),
+                                                local_result_ends_.size());
+    if (cached_size > 0) {
+      position = local_result_ends_[cached_size - 1].length;
+    }
+    it += cached_size;
+  }
+  for (; it != cur_it; ++it) {
     position += it->GetLength(transliterator);
   }
   return position;
@@ -384,37 +449,39 @@ CharChunkList::iterator Composition::MaybeSplitChunkAt(const size_t position) {
   absl::StatusOr<CharChunk> left_chunk =
       chunk.SplitChunk(Transliterators::LOCAL, inner_position);
   if (left_chunk.ok()) {
-    chunks_.insert(it, *std::move(left_chunk));
+    it = std::next(chunks_.insert(it, *std::move(left_chunk)));
   }
   return it;
 }
 
-void Composition::CombinePendingChunks(CharChunkList::iterator it,
-                                       const CompositionInput& input) {
+CharChunkList::iterator Composition::CombinePendingChunks(
+    CharChunkList::iterator it, const CompositionInput& input) {
   // If the input is asis, pending chunks are not related with this input.
   if (input.is_asis()) {
-    return;
+    return it;
   }
   // Combine |**it| and |**(--it)| into |**it| as long as possible.
   const absl::string_view next_input =
       input.conversion().empty() ? input.raw() : input.conversion();
 
   while (it != chunks_.begin()) {
-    CharChunkList::iterator left_it = it;
-    --left_it;
+    CharChunkList::iterator left_it = std::prev(it);
     if (!left_it->IsConvertible(input_t12r_, *table_,
                                 absl::StrCat(it->pending(), next_input))) {
-      return;
+      return it;
     }
 
+    InvalidateLocalResults(left_it);
     it->Combine(*left_it);
-    chunks_.erase(left_it);
+    it = chunks_.erase(left_it);
   }
+  return it;
 }
 
 // Insert a chunk to the prev of it.
 CharChunkList::iterator Composition::InsertChunk(
     CharChunkList::const_iterator it) {
+  InvalidateLocalResults(it);
   return chunks_.insert(it, CharChunk(input_t12r_, table_));
 }
 
@@ -434,6 +501,7 @@ CharChunkList::iterator Composition::GetInsertionChunk(
 
   const CharChunkList::iterator left_it = std::prev(it);
   if (left_it->IsAppendable(input_t12r_, *table_)) {
+    InvalidateLocalResults(left_it);
     return left_it;
   }
   return InsertChunk(it);
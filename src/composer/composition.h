@@ -31,11 +31,11 @@
 #define MOZC_COMPOSER_COMPOSITION_H_
 
 #include <cstddef>
-#include <list>
 #include <memory>
 #include <string>
 #include <tuple>
 #include <utility>
+#include <vector>
 
 #include "absl/container/btree_set.h"
 #include "absl/log/check.h"
@@ -49,7 +49,9 @@
 namespace mozc {
 namespace composer {
 
-using CharChunkList = std::list<CharChunk>;
+// Chunks are stored contiguously. Note that inserting or erasing a chunk
+// invalidates the iterators after it.
+using CharChunkList = std::vector<CharChunk>;
 
 enum TrimMode {
   TRIM,  // "かn" => "か"
@@ -150,6 +152,8 @@ class Composition final {
   bool IsToggleable(size_t position) const;
 
   // Following methods are declared as public for unit test.
+  // The chunks returned via mutable iterators are regarded as modified, and
+  // are excluded from the cached preedit until the next edit operation.
 
   // Return the focused CharChunk iterator at the `position`,
   // and fill `inner_position` as the position inside the returned CharChunk.
@@ -168,6 +172,7 @@ class Composition final {
   // The argument `it` is the focused CharChunk by the cursor.
   CharChunkList::iterator GetInsertionChunk(CharChunkList::iterator it);
 
+  // Insert a new CharChunk before `it` and return the iterator to it.
   CharChunkList::iterator InsertChunk(CharChunkList::const_iterator it);
 
   // Return the iterator to the right side CharChunk at the `position`.
@@ -196,8 +201,9 @@ class Composition final {
   //      into [pending='q']+[pending='ky'] because [pending='ky']+[input='o']
   //      can turn to be a fixed chunk.
   // e.g. [pending='k']+[pending='y']+[input='q'] are not combined.
-  void CombinePendingChunks(CharChunkList::iterator it,
-                            const CompositionInput& input);
+  // Return the iterator to the combined chunk, as `it` is invalidated.
+  CharChunkList::iterator CombinePendingChunks(CharChunkList::iterator it,
+                                               const CompositionInput& input);
   const CharChunkList& GetCharChunkList() const;
   std::shared_ptr<const Table> table_for_testing() const { return table_; }
   const CharChunkList& chunks() const { return chunks_; }
@@ -219,13 +225,37 @@ class Composition final {
   }
 
  private:
+  // Cumulative length and byte size of the LOCAL results up to a chunk.
+  struct LocalResultEnd {
+    size_t length = 0;
+    size_t bytes = 0;
+  };
+
   std::string GetStringWithModes(Transliterators::Transliterator transliterator,
                                  TrimMode trim_mode) const;
 
+  // Appends the LOCAL results of the chunks in [0, end_index) to `result`.
+  void AppendLocalResults(size_t end_index, std::string* result) const;
+
+  // Drops the cached LOCAL results of the chunks at `index` and after, as
+  // they are about to be modified.
+  void InvalidateLocalResults(size_t index);
+  void InvalidateLocalResults(CharChunkList::const_iterator it) {
+    InvalidateLocalResults(it - chunks_.cbegin());
+  }
+  // Caches the LOCAL results of the chunks not cached yet. Called at the end
+  // of each edit operation, which usually modifies only the last few chunks.
+  void UpdateLocalResults();
+
   std::shared_ptr<const Table> table_;
   CharChunkList chunks_;
   Transliterators::Transliterator input_t12r_ =
       Transliterators::CONVERSION_STRING;
+
+  // The concatenated LOCAL results of the leading chunks, i.e. the preedit,
+  // and their ends. Only chunks_[0, local_result_ends_.size()) are cached.
+  std::string local_results_;
+  std::vector<LocalResultEnd> local_result_ends_;
 };
 
 }  // namespace composer
@@ -97,10 +97,11 @@ static int InitComposition(Composition& comp) {
   CharChunkList::iterator it = comp.MaybeSplitChunkAt(0);
   for (int i = 0; i < test_chunks_size; ++i) {
     const TestCharChunk& data = test_chunks[i];
-    CharChunk& chunk = *comp.InsertChunk(it);
-    chunk.set_conversion(data.conversion);
-    chunk.set_pending(data.pending);
-    chunk.set_raw(data.raw);
+    it = comp.InsertChunk(it);
+    it->set_conversion(data.conversion);
+    it->set_pending(data.pending);
+    it->set_raw(data.raw);
+    ++it;
   }
   return test_chunks_size;
 }
@@ -431,9 +432,10 @@ TEST_F(CompositionTest, DeleteAtInvisibleCharacter) {
     composition.Erase();
     CharChunkList::iterator it = composition.MaybeSplitChunkAt(0);
     for (const auto& item : data) {
-      CharChunk& chunk = *composition.InsertChunk(it);
-      chunk.set_raw(table_->ParseSpecialKey(item.first));
-      chunk.set_pending(table_->ParseSpecialKey(item.second));
+      it = composition.InsertChunk(it);
+      it->set_raw(table_->ParseSpecialKey(item.first));
+      it->set_pending(table_->ParseSpecialKey(item.second));
+      ++it;
     }
   };
 
@@ -1147,7 +1149,7 @@ TEST_F(CompositionTest, CombinePendingChunks) {
 
     CompositionInput input;
     SetInput("n", "", false, &input);
-    comp.CombinePendingChunks(chunk_it, input);
+    chunk_it = comp.CombinePendingChunks(chunk_it, input);
     EXPECT_EQ(chunk_it->pending(), "");
     EXPECT_EQ(chunk_it->conversion(), "");
     EXPECT_EQ(chunk_it->raw(), "");
@@ -1167,7 +1169,7 @@ TEST_F(CompositionTest, CombinePendingChunks) {
     CompositionInput input;
     SetInput("n", "", false, &input);
 
-    comp.CombinePendingChunks(chunk_it, input);
+    chunk_it = comp.CombinePendingChunks(chunk_it, input);
     EXPECT_EQ(chunk_it->pending(), "");
     EXPECT_EQ(chunk_it->conversion(), "");
     EXPECT_EQ(chunk_it->raw(), "");
@@ -1188,7 +1190,7 @@ TEST_F(CompositionTest, CombinePendingChunks) {
     CompositionInput input;
     SetInput("a", "", false, &input);
 
-    comp.CombinePendingChunks(chunk_it, input);
+    chunk_it = comp.CombinePendingChunks(chunk_it, input);
     EXPECT_EQ(chunk_it->pending(), "ny");
     EXPECT_EQ(chunk_it->conversion(), "");
     EXPECT_EQ(chunk_it->raw(), "ny");
@@ -1210,7 +1212,7 @@ TEST_F(CompositionTest, CombinePendingChunks) {
     CompositionInput input;
     SetInput("a", "", false, &input);
 
-    comp.CombinePendingChunks(chunk_it, input);
+    chunk_it = comp.CombinePendingChunks(chunk_it, input);
     EXPECT_EQ(chunk_it->pending(), "ny");
     EXPECT_EQ(chunk_it->conversion(), "");
     EXPECT_EQ(chunk_it->raw(), "ny");
@@ -1234,7 +1236,7 @@ TEST_F(CompositionTest, CombinePendingChunks) {
     CompositionInput input;
     SetInput("x", "a", false, &input);
 
-    comp.CombinePendingChunks(chunk_it, input);
+    chunk_it = comp.CombinePendingChunks(chunk_it, input);
     EXPECT_EQ(chunk_it->pending(), "ny");
     EXPECT_EQ(chunk_it->conversion(), "");
     EXPECT_EQ(chunk_it->raw(), "ny");
@@ -1691,6 +1693,51 @@ TEST_F(CompositionTest, Copy) {
   EXPECT_EQ(copy2, src);
 }
 
+TEST_F(CompositionTest, LongComposition) {
+  table_->AddRule("ka", "か", "");
+  table_->AddRule("n", "ん", "");
+  table_->AddRule("nn", "ん", "");
+
+  // Recomputes the preedit from the chunks without the cached results.
+  auto get_expected_string = [](const Composition& composition) {
+    std::string result;
+    for (const CharChunk& chunk : composition.GetCharChunkList()) {
+      chunk.AppendResult(Transliterators::LOCAL, &result);
+    }
+    return result;
+  };
+
+  size_t pos = 0;
+  for (int i = 0; i < 300; ++i) {
+    pos = composition_.InsertAt(pos, "k");
+    pos = composition_.InsertAt(pos, "a");
+  }
+  EXPECT_EQ(composition_.GetLength(), 300);
+  EXPECT_EQ(composition_.GetString(), get_expected_string(composition_));
+
+  // Edits in the middle.
+  pos = composition_.InsertAt(150, "n");
+  EXPECT_EQ(pos, 151);
+  EXPECT_EQ(composition_.DeleteAt(10), 10);
+  EXPECT_EQ(composition_.GetLength(), 300);
+  EXPECT_EQ(composition_.GetString(), get_expected_string(composition_));
+  EXPECT_EQ(composition_.GetStringWithTrimMode(FIX),
+            composition_.GetString());
+
+  composition_.SetTransliterator(0, 100, Transliterators::FULL_KATAKANA);
+  const std::string expected = get_expected_string(composition_);
+  EXPECT_EQ(composition_.GetString(), expected);
+  EXPECT_TRUE(expected.starts_with("カカ"));
+  EXPECT_EQ(composition_.GetLength(), 300);
+
+  size_t inner_position = 0;
+  composition_.GetChunkAt(200, Transliterators::LOCAL, &inner_position);
+  EXPECT_EQ(inner_position, 1);
+  EXPECT_EQ(composition_.ConvertPosition(300, Transliterators::LOCAL,
+                                         Transliterators::RAW_STRING),
+            599);
+}
+
 TEST_F(CompositionTest, IsToggleable) {
   constexpr int kAttrs =
       TableAttribute::NEW_CHUNK | TableAttribute::NO_TRANSLITERATION;
@@ -30,6 +30,7 @@
 #ifndef MOZC_COMPOSER_SPECIAL_KEY_H_
 #define MOZC_COMPOSER_SPECIAL_KEY_H_
 
+#include <cstddef>
 #include <string>
 
 #include "absl/container/flat_hash_map.h"
@@ -47,6 +48,9 @@ class SpecialKeyMap {
   // the parsed string.
   std::string Parse(absl::string_view input) const;
 
+  // Returns the number of the registered special keys.
+  size_t size() const { return map_.size(); }
+
  private:
   absl::flat_hash_map<std::string, std::string> map_;
 };
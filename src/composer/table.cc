@@ -34,6 +34,7 @@
 #include <cstddef>
 #include <cstdint>
 #include <istream>  // NOLINT
+#include <iterator>
 #include <memory>
 #include <sstream>
 #include <streambuf>
@@ -43,12 +44,15 @@
 
 #include "absl/base/no_destructor.h"
 #include "absl/base/nullability.h"
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
 #include "absl/hash/hash.h"
 #include "absl/log/check.h"
 #include "absl/log/log.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_split.h"
 #include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
 #include "base/config_file_stream.h"
 #include "base/hash.h"
 #include "base/util.h"
@@ -106,6 +110,16 @@ constexpr char k50KeysHiraganaTableFile[] = "system://50keys-hiragana.tsv";
 
 constexpr char kNewChunkPrefix[] = "\t";
 
+constexpr absl::string_view kSystemFilePrefix = "system://";
+
+// Special keys registered to every table.
+constexpr absl::string_view kPredefinedSpecialKeys[] = {
+    "{?}",  // toggle
+    "{*}",  // internal state
+    "{<}",  // rewind
+    "{!}",  // timeout
+};
+
 }  // namespace
 
 // ========================================
@@ -122,11 +136,9 @@ Entry::Entry(const absl::string_view input, const absl::string_view result,
 // Table
 // ========================================
 Table::Table() {
-  // Add predefined special keys.
-  special_key_map_.Register("{?}");  // toggle
-  special_key_map_.Register("{*}");  // internal state
-  special_key_map_.Register("{<}");  // rewind
-  special_key_map_.Register("{!}");  // timeout
+  for (const absl::string_view key : kPredefinedSpecialKeys) {
+    special_key_map_.Register(key);
+  }
 }
 
 constexpr absl::string_view kKuten = "、";
@@ -429,6 +441,17 @@ bool Table::LoadFromString(absl::string_view str) {
 }
 
 bool Table::LoadFromFile(absl::string_view filepath) {
+  // Rules are added one by one and may override or loop with the existing
+  // ones, so only an empty table can take over the parsed system table.
+  if (filepath.starts_with(kSystemFilePrefix) && IsEmpty()) {
+    const std::shared_ptr<const Table> table = GetSharedSystemTable(filepath);
+    if (table == nullptr) {
+      return false;
+    }
+    CopyRulesFrom(*table);
+    return true;
+  }
+
   std::unique_ptr<std::istream> ifs(ConfigFileStream::LegacyOpen(filepath));
   if (ifs == nullptr) {
     return false;
@@ -554,6 +577,50 @@ bool Table::HasSubRules(const absl::string_view input) const {
 
 void Table::DeleteEntry(const Entry* entry) { entry_set_.erase(entry); }
 
+bool Table::IsEmpty() const {
+  return entry_set_.empty() &&
+         special_key_map_.size() == std::size(kPredefinedSpecialKeys);
+}
+
+void Table::CopyRulesFrom(const Table& table) {
+  DCHECK(IsEmpty());
+  // `entry_set_` holds only the live entries, so adding them in any order
+  // reproduces the trie.
+  for (const std::shared_ptr<const Entry>& entry : table.entry_set_) {
+    entries_.AddEntry(entry->input(), entry.get());
+  }
+  entry_set_ = table.entry_set_;
+  // Special keys are numbered in the order of registration, so the map is
+  // copied as a whole to keep the entries valid.
+  special_key_map_ = table.special_key_map_;
+  case_sensitive_ = case_sensitive_ || table.case_sensitive_;
+}
+
+// static
+std::shared_ptr<const Table> Table::GetSharedSystemTable(
+    absl::string_view filepath) {
+  struct SystemTables {
+    absl::Mutex mutex;
+    absl::flat_hash_map<std::string, std::shared_ptr<const Table>> tables
+        ABSL_GUARDED_BY(mutex);
+  };
+  static absl::NoDestructor<SystemTables> system_tables;
+
+  absl::MutexLock lock(&system_tables->mutex);
+  if (const auto it = system_tables->tables.find(filepath);
+      it != system_tables->tables.end()) {
+    return it->second;
+  }
+  std::unique_ptr<std::istream> ifs(ConfigFileStream::LegacyOpen(filepath));
+  if (ifs == nullptr) {
+    return nullptr;
+  }
+  auto table = std::make_shared<Table>();
+  table->LoadFromStream(ifs.get());
+  system_tables->tables.emplace(filepath, table);
+  return table;
+}
+
 bool Table::case_sensitive() const { return case_sensitive_; }
 
 void Table::set_case_sensitive(const bool case_sensitive) {
@@ -144,9 +144,22 @@ class Table final {
   bool LoadFromStream(std::istream* is);
   void DeleteEntry(const Entry* entry);
 
+  // Returns true if no rule has been added to the table yet.
+  bool IsEmpty() const;
+
+  // Copies all the rules of `table` into this empty table. The entries are
+  // immutable, so they are shared with `table` instead of being duplicated.
+  void CopyRulesFrom(const Table& table);
+
+  // Returns the table of the system rule file `filepath`. Each system rule
+  // file is parsed only once in the process, since it is embedded in the
+  // binary. Returns nullptr if the file is not available.
+  static std::shared_ptr<const Table> GetSharedSystemTable(
+      absl::string_view filepath);
+
   using EntryTrie = Trie<const Entry*>;
   EntryTrie entries_;
-  using EntrySet = absl::flat_hash_set<std::unique_ptr<Entry>>;
+  using EntrySet = absl::flat_hash_set<std::shared_ptr<const Entry>>;
   EntrySet entry_set_;
 
   internal::SpecialKeyMap special_key_map_;
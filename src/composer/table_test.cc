@@ -988,6 +988,39 @@ TEST_F(TableTest, DeleteSpecialKey) {
   EXPECT_EQ(DeleteSpecialKeys("\u000Fab\u000E\u000E"), "\u000E");
 }
 
+TEST_F(TableTest, SharedSystemTable) {
+  constexpr absl::string_view kFile = "system://toggle_flick-hiragana.tsv";
+  Table table1;
+  Table table2;
+  ASSERT_TRUE(table1.LoadFromFile(kFile));
+  ASSERT_TRUE(table2.LoadFromFile(kFile));
+
+  // The entries parsed from the system file are shared.
+  const Entry* entry1 = table1.LookUp("1");
+  ASSERT_NE(entry1, nullptr);
+  EXPECT_EQ(table2.LookUp("1"), entry1);
+  EXPECT_EQ(table1.ParseSpecialKey("{?}"), table2.ParseSpecialKey("{?}"));
+
+  // Rules added later belong to each table.
+  table1.AddRule("1", "X", "");
+  EXPECT_EQ(GetResult(table1, "1"), "X");
+  EXPECT_EQ(table2.LookUp("1"), entry1);
+
+  // A table having rules parses the file on its own.
+  Table table3;
+  table3.AddRule("xx", "x", "");
+  ASSERT_TRUE(table3.LoadFromFile(kFile));
+  const Entry* entry3 = table3.LookUp("1");
+  ASSERT_NE(entry3, nullptr);
+  EXPECT_NE(entry3, entry1);
+  EXPECT_EQ(entry3->result(), entry1->result());
+  EXPECT_EQ(entry3->pending(), entry1->pending());
+  EXPECT_EQ(GetResult(table3, "xx"), "x");
+
+  Table table4;
+  EXPECT_FALSE(table4.LoadFromFile("system://does-not-exist.tsv"));
+}
+
 TEST_F(TableTest, TableManager) {
   TableManager table_manager;
   absl::flat_hash_set<std::shared_ptr<const Table>> table_set;
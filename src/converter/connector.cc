@@ -29,7 +29,9 @@
 
 #include "converter/connector.h"
 
+#include <algorithm>
 #include <atomic>
+#include <bit>
 #include <cstddef>
 #include <cstdint>
 #include <limits>
@@ -40,11 +42,14 @@
 #include <utility>
 #include <vector>
 
+#include "absl/base/optimization.h"
+#include "absl/log/check.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/escaping.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
 #include "base/bits.h"
 #include "storage/louds/simple_succinct_bit_vector_index.h"
 
@@ -53,11 +58,17 @@ namespace {
 
 constexpr uint16_t kConnectorMagicNumber = 0xCDAB;
 constexpr uint8_t kInvalid1ByteCostValue = 255;
-constexpr uint32_t kCacheSize = 1024;
-constexpr uint32_t kCacheHashMask = kCacheSize - 1;
 
-static_assert((kCacheSize & kCacheHashMask) == 0,
-              "kCacheSize must be power of 2.");
+// Layout of a cache entry:
+// +-------+-----------------+-----------------+
+// | bit63 |   bits 62..32   |   bits 31..0    |
+// | valid |      cost       | rid << 16 | lid |
+// +-------+-----------------+-----------------+
+// The valid bit distinguishes the entry for (0, 0) from an empty one.
+constexpr uint64_t kCacheValidBit = uint64_t{1} << 63;
+constexpr uint64_t kCacheKeyMask = kCacheValidBit | 0xffffffff;
+constexpr int kCacheCostShift = 32;
+constexpr uint64_t kCacheCostMask = 0x7fffffff;
 
 absl::Status IsMemoryAligned32(const void* ptr) {
   const auto addr = reinterpret_cast<std::uintptr_t>(ptr);
@@ -161,17 +172,19 @@ std::optional<uint16_t> Connector::Row::GetValue(uint16_t index) const {
   return value;
 }
 
-absl::StatusOr<Connector> Connector::Create(absl::string_view connection_data) {
+absl::StatusOr<Connector> Connector::Create(absl::string_view connection_data,
+                                            size_t cache_size) {
   Connector connector;
-  absl::Status status = connector.Init(connection_data);
+  absl::Status status = connector.Init(connection_data, cache_size);
   if (!status.ok()) {
     return status;
   }
   return connector;
 }
 
-absl::Status Connector::Init(absl::string_view connection_data) {
-  cache_ = std::make_unique<cache_t>(kCacheSize);
+absl::Status Connector::Init(absl::string_view connection_data,
+                             size_t cache_size) {
+  cache_ = std::make_unique<Cache>(cache_size);
 
   absl::StatusOr<Metadata> metadata =
       ParseMetadata(connection_data.data(), connection_data.size());
@@ -279,27 +292,31 @@ int Connector::GetTransitionCost(uint16_t rid, uint16_t lid) const {
   // execution time. When making any modifications, please conduct a performance
   // analysis.
 
-  const uint32_t index = (static_cast<uint32_t>(rid) << 16) | lid;
-  const uint32_t bucket =
-      (3 * static_cast<uint32_t>(rid) + lid) & kCacheHashMask;
-  // The above value is equivalent to (3 * rid + lid) % kCacheSize;
-  // because cache_size_ is the power of 2.
-  // Multiplying '3' makes the conversion speed faster.
-  // The result hash value becomes reasonably random.
-
-  // don't care the memory order. atomic access is only required.
-  // Upper 32bits stores the value-cost, lower 32 bits the index.
-  const uint64_t cv = (*cache_)[bucket].load(std::memory_order_relaxed);
-  if (static_cast<uint32_t>(cv) == index) {
-    return static_cast<int>(cv >> 32);
+  if (const std::optional<int> cost = cache_->Lookup(rid, lid);
+      cost.has_value()) {
+    return *cost;
   }
   const int value = LookupCost(rid, lid);
-  (*cache_)[bucket].store(static_cast<uint64_t>(value) << 32 | index,
-                          std::memory_order_relaxed);
-
+  cache_->Insert(rid, lid, value);
   return value;
 }
 
+void Connector::EnableCacheStats(bool enable) const {
+  cache_->EnableStats(enable);
+}
+
+Connector::CacheStats Connector::GetCacheStats() const {
+  return cache_->GetStats();
+}
+
+void Connector::ResetCacheStats() const { cache_->ResetStats(); }
+
+void Connector::StartTrace() const { cache_->StartTrace(); }
+
+std::vector<uint32_t> Connector::StopTrace() const {
+  return cache_->StopTrace();
+}
+
 int Connector::LookupCost(uint16_t rid, uint16_t lid) const {
   std::optional<uint16_t> value = rows_[rid].GetValue(lid);
   if (!value.has_value()) {
@@ -308,4 +325,118 @@ int Connector::LookupCost(uint16_t rid, uint16_t lid) const {
   return *value * resolution_;
 }
 
+Connector::Cache::Cache(size_t size) {
+  const size_t num_sets =
+      std::bit_ceil(std::max<size_t>(size / kNumWays, 1));
+  set_mask_ = static_cast<uint32_t>(num_sets - 1);
+  const size_t num_entries = num_sets * kNumWays;
+  entries_ = std::make_unique<std::atomic<uint64_t>[]>(num_entries);
+  for (size_t i = 0; i < num_entries; ++i) {
+    entries_[i].store(0, std::memory_order_relaxed);
+  }
+}
+
+std::optional<int> Connector::Cache::Lookup(uint16_t rid, uint16_t lid) {
+  const uint32_t key = (static_cast<uint32_t>(rid) << 16) | lid;
+  // Multiplying '3' makes the conversion speed faster.
+  // The result hash value becomes reasonably random.
+  const uint32_t set = (3 * static_cast<uint32_t>(rid) + lid) & set_mask_;
+  const std::atomic<uint64_t>* ways = &entries_[set * kNumWays];
+  std::optional<int> result;
+  for (size_t i = 0; i < kNumWays; ++i) {
+    // don't care the memory order. atomic access is only required.
+    const uint64_t entry = ways[i].load(std::memory_order_relaxed);
+    if ((entry & kCacheKeyMask) == (kCacheValidBit | key)) {
+      result = static_cast<int>((entry >> kCacheCostShift) & kCacheCostMask);
+      break;
+    }
+  }
+  if (ABSL_PREDICT_FALSE(instrumented_.load(std::memory_order_relaxed))) {
+    RecordLookup(key, result.has_value());
+  }
+  return result;
+}
+
+void Connector::Cache::Insert(uint16_t rid, uint16_t lid, int cost) {
+  DCHECK_GE(cost, 0);
+  const uint32_t key = (static_cast<uint32_t>(rid) << 16) | lid;
+  const uint32_t set = (3 * static_cast<uint32_t>(rid) + lid) & set_mask_;
+  std::atomic<uint64_t>* ways = &entries_[set * kNumWays];
+  // Inserts the new entry at the front and shifts the others, so that each
+  // set keeps the most recently inserted kNumWays entries. Unlike a random
+  // replacement, up to kNumWays hot pairs colliding in a set never evict
+  // each other.
+  const uint64_t evicted =
+      ways[kNumWays - 1].load(std::memory_order_relaxed);
+  for (size_t i = kNumWays - 1; i > 0; --i) {
+    ways[i].store(ways[i - 1].load(std::memory_order_relaxed),
+                  std::memory_order_relaxed);
+  }
+  ways[0].store(kCacheValidBit |
+                    (static_cast<uint64_t>(cost) & kCacheCostMask)
+                        << kCacheCostShift |
+                    key,
+                std::memory_order_relaxed);
+  if (ABSL_PREDICT_FALSE(stats_enabled_.load(std::memory_order_relaxed)) &&
+      (evicted & kCacheValidBit)) {
+    evictions_.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+void Connector::Cache::RecordLookup(uint32_t key, bool hit) {
+  if (stats_enabled_.load(std::memory_order_relaxed)) {
+    (hit ? hits_ : misses_).fetch_add(1, std::memory_order_relaxed);
+  }
+  if (tracing_.load(std::memory_order_relaxed)) {
+    absl::MutexLock lock(&trace_mutex_);
+    trace_.push_back(key);
+  }
+}
+
+void Connector::Cache::UpdateInstrumented() {
+  instrumented_.store(stats_enabled_.load(std::memory_order_relaxed) ||
+                          tracing_.load(std::memory_order_relaxed),
+                      std::memory_order_relaxed);
+}
+
+void Connector::Cache::EnableStats(bool enable) {
+  stats_enabled_.store(enable, std::memory_order_relaxed);
+  UpdateInstrumented();
+}
+
+Connector::CacheStats Connector::Cache::GetStats() const {
+  CacheStats stats;
+  stats.cache_size = size();
+  stats.hits = hits_.load(std::memory_order_relaxed);
+  stats.misses = misses_.load(std::memory_order_relaxed);
+  stats.evictions = evictions_.load(std::memory_order_relaxed);
+  return stats;
+}
+
+void Connector::Cache::ResetStats() {
+  hits_.store(0, std::memory_order_relaxed);
+  misses_.store(0, std::memory_order_relaxed);
+  evictions_.store(0, std::memory_order_relaxed);
+}
+
+void Connector::Cache::StartTrace() {
+  {
+    absl::MutexLock lock(&trace_mutex_);
+    trace_.clear();
+    tracing_.store(true, std::memory_order_relaxed);
+  }
+  UpdateInstrumented();
+}
+
+std::vector<uint32_t> Connector::Cache::StopTrace() {
+  std::vector<uint32_t> trace;
+  {
+    absl::MutexLock lock(&trace_mutex_);
+    tracing_.store(false, std::memory_order_relaxed);
+    trace.swap(trace_);
+  }
+  UpdateInstrumented();
+  return trace;
+}
+
 }  // namespace mozc
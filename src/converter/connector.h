@@ -37,9 +37,11 @@
 #include <optional>
 #include <vector>
 
+#include "absl/base/thread_annotations.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
 #include "storage/louds/simple_succinct_bit_vector_index.h"
 
 namespace mozc {
@@ -47,16 +49,48 @@ namespace mozc {
 class Connector final {
  public:
   static constexpr int16_t kInvalidCost = 30000;
-
-  static absl::StatusOr<Connector> Create(absl::string_view connection_data);
+  // The default number of entries in the transition cost cache.
+  static constexpr size_t kDefaultCacheSize = 4096;
+
+  struct CacheStats {
+    // The number of entries in the cache.
+    size_t cache_size = 0;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    // The number of valid entries dropped from the cache by new ones.
+    uint64_t evictions = 0;
+
+    double HitRate() const {
+      const uint64_t lookups = hits + misses;
+      return lookups == 0 ? 0.0 : static_cast<double>(hits) / lookups;
+    }
+  };
+
+  // `cache_size` is rounded up to a power of 2 and to at least one set.
+  static absl::StatusOr<Connector> Create(
+      absl::string_view connection_data,
+      size_t cache_size = kDefaultCacheSize);
 
   int GetTransitionCost(uint16_t rid, uint16_t lid) const;
   int GetResolution() const { return resolution_; }
 
+  // Cache statistics are collected only while enabled because counting every
+  // lookup is not free in GetTransitionCost().
+  void EnableCacheStats(bool enable) const;
+  CacheStats GetCacheStats() const;
+  void ResetCacheStats() const;
+
+  // Records the (rid, lid) of every GetTransitionCost() call until
+  // StopTrace() is called. Each element of the returned trace is encoded as
+  // (rid << 16 | lid). Used to size the cache offline.
+  void StartTrace() const;
+  std::vector<uint32_t> StopTrace() const;
+
  private:
   class Row;
+  class Cache;
 
-  absl::Status Init(absl::string_view connection_data);
+  absl::Status Init(absl::string_view connection_data, size_t cache_size);
 
   int LookupCost(uint16_t rid, uint16_t lid) const;
 
@@ -64,8 +98,7 @@ class Connector final {
   const uint16_t* default_cost_ = nullptr;
   int resolution_ = 0;
   // Cache for transition cost.
-  using cache_t = std::vector<std::atomic<uint64_t>>;
-  mutable std::unique_ptr<cache_t> cache_;
+  mutable std::unique_ptr<Cache> cache_;
 };
 
 class Connector::Row final {
@@ -87,6 +120,52 @@ class Connector::Row final {
   bool use_1byte_value_ = false;
 };
 
+// A set-associative cache of transition costs. Each entry packs the key and
+// the cost into a single 64-bit word, so lookups and updates are lock-free;
+// racing updates can only drop or duplicate an entry, never tear it.
+class Connector::Cache final {
+ public:
+  static constexpr size_t kNumWays = 4;
+
+  explicit Cache(size_t size);
+
+  Cache(const Cache&) = delete;
+  Cache& operator=(const Cache&) = delete;
+
+  // Returns the cached cost of (rid, lid) if available.
+  std::optional<int> Lookup(uint16_t rid, uint16_t lid);
+  void Insert(uint16_t rid, uint16_t lid, int cost);
+
+  size_t size() const { return (set_mask_ + 1) * kNumWays; }
+
+  void EnableStats(bool enable);
+  CacheStats GetStats() const;
+  void ResetStats();
+
+  void StartTrace();
+  std::vector<uint32_t> StopTrace();
+
+ private:
+  // Updates the statistics and the trace. Called only when instrumented_ is
+  // true.
+  void RecordLookup(uint32_t key, bool hit);
+  void UpdateInstrumented();
+
+  std::unique_ptr<std::atomic<uint64_t>[]> entries_;
+  uint32_t set_mask_ = 0;
+
+  // True if either stats or trace is enabled. Checked on every lookup.
+  std::atomic<bool> instrumented_ = false;
+  std::atomic<bool> stats_enabled_ = false;
+  std::atomic<bool> tracing_ = false;
+  std::atomic<uint64_t> hits_ = 0;
+  std::atomic<uint64_t> misses_ = 0;
+  std::atomic<uint64_t> evictions_ = 0;
+
+  absl::Mutex trace_mutex_;
+  std::vector<uint32_t> trace_ ABSL_GUARDED_BY(trace_mutex_);
+};
+
 }  // namespace mozc
 
 #endif  // MOZC_CONVERTER_CONNECTOR_H_
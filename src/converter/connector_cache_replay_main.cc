@@ -0,0 +1,152 @@
+// Copyright 2010-2025, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Replays a trace of (rid, lid) lookups recorded by converter_main
+// --connector_trace_file against transition cost caches of different sizes,
+// and reports the hit rate and the replay time of each size.
+//
+// connector_cache_replay_main
+//  --trace=connector_trace.bin
+//  --engine_data_path=mozc.data
+//  --cache_sizes=1024,4096,16384
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/log/check.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/str_split.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+#include "base/file_util.h"
+#include "base/init_mozc.h"
+#include "base/stopwatch.h"
+#include "converter/connector.h"
+#include "data_manager/data_manager.h"
+
+ABSL_FLAG(std::string, trace, "",
+          "trace file written by converter_main --connector_trace_file");
+ABSL_FLAG(std::string, engine_data_path, "", "path to engine data file");
+ABSL_FLAG(std::string, magic, "", "expected magic number of data file");
+ABSL_FLAG(std::string, cache_sizes, "256,1024,4096,16384,65536",
+          "comma separated numbers of cache entries to measure");
+ABSL_FLAG(int32_t, iterations, 3,
+          "number of timed replays for each cache size");
+
+namespace mozc {
+namespace {
+
+// The trace file is a sequence of (rid << 16 | lid) in the host byte order.
+std::vector<uint32_t> LoadTrace(const std::string& path) {
+  absl::StatusOr<std::string> contents = FileUtil::GetContents(path);
+  CHECK_OK(contents) << "Failed to read " << path;
+  CHECK_EQ(contents->size() % sizeof(uint32_t), 0)
+      << path << " is not a connector trace file";
+  std::vector<uint32_t> trace(contents->size() / sizeof(uint32_t));
+  std::memcpy(trace.data(), contents->data(), contents->size());
+  return trace;
+}
+
+}  // namespace
+}  // namespace mozc
+
+int main(int argc, char** argv) {
+  mozc::InitMozc(argv[0], &argc, &argv);
+
+  const std::vector<uint32_t> trace =
+      mozc::LoadTrace(absl::GetFlag(FLAGS_trace));
+  absl::StatusOr<std::unique_ptr<const mozc::DataManager>> data_manager =
+      absl::GetFlag(FLAGS_magic).empty()
+          ? mozc::DataManager::CreateFromFile(
+                absl::GetFlag(FLAGS_engine_data_path))
+          : mozc::DataManager::CreateFromFile(
+                absl::GetFlag(FLAGS_engine_data_path),
+                absl::GetFlag(FLAGS_magic));
+  CHECK_OK(data_manager) << "Failed to load "
+                         << absl::GetFlag(FLAGS_engine_data_path);
+  const absl::string_view connection_data =
+      data_manager.value()->GetConnectorData();
+
+  std::vector<size_t> cache_sizes;
+  for (absl::string_view field :
+       absl::StrSplit(absl::GetFlag(FLAGS_cache_sizes), ',',
+                      absl::SkipWhitespace())) {
+    size_t cache_size = 0;
+    CHECK(absl::SimpleAtoi(field, &cache_size)) << "Invalid size: " << field;
+    cache_sizes.push_back(cache_size);
+  }
+
+  std::cout << "Lookups: " << trace.size() << std::endl;
+  std::cout << absl::StreamFormat("%10s %10s %12s %12s %12s\n", "entries",
+                                  "hit rate", "misses", "evictions",
+                                  "replay[ms]");
+  const int iterations = absl::GetFlag(FLAGS_iterations);
+  CHECK_GT(iterations, 0);
+  for (const size_t cache_size : cache_sizes) {
+    // The statistics are collected by a separate replay so that counting
+    // doesn't affect the measured time.
+    mozc::Connector::CacheStats stats;
+    {
+      absl::StatusOr<mozc::Connector> connector =
+          mozc::Connector::Create(connection_data, cache_size);
+      CHECK_OK(connector);
+      connector->EnableCacheStats(true);
+      for (const uint32_t key : trace) {
+        connector->GetTransitionCost(key >> 16, key & 0xffff);
+      }
+      stats = connector->GetCacheStats();
+    }
+
+    absl::Duration elapsed;
+    for (int i = 0; i < iterations; ++i) {
+      // A new connector starts from the cold cache for every replay.
+      absl::StatusOr<mozc::Connector> connector =
+          mozc::Connector::Create(connection_data, cache_size);
+      CHECK_OK(connector);
+      mozc::Stopwatch stopwatch = mozc::Stopwatch::StartNew();
+      for (const uint32_t key : trace) {
+        connector->GetTransitionCost(key >> 16, key & 0xffff);
+      }
+      elapsed += stopwatch.GetElapsed();
+    }
+    std::cout << absl::StreamFormat(
+        "%10d %9.2f%% %12d %12d %12.2f\n", stats.cache_size,
+        stats.HitRate() * 100, stats.misses, stats.evictions,
+        absl::ToDoubleMilliseconds(elapsed) / iterations);
+  }
+  return 0;
+}
@@ -93,6 +93,73 @@ TEST(ConnectorTest, CompareWithRawData) {
   }
 }
 
+TEST(ConnectorTest, CacheSizes) {
+  const std::string path = testing::GetSourceFileOrDie(
+      {"data_manager", "testing", "connection.data"});
+  absl::StatusOr<Mmap> cmmap = Mmap::Map(path);
+  ASSERT_OK(cmmap) << cmmap.status();
+  absl::StatusOr<Connector> reference = Connector::Create(cmmap->string_view());
+  ASSERT_OK(reference);
+
+  absl::BitGen urbg;
+  for (const size_t cache_size : {0, 1, 5, 64, 100000}) {
+    absl::StatusOr<Connector> connector =
+        Connector::Create(cmmap->string_view(), cache_size);
+    ASSERT_OK(connector);
+    EXPECT_GE(connector->GetCacheStats().cache_size, cache_size);
+    for (int i = 0; i < 10000; ++i) {
+      const uint16_t rid = absl::Uniform<uint16_t>(urbg, 0, 64);
+      const uint16_t lid = absl::Uniform<uint16_t>(urbg, 0, 64);
+      EXPECT_EQ(connector->GetTransitionCost(rid, lid),
+                reference->GetTransitionCost(rid, lid));
+    }
+  }
+}
+
+TEST(ConnectorTest, CacheStatsAndTrace) {
+  const std::string path = testing::GetSourceFileOrDie(
+      {"data_manager", "testing", "connection.data"});
+  absl::StatusOr<Mmap> cmmap = Mmap::Map(path);
+  ASSERT_OK(cmmap) << cmmap.status();
+  absl::StatusOr<Connector> connector =
+      Connector::Create(cmmap->string_view(), 4);
+  ASSERT_OK(connector);
+
+  // Stats are not collected by default.
+  connector->GetTransitionCost(0, 0);
+  EXPECT_EQ(connector->GetCacheStats().hits, 0);
+  EXPECT_EQ(connector->GetCacheStats().misses, 0);
+
+  connector->EnableCacheStats(true);
+  connector->StartTrace();
+  // (0, 0) is cached above. Note that it must not be confused with an empty
+  // entry.
+  connector->GetTransitionCost(0, 0);
+  connector->GetTransitionCost(1, 2);
+  connector->GetTransitionCost(1, 2);
+  EXPECT_THAT(connector->StopTrace(),
+              ::testing::ElementsAre(0, 1 << 16 | 2, 1 << 16 | 2));
+
+  Connector::CacheStats stats = connector->GetCacheStats();
+  EXPECT_EQ(stats.cache_size, 4);
+  EXPECT_EQ(stats.hits, 2);
+  EXPECT_EQ(stats.misses, 1);
+  EXPECT_EQ(stats.evictions, 0);
+  EXPECT_DOUBLE_EQ(stats.HitRate(), 2.0 / 3.0);
+
+  // Five pairs in a single set of four ways evict one entry. (3 * rid + lid)
+  // is the same for all of them.
+  for (uint16_t rid = 10; rid < 15; ++rid) {
+    connector->GetTransitionCost(rid, 100 - 3 * rid);
+  }
+  EXPECT_EQ(connector->GetCacheStats().evictions, 3);
+
+  connector->ResetCacheStats();
+  stats = connector->GetCacheStats();
+  EXPECT_EQ(stats.hits + stats.misses + stats.evictions, 0);
+  EXPECT_TRUE(connector->StopTrace().empty());
+}
+
 TEST(ConnectorTest, BrokenData) {
   const std::string path = testing::GetSourceFileOrDie(
       {"data_manager", "testing", "connection.data"});
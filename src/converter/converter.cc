@@ -42,6 +42,7 @@
 #include <vector>
 
 #include "absl/base/optimization.h"
+#include "absl/container/flat_hash_set.h"
 #include "absl/log/check.h"
 #include "absl/log/log.h"
 #include "absl/random/random.h"
@@ -49,6 +50,7 @@
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
 #include "absl/types/span.h"
+#include "base/metrics.h"
 #include "base/strings/assign.h"
 #include "base/util.h"
 #include "base/vlog.h"
@@ -505,6 +507,64 @@ bool Converter::ResizeSegments(Segments* segments,
   return true;
 }
 
+bool Converter::ExpandSegmentCandidates(Segments* segments,
+                                        const ConversionRequest& request,
+                                        size_t segment_index) const {
+  if (request.request_type() != ConversionRequest::CONVERSION) {
+    return false;
+  }
+
+  segment_index = GetSegmentIndex(segments, segment_index);
+  if (segment_index == kErrorIndex) {
+    return false;
+  }
+  Segment* segment = segments->mutable_segment(segment_index);
+  if (!segment->has_more_candidates()) {
+    return false;
+  }
+  segment->set_has_more_candidates(false);
+
+  // Converts the segment alone with the history as the context. The other
+  // conversion segments are left as they are.
+  Segments expanded_segments = *segments;
+  expanded_segments.erase_segments(segment_index + 1,
+                                   expanded_segments.segments_size() -
+                                       segment_index - 1);
+  expanded_segments.erase_segments(
+      expanded_segments.history_segments_size(),
+      segment_index - expanded_segments.history_segments_size());
+  Segment* target = expanded_segments.mutable_conversion_segment(0);
+  target->clear_candidates();
+  target->set_segment_type(Segment::FIXED_BOUNDARY);
+
+  ConversionRequest::Options options = request.options();
+  options.lazy_candidate_expansion = false;
+  const ConversionRequest expand_request =
+      ConversionRequestBuilder()
+          .SetConversionRequestView(request)
+          .SetOptions(std::move(options))
+          .Build();
+  ApplyConversion(&expanded_segments, expand_request);
+  if (expanded_segments.conversion_segments_size() != 1) {
+    // Rewriters resized the segment. Keeps the top candidates.
+    return false;
+  }
+
+  // Appends the new candidates after the existing ones so that the candidates
+  // already shown keep their indices.
+  absl::flat_hash_set<std::string> seen;
+  for (const Candidate* candidate : segment->candidates()) {
+    seen.insert(candidate->value);
+  }
+  for (const Candidate* candidate :
+       expanded_segments.conversion_segment(0).candidates()) {
+    if (seen.insert(candidate->value).second) {
+      *segment->add_candidate() = *candidate;
+    }
+  }
+  return true;
+}
+
 void Converter::CommitContext(const ConversionRequest& request) const {
   predictor_->CommitContext(request);
 }
@@ -603,8 +663,12 @@ void Converter::RewriteAndSuppressCandidates(const ConversionRequest& request,
   }
 
   // 2. Rewrite candidates in each segment.
-  if (!rewriter_->Rewrite(request, segments)) {
-    return;
+  {
+    ScopedLatency latency(
+        MetricsRegistry::GetStage(MetricsRegistry::REWRITERS));
+    if (!rewriter_->Rewrite(request, segments)) {
+      return;
+    }
   }
 
   // 3. Suppress candidates in each segment.
@@ -139,6 +139,9 @@ class Converter final : public ConverterInterface {
       Segments* segments, const ConversionRequest& request,
       size_t start_segment_index,
       absl::Span<const uint8_t> new_size_array) const override;
+  [[nodiscard]] bool ExpandSegmentCandidates(
+      Segments* segments, const ConversionRequest& request,
+      size_t segment_index) const override;
 
   // Syncs user-modified context.
   void CommitContext(const ConversionRequest& request) const override;
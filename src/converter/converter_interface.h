@@ -163,6 +163,14 @@ class ConverterInterface {
       size_t start_segment_index,
       absl::Span<const uint8_t> new_size_array) const = 0;
 
+  // Generates the rest of the candidates of segment_index-th segment, which
+  // has only its top candidates because of lazy candidate expansion. The
+  // existing candidates keep their order and indices. Returns false if the
+  // segment has no more candidates to generate.
+  [[nodiscard]] virtual bool ExpandSegmentCandidates(
+      Segments* segments, const ConversionRequest& request,
+      size_t segment_index) const = 0;
+
   // Syncs user-modified context.
   virtual void CommitContext(const ConversionRequest& request) const = 0;
 
@@ -43,6 +43,7 @@
 #include "absl/flags/flag.h"
 #include "absl/log/check.h"
 #include "absl/log/log.h"
+#include "absl/status/status.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
 #include "absl/strings/str_join.h"
@@ -59,6 +60,7 @@
 #include "config/config_handler.h"
 #include "converter/attribute.h"
 #include "converter/candidate.h"
+#include "converter/connector.h"
 #include "converter/converter_interface.h"
 #include "converter/pos_id_printer.h"
 #include "converter/segments.h"
@@ -99,6 +101,11 @@ ABSL_FLAG(std::string, decoder_experiment_params, "",
           "format and it is merged to the default value.");
 ABSL_FLAG(std::string, supplemental_model, "",
           "Supplemental model file. Default model is used when this is empty.");
+ABSL_FLAG(bool, connector_cache_stats, false,
+          "If true, print the statistics of the transition cost cache at exit.");
+ABSL_FLAG(std::string, connector_trace_file, "",
+          "If nonempty, (rid, lid) of every transition cost lookup is written "
+          "to this file at exit. Replay it with connector_cache_replay_main.");
 
 namespace mozc {
 namespace {
@@ -307,8 +314,7 @@ void ConverterMain::LoadSupplementalModel(std::string path) {
   }
   EngineReloadRequest req;
   req.set_file_path(path);
-  const EngineReloadResponse response =
-      engine_->GetModulesForTesting().GetSupplementalModel().Load(req);
+  const EngineReloadResponse response = engine_->LoadSupplementalModel(req);
   CHECK_EQ(response.status(), kSupplementalModelExpectedStatus);
   LOG(INFO) << "Set the supplemental model: path = " << path;
 }
@@ -574,12 +580,41 @@ bool IsConsistentEngineNameAndType(absl::string_view engine_name,
 void ConverterMain::RunLoop() {
   CHECK(converter_);
 
+  const std::string trace_file = absl::GetFlag(FLAGS_connector_trace_file);
+  if (!trace_file.empty()) {
+    engine_->StartConnectorTrace();
+  }
+  if (absl::GetFlag(FLAGS_connector_cache_stats)) {
+    engine_->EnableConnectorCacheStats(true);
+  }
+
   Segments segments;
   std::string line;
   while (!std::getline(std::cin, line).fail()) {
     const std::string result = ExecCommandToString(line);
     std::cout << result << std::endl;
   }
+
+  if (absl::GetFlag(FLAGS_connector_cache_stats)) {
+    const Connector::CacheStats stats = engine_->GetConnectorCacheStats();
+    std::cout << absl::StreamFormat(
+                     "Connector cache: entries=%d hits=%d misses=%d "
+                     "evictions=%d hit_rate=%.2f%%",
+                     stats.cache_size, stats.hits, stats.misses,
+                     stats.evictions, stats.HitRate() * 100)
+              << std::endl;
+  }
+  if (!trace_file.empty()) {
+    // The trace is written in the host byte order.
+    const std::vector<uint32_t> trace = engine_->StopConnectorTrace();
+    const absl::Status status = FileUtil::SetContents(
+        trace_file,
+        absl::string_view(reinterpret_cast<const char*>(trace.data()),
+                          trace.size() * sizeof(uint32_t)));
+    if (!status.ok()) {
+      LOG(ERROR) << "Failed to write " << trace_file << ": " << status;
+    }
+  }
 }
 
 }  // namespace
@@ -426,6 +426,60 @@ TEST_F(ConverterTest, ConvertTest) {
   }
 }
 
+TEST_F(ConverterTest, LazyCandidateExpansion) {
+  std::unique_ptr<Engine> engine = MockDataEngineFactory::Create().value();
+  std::shared_ptr<const ConverterInterface> converter = engine->GetConverter();
+  CHECK(converter);
+
+  constexpr absl::string_view kKey = "わたしのなまえはなかのです";
+  composer::Composer composer;
+  composer.SetPreeditTextForTestOnly(kKey);
+  const ConversionRequest request =
+      ConversionRequestBuilder()
+          .SetComposer(composer)
+          .SetOptions({
+              .request_type = ConversionRequest::CONVERSION,
+              .lazy_candidate_expansion = true,
+          })
+          .Build();
+
+  Segments segments;
+  ASSERT_TRUE(converter->StartConversion(request, &segments));
+  ASSERT_LT(1, segments.conversion_segments_size());
+  // The first segment, which is focused first, is fully expanded.
+  EXPECT_FALSE(segments.conversion_segment(0).has_more_candidates());
+  EXPECT_FALSE(converter->ExpandSegmentCandidates(&segments, request, 0));
+
+  size_t lazy_size = 0;
+  size_t expanded_size = 0;
+  for (size_t i = 1; i < segments.conversion_segments_size(); ++i) {
+    ASSERT_TRUE(segments.conversion_segment(i).has_more_candidates());
+    const std::vector<std::string> lazy_values = [&] {
+      std::vector<std::string> values;
+      for (const Candidate* candidate :
+           segments.conversion_segment(i).candidates()) {
+        values.push_back(candidate->value);
+      }
+      return values;
+    }();
+    lazy_size += lazy_values.size();
+
+    EXPECT_TRUE(converter->ExpandSegmentCandidates(&segments, request, i));
+    const Segment& segment = segments.conversion_segment(i);
+    EXPECT_FALSE(segment.has_more_candidates());
+    ASSERT_LE(lazy_values.size(), segment.candidates_size());
+    // The candidates already shown keep their indices.
+    for (size_t j = 0; j < lazy_values.size(); ++j) {
+      EXPECT_EQ(segment.candidate(j).value, lazy_values[j]);
+    }
+    expanded_size += segment.candidates_size();
+
+    // Nothing to do for an expanded segment.
+    EXPECT_FALSE(converter->ExpandSegmentCandidates(&segments, request, i));
+  }
+  EXPECT_LT(lazy_size, expanded_size);
+}
+
 namespace {
 std::string ContextAwareConvert(absl::string_view first_key,
                                 absl::string_view first_value,
@@ -51,6 +51,7 @@
 #include "absl/types/span.h"
 #include "base/container/trie.h"
 #include "base/japanese_util.h"
+#include "base/metrics.h"
 #include "base/strings/unicode.h"
 #include "base/util.h"
 #include "base/vlog.h"
@@ -89,6 +90,9 @@ constexpr int kMaxCost = 32767;
 constexpr int kMinCost = -32767;
 constexpr int kDefaultNumberCost = 3000;
 constexpr int kMaxNodesSize = 8192;
+// The beam width of the n-best search. Ambiguous long segments can grow the
+// agenda much larger while the best candidates are found in its head.
+constexpr size_t kMaxNBestAgendaSize = 4096;
 
 class KeyCorrectedNodeListBuilder : public BaseNodeListBuilder {
  public:
@@ -675,6 +679,26 @@ std::vector<Node*> ImmutableConverter::Lookup(int begin_pos,
   return builder.result();
 }
 
+std::vector<Node*> ImmutableConverter::MakeNodesFromPrefixMatches(
+    int begin_pos,
+    absl::Span<dictionary::DictionaryInterface::PrefixMatch> matches,
+    Lattice* lattice) const {
+  absl::string_view key = lattice->key();
+  const absl::string_view key_substr =
+      key.substr(std::min<int>(begin_pos, key.size()));
+
+  BaseNodeListBuilder builder(lattice->node_allocator(), kMaxNodesSize);
+  for (dictionary::DictionaryInterface::PrefixMatch& match : matches) {
+    DCHECK_EQ(static_cast<int>(match.begin), begin_pos);
+    if (!builder.AddPrefixMatch(std::move(match))) {
+      break;
+    }
+  }
+  AddCharacterTypeBasedNodes(key_substr, lattice, &builder);
+
+  return builder.result();
+}
+
 void ImmutableConverter::AddCharacterTypeBasedNodes(
     absl::string_view key_substr, Lattice* lattice,
     BaseNodeListBuilder* builder) const {
@@ -1377,10 +1401,43 @@ void ImmutableConverter::MakeLatticeNodesForConversionSegments(
 
   const bool is_reverse =
       (options.request_type == RequestType::REVERSE_CONVERSION);
+
+  // Looks up the prefixes at all the character boundaries at once. Every
+  // character boundary is reachable because a node for a single character is
+  // always added, so the batched lookup doesn't waste work in practice.
+  std::vector<dictionary::DictionaryInterface::PrefixMatch> matches;
+  if (!is_reverse) {
+    std::vector<size_t> begin_positions;
+    for (size_t pos = history_key.size(); pos < key.size();
+         pos += strings::OneCharLen(key.data() + pos)) {
+      begin_positions.push_back(pos);
+    }
+    dictionary_.LookupPrefixBatch(key, begin_positions, options,
+                                  /*filter=*/nullptr, &matches);
+  }
+  size_t match_index = 0;
+
   for (size_t pos = history_key.size(); pos < key.size(); ++pos) {
     if (lattice->end_nodes(pos).empty()) continue;
 
-    std::vector<Node*> rnodes = Lookup(pos, options, is_reverse, lattice);
+    std::vector<Node*> rnodes;
+    if (is_reverse) {
+      rnodes = Lookup(pos, options, is_reverse, lattice);
+    } else {
+      while (match_index < matches.size() && matches[match_index].begin < pos) {
+        ++match_index;
+      }
+      size_t match_end = match_index;
+      while (match_end < matches.size() && matches[match_end].begin == pos) {
+        ++match_end;
+      }
+      rnodes = MakeNodesFromPrefixMatches(
+          pos,
+          absl::MakeSpan(matches).subspan(match_index,
+                                          match_end - match_index),
+          lattice);
+      match_index = match_end;
+    }
     // If history key is NOT empty and user input seems to starts with
     // a particle ("はにで..."), mark the node as STARTS_WITH_PARTICLE.
     // We change the segment boundary if STARTS_WITH_PARTICLE attribute
@@ -1616,6 +1673,7 @@ void ImmutableConverter::InsertCandidates(const ConversionOptions& options,
   }
 
   size_t begin_pos = std::string::npos;
+  bool is_first_segment = true;
   for (Node* node = prev->next; node->next != nullptr; node = node->next) {
     if (begin_pos == std::string::npos) {
       begin_pos = node->begin_pos;
@@ -1629,6 +1687,16 @@ void ImmutableConverter::InsertCandidates(const ConversionOptions& options,
         GetInsertTargetSegment(lattice, group, type, begin_pos, node, segments);
     DCHECK(segment);
 
+    // The first segment is focused first. The others get only the top
+    // candidate until they are focused.
+    const bool is_lazy_segment = type == MULTI_SEGMENTS &&
+                                 options.lazy_candidate_expansion &&
+                                 !is_first_segment &&
+                                 node->node_type != Node::CON_NODE;
+    const size_t segment_expand_size = is_lazy_segment ? 1 : expand_size;
+    segment->set_has_more_candidates(is_lazy_segment);
+    is_first_segment = false;
+
     NBestGenerator::Options nbest_options;
     if (type == SINGLE_SEGMENT || type == FIRST_INNER_SEGMENT) {
       // For real time conversion.
@@ -1644,11 +1712,19 @@ void ImmutableConverter::InsertCandidates(const ConversionOptions& options,
           NBestGenerator::BUILD_FROM_ONLY_FIRST_INNER_SEGMENT;
       nbest_options.candidate_mode |= NBestGenerator::FILL_INNER_SEGMENT_INFO;
     }
+    nbest_options.max_agenda_size = kMaxNBestAgendaSize;
     nbest_generator.Reset(prev, node->next, nbest_options);
-    nbest_generator.SetCandidates(options, original_key, expand_size, segment);
+    nbest_generator.SetCandidates(options, original_key, segment_expand_size,
+                                  segment);
+    const NBestGenerator::Stats& stats = nbest_generator.stats();
+    MOZC_VLOG(3) << "n-best: candidates=" << stats.candidates
+                 << " expansions=" << stats.expansions
+                 << " boundary_rejections=" << stats.boundary_rejections
+                 << " filter_rejections=" << stats.filter_rejections
+                 << " pruned=" << stats.pruned_elements;
 
     if (type == MULTI_SEGMENTS || type == SINGLE_SEGMENT) {
-      InsertDummyCandidates(segment, expand_size);
+      InsertDummyCandidates(segment, segment_expand_size);
     }
 
     if (node->node_type == Node::CON_NODE) {
@@ -1822,24 +1898,32 @@ bool ImmutableConverter::Convert(const ConversionOptions& options,
   const bool is_prediction = (options.request_type == RequestType::PREDICTION ||
                               options.request_type == RequestType::SUGGESTION);
 
-  if (!MakeLattice(options, segments, lattice)) {
-    LOG(WARNING) << "could not make lattice";
-    return false;
-  }
-
-  if (is_prediction) {
-    if (!PredictionViterbi(*segments, lattice)) {
-      LOG(WARNING) << "prediction_viterbi failed";
+  {
+    ScopedLatency latency(
+        MetricsRegistry::GetStage(MetricsRegistry::LATTICE_BUILD));
+    if (!MakeLattice(options, segments, lattice)) {
+      LOG(WARNING) << "could not make lattice";
       return false;
     }
-  } else {
-    if (!Viterbi(*segments, lattice)) {
-      LOG(WARNING) << "viterbi failed";
-      return false;
+  }
+
+  {
+    ScopedLatency latency(MetricsRegistry::GetStage(MetricsRegistry::VITERBI));
+    if (is_prediction) {
+      if (!PredictionViterbi(*segments, lattice)) {
+        LOG(WARNING) << "prediction_viterbi failed";
+        return false;
+      }
+    } else {
+      if (!Viterbi(*segments, lattice)) {
+        LOG(WARNING) << "viterbi failed";
+        return false;
+      }
     }
   }
 
   MOZC_VLOG(2) << lattice->DebugString();
+  ScopedLatency latency(MetricsRegistry::GetStage(MetricsRegistry::NBEST));
   if (!MakeSegments(options, *lattice, segments)) {
     LOG(WARNING) << "make segments failed";
     return false;
@@ -87,6 +87,13 @@ class ImmutableConverter : public ImmutableConverterInterface {
   void InsertDummyCandidates(Segment* segment, size_t expand_size) const;
   std::vector<Node*> Lookup(int begin_pos, const ConversionOptions& options,
                             bool is_reverse, Lattice* lattice) const;
+  // Same as Lookup() for prefix lookup, but makes nodes from `matches`, which
+  // are the results of LookupPrefixBatch() starting at `begin_pos`. The tokens
+  // are moved out of `matches`.
+  std::vector<Node*> MakeNodesFromPrefixMatches(
+      int begin_pos,
+      absl::Span<dictionary::DictionaryInterface::PrefixMatch> matches,
+      Lattice* lattice) const;
   void AddCharacterTypeBasedNodes(absl::string_view key_substr,
                                   Lattice* lattice,
                                   BaseNodeListBuilder* builder) const;
@@ -30,6 +30,7 @@
 #include "converter/nbest_generator.h"
 
 #include <algorithm>
+#include <cstddef>
 #include <cstdint>
 #include <cstdlib>
 #include <iterator>
@@ -43,6 +44,7 @@
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
 #include "absl/types/span.h"
+#include "base/clock.h"
 #include "base/vlog.h"
 #include "converter/attribute.h"
 #include "converter/candidate.h"
@@ -107,6 +109,24 @@ void NBestGenerator::Agenda::Pop() {
   priority_queue_.pop_back();
 }
 
+size_t NBestGenerator::Agenda::Truncate(size_t size) {
+  if (priority_queue_.size() <= size) {
+    return 0;
+  }
+  const size_t dropped = priority_queue_.size() - size;
+  // QueueElement::Comparator is "greater", so the smallest f(x) come first.
+  std::nth_element(priority_queue_.begin(), priority_queue_.begin() + size,
+                   priority_queue_.end(),
+                   [](const QueueElement* absl_nonnull q1,
+                      const QueueElement* absl_nonnull q2) {
+                     return QueueElement::Comparator(q2, q1);
+                   });
+  priority_queue_.resize(size);
+  std::make_heap(priority_queue_.begin(), priority_queue_.end(),
+                 QueueElement::Comparator);
+  return dropped;
+}
+
 NBestGenerator::NBestGenerator(const UserDictionaryInterface& user_dictionary,
                                const Segmenter& segmenter,
                                const Connector& connector,
@@ -136,6 +156,7 @@ void NBestGenerator::Reset(const Node* absl_nonnull begin_node,
   filter_.Reset();
   viterbi_result_checked_ = false;
   options_ = options;
+  stats_ = Stats();
 
   begin_node_ = begin_node;
   end_node_ = end_node;
@@ -335,6 +356,12 @@ void NBestGenerator::SetCandidates(const ConversionOptions& options,
   }
 
   while (segment->candidates_size() < expand_size) {
+    // Keeps the best-so-far candidates when running out of time. At least one
+    // candidate, which is usually the Viterbi best, is generated.
+    if (segment->candidates_size() > 0 &&
+        options.IsDeadlineExceeded(Clock::GetAbslTime())) {
+      break;
+    }
     Candidate* candidate = segment->push_back_candidate();
     DCHECK(candidate);
 
@@ -343,6 +370,7 @@ void NBestGenerator::SetCandidates(const ConversionOptions& options,
       segment->pop_back_candidate();
       break;
     }
+    ++stats_.candidates;
   }
 #ifdef MOZC_CANDIDATE_DEBUG
   // Append moved bad_candidates_ to segment->removed_candidates_for_debug_.
@@ -395,6 +423,7 @@ bool NBestGenerator::Next(const ConversionOptions& options,
         return false;
         // Viterbi best result was tried to be inserted but reverted.
       case CandidateFilter::BAD_CANDIDATE:
+        ++stats_.filter_rejections;
 #ifdef MOZC_CANDIDATE_DEBUG
         bad_candidates_.push_back(candidate);
         break;
@@ -405,7 +434,6 @@ bool NBestGenerator::Next(const ConversionOptions& options,
     }
   }
 
-  const int KMaxTrial = 500;
   int num_trials = 0;
 
   while (!agenda_.IsEmpty()) {
@@ -413,10 +441,11 @@ bool NBestGenerator::Next(const ConversionOptions& options,
     agenda_.Pop();
     const Node* absl_nonnull rnode = top->node;
 
-    if (num_trials++ > KMaxTrial) {  // too many trials
+    if (num_trials++ > options_.max_expansions_per_candidate) {
       MOZC_VLOG(2) << "too many trials: " << num_trials;
       return false;
     }
+    ++stats_.expansions;
 
     // reached to the goal.
     if (rnode->end_pos == begin_node_->end_pos) {
@@ -429,6 +458,7 @@ bool NBestGenerator::Next(const ConversionOptions& options,
         case CandidateFilter::STOP_ENUMERATION:
           return false;
         case CandidateFilter::BAD_CANDIDATE:
+          ++stats_.filter_rejections;
 #ifdef MOZC_CANDIDATE_DEBUG
           bad_candidates_.push_back(candidate);
           break;
@@ -490,6 +520,7 @@ bool NBestGenerator::Next(const ConversionOptions& options,
       const BoundaryCheckResult boundary_result =
           BoundaryCheck(*lnode, *rnode, is_edge);
       if (boundary_result == INVALID) {
+        ++stats_.boundary_rejections;
         continue;
       }
 
@@ -552,6 +583,13 @@ bool NBestGenerator::Next(const ConversionOptions& options,
     if (best_left_elm != nullptr) {
       agenda_.Push(best_left_elm);
     }
+
+    // Truncates the agenda only after it doubles, so that the cost of
+    // Truncate() is amortized over the pushes.
+    if (options_.max_agenda_size > 0 &&
+        agenda_.Size() > 2 * options_.max_agenda_size) {
+      stats_.pruned_elements += agenda_.Truncate(options_.max_agenda_size);
+    }
   }
 
   return false;
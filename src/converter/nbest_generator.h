@@ -96,6 +96,26 @@ class NBestGenerator {
   struct Options {
     BoundaryCheckMode boundary_mode = STRICT;
     uint32_t candidate_mode = CANDIDATE_MODE_NONE;
+    // Bounds of the A* search to limit the worst-case time on long segments.
+    // The agenda keeps only the |max_agenda_size| best elements (0 means no
+    // limit), and a candidate is given up after popping
+    // |max_expansions_per_candidate| elements.
+    size_t max_agenda_size = 0;
+    int max_expansions_per_candidate = 500;
+  };
+
+  // Counters of the search since the last Reset().
+  struct Stats {
+    // Elements popped from the agenda.
+    size_t expansions = 0;
+    // Expansions rejected by BoundaryCheck.
+    size_t boundary_rejections = 0;
+    // Complete paths rejected by CandidateFilter.
+    size_t filter_rejections = 0;
+    // Elements dropped from the agenda by |max_agenda_size|.
+    size_t pruned_elements = 0;
+    // Candidates generated.
+    size_t candidates = 0;
   };
 
   // Try to enumerate N-best results between begin_node and end_node.
@@ -117,6 +137,8 @@ class NBestGenerator {
                      absl::string_view original_key, size_t expand_size,
                      Segment* absl_nonnull segment);
 
+  const Stats& stats() const { return stats_; }
+
  private:
   enum BoundaryCheckResult {
     VALID = 0,
@@ -159,12 +181,17 @@ class NBestGenerator {
     }
 
     bool IsEmpty() const { return priority_queue_.empty(); }
+    size_t Size() const { return priority_queue_.size(); }
     void Clear() { priority_queue_.clear(); }
     void Reserve(int size) { priority_queue_.reserve(size); }
 
     void Push(const QueueElement* absl_nonnull element);
     void Pop();
 
+    // Keeps only the |size| elements with the smallest f(x), and returns the
+    // number of dropped elements.
+    size_t Truncate(size_t size);
+
    private:
     std::vector<const QueueElement* absl_nonnull> priority_queue_;
   };
@@ -226,6 +253,7 @@ class NBestGenerator {
   converter::CandidateFilter filter_;
   bool viterbi_result_checked_ = false;
   Options options_;
+  Stats stats_;
 
 #ifdef MOZC_CANDIDATE_DEBUG
   std::vector<converter::Candidate> bad_candidates_;
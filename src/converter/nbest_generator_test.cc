@@ -434,4 +434,58 @@ TEST_F(NBestGeneratorTest, NoAlphabetsConnection3Nodes) {
   }
 }
 
+TEST_F(NBestGeneratorTest, BoundedAgenda) {
+  auto data_and_converter = std::make_unique<MockDataAndImmutableConverter>();
+  ImmutableConverterTestPeer converter =
+      data_and_converter->GetConverterTestPeer();
+
+  Segments segments;
+  std::string kText = "わたしのなまえはなかのです";
+  {
+    Segment* segment = segments.add_segment();
+    segment->set_segment_type(Segment::FREE);
+    segment->set_key(kText);
+  }
+
+  Lattice lattice;
+  lattice.SetKey(kText);
+  const ConversionRequest request = ConvReq(ConversionRequest::CONVERSION);
+  converter.MakeLattice(request.options(), &segments, &lattice);
+
+  const std::vector<uint16_t> group = converter.MakeGroup(segments);
+  converter.Viterbi(segments, &lattice);
+
+  std::unique_ptr<NBestGenerator> nbest_generator =
+      data_and_converter->CreateNBestGenerator(lattice);
+
+  constexpr bool kSingleSegment = true;
+  const Node* begin_node = lattice.bos_node();
+  const Node* end_node = GetEndNode(request, converter, segments, *begin_node,
+                                    group, kSingleSegment);
+  {
+    nbest_generator->Reset(
+        begin_node, end_node,
+        {NBestGenerator::ONLY_EDGE, NBestGenerator::CANDIDATE_MODE_NONE});
+    Segment result_segment;
+    nbest_generator->SetCandidates(request.options(), "", 10, &result_segment);
+    ASSERT_LT(1, result_segment.candidates_size());
+    const NBestGenerator::Stats& stats = nbest_generator->stats();
+    EXPECT_EQ(stats.candidates, result_segment.candidates_size());
+    EXPECT_GT(stats.expansions, 0);
+    EXPECT_EQ(stats.pruned_elements, 0);
+  }
+  {
+    // Even a tiny agenda keeps the Viterbi best path on top.
+    NBestGenerator::Options options = {NBestGenerator::ONLY_EDGE,
+                                       NBestGenerator::CANDIDATE_MODE_NONE};
+    options.max_agenda_size = 2;
+    nbest_generator->Reset(begin_node, end_node, options);
+    Segment result_segment;
+    nbest_generator->SetCandidates(request.options(), "", 10, &result_segment);
+    ASSERT_LE(1, result_segment.candidates_size());
+    EXPECT_EQ(result_segment.candidate(0).value, "私の名前は中ノです");
+    EXPECT_GT(nbest_generator->stats().pruned_elements, 0);
+  }
+}
+
 }  // namespace mozc
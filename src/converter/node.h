@@ -32,6 +32,7 @@
 
 #include <cstdint>
 #include <string>
+#include <utility>
 
 #include "dictionary/dictionary_token.h"
 
@@ -122,6 +123,20 @@ struct Node {
   }
 
   inline void InitFromToken(const dictionary::Token& token) {
+    InitFromTokenWithoutKeyValue(token);
+    key = token.key;
+    value = token.value;
+  }
+
+  // Same as above, but moves the key and the value of |token|.
+  inline void InitFromToken(dictionary::Token&& token) {
+    InitFromTokenWithoutKeyValue(token);
+    key = std::move(token.key);
+    value = std::move(token.value);
+  }
+
+  // Initializes all the fields but the key and the value from |token|.
+  inline void InitFromTokenWithoutKeyValue(const dictionary::Token& token) {
     prev = nullptr;
     next = nullptr;
     constrained_prev = nullptr;
@@ -143,8 +158,6 @@ struct Node {
       attributes |= USER_DICTIONARY;
       attributes |= NO_VARIANTS_EXPANSION;
     }
-    key = token.key;
-    value = token.value;
   }
 };
 
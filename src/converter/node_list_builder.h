@@ -32,6 +32,7 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <utility>
 #include <vector>
 
 #include "absl/log/check.h"
@@ -89,6 +90,15 @@ class BaseNodeListBuilder : public dictionary::DictionaryInterface::Callback {
     return (result_.size() > limit_) ? TRAVERSE_DONE : TRAVERSE_CONTINUE;
   }
 
+  // Creates a new node from a token found by LookupPrefixBatch() and appends
+  // it to the current list. The token is moved to the node. Returns false if
+  // the list exceeds the limit.
+  bool AddPrefixMatch(dictionary::DictionaryInterface::PrefixMatch&& match) {
+    penalty_ = GetSpatialCostPenalty(match.num_expanded);
+    AppendToResult(NewNodeFromToken(std::move(match.token)));
+    return result_.size() <= limit_;
+  }
+
   int limit() const { return limit_; }
   int penalty() const { return penalty_; }
   NodeAllocator* allocator() { return allocator_; }
@@ -106,6 +116,14 @@ class BaseNodeListBuilder : public dictionary::DictionaryInterface::Callback {
     return new_node;
   }
 
+  Node* NewNodeFromToken(dictionary::Token&& token) {
+    Node* new_node = allocator_->NewNode();
+    new_node->InitFromToken(std::move(token));
+    new_node->wcost += penalty_;
+    if (penalty_ > 0) new_node->attributes |= Node::KEY_EXPANDED;
+    return new_node;
+  }
+
   void AppendToResult(Node* node) {
     DCHECK(node);
     result_.push_back(node);
@@ -136,6 +154,14 @@ class NodeListBuilderForLookupPrefix : public BaseNodeListBuilder {
     return key.size() < min_key_length_ ? TRAVERSE_NEXT_KEY : TRAVERSE_CONTINUE;
   }
 
+  // Skips the tokens that OnToken() would drop or stop at before their values
+  // are decoded: tokens of too short keys and tokens after the list is full,
+  // e.g., when the builder is passed to more than one lookup.
+  bool ShouldDecodeToken(absl::string_view key, absl::string_view actual_key,
+                         const dictionary::TokenView& token) override {
+    return key.size() >= min_key_length_ && result_view().size() <= limit();
+  }
+
  protected:
   const size_t min_key_length_ = 0;
 };
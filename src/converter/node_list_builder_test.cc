@@ -0,0 +1,141 @@
+// Copyright 2010-2021, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "converter/node_list_builder.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/strings/string_view.h"
+#include "base/file/temp_dir.h"
+#include "base/file_util.h"
+#include "converter/node.h"
+#include "converter/node_allocator.h"
+#include "dictionary/dictionary_token.h"
+#include "dictionary/system/system_dictionary.h"
+#include "dictionary/system/system_dictionary_builder.h"
+#include "testing/gunit.h"
+#include "testing/mozctest.h"
+
+namespace mozc {
+namespace {
+
+using ::mozc::dictionary::SystemDictionary;
+using ::mozc::dictionary::SystemDictionaryBuilder;
+using ::mozc::dictionary::Token;
+using ::mozc::dictionary::TokenView;
+
+// Counts the tokens skipped before their values are decoded and the tokens
+// decoded.
+class CountingNodeListBuilder : public NodeListBuilderForLookupPrefix {
+ public:
+  using NodeListBuilderForLookupPrefix::NodeListBuilderForLookupPrefix;
+
+  bool ShouldDecodeToken(absl::string_view key, absl::string_view actual_key,
+                         const TokenView& token) override {
+    const bool should_decode =
+        NodeListBuilderForLookupPrefix::ShouldDecodeToken(key, actual_key,
+                                                          token);
+    if (!should_decode) {
+      ++num_skipped_;
+    }
+    return should_decode;
+  }
+
+  ResultType OnToken(absl::string_view key, absl::string_view actual_key,
+                     const Token& token) override {
+    ++num_decoded_;
+    return NodeListBuilderForLookupPrefix::OnToken(key, actual_key, token);
+  }
+
+  int num_skipped() const { return num_skipped_; }
+  int num_decoded() const { return num_decoded_; }
+
+ private:
+  int num_skipped_ = 0;
+  int num_decoded_ = 0;
+};
+
+class NodeListBuilderTest : public testing::TestWithTempUserProfile {
+ protected:
+  std::unique_ptr<SystemDictionary> BuildSystemDictionary(
+      std::vector<Token>& tokens) {
+    std::vector<Token*> token_ptrs;
+    for (Token& token : tokens) {
+      token_ptrs.push_back(&token);
+    }
+    const TempDirectory temp_dir = testing::MakeTempDirectoryOrDie();
+    const std::string filename =
+        FileUtil::JoinPath(temp_dir.path(), "mozc.dic");
+    SystemDictionaryBuilder builder;
+    builder.BuildFromTokens(token_ptrs);
+    builder.WriteToFile(filename);
+    return SystemDictionary::Builder(filename).Build().value();
+  }
+};
+
+TEST_F(NodeListBuilderTest, LookupPrefixSkipsDecodingAfterLimit) {
+  std::vector<Token> tokens = {
+      {"か", "蚊", 100, 1, 1, Token::NONE},
+      {"かき", "柿", 100, 1, 1, Token::NONE},
+      {"かき", "牡蠣", 200, 1, 1, Token::NONE},
+      {"かき", "夏季", 300, 1, 1, Token::NONE},
+      {"かきく", "書き区", 100, 1, 1, Token::NONE},
+  };
+  std::unique_ptr<SystemDictionary> system_dic = BuildSystemDictionary(tokens);
+  ASSERT_TRUE(system_dic);
+
+  NodeAllocator allocator;
+  // "か" is shorter than the minimum key length. The list is full after the
+  // third node.
+  CountingNodeListBuilder builder(&allocator, 2, std::string("かき").size());
+  system_dic->LookupPrefix("かきく", &builder);
+  EXPECT_EQ(builder.num_decoded(), 3);
+  EXPECT_EQ(builder.num_skipped(), 0);
+  EXPECT_EQ(builder.result_view().size(), 3);
+
+  // The following lookups don't decode any token for the full list.
+  system_dic->LookupPrefix("かきく", &builder);
+  EXPECT_EQ(builder.num_decoded(), 3);
+  EXPECT_EQ(builder.num_skipped(), 4);
+  EXPECT_EQ(builder.result_view().size(), 3);
+}
+
+TEST_F(NodeListBuilderTest, ShouldDecodeTokenOfShortKey) {
+  NodeAllocator allocator;
+  NodeListBuilderForLookupPrefix builder(&allocator, 10,
+                                         std::string("かき").size());
+  const TokenView token = {.key = "か"};
+  EXPECT_FALSE(builder.ShouldDecodeToken("か", "か", token));
+  EXPECT_TRUE(builder.ShouldDecodeToken("かき", "かき", token));
+}
+
+}  // namespace
+}  // namespace mozc
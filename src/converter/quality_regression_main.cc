@@ -27,6 +27,7 @@
 // (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 // OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
+#include <cstddef>
 #include <fstream>
 #include <iostream>
 #include <memory>
@@ -39,10 +40,14 @@
 #include "absl/log/log.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
+#include "absl/strings/str_format.h"
 #include "absl/strings/string_view.h"
+#include "absl/time/time.h"
 #include "absl/types/span.h"
 #include "base/file/temp_dir.h"
 #include "base/init_mozc.h"
+#include "base/metrics.h"
+#include "base/stopwatch.h"
 #include "base/system_util.h"
 #include "converter/quality_regression_util.h"
 #include "engine/engine.h"
@@ -55,13 +60,39 @@ ABSL_FLAG(std::string, data_file, "", "engine data file");
 ABSL_FLAG(std::string, data_type, "", "engine data type");
 ABSL_FLAG(std::string, engine_type, "desktop", "engine type");
 ABSL_FLAG(std::string, output, "", "output file");
+ABSL_FLAG(int, num_threads, 1,
+          "number of threads evaluating the test items concurrently");
 
 namespace {
 
 using ::mozc::Engine;
+using ::mozc::LatencyHistogram;
+using ::mozc::Stopwatch;
 using ::mozc::TempDirectory;
 using ::mozc::quality_regression::QualityRegressionUtil;
 
+// Reports the throughput, the latency distribution and the accuracy of the
+// evaluation to the log.
+void ReportStats(absl::Span<const QualityRegressionUtil::TestResult> results,
+                 const LatencyHistogram& latency, absl::Duration elapsed) {
+  size_t num_passed = 0;
+  for (const QualityRegressionUtil::TestResult& result : results) {
+    if (result.result.ok() && result.result.value()) {
+      ++num_passed;
+    }
+  }
+  const double seconds = absl::ToDoubleSeconds(elapsed);
+  LOG(INFO) << absl::StrFormat(
+      "%d sentences in %.2fs: %.1f sentences/s", results.size(), seconds,
+      seconds > 0 ? results.size() / seconds : 0.0);
+  LOG(INFO) << "Latency: p50=" << latency.Percentile(0.5)
+            << " p90=" << latency.Percentile(0.9)
+            << " p99=" << latency.Percentile(0.99) << " max=" << latency.max();
+  LOG(INFO) << absl::StrFormat(
+      "Accuracy: %d / %d (%.2f%%)", num_passed, results.size(),
+      results.empty() ? 0.0 : 100.0 * num_passed / results.size());
+}
+
 absl::Status Run(std::ostream& out, const Engine& engine,
                  absl::string_view engine_type,
                  absl::Span<const QualityRegressionUtil::TestItem> items) {
@@ -71,16 +102,23 @@ absl::Status Run(std::ostream& out, const Engine& engine,
     mozc::request_test_util::FillMobileRequest(&request);
     util.SetRequest(request);
   }
-  for (const QualityRegressionUtil::TestItem& item : items) {
-    std::string actual_value;
-    const absl::StatusOr<bool> result =
-        util.ConvertAndTest(item, &actual_value);
-    if (!result.ok()) {
+
+  LatencyHistogram latency;
+  const Stopwatch stopwatch = Stopwatch::StartNew();
+  const std::vector<QualityRegressionUtil::TestResult> results =
+      util.ConvertAndTestAll(items, absl::GetFlag(FLAGS_num_threads),
+                             &latency);
+  ReportStats(results, latency, stopwatch.GetElapsed());
+
+  for (size_t i = 0; i < items.size(); ++i) {
+    const QualityRegressionUtil::TestItem& item = items[i];
+    const QualityRegressionUtil::TestResult& result = results[i];
+    if (!result.result.ok()) {
       LOG(INFO) << "Failed to convert: " << item.key;
-      return result.status();
+      return result.result.status();
     }
-    out << (result.value() ? "OK:\t" : "FAILED:\t") << item.key << "\t"
-        << actual_value << "\t" << item.command;
+    out << (result.result.value() ? "OK:\t" : "FAILED:\t") << item.key
+        << "\t" << result.actual_value << "\t" << item.command;
     if (item.expected_rank != 0) {
       out << " " << item.expected_rank;
     }
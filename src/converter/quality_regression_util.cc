@@ -29,6 +29,7 @@
 
 #include "converter/quality_regression_util.h"
 
+#include <atomic>
 #include <cstddef>
 #include <cstdint>
 #include <iterator>
@@ -48,8 +49,11 @@
 #include "absl/strings/string_view.h"
 #include "absl/types/span.h"
 #include "base/file_stream.h"
+#include "base/metrics.h"
 #include "base/number_util.h"
+#include "base/stopwatch.h"
 #include "base/text_normalizer.h"
+#include "base/thread.h"
 #include "base/util.h"
 #include "composer/composer.h"
 #include "composer/table.h"
@@ -385,6 +389,61 @@ absl::StatusOr<bool> QualityRegressionUtil::ConvertAndTest(
   return result;
 }
 
+std::vector<QualityRegressionUtil::TestResult>
+QualityRegressionUtil::ConvertAndTestAll(absl::Span<const TestItem> items,
+                                         int num_threads,
+                                         LatencyHistogram* latency) {
+  std::vector<TestResult> results(items.size());
+  auto run = [&](QualityRegressionUtil& util, size_t index) {
+    TestResult& result = results[index];
+    const Stopwatch stopwatch = Stopwatch::StartNew();
+    result.result = util.ConvertAndTest(items[index], &result.actual_value);
+    result.latency = stopwatch.GetElapsed();
+    if (latency != nullptr) {
+      latency->Record(result.latency);
+    }
+  };
+
+  if (num_threads <= 1) {
+    for (size_t i = 0; i < items.size(); ++i) {
+      run(*this, i);
+    }
+    return results;
+  }
+
+  std::vector<size_t> parallel_indices, serial_indices;
+  for (size_t i = 0; i < items.size(); ++i) {
+    const absl::string_view command = items[i].command;
+    if (command == kZeroQueryExpect || command == kZeroQueryNotExpect) {
+      serial_indices.push_back(i);
+    } else {
+      parallel_indices.push_back(i);
+    }
+  }
+
+  // Sentences vary in length, so the workers take the items one by one
+  // instead of processing fixed ranges.
+  std::atomic<size_t> next = 0;
+  const size_t num_workers = num_threads;
+  ParallelForRanges(num_workers, num_workers, [&](size_t begin, size_t end) {
+    for (size_t worker = begin; worker < end; ++worker) {
+      QualityRegressionUtil util(converter_);
+      util.SetRequest(request_);
+      util.SetConfig(config_);
+      for (size_t i = next.fetch_add(1, std::memory_order_relaxed);
+           i < parallel_indices.size();
+           i = next.fetch_add(1, std::memory_order_relaxed)) {
+        run(util, parallel_indices[i]);
+      }
+    }
+  });
+
+  for (const size_t index : serial_indices) {
+    run(*this, index);
+  }
+  return results;
+}
+
 void QualityRegressionUtil::SetRequest(const commands::Request& request) {
   request_ = request;
 }
@@ -37,7 +37,9 @@
 
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
+#include "absl/time/time.h"
 #include "absl/types/span.h"
+#include "base/metrics.h"
 #include "protocol/commands.pb.h"
 #include "protocol/config.pb.h"
 
@@ -72,6 +74,13 @@ class QualityRegressionUtil {
     absl::Status ParseFromTSV(absl::string_view tsv_line);
   };
 
+  struct TestResult {
+    // The result of ConvertAndTest().
+    absl::StatusOr<bool> result = false;
+    std::string actual_value;
+    absl::Duration latency;
+  };
+
   explicit QualityRegressionUtil(
       std::shared_ptr<const ConverterInterface> converter);
   QualityRegressionUtil(const QualityRegressionUtil&) = delete;
@@ -87,6 +96,18 @@ class QualityRegressionUtil {
   absl::StatusOr<bool> ConvertAndTest(const TestItem& item,
                                       std::string* actual_value);
 
+  // Runs ConvertAndTest() for all the |items| and returns the results in the
+  // order of |items|. If |num_threads| <= 1, the items run on the calling
+  // thread in their original order. Otherwise each of the |num_threads|
+  // workers has its own QualityRegressionUtil sharing the converter, the
+  // request and the config of this instance. Zero query items learn the user
+  // history, so in that case they run after the others on the calling thread
+  // in their original order. The latencies are also recorded to |latency| if
+  // it is not null.
+  std::vector<TestResult> ConvertAndTestAll(
+      absl::Span<const TestItem> items, int num_threads,
+      LatencyHistogram* latency = nullptr);
+
   void SetRequest(const commands::Request& request);
   void SetConfig(const config::Config& config);
   static std::string GetPlatformString(uint32_t platform_bitfiled);
@@ -0,0 +1,106 @@
+// Copyright 2010-2021, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "converter/quality_regression_util.h"
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "engine/engine.h"
+#include "engine/mock_data_engine_factory.h"
+#include "testing/gunit.h"
+#include "testing/mozctest.h"
+
+namespace mozc {
+namespace quality_regression {
+namespace {
+
+QualityRegressionUtil::TestItem MakeItem(absl::string_view key,
+                                         absl::string_view expected_value,
+                                         absl::string_view command) {
+  QualityRegressionUtil::TestItem item;
+  item.label = "label";
+  item.key = std::string(key);
+  item.expected_value = std::string(expected_value);
+  item.command = std::string(command);
+  item.accuracy = 1.0;
+  item.expected_rank = 0;
+  item.platform = QualityRegressionUtil::DESKTOP;
+  return item;
+}
+
+class QualityRegressionUtilTest : public testing::TestWithTempUserProfile {};
+
+TEST_F(QualityRegressionUtilTest, ConvertAndTestAllKeepsCorpusOrder) {
+  const std::vector<QualityRegressionUtil::TestItem> items = {
+      MakeItem("ここではきものをぬぐ", "ここでは", "Conversion Match"),
+      MakeItem("とうきょう", "東京", "Prediction Expected"),
+      MakeItem("わたしのなまえはなかのです", "名前", "Conversion Match"),
+      MakeItem("とうきょう", "東京", "ZeroQuery Expected"),
+      MakeItem("きょう", "今日", "Conversion Expected"),
+      MakeItem("おきておきて", "起きて", "Conversion Match"),
+  };
+
+  // Runs the items one by one in the corpus order.
+  std::vector<absl::StatusOr<bool>> expected_results;
+  std::vector<std::string> expected_values;
+  {
+    std::unique_ptr<Engine> engine = MockDataEngineFactory::Create().value();
+    ASSERT_TRUE(engine->ClearUserHistory());
+    QualityRegressionUtil util(engine->GetConverter());
+    for (const QualityRegressionUtil::TestItem& item : items) {
+      std::string actual_value;
+      expected_results.push_back(util.ConvertAndTest(item, &actual_value));
+      expected_values.push_back(actual_value);
+    }
+  }
+
+  for (const int num_threads : {1, 4}) {
+    SCOPED_TRACE(num_threads);
+    std::unique_ptr<Engine> engine = MockDataEngineFactory::Create().value();
+    ASSERT_TRUE(engine->ClearUserHistory());
+    QualityRegressionUtil util(engine->GetConverter());
+    const std::vector<QualityRegressionUtil::TestResult> results =
+        util.ConvertAndTestAll(items, num_threads);
+    ASSERT_EQ(results.size(), items.size());
+    for (size_t i = 0; i < items.size(); ++i) {
+      SCOPED_TRACE(items[i].key);
+      EXPECT_EQ(results[i].result, expected_results[i]);
+      EXPECT_EQ(results[i].actual_value, expected_values[i]);
+    }
+  }
+}
+
+}  // namespace
+}  // namespace quality_regression
+}  // namespace mozc
@@ -61,6 +61,7 @@ constexpr size_t kMaxHistorySize = 32;
 Segment::Segment(const Segment& x)
     : removed_candidates_for_debug_(x.removed_candidates_for_debug_),
       segment_type_(x.segment_type_),
+      has_more_candidates_(x.has_more_candidates_),
       key_(x.key_),
       key_len_(x.key_len_),
       meta_candidates_(x.meta_candidates_) {
@@ -70,6 +71,7 @@ Segment::Segment(const Segment& x)
 Segment& Segment::operator=(const Segment& x) {
   removed_candidates_for_debug_ = x.removed_candidates_for_debug_;
   segment_type_ = x.segment_type_;
+  has_more_candidates_ = x.has_more_candidates_;
   key_ = x.key_;
   key_len_ = x.key_len_;
   meta_candidates_ = x.meta_candidates_;
@@ -238,6 +240,7 @@ void Segment::Clear() {
   key_len_ = 0;
   meta_candidates_.clear();
   segment_type_ = FREE;
+  has_more_candidates_ = false;
 }
 
 void Segment::DeepCopyCandidates(const std::deque<Candidate*>& candidates) {
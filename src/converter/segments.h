@@ -77,6 +77,13 @@ class Segment final {
     segment_type_ = segment_type;
   }
 
+  // True if only the top candidates are populated and more can be generated
+  // on demand with Converter::ExpandSegmentCandidates().
+  bool has_more_candidates() const { return has_more_candidates_; }
+  void set_has_more_candidates(bool has_more_candidates) {
+    has_more_candidates_ = has_more_candidates;
+  }
+
   absl::string_view key() const { return key_; }
 
   // Returns the length of the key in Unicode characters. (e.g. 1 for "あ")
@@ -161,6 +168,7 @@ class Segment final {
 
   // LINT.IfChange
   SegmentType segment_type_;
+  bool has_more_candidates_ = false;
   // Note that |key_| is shorter than usual when partial suggestion is
   // performed.
   // For example if the preedit text is "しれ|ません", there is only a segment
@@ -101,6 +101,7 @@ MATCHER_P(EqualsSegment, segment, "") {
     return false;                                                          \
   }
   COMPARE_PROPERTY(segment_type);
+  COMPARE_PROPERTY(has_more_candidates);
   COMPARE_PROPERTY(key);
   COMPARE_PROPERTY(key_len);
 #undef COMPARE_PROPERTY
@@ -30,9 +30,12 @@
 #include "dictionary/dictionary_impl.h"
 
 #include <algorithm>
+#include <cstddef>
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "absl/algorithm/container.h"
 #include "absl/log/check.h"
@@ -80,17 +83,74 @@ bool DictionaryImpl::HasValue(absl::string_view value) const {
 
 namespace {
 
+// Decides whether a token should be dropped under the conversion options.
+// Tokens dropped by `next` are also dropped.
+class TokenFilter : public DictionaryInterface::TokenFilterInterface {
+ public:
+  TokenFilter(const ConversionOptions& options, const PosMatcher& pos_matcher,
+              const UserDictionaryInterface& user_dictionary,
+              const TokenFilterInterface* next = nullptr)
+      : options_(options),
+        pos_matcher_(pos_matcher),
+        user_dictionary_(user_dictionary),
+        next_(next),
+        has_suppressed_entries_(user_dictionary_.HasSuppressedEntries()) {}
+
+  bool IsFiltered(const TokenView& token) const override {
+    return (next_ != nullptr && next_->IsFiltered(token)) ||
+           IsFilteredWithoutValue(token.attributes, token.lid);
+  }
+
+  bool IsFiltered(const Token& token) const override {
+    if (next_ != nullptr && next_->IsFiltered(token)) {
+      return true;
+    }
+    if (!(token.attributes & Token::USER_DICTIONARY)) {
+      if (IsFilteredWithoutValue(token.attributes, token.lid)) {
+        return true;
+      }
+      if (!options_.use_t13n_conversion &&
+          Util::IsEnglishTransliteration(token.value)) {
+        return true;
+      }
+    }
+    return has_suppressed_entries_ &&
+           user_dictionary_.IsSuppressedEntry(token.key, token.value);
+  }
+
+  const ConversionOptions& options() const { return options_; }
+
+ private:
+  // Applies the rules that don't depend on the value of the token.
+  bool IsFilteredWithoutValue(Token::AttributesBitfield attributes,
+                              uint16_t lid) const {
+    if (attributes & Token::USER_DICTIONARY) {
+      return false;
+    }
+    if (!options_.use_spelling_correction &&
+        (attributes & Token::SPELLING_CORRECTION)) {
+      return true;
+    }
+    return !options_.use_zip_code_conversion && pos_matcher_.IsZipcode(lid);
+  }
+
+  const ConversionOptions& options_;
+  const PosMatcher& pos_matcher_;
+  const UserDictionaryInterface& user_dictionary_;
+  const TokenFilterInterface* next_ = nullptr;
+  // cache the result of HasSuppressedEntries, because calling
+  // IsSuppressedEntry() has some latency because of mutex lock even when
+  // the entry is empty.
+  const bool has_suppressed_entries_ = false;
+};
+
 class CallbackWithFilter : public DictionaryInterface::Callback {
  public:
   CallbackWithFilter(const ConversionOptions& options,
                      const PosMatcher& pos_matcher,
                      const UserDictionaryInterface& user_dictionary,
                      DictionaryInterface::Callback* callback)
-      : options_(options),
-        pos_matcher_(pos_matcher),
-        user_dictionary_(user_dictionary),
-        has_suppressed_entries_(user_dictionary_.HasSuppressedEntries()),
-        callback_(callback) {}
+      : filter_(options, pos_matcher, user_dictionary), callback_(callback) {}
 
   ResultType OnKey(absl::string_view key) override {
     return callback_->OnKey(key);
@@ -101,41 +161,26 @@ class CallbackWithFilter : public DictionaryInterface::Callback {
     return callback_->OnActualKey(key, actual_key, num_expanded);
   }
 
+  bool ShouldDecodeToken(absl::string_view key, absl::string_view actual_key,
+                         const TokenView& token) override {
+    return !filter_.IsFiltered(token) &&
+           callback_->ShouldDecodeToken(key, actual_key, token);
+  }
+
   ResultType OnToken(absl::string_view key, absl::string_view actual_key,
                      const Token& token) override {
-    if (!(token.attributes & Token::USER_DICTIONARY)) {
-      if (!options_.use_spelling_correction &&
-          (token.attributes & Token::SPELLING_CORRECTION)) {
-        return TRAVERSE_CONTINUE;
-      }
-      if (!options_.use_zip_code_conversion &&
-          pos_matcher_.IsZipcode(token.lid)) {
-        return TRAVERSE_CONTINUE;
-      }
-      if (!options_.use_t13n_conversion &&
-          Util::IsEnglishTransliteration(token.value)) {
-        return TRAVERSE_CONTINUE;
-      }
-    }
-    if (has_suppressed_entries_ &&
-        user_dictionary_.IsSuppressedEntry(token.key, token.value)) {
+    if (filter_.IsFiltered(token)) {
       return TRAVERSE_CONTINUE;
     }
     return callback_->OnToken(key, actual_key, token);
   }
 
   bool IsKanaModifierInsensitiveConversion() const override {
-    return options_.kana_modifier_insensitive_conversion;
+    return filter_.options().kana_modifier_insensitive_conversion;
   }
 
  private:
-  const ConversionOptions& options_;
-  const PosMatcher& pos_matcher_;
-  const UserDictionaryInterface& user_dictionary_;
-  // cache the result of HasSuppressedEntries, because calling
-  // IsSuppressedEntry() has some latency because of mutex lock even when
-  // the entry is empty.
-  const bool has_suppressed_entries_ = false;
+  const TokenFilter filter_;
   DictionaryInterface::Callback* callback_ = nullptr;
 };
 
@@ -163,6 +208,29 @@ void DictionaryImpl::LookupPrefix(absl::string_view key,
   }
 }
 
+void DictionaryImpl::LookupPrefixBatch(
+    absl::string_view key, absl::Span<const size_t> begin_positions,
+    const ConversionOptions& options, const TokenFilterInterface* filter,
+    std::vector<PrefixMatch>* matches) const {
+  // The dictionaries apply the filter while looking up, so that the dropped
+  // tokens are neither decoded nor copied.
+  const TokenFilter token_filter(options, pos_matcher_, user_dictionary_,
+                                 filter);
+  const size_t original_size = matches->size();
+  for (const DictionaryInterface* dic :
+       GetDictionaries(options.incognito_mode)) {
+    dic->LookupPrefixBatch(key, begin_positions, options, &token_filter,
+                           matches);
+  }
+  // Each dictionary appends its matches in the order of begin positions.
+  // Stable sort merges them while keeping the order of dictionaries for the
+  // same begin position, as LookupPrefix() does.
+  std::stable_sort(matches->begin() + original_size, matches->end(),
+                   [](const PrefixMatch& lhs, const PrefixMatch& rhs) {
+                     return lhs.begin < rhs.begin;
+                   });
+}
+
 void DictionaryImpl::LookupExact(absl::string_view key,
                                  const ConversionOptions& options,
                                  Callback* callback) const {
@@ -30,11 +30,13 @@
 #ifndef MOZC_DICTIONARY_DICTIONARY_IMPL_H_
 #define MOZC_DICTIONARY_DICTIONARY_IMPL_H_
 
+#include <cstddef>
 #include <memory>
 #include <string>
 #include <vector>
 
 #include "absl/strings/string_view.h"
+#include "absl/types/span.h"
 #include "dictionary/dictionary_interface.h"
 #include "dictionary/pos_matcher.h"
 #include "request/options.h"
@@ -82,6 +84,11 @@ class DictionaryImpl : public DictionaryInterface {
                         Callback* callback) const override;
   void LookupPrefix(absl::string_view key, const ConversionOptions& options,
                     Callback* callback) const override;
+  void LookupPrefixBatch(absl::string_view key,
+                         absl::Span<const size_t> begin_positions,
+                         const ConversionOptions& options,
+                         const TokenFilterInterface* filter,
+                         std::vector<PrefixMatch>* matches) const override;
 
   void LookupExact(absl::string_view key, const ConversionOptions& options,
                    Callback* callback) const override;
@@ -29,13 +29,17 @@
 
 #include "dictionary/dictionary_impl.h"
 
+#include <algorithm>
+#include <cstddef>
 #include <cstring>
 #include <iterator>
 #include <memory>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "absl/strings/string_view.h"
+#include "absl/types/span.h"
 #include "base/container/tuple.h"
 #include "base/util.h"
 #include "config/config_handler.h"
@@ -288,6 +292,45 @@ TEST_F(DictionaryImplTest, DisableSpellingCorrectionTest) {
   }
 }
 
+TEST_F(DictionaryImplTest, LookupPrefixBatchAppliesFilter) {
+  std::unique_ptr<DictionaryData> data = CreateDictionaryData();
+  DictionaryInterface* d = data->dictionary.get();
+
+  // "あぼがど" -> "アボカド" is a spelling correction entry in the test
+  // dictionary.
+  constexpr absl::string_view kKey = "xあぼがど";
+  constexpr absl::string_view kValue = "アボカド";
+  const std::vector<size_t> begin_positions = {0, 1, 4, 7, 10};
+
+  auto find_spelling_correction =
+      [&](absl::Span<const DictionaryInterface::PrefixMatch> matches) {
+        return std::any_of(
+            matches.begin(), matches.end(),
+            [&](const DictionaryInterface::PrefixMatch& match) {
+              return match.begin == 1 && match.end == kKey.size() &&
+                     match.token.value == kValue &&
+                     (match.token.attributes & Token::SPELLING_CORRECTION);
+            });
+      };
+
+  config_.set_use_spelling_correction(true);
+  std::vector<DictionaryInterface::PrefixMatch> matches;
+  d->LookupPrefixBatch(kKey, begin_positions, ConvReq(config_).options(),
+                       /*filter=*/nullptr, &matches);
+  EXPECT_TRUE(find_spelling_correction(matches));
+  EXPECT_TRUE(std::is_sorted(matches.begin(), matches.end(),
+                             [](const DictionaryInterface::PrefixMatch& lhs,
+                                const DictionaryInterface::PrefixMatch& rhs) {
+                               return lhs.begin < rhs.begin;
+                             }));
+
+  config_.set_use_spelling_correction(false);
+  matches.clear();
+  d->LookupPrefixBatch(kKey, begin_positions, ConvReq(config_).options(),
+                       /*filter=*/nullptr, &matches);
+  EXPECT_FALSE(find_spelling_correction(matches));
+}
+
 TEST_F(DictionaryImplTest, DisableZipCodeConversionTest) {
   std::unique_ptr<DictionaryData> data = CreateDictionaryData();
   DictionaryInterface* d = data->dictionary.get();
@@ -30,12 +30,15 @@
 #ifndef MOZC_DICTIONARY_DICTIONARY_INTERFACE_H_
 #define MOZC_DICTIONARY_DICTIONARY_INTERFACE_H_
 
+#include <cstddef>
+#include <cstdint>
 #include <functional>
 #include <string>
 #include <utility>
 #include <vector>
 
 #include "absl/strings/string_view.h"
+#include "absl/types/span.h"
 #include "dictionary/dictionary_token.h"
 #include "protocol/user_dictionary_storage.pb.h"
 #include "request/options.h"
@@ -55,7 +58,9 @@ class DictionaryInterface {
   //   OnKey(key);
   //   OnActualKey(key, actual_key, key != actual_key);
   //   for (each token in the token array for the key) {
-  //     OnToken(key, actual_key, token);
+  //     if (ShouldDecodeToken(key, actual_key, token_view)) {
+  //       OnToken(key, actual_key, token);
+  //     }
   //   }
   // }
   //
@@ -103,6 +108,16 @@ class DictionaryInterface {
       return TRAVERSE_CONTINUE;
     }
 
+    // Called back before OnToken() by dictionaries that decode the value of a
+    // token lazily. Returning false skips the token without decoding its
+    // value. Other dictionaries don't call this method, so OnToken() must
+    // still be prepared to receive tokens rejected here.
+    virtual bool ShouldDecodeToken(absl::string_view key,
+                                   absl::string_view actual_key,
+                                   const TokenView& token) {
+      return true;
+    }
+
     // Called back when a token is decoded.
     virtual ResultType OnToken(absl::string_view key,
                                absl::string_view expanded_key,
@@ -116,6 +131,29 @@ class DictionaryInterface {
     Callback() = default;
   };
 
+  // A token found by LookupPrefixBatch(). The key of `token` is a prefix of
+  // the lookup key starting at `begin`, and `end` is the position right after
+  // the prefix. Positions are byte offsets in the lookup key.
+  struct PrefixMatch {
+    uint32_t begin = 0;
+    uint32_t end = 0;
+    // The number of characters expanded by kana modifier insensitive lookup.
+    int num_expanded = 0;
+    Token token;
+  };
+
+  // Drops tokens from the results of LookupPrefixBatch().
+  class TokenFilterInterface {
+   public:
+    virtual ~TokenFilterInterface() = default;
+
+    // Returns true if the token should be dropped. Dictionaries that decode
+    // values lazily call the first one before decoding the value, but still
+    // call the second one for the decoded token.
+    virtual bool IsFiltered(const TokenView& token) const = 0;
+    virtual bool IsFiltered(const Token& token) const = 0;
+  };
+
   virtual ~DictionaryInterface() = default;
 
   // Returns true if the dictionary has an entry for the given key.
@@ -193,6 +231,21 @@ class DictionaryInterface {
     return LookupComment(key, value, comment);
   }
 
+  // Looks up the prefixes of `key.substr(begin)` for every `begin` in
+  // `begin_positions` at once, and appends all the found tokens to `matches`.
+  // `begin_positions` must be sorted, and the matches are appended in the
+  // order of their begin positions. This is equivalent to calling
+  // LookupPrefix() for each position with a callback accepting all the tokens,
+  // but implementations can share the decoding state among positions and avoid
+  // virtual calls per token. Tokens rejected by `filter` are not appended, and
+  // `filter` can be null to accept all the tokens. `matches` is not cleared so
+  // that callers can reuse its buffer.
+  virtual void LookupPrefixBatch(absl::string_view key,
+                                 absl::Span<const size_t> begin_positions,
+                                 const ConversionOptions& options,
+                                 const TokenFilterInterface* filter,
+                                 std::vector<PrefixMatch>* matches) const;
+
   // Populates cache for LookupReverse().
   // TODO(noriyukit): These cache initialize/finalize mechanism shouldn't be a
   // part of the interface.
@@ -296,6 +349,73 @@ class UserDictionaryInterface : public DictionaryInterface {
   virtual std::string GetFileName() const { return ""; }
 };
 
+namespace dictionary_internal {
+
+// Collects tokens into PrefixMatch for the default implementation of
+// DictionaryInterface::LookupPrefixBatch().
+class PrefixMatchCollector : public DictionaryInterface::Callback {
+ public:
+  PrefixMatchCollector(
+      const ConversionOptions& options,
+      const DictionaryInterface::TokenFilterInterface* filter,
+      std::vector<DictionaryInterface::PrefixMatch>* matches)
+      : options_(options), filter_(filter), matches_(matches) {}
+
+  void set_begin(size_t begin) { begin_ = begin; }
+
+  ResultType OnActualKey(absl::string_view key, absl::string_view actual_key,
+                         int num_expanded) override {
+    num_expanded_ = num_expanded;
+    return TRAVERSE_CONTINUE;
+  }
+
+  bool ShouldDecodeToken(absl::string_view key, absl::string_view actual_key,
+                         const TokenView& token) override {
+    return filter_ == nullptr || !filter_->IsFiltered(token);
+  }
+
+  ResultType OnToken(absl::string_view key, absl::string_view actual_key,
+                     const Token& token) override {
+    if (filter_ != nullptr && filter_->IsFiltered(token)) {
+      return TRAVERSE_CONTINUE;
+    }
+    DictionaryInterface::PrefixMatch& match = matches_->emplace_back();
+    match.begin = begin_;
+    match.end = begin_ + key.size();
+    match.num_expanded = num_expanded_;
+    match.token = token;
+    return TRAVERSE_CONTINUE;
+  }
+
+  bool IsKanaModifierInsensitiveConversion() const override {
+    return options_.kana_modifier_insensitive_conversion;
+  }
+
+ private:
+  const ConversionOptions& options_;
+  const DictionaryInterface::TokenFilterInterface* filter_;
+  std::vector<DictionaryInterface::PrefixMatch>* matches_;
+  uint32_t begin_ = 0;
+  int num_expanded_ = 0;
+};
+
+}  // namespace dictionary_internal
+
+inline void DictionaryInterface::LookupPrefixBatch(
+    absl::string_view key, absl::Span<const size_t> begin_positions,
+    const ConversionOptions& options, const TokenFilterInterface* filter,
+    std::vector<PrefixMatch>* matches) const {
+  dictionary_internal::PrefixMatchCollector collector(options, filter,
+                                                      matches);
+  for (const size_t begin : begin_positions) {
+    if (begin >= key.size()) {
+      break;
+    }
+    collector.set_begin(begin);
+    LookupPrefix(key.substr(begin), options, &collector);
+  }
+}
+
 }  // namespace dictionary
 }  // namespace mozc
 
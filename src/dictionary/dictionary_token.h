@@ -70,6 +70,17 @@ struct Token {
   AttributesBitfield attributes = NONE;
 };
 
+// Fields of a token that can be decoded without its value. Dictionaries that
+// restore values lazily pass this to Callback::ShouldDecodeToken() so that
+// callbacks can reject tokens before the value string is built.
+struct TokenView {
+  absl::string_view key;
+  int cost = 0;
+  uint16_t lid = 0;
+  uint16_t rid = 0;
+  Token::AttributesBitfield attributes = Token::NONE;
+};
+
 }  // namespace dictionary
 }  // namespace mozc
 
@@ -34,10 +34,13 @@
 //  --output="output.h"
 //  --make_header
 
+#include <algorithm>
+#include <cstdint>
 #include <ios>
 #include <memory>
 #include <ostream>
 #include <string>
+#include <thread>  // NOLINT(build/c++11): used only to count CPUs.
 #include <tuple>
 #include <utility>
 #include <vector>
@@ -57,6 +60,9 @@
 ABSL_FLAG(std::string, input, "", "space separated input text files");
 ABSL_FLAG(std::string, user_pos_manager_data, "", "user pos manager data");
 ABSL_FLAG(std::string, output, "", "output binary file");
+ABSL_FLAG(int32_t, num_threads, 1,
+          "number of threads to build the dictionary. 0 means the number of "
+          "available CPUs. The output doesn't depend on this value.");
 
 namespace mozc {
 namespace {
@@ -90,6 +96,14 @@ std::pair<std::string, std::string> GetInputFileName(
           absl::StrJoin(reading_correction_inputs, kDelimiter)};
 }
 
+int GetNumThreads() {
+  const int num_threads = absl::GetFlag(FLAGS_num_threads);
+  if (num_threads > 0) {
+    return num_threads;
+  }
+  return std::max<int>(std::thread::hardware_concurrency(), 1);
+}
+
 }  // namespace
 }  // namespace mozc
 
@@ -111,10 +125,13 @@ int main(int argc, char** argv) {
   const mozc::dictionary::PosMatcher pos_matcher(
       data_manager.value()->GetPosMatcherData());
 
+  const int num_threads = mozc::GetNumThreads();
   mozc::dictionary::TextDictionaryLoader loader(pos_matcher);
+  loader.set_num_threads(num_threads);
   loader.Load(system_dictionary_input, reading_correction_input);
 
   mozc::dictionary::SystemDictionaryBuilder builder;
+  builder.set_num_threads(num_threads);
   builder.BuildFromTokens(loader.tokens());
 
   auto output_stream = std::make_unique<mozc::OutputFileStream>(
@@ -47,6 +47,7 @@
 #include "dictionary/system/system_dictionary.h"
 
 #include <algorithm>
+#include <cstddef>
 #include <cstdint>
 #include <cstring>
 #include <iterator>
@@ -81,6 +82,7 @@
 #include "dictionary/system/key_expansion_table.h"
 #include "dictionary/system/token_decode_iterator.h"
 #include "dictionary/system/words_info.h"
+#include "request/options.h"
 #include "storage/louds/bit_vector_based_array.h"
 #include "storage/louds/louds_trie.h"
 
@@ -689,6 +691,10 @@ void SystemDictionary::LookupPredictive(absl::string_view key,
                                   actual_key,
                                   GetTokenArrayPtr(token_array_, key_id));
          !iter.Done(); iter.Next()) {
+      if (!callback->ShouldDecodeToken(decoded_key, actual_key,
+                                       iter.GetView())) {
+        continue;
+      }
       const TokenInfo& token_info = iter.Get();
       const Callback::ResultType result =
           callback->OnToken(decoded_key, actual_key, *token_info.token);
@@ -719,13 +725,12 @@ namespace {
 //   token_filter:
 //     A functor of signature bool(const TokenInfo &).  Only tokens for which
 //     this functor returns true are passed to callback function.
-template <typename Func>
+template <typename CallbackT, typename Func>
 void RunCallbackOnEachPrefix(
     const LoudsTrie& key_trie, const LoudsTrie& value_trie,
     const BitVectorBasedArray& token_array, const SystemDictionaryCodec& codec,
     absl::Span<const uint32_t> frequent_pos, absl::string_view key,
-    absl::string_view encoded_key, DictionaryInterface::Callback* callback,
-    Func token_filter) {
+    absl::string_view encoded_key, CallbackT* callback, Func token_filter) {
   typedef DictionaryInterface::Callback Callback;
   LoudsTrie::Node node;
   for (absl::string_view::size_type i = 0; i < encoded_key.size();) {
@@ -764,6 +769,9 @@ void RunCallbackOnEachPrefix(
     for (TokenDecodeIterator iter(codec, value_trie, frequent_pos, prefix,
                                   GetTokenArrayPtr(token_array, key_id));
          !iter.Done(); iter.Next()) {
+      if (!callback->ShouldDecodeToken(prefix, prefix, iter.GetView())) {
+        continue;
+      }
       const TokenInfo& token_info = iter.Get();
       if (!token_filter(token_info)) {
         continue;
@@ -823,10 +831,11 @@ class ReverseLookupCallbackWrapper : public DictionaryInterface::Callback {
 //   actual_prefix:
 //     A reused string for decoded actual key.  This is just for performance
 //     purpose.
+template <class CallbackT>
 DictionaryInterface::Callback::ResultType
 SystemDictionary::LookupPrefixWithKeyExpansionImpl(
     absl::string_view key, absl::string_view encoded_key,
-    const KeyExpansionTable& table, Callback* callback, LoudsTrie::Node node,
+    const KeyExpansionTable& table, CallbackT* callback, LoudsTrie::Node node,
     absl::string_view::size_type key_pos, int num_expanded,
     char* actual_key_buffer, std::string* actual_prefix) const {
   // This do-block handles a terminal node and callback.  do-block is used to
@@ -864,6 +873,10 @@ SystemDictionary::LookupPrefixWithKeyExpansionImpl(
                                   *actual_prefix,
                                   GetTokenArrayPtr(token_array_, key_id));
          !iter.Done(); iter.Next()) {
+      if (!callback->ShouldDecodeToken(prefix, *actual_prefix,
+                                       iter.GetView())) {
+        continue;
+      }
       const TokenInfo& token_info = iter.Get();
       result = callback->OnToken(prefix, *actual_prefix, *token_info.token);
       if (result == Callback::TRAVERSE_DONE ||
@@ -921,6 +934,105 @@ void SystemDictionary::LookupPrefix(absl::string_view key,
       LoudsTrie::Node(), 0, false, actual_key_buffer, &actual_prefix);
 }
 
+namespace {
+
+// Appends tokens to the buffer of LookupPrefixBatch(). This class provides the
+// same methods as DictionaryInterface::Callback, but they are not virtual so
+// that the traversal templates above can call them directly. Tokens rejected
+// by the filter are skipped before their values are decoded.
+class PrefixMatchSink final {
+ public:
+  using Callback = DictionaryInterface::Callback;
+  using PrefixMatch = DictionaryInterface::PrefixMatch;
+  using TokenFilterInterface = DictionaryInterface::TokenFilterInterface;
+
+  PrefixMatchSink(const TokenFilterInterface* filter,
+                  std::vector<PrefixMatch>* matches)
+      : filter_(filter), matches_(matches) {}
+
+  void set_begin(size_t begin) { begin_ = begin; }
+
+  Callback::ResultType OnKey(absl::string_view key) {
+    return Callback::TRAVERSE_CONTINUE;
+  }
+
+  Callback::ResultType OnActualKey(absl::string_view key,
+                                   absl::string_view actual_key,
+                                   int num_expanded) {
+    num_expanded_ = num_expanded;
+    return Callback::TRAVERSE_CONTINUE;
+  }
+
+  bool ShouldDecodeToken(absl::string_view key, absl::string_view actual_key,
+                         const TokenView& token) {
+    return filter_ == nullptr || !filter_->IsFiltered(token);
+  }
+
+  Callback::ResultType OnToken(absl::string_view key,
+                               absl::string_view actual_key,
+                               const Token& token) {
+    if (filter_ != nullptr && filter_->IsFiltered(token)) {
+      return Callback::TRAVERSE_CONTINUE;
+    }
+    PrefixMatch& match = matches_->emplace_back();
+    match.begin = begin_;
+    match.end = begin_ + key.size();
+    match.num_expanded = num_expanded_;
+    match.token = token;
+    return Callback::TRAVERSE_CONTINUE;
+  }
+
+ private:
+  const TokenFilterInterface* filter_;
+  std::vector<PrefixMatch>* matches_;
+  uint32_t begin_ = 0;
+  int num_expanded_ = 0;
+};
+
+}  // namespace
+
+void SystemDictionary::LookupPrefixBatch(
+    absl::string_view key, absl::Span<const size_t> begin_positions,
+    const ConversionOptions& options, const TokenFilterInterface* filter,
+    std::vector<PrefixMatch>* matches) const {
+  // Keys are encoded character by character, so the whole key is encoded only
+  // once and its suffixes are shared by all the begin positions.
+  const std::string encoded_key = codec_->EncodeKey(key);
+  PrefixMatchSink sink(filter, matches);
+  char actual_key_buffer[LoudsTrie::kMaxDepth + 1];
+  std::string actual_prefix;
+  actual_prefix.reserve(key.size() * 3);
+
+  size_t prev_begin = 0;
+  size_t encoded_begin = 0;
+  for (const size_t begin : begin_positions) {
+    if (begin >= key.size()) {
+      break;
+    }
+    DCHECK_GE(begin, prev_begin);
+    encoded_begin +=
+        codec_->GetEncodedKeyLength(key.substr(prev_begin, begin - prev_begin));
+    prev_begin = begin;
+
+    const absl::string_view key_suffix = key.substr(begin);
+    const absl::string_view encoded_suffix =
+        absl::string_view(encoded_key).substr(encoded_begin);
+    sink.set_begin(begin);
+    if (!options.kana_modifier_insensitive_conversion) {
+      RunCallbackOnEachPrefix(
+          key_trie_, value_trie_, token_array_, *codec_, frequent_pos_,
+          key_suffix, encoded_suffix, &sink,
+          // Select all tokens.
+          [](const TokenInfo& token_info) { return true; });
+      continue;
+    }
+    LookupPrefixWithKeyExpansionImpl(key_suffix, encoded_suffix,
+                                     hiragana_expansion_table_, &sink,
+                                     LoudsTrie::Node(), 0, 0,
+                                     actual_key_buffer, &actual_prefix);
+  }
+}
+
 void SystemDictionary::LookupExact(absl::string_view key,
                                    Callback* callback) const {
   // Find the key in the key trie.
@@ -939,6 +1051,9 @@ void SystemDictionary::LookupExact(absl::string_view key,
   for (TokenDecodeIterator iter(*codec_, value_trie_, frequent_pos_, key,
                                 GetTokenArrayPtr(token_array_, key_id));
        !iter.Done(); iter.Next()) {
+    if (!callback->ShouldDecodeToken(key, key, iter.GetView())) {
+      continue;
+    }
     if (callback->OnToken(key, key, *iter.Get().token) !=
         Callback::TRAVERSE_CONTINUE) {
       break;
@@ -1084,12 +1199,12 @@ void SystemDictionary::RegisterReverseLookupResults(
                *codec_, value_trie_, frequent_pos_, tokens_key,
                encoded_tokens_ptr + reverse_result.tokens_offset);
            !iter.Done(); iter.Next()) {
-        const TokenInfo& token_info = iter.Get();
-        if (token_info.token->attributes & Token::SPELLING_CORRECTION ||
-            token_info.id_in_value_trie != value_id) {
+        // Check the token before restoring its value.
+        if (iter.GetView().attributes & Token::SPELLING_CORRECTION ||
+            iter.GetValueId() != value_id) {
           continue;
         }
-        callback->OnToken(tokens_key, tokens_key, *token_info.token);
+        callback->OnToken(tokens_key, tokens_key, *iter.Get().token);
       }
     }
   }
@@ -46,6 +46,7 @@
 #include "dictionary/file/dictionary_file.h"
 #include "dictionary/system/codec.h"
 #include "dictionary/system/key_expansion_table.h"
+#include "request/options.h"
 #include "storage/louds/bit_vector_based_array.h"
 #include "storage/louds/louds_trie.h"
 
@@ -126,6 +127,11 @@ class SystemDictionary : public DictionaryInterface {
                         Callback* callback) const override;
 
   void LookupPrefix(absl::string_view key, Callback* callback) const override;
+  void LookupPrefixBatch(absl::string_view key,
+                         absl::Span<const size_t> begin_positions,
+                         const ConversionOptions& options,
+                         const TokenFilterInterface* filter,
+                         std::vector<PrefixMatch>* matches) const override;
 
   void LookupExact(absl::string_view key, Callback* callback) const override;
 
@@ -155,9 +161,12 @@ class SystemDictionary : public DictionaryInterface {
                                     Callback* callback) const;
   void InitReverseLookupIndex();
 
+  // `CallbackT` is either Callback or a concrete class with the same methods.
+  // The latter avoids virtual calls for each key and token.
+  template <class CallbackT>
   Callback::ResultType LookupPrefixWithKeyExpansionImpl(
       absl::string_view key, absl::string_view encoded_key,
-      const KeyExpansionTable& table, Callback* callback,
+      const KeyExpansionTable& table, CallbackT* callback,
       storage::louds::LoudsTrie::Node node,
       absl::string_view::size_type key_pos, int num_expanded,
       char* actual_key_buffer, std::string* actual_prefix) const;
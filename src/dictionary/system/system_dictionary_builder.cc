@@ -31,6 +31,7 @@
 
 #include <algorithm>
 #include <climits>
+#include <cstddef>
 #include <cstdint>
 #include <cstring>
 #include <ios>
@@ -55,6 +56,7 @@
 #include "base/file_stream.h"
 #include "base/file_util.h"
 #include "base/japanese_util.h"
+#include "base/thread.h"
 #include "base/util.h"
 #include "base/vlog.h"
 #include "dictionary/dictionary_token.h"
@@ -99,9 +101,19 @@ void SystemDictionaryBuilder::BuildFromTokensInternal(
     std::vector<Token*> tokens) {
   KeyInfoList key_info_list = ReadTokens(std::move(tokens));
 
-  BuildFrequentPos(key_info_list);
-  BuildValueTrie(key_info_list);
-  BuildKeyTrie(key_info_list);
+  // The value trie, the key trie and the frequent POS map are independent of
+  // each other, so the value trie is built in background if possible.
+  if (num_threads_ > 1) {
+    BackgroundFuture<void> value_trie(
+        [this, &key_info_list] { BuildValueTrie(key_info_list); });
+    BuildKeyTrie(key_info_list);
+    BuildFrequentPos(key_info_list);
+    value_trie.Wait();
+  } else {
+    BuildFrequentPos(key_info_list);
+    BuildValueTrie(key_info_list);
+    BuildKeyTrie(key_info_list);
+  }
 
   SetIdForValue(&key_info_list);
   SetIdForKey(&key_info_list);
@@ -253,6 +265,17 @@ SystemDictionaryBuilder::KeyInfoList SystemDictionaryBuilder::ReadTokens(
   return key_info_list;
 }
 
+template <class F>
+void SystemDictionaryBuilder::ForEachKeyInfo(KeyInfoList* key_info_list,
+                                             F f) const {
+  ParallelForRanges(key_info_list->size(), num_threads_,
+                    [key_info_list, &f](size_t begin, size_t end) {
+                      for (size_t i = begin; i < end; ++i) {
+                        f((*key_info_list)[i]);
+                      }
+                    });
+}
+
 void SystemDictionaryBuilder::BuildFrequentPos(
     const KeyInfoList& key_info_list) {
   // Calculate the frequency of each POS.
@@ -317,17 +340,17 @@ void SystemDictionaryBuilder::BuildValueTrie(const KeyInfoList& key_info_list) {
 }
 
 void SystemDictionaryBuilder::SetIdForValue(KeyInfoList* key_info_list) const {
-  for (KeyInfo& key_info : *key_info_list) {
+  ForEachKeyInfo(key_info_list, [this](KeyInfo& key_info) {
     for (TokenInfo& token_info : key_info.tokens) {
       const std::string value_str =
           codec_->EncodeValue(token_info.token->value);
       token_info.id_in_value_trie = value_trie_builder_.GetId(value_str);
     }
-  }
+  });
 }
 
 void SystemDictionaryBuilder::SortTokenInfo(KeyInfoList* key_info_list) const {
-  for (KeyInfo& key_info : *key_info_list) {
+  ForEachKeyInfo(key_info_list, [](KeyInfo& key_info) {
     std::stable_sort(
         key_info.tokens.begin(), key_info.tokens.end(),
         [](const TokenInfo& lhs, const TokenInfo& rhs) {
@@ -337,7 +360,7 @@ void SystemDictionaryBuilder::SortTokenInfo(KeyInfoList* key_info_list) const {
                  std::tie(lhs.token->lid, lhs.token->rid, rhs.id_in_value_trie,
                           rhs.token->attributes);
         });
-  }
+  });
 }
 
 void SystemDictionaryBuilder::SetCostType(KeyInfoList* key_info_list) const {
@@ -367,17 +390,18 @@ void SystemDictionaryBuilder::SetCostType(KeyInfoList* key_info_list) const {
 
   const int min_key_len =
       absl::GetFlag(FLAGS_min_key_length_to_use_small_cost_encoding);
-  for (KeyInfo& key_info : *key_info_list) {
+  ForEachKeyInfo(key_info_list, [min_key_len, &heterophone_values](
+                                     KeyInfo& key_info) {
     if (Util::CharsLen(key_info.key) < min_key_len) {
       // Do not use small cost encoding for short keys.
-      continue;
+      return;
     }
     if (HasHomonymsInSamePos(key_info)) {
-      continue;
+      return;
     }
     if (HasHeterophones(key_info, heterophone_values)) {
       // We want to keep the cost order for LookupReverse().
-      continue;
+      return;
     }
 
     for (TokenInfo& token_info : key_info.tokens) {
@@ -387,11 +411,11 @@ void SystemDictionaryBuilder::SetCostType(KeyInfoList* key_info_list) const {
       }
       token_info.cost_type = TokenInfo::CAN_USE_SMALL_ENCODING;
     }
-  }
+  });
 }
 
 void SystemDictionaryBuilder::SetPosType(KeyInfoList* key_info_list) const {
-  for (KeyInfo& key_info : *key_info_list) {
+  ForEachKeyInfo(key_info_list, [this](KeyInfo& key_info) {
     for (size_t i = 0; i < key_info.tokens.size(); ++i) {
       TokenInfo* token_info = &(key_info.tokens[i]);
       const uint32_t pos =
@@ -410,11 +434,11 @@ void SystemDictionaryBuilder::SetPosType(KeyInfoList* key_info_list) const {
         }
       }
     }
-  }
+  });
 }
 
 void SystemDictionaryBuilder::SetValueType(KeyInfoList* key_info_list) const {
-  for (KeyInfo& key_info : *key_info_list) {
+  ForEachKeyInfo(key_info_list, [](KeyInfo& key_info) {
     for (size_t i = 1; i < key_info.tokens.size(); ++i) {
       const TokenInfo& prev_token_info = key_info.tokens[i - 1];
       TokenInfo* token_info = &(key_info.tokens[i]);
@@ -424,7 +448,7 @@ void SystemDictionaryBuilder::SetValueType(KeyInfoList* key_info_list) const {
         token_info->value_type = TokenInfo::SAME_AS_PREV_VALUE;
       }
     }
-  }
+  });
 }
 
 void SystemDictionaryBuilder::BuildKeyTrie(const KeyInfoList& key_info_list) {
@@ -435,10 +459,10 @@ void SystemDictionaryBuilder::BuildKeyTrie(const KeyInfoList& key_info_list) {
 }
 
 void SystemDictionaryBuilder::SetIdForKey(KeyInfoList* key_info_list) const {
-  for (KeyInfo& key_info : *key_info_list) {
+  ForEachKeyInfo(key_info_list, [this](KeyInfo& key_info) {
     key_info.id_in_key_trie =
         key_trie_builder_.GetId(codec_->EncodeKey(key_info.key));
-  }
+  });
 }
 
 void SystemDictionaryBuilder::BuildTokenArray(
@@ -453,8 +477,20 @@ void SystemDictionaryBuilder::BuildTokenArray(
       id_to_keyinfo_table[id] = &key_info;
     }
 
-    for (const KeyInfo* key_info : id_to_keyinfo_table) {
-      token_array_builder_.Add(codec_->EncodeTokens(key_info->tokens));
+    // Encoding is done in parallel, but the encoded tokens are added in the
+    // order of ids.
+    std::vector<std::string> encoded_tokens(id_to_keyinfo_table.size());
+    ParallelForRanges(
+        id_to_keyinfo_table.size(), num_threads_,
+        [this, &id_to_keyinfo_table, &encoded_tokens](size_t begin,
+                                                      size_t end) {
+          for (size_t i = begin; i < end; ++i) {
+            encoded_tokens[i] =
+                codec_->EncodeTokens(id_to_keyinfo_table[i]->tokens);
+          }
+        });
+    for (std::string& encoded : encoded_tokens) {
+      token_array_builder_.Add(std::move(encoded));
     }
   }
 
@@ -73,6 +73,10 @@ class SystemDictionaryBuilder final {
   SystemDictionaryBuilder(const SystemDictionaryBuilder&) = delete;
   SystemDictionaryBuilder& operator=(const SystemDictionaryBuilder&) = delete;
 
+  // Sets the number of threads used to build the dictionary. The output image
+  // is byte-identical regardless of this value. Defaults to 1.
+  void set_num_threads(int num_threads) { num_threads_ = num_threads; }
+
   void BuildFromTokens(absl::Span<Token* const> tokens) {
     BuildFromTokensInternal(std::vector<Token*>(tokens.begin(), tokens.end()));
   }
@@ -92,6 +96,11 @@ class SystemDictionaryBuilder final {
 
   KeyInfoList ReadTokens(std::vector<Token*> tokens) const;
 
+  // Invokes `f(key_info)` for every element of `key_info_list`, distributing
+  // the elements over `num_threads_` threads.
+  template <class F>
+  void ForEachKeyInfo(KeyInfoList* key_info_list, F f) const;
+
   void BuildFrequentPos(const KeyInfoList& key_info_list);
   void BuildValueTrie(const KeyInfoList& key_info_list);
   void BuildKeyTrie(const KeyInfoList& key_info_list);
@@ -114,6 +123,7 @@ class SystemDictionaryBuilder final {
 
   std::unique_ptr<const SystemDictionaryCodec> codec_;
   std::unique_ptr<const DictionaryFileCodec> file_codec_;
+  int num_threads_ = 1;
 };
 
 }  // namespace dictionary
@@ -36,7 +36,9 @@
 #include <limits>
 #include <memory>
 #include <set>
+#include <sstream>
 #include <string>
+#include <tuple>
 #include <utility>
 #include <vector>
 
@@ -49,6 +51,7 @@
 #include "absl/types/span.h"
 #include "base/file/temp_dir.h"
 #include "base/file_util.h"
+#include "base/strings/unicode.h"
 #include "data_manager/testing/mock_data_manager.h"
 #include "dictionary/dictionary_interface.h"
 #include "dictionary/dictionary_mock.h"
@@ -58,6 +61,7 @@
 #include "dictionary/system/system_dictionary_builder.h"
 #include "dictionary/text_dictionary_loader.h"
 #include "protocol/commands.pb.h"
+#include "request/options.h"
 #include "testing/gmock.h"
 #include "testing/gunit.h"
 #include "testing/mozctest.h"
@@ -76,6 +80,7 @@ using ::testing::_;
 using ::testing::AtLeast;
 using ::testing::Eq;
 using ::testing::Return;
+using ::testing::UnorderedElementsAre;
 
 class SystemDictionaryTest : public testing::TestWithTempUserProfile {
  protected:
@@ -536,6 +541,187 @@ TEST_F(SystemDictionaryTest, LookupPrefix) {
   }
 }
 
+// Collects the results of LookupPrefix() in the same form as PrefixMatch.
+class CollectPrefixMatchCallback : public TokenCallbackBase {
+ public:
+  using Match = std::tuple<uint32_t, uint32_t, int, std::string, std::string>;
+
+  explicit CollectPrefixMatchCallback(uint32_t begin) : begin_(begin) {}
+
+  ResultType OnActualKey(absl::string_view key, absl::string_view actual_key,
+                         int num_expanded) override {
+    num_expanded_ = num_expanded;
+    return TRAVERSE_CONTINUE;
+  }
+
+  ResultType OnToken(absl::string_view key, absl::string_view actual_key,
+                     const Token& token) override {
+    matches_.emplace_back(begin_, begin_ + key.size(), num_expanded_,
+                          token.key, token.value);
+    return TRAVERSE_CONTINUE;
+  }
+
+  const std::vector<Match>& matches() const { return matches_; }
+
+ private:
+  const uint32_t begin_;
+  int num_expanded_ = 0;
+  std::vector<Match> matches_;
+};
+
+TEST_F(SystemDictionaryTest, LookupPrefixBatch) {
+  std::vector<Token> tokens = {
+      {"あ", "亜"},     {"あ", "安"},     {"あい", "愛"},     {"い", "胃"},
+      {"いう", "言う"}, {"う", "宇"},     {"は", "葉"},       {"ば", "場"},
+      {"はひ", "ハヒ"}, {"ばび", "馬尾"}, {"ひ", "日"},       {"び", "美"},
+  };
+  std::unique_ptr<SystemDictionary> system_dic =
+      BuildSystemDictionary(MakeTokenPointers(&tokens));
+  ASSERT_TRUE(system_dic);
+
+  using Match = CollectPrefixMatchCallback::Match;
+  for (const bool kana_modifier_insensitive : {false, true}) {
+    for (const absl::string_view key : {"あいう", "はひ", "xあい"}) {
+      ConversionOptions options;
+      options.kana_modifier_insensitive_conversion = kana_modifier_insensitive;
+
+      // Expected results are collected by LookupPrefix() for each position.
+      std::vector<Match> expected;
+      std::vector<size_t> begin_positions;
+      for (size_t begin = 0; begin < key.size();
+           begin += strings::OneCharLen(key.data() + begin)) {
+        begin_positions.push_back(begin);
+        CollectPrefixMatchCallback callback(begin);
+        callback.SetKanaModifierInsensitiveConversion(
+            kana_modifier_insensitive);
+        system_dic->LookupPrefix(key.substr(begin), &callback);
+        expected.insert(expected.end(), callback.matches().begin(),
+                        callback.matches().end());
+      }
+
+      std::vector<DictionaryInterface::PrefixMatch> matches;
+      system_dic->LookupPrefixBatch(key, begin_positions, options,
+                                    /*filter=*/nullptr, &matches);
+      std::vector<Match> actual;
+      for (const DictionaryInterface::PrefixMatch& match : matches) {
+        actual.emplace_back(match.begin, match.end, match.num_expanded,
+                            match.token.key, match.token.value);
+      }
+      EXPECT_EQ(actual, expected)
+          << key << ", kana_modifier_insensitive = "
+          << kana_modifier_insensitive;
+    }
+  }
+}
+
+// Rejects tokens whose costs are at most the given cost before their values
+// are decoded.
+class RejectCostCallback : public TokenCallbackBase {
+ public:
+  explicit RejectCostCallback(int max_rejected_cost)
+      : max_rejected_cost_(max_rejected_cost) {}
+
+  bool ShouldDecodeToken(absl::string_view key, absl::string_view actual_key,
+                         const TokenView& token) override {
+    return token.cost > max_rejected_cost_;
+  }
+
+  ResultType OnToken(absl::string_view key, absl::string_view actual_key,
+                     const Token& token) override {
+    EXPECT_GT(token.cost, max_rejected_cost_);
+    values_.push_back(token.value);
+    return TRAVERSE_CONTINUE;
+  }
+
+  const std::vector<std::string>& values() const { return values_; }
+
+ private:
+  const int max_rejected_cost_;
+  std::vector<std::string> values_;
+};
+
+TEST_F(SystemDictionaryTest, ShouldDecodeToken) {
+  // The second "柿" is encoded as SAME_AS_PREV_VALUE, so its value has to be
+  // restored even though the first one is rejected.
+  std::vector<Token> tokens = {
+      {"かき", "柿", 100, 1, 1, Token::NONE},
+      {"かき", "柿", 200, 1, 1, Token::NONE},
+      {"かき", "カキ", 300, 1, 1, Token::NONE},
+      {"かき", "かき", 400, 1, 1, Token::NONE},
+      {"かき", "牡蠣", 500, 1, 1, Token::NONE},
+  };
+  std::unique_ptr<SystemDictionary> system_dic =
+      BuildSystemDictionary(MakeTokenPointers(&tokens));
+  ASSERT_TRUE(system_dic);
+
+  {
+    RejectCostCallback callback(100);
+    system_dic->LookupExact("かき", &callback);
+    EXPECT_THAT(callback.values(),
+                UnorderedElementsAre("柿", "カキ", "かき", "牡蠣"));
+  }
+  {
+    RejectCostCallback callback(100);
+    system_dic->LookupPrefix("かきく", &callback);
+    EXPECT_THAT(callback.values(),
+                UnorderedElementsAre("柿", "カキ", "かき", "牡蠣"));
+  }
+  {
+    RejectCostCallback callback(300);
+    system_dic->LookupPredictive("か", &callback);
+    EXPECT_THAT(callback.values(), UnorderedElementsAre("かき", "牡蠣"));
+  }
+}
+
+// Rejects tokens whose costs are at most the given cost before their values
+// are decoded, and the tokens of the given value after decoding.
+class RejectCostAndValueFilter
+    : public DictionaryInterface::TokenFilterInterface {
+ public:
+  RejectCostAndValueFilter(int max_rejected_cost,
+                           absl::string_view rejected_value)
+      : max_rejected_cost_(max_rejected_cost),
+        rejected_value_(rejected_value) {}
+
+  bool IsFiltered(const TokenView& token) const override {
+    return token.cost <= max_rejected_cost_;
+  }
+
+  bool IsFiltered(const Token& token) const override {
+    EXPECT_GT(token.cost, max_rejected_cost_);
+    return token.value == rejected_value_;
+  }
+
+ private:
+  const int max_rejected_cost_;
+  const absl::string_view rejected_value_;
+};
+
+TEST_F(SystemDictionaryTest, LookupPrefixBatchWithFilter) {
+  std::vector<Token> tokens = {
+      {"か", "蚊", 100, 1, 1, Token::NONE},
+      {"か", "可", 200, 1, 1, Token::NONE},
+      {"かき", "柿", 100, 1, 1, Token::NONE},
+      {"かき", "カキ", 300, 1, 1, Token::NONE},
+      {"かき", "牡蠣", 500, 1, 1, Token::NONE},
+      {"き", "木", 300, 1, 1, Token::NONE},
+  };
+  std::unique_ptr<SystemDictionary> system_dic =
+      BuildSystemDictionary(MakeTokenPointers(&tokens));
+  ASSERT_TRUE(system_dic);
+
+  const RejectCostAndValueFilter filter(100, "カキ");
+  const std::vector<size_t> begin_positions = {0, 3};
+  std::vector<DictionaryInterface::PrefixMatch> matches;
+  system_dic->LookupPrefixBatch("かき", begin_positions, ConversionOptions(),
+                                &filter, &matches);
+  std::vector<std::string> values;
+  for (const DictionaryInterface::PrefixMatch& match : matches) {
+    values.push_back(match.token.value);
+  }
+  EXPECT_THAT(values, UnorderedElementsAre("可", "牡蠣", "木"));
+}
+
 TEST_F(SystemDictionaryTest, LookupPredictive) {
   Token tokens[] = {
       {"まみむめもや", "value0", 0, 0, 0, Token::NONE},
@@ -939,6 +1125,27 @@ TEST_F(SystemDictionaryTest, ShouldNotUseSmallCostEncodingForHeteronyms) {
   }
 }
 
+TEST_F(SystemDictionaryTest, ParallelBuildIsDeterministic) {
+  absl::SetFlag(&FLAGS_min_key_length_to_use_small_cost_encoding,
+                original_flags_min_key_length_to_use_small_cost_encoding_);
+
+  std::vector<Token*> source_tokens;
+  text_dict_.CollectTokens(&source_tokens);
+
+  auto build_image = [&source_tokens](int num_threads) {
+    SystemDictionaryBuilder builder;
+    builder.set_num_threads(num_threads);
+    builder.BuildFromTokens(source_tokens);
+    std::ostringstream output;
+    builder.WriteToStream("", &output);
+    return std::move(output).str();
+  };
+  const std::string expected = build_image(1);
+  ASSERT_FALSE(expected.empty());
+  EXPECT_EQ(build_image(4), expected);
+  EXPECT_EQ(build_image(7), expected);
+}
+
 }  // namespace
 }  // namespace dictionary
 }  // namespace mozc
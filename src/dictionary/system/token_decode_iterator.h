@@ -57,7 +57,26 @@ class TokenDecodeIterator {
                       absl::string_view key, const uint8_t* ptr);
   ~TokenDecodeIterator() = default;
 
-  const TokenInfo& Get() const { return token_info_; }
+  // Returns the current token. The value is restored from the value trie on
+  // the first call for each token.
+  const TokenInfo& Get() {
+    if (value_pending_) {
+      RestoreValue();
+    }
+    return token_info_;
+  }
+
+  // Returns the fields of the current token that are decoded without the
+  // value. Use this to reject tokens before paying for Get().
+  TokenView GetView() const {
+    return TokenView{key_, token_.cost, token_.lid, token_.rid,
+                     token_.attributes};
+  }
+
+  // Returns the id of the current value in the value trie, or -1 if the value
+  // is not stored in the value trie. Doesn't restore the value.
+  int GetValueId() const { return token_info_.id_in_value_trie; }
+
   bool Done() const { return state_ == DONE; }
   void Next();
 
@@ -69,6 +88,7 @@ class TokenDecodeIterator {
   };
 
   void NextInternal();
+  void RestoreValue();
 
   std::string LookupValue(int id) const {
     char buffer[storage::louds::LoudsTrie::kMaxDepth + 1];
@@ -90,6 +110,15 @@ class TokenDecodeIterator {
 
   TokenInfo token_info_;
   Token token_;
+
+  // The value of |token_| is restored lazily in Get() because callbacks
+  // reject most of the tokens by cost or POS. While |value_pending_| is true,
+  // token_.value is stale and the fields below describe the actual value.
+  bool value_pending_ = false;
+  TokenInfo::ValueType pending_value_type_ = TokenInfo::DEFAULT_VALUE;
+  int pending_id_in_value_trie_ = -1;
+  // Accent suffixes to be appended to the pending value.
+  std::string pending_value_suffix_;
 };
 
 // Implementation is inlined for performance.
@@ -149,27 +178,22 @@ inline void TokenDecodeIterator::NextInternal() {
   }
   ptr_ += read_bytes;
 
-  // Fill remaining values.
+  // Record where the value comes from. The value itself is restored in
+  // RestoreValue() only when the token is requested by Get().
   switch (token_info_.value_type) {
-    case TokenInfo::DEFAULT_VALUE: {
-      token_.value = LookupValue(token_info_.id_in_value_trie);
-      break;
-    }
     case TokenInfo::SAME_AS_PREV_VALUE: {
       DCHECK_NE(prev_id_in_value_trie, -1);
       token_info_.id_in_value_trie = prev_id_in_value_trie;
-      // We can keep the current value here.
-      break;
-    }
-    case TokenInfo::AS_IS_HIRAGANA: {
-      token_.value = token_.key;
+      // We can keep the current value (or the pending one) here.
       break;
     }
+    case TokenInfo::DEFAULT_VALUE:
+    case TokenInfo::AS_IS_HIRAGANA:
     case TokenInfo::AS_IS_KATAKANA: {
-      if (!key_.empty() && key_katakana_.empty()) {
-        key_katakana_ = japanese_util::HiraganaToKatakana(key_);
-      }
-      token_.value = key_katakana_;
+      value_pending_ = true;
+      pending_value_type_ = token_info_.value_type;
+      pending_id_in_value_trie_ = token_info_.id_in_value_trie;
+      pending_value_suffix_.clear();
       break;
     }
     default: {
@@ -179,7 +203,8 @@ inline void TokenDecodeIterator::NextInternal() {
   }
 
   if (token_info_.accent_encoding_type == TokenInfo::EMBEDDED_IN_TOKEN) {
-    absl::StrAppend(&token_.value, "_", token_info_.accent_type);
+    absl::StrAppend(value_pending_ ? &pending_value_suffix_ : &token_.value,
+                    "_", token_info_.accent_type);
   }
 
   if (token_info_.pos_type == TokenInfo::FREQUENT_POS) {
@@ -189,6 +214,33 @@ inline void TokenDecodeIterator::NextInternal() {
   }
 }
 
+inline void TokenDecodeIterator::RestoreValue() {
+  DCHECK(value_pending_);
+  switch (pending_value_type_) {
+    case TokenInfo::DEFAULT_VALUE: {
+      token_.value = LookupValue(pending_id_in_value_trie_);
+      break;
+    }
+    case TokenInfo::AS_IS_HIRAGANA: {
+      token_.value = token_.key;
+      break;
+    }
+    case TokenInfo::AS_IS_KATAKANA: {
+      if (!key_.empty() && key_katakana_.empty()) {
+        key_katakana_ = japanese_util::HiraganaToKatakana(key_);
+      }
+      token_.value = key_katakana_;
+      break;
+    }
+    default: {
+      LOG(DFATAL) << "unexpected value_type: " << pending_value_type_;
+      break;
+    }
+  }
+  token_.value.append(pending_value_suffix_);
+  value_pending_ = false;
+}
+
 }  // namespace dictionary
 }  // namespace mozc
 
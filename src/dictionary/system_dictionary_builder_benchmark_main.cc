@@ -0,0 +1,158 @@
+// Copyright 2010-2021, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+// Measures the build time of the system dictionary with different numbers of
+// threads, and verifies that the output images are byte-identical.
+//
+// system_dictionary_builder_benchmark_main
+//  --input=dictionary00.txt,dictionary01.txt,...
+//  --reading_correction=reading_correction.tsv
+//  --user_pos_manager_data=user_pos_manager.data
+//  --num_threads=1,2,4,8
+
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/log/check.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/str_split.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+#include "base/init_mozc.h"
+#include "base/stopwatch.h"
+#include "data_manager/data_manager.h"
+#include "dictionary/pos_matcher.h"
+#include "dictionary/system/system_dictionary_builder.h"
+#include "dictionary/text_dictionary_loader.h"
+
+ABSL_FLAG(std::string, input, "", "comma separated dictionary files");
+ABSL_FLAG(std::string, reading_correction, "",
+          "comma separated reading correction files");
+ABSL_FLAG(std::string, user_pos_manager_data, "", "user pos manager data");
+ABSL_FLAG(std::string, num_threads, "1,2,4,8",
+          "comma separated numbers of threads to measure");
+ABSL_FLAG(int32_t, iterations, 3, "number of builds for each setting");
+
+namespace mozc {
+namespace {
+
+struct BuildResult {
+  absl::Duration load_time;
+  absl::Duration build_time;
+  absl::Duration write_time;
+  std::string image;
+};
+
+BuildResult Build(const dictionary::PosMatcher& pos_matcher,
+                  int num_threads) {
+  BuildResult result;
+  dictionary::TextDictionaryLoader loader(pos_matcher);
+  loader.set_num_threads(num_threads);
+  Stopwatch stopwatch = Stopwatch::StartNew();
+  loader.Load(absl::GetFlag(FLAGS_input),
+              absl::GetFlag(FLAGS_reading_correction));
+  result.load_time = stopwatch.GetElapsed();
+
+  dictionary::SystemDictionaryBuilder builder;
+  builder.set_num_threads(num_threads);
+  stopwatch = Stopwatch::StartNew();
+  builder.BuildFromTokens(loader.tokens());
+  result.build_time = stopwatch.GetElapsed();
+
+  std::ostringstream output;
+  stopwatch = Stopwatch::StartNew();
+  builder.WriteToStream("", &output);
+  result.write_time = stopwatch.GetElapsed();
+  result.image = std::move(output).str();
+  return result;
+}
+
+}  // namespace
+}  // namespace mozc
+
+int main(int argc, char** argv) {
+  mozc::InitMozc(argv[0], &argc, &argv);
+
+  constexpr absl::string_view kMagicNumber = "";
+  absl::StatusOr<std::unique_ptr<const mozc::DataManager>> data_manager =
+      mozc::DataManager::CreateUserPosManagerDataFromFile(
+          absl::GetFlag(FLAGS_user_pos_manager_data), kMagicNumber);
+  CHECK_OK(data_manager) << "Failed to initialize data manager from "
+                         << absl::GetFlag(FLAGS_user_pos_manager_data);
+  const mozc::dictionary::PosMatcher pos_matcher(
+      data_manager.value()->GetPosMatcherData());
+
+  std::vector<int> num_threads_list;
+  for (absl::string_view field :
+       absl::StrSplit(absl::GetFlag(FLAGS_num_threads), ',',
+                      absl::SkipWhitespace())) {
+    int num_threads = 0;
+    CHECK(absl::SimpleAtoi(field, &num_threads) && num_threads > 0)
+        << "Invalid number of threads: " << field;
+    num_threads_list.push_back(num_threads);
+  }
+
+  std::string reference_image;
+  std::cout << absl::StreamFormat("%8s %12s %12s %12s %12s\n", "threads",
+                                  "load[ms]", "build[ms]", "write[ms]",
+                                  "total[ms]");
+  for (const int num_threads : num_threads_list) {
+    absl::Duration load_time, build_time, write_time;
+    const int iterations = absl::GetFlag(FLAGS_iterations);
+    for (int i = 0; i < iterations; ++i) {
+      mozc::BuildResult result = mozc::Build(pos_matcher, num_threads);
+      if (reference_image.empty()) {
+        reference_image = std::move(result.image);
+      } else {
+        CHECK(result.image == reference_image)
+            << "The image built with " << num_threads
+            << " threads differs from the reference image.";
+      }
+      load_time += result.load_time;
+      build_time += result.build_time;
+      write_time += result.write_time;
+    }
+    auto average_ms = [iterations](absl::Duration d) {
+      return absl::ToDoubleMilliseconds(d) / iterations;
+    };
+    std::cout << absl::StreamFormat(
+        "%8d %12.1f %12.1f %12.1f %12.1f\n", num_threads,
+        average_ms(load_time), average_ms(build_time), average_ms(write_time),
+        average_ms(load_time + build_time + write_time));
+  }
+  return 0;
+}
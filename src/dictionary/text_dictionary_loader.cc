@@ -34,6 +34,7 @@
 #include "dictionary/text_dictionary_loader.h"
 
 #include <algorithm>
+#include <cstddef>
 #include <cstdint>
 #include <iterator>
 #include <limits>
@@ -52,6 +53,7 @@
 #include "absl/types/span.h"
 #include "base/japanese_util.h"
 #include "base/multifile.h"
+#include "base/thread.h"
 #include "base/util.h"
 #include "base/vlog.h"
 #include "dictionary/dictionary_token.h"
@@ -165,18 +167,25 @@ void TextDictionaryLoader::LoadWithLineLimit(
     tokens_.reserve(limit);
   }
 
-  // Read system dictionary.
+  // Read system dictionary. Lines are read sequentially and then parsed in
+  // parallel. Each line is parsed into its own slot so that the order of
+  // tokens doesn't depend on the number of threads.
   {
     InputMultiFile file(dictionary_filename);
+    std::vector<std::string> lines;
     std::string line;
     while (limit > 0 && file.ReadLine(&line)) {
       Util::ChopReturns(&line);
-      std::unique_ptr<Token> token = ParseTSVLine(line);
-      if (token) {
-        tokens_.push_back(std::move(token));
-        --limit;
-      }
+      lines.push_back(std::move(line));
+      --limit;
     }
+    tokens_.resize(lines.size());
+    ParallelForRanges(lines.size(), num_threads_,
+                      [this, &lines](size_t begin, size_t end) {
+                        for (size_t i = begin; i < end; ++i) {
+                          tokens_[i] = ParseTSVLine(lines[i]);
+                        }
+                      });
     LOG(INFO) << tokens_.size() << " tokens from " << dictionary_filename;
   }
 
@@ -33,6 +33,7 @@
 #include <string>
 #include <vector>
 
+#include "absl/strings/str_cat.h"
 #include "absl/types/span.h"
 #include "base/file/temp_dir.h"
 #include "base/file_util.h"
@@ -232,6 +233,30 @@ TEST_F(TextDictionaryLoaderTest, LoadMultipleFilesTest) {
   }
 }
 
+TEST_F(TextDictionaryLoaderTest, ParallelLoadKeepsOrder) {
+  const std::string filename = FileUtil::JoinPath(temp_dir_.path(), "test.tsv");
+  std::string lines;
+  for (int i = 0; i < 100; ++i) {
+    absl::StrAppend(&lines, "key", i, "\t", i, "\t", i + 1, "\t", i + 2,
+                    "\tvalue", i, "\n");
+  }
+  ASSERT_OK(FileUtil::SetContents(filename, lines));
+  FileUnlinker unlinker(filename);
+
+  std::unique_ptr<TextDictionaryLoader> loader = CreateTextDictionaryLoader();
+  loader->set_num_threads(8);
+  loader->LoadWithLineLimit(filename, "", 90);
+  absl::Span<const std::unique_ptr<Token>> tokens = loader->tokens();
+  ASSERT_EQ(tokens.size(), 90);
+  for (int i = 0; i < tokens.size(); ++i) {
+    EXPECT_EQ(tokens[i]->key, absl::StrCat("key", i));
+    EXPECT_EQ(tokens[i]->value, absl::StrCat("value", i));
+    EXPECT_EQ(tokens[i]->lid, i);
+    EXPECT_EQ(tokens[i]->rid, i + 1);
+    EXPECT_EQ(tokens[i]->cost, i + 2);
+  }
+}
+
 TEST_F(TextDictionaryLoaderTest, ReadingCorrectionTest) {
   std::unique_ptr<TextDictionaryLoader> loader = CreateTextDictionaryLoader();
 
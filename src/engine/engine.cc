@@ -179,13 +179,30 @@ bool Engine::SendSupplementalModelReloadRequest(
     const EngineReloadRequest& request) {
   if (converter_) {
     converter_->modules().GetSupplementalModel().LoadAsync(request);
+    converter_->modules().GetTypingCorrectionCache().Clear();
   }
   return true;
 }
 
+EngineReloadResponse Engine::LoadSupplementalModel(
+    const EngineReloadRequest& request) {
+  if (!converter_) {
+    EngineReloadResponse response;
+    response.set_status(EngineReloadResponse::DATA_MISSING);
+    return response;
+  }
+  EngineReloadResponse response =
+      converter_->modules().GetSupplementalModel().Load(request);
+  converter_->modules().GetTypingCorrectionCache().Clear();
+  return response;
+}
+
 void Engine::ClearOldSupplementalModels() {
-  if (converter_) {
-    converter_->modules().GetSupplementalModel().ClearOldModels();
+  // This is called for every command, so the cache is kept unless a new model
+  // has been swapped in. The corrections made by the old model are stale.
+  if (converter_ &&
+      converter_->modules().GetSupplementalModel().ClearOldModels()) {
+    converter_->modules().GetTypingCorrectionCache().Clear();
   }
 }
 
@@ -30,6 +30,7 @@
 #ifndef MOZC_ENGINE_ENGINE_H_
 #define MOZC_ENGINE_ENGINE_H_
 
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <vector>
@@ -38,6 +39,7 @@
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/string_view.h"
+#include "converter/connector.h"
 #include "converter/converter.h"
 #include "converter/converter_interface.h"
 #include "data_manager/data_manager.h"
@@ -115,6 +117,38 @@ class Engine : public EngineInterface {
     return {};
   }
 
+  // Enables or disables the statistics of the transition cost cache. They are
+  // disabled by default and are not carried over to reloaded modules.
+  void EnableConnectorCacheStats(bool enable) const {
+    if (converter_) {
+      converter_->modules().GetConnector().EnableCacheStats(enable);
+    }
+  }
+
+  // Returns the statistics of the transition cost cache.
+  Connector::CacheStats GetConnectorCacheStats() const {
+    return converter_ ? converter_->modules().GetConnector().GetCacheStats()
+                      : Connector::CacheStats();
+  }
+
+  // Starts and stops the trace of the transition cost lookups. See
+  // Connector::StartTrace() for the format.
+  void StartConnectorTrace() const {
+    if (converter_) {
+      converter_->modules().GetConnector().StartTrace();
+    }
+  }
+  std::vector<uint32_t> StopConnectorTrace() const {
+    return converter_ ? converter_->modules().GetConnector().StopTrace()
+                      : std::vector<uint32_t>();
+  }
+
+  // Loads the supplemental model synchronously and returns the result, while
+  // SendSupplementalModelReloadRequest() loads it in the background. Used by
+  // the command line tools.
+  EngineReloadResponse LoadSupplementalModel(
+      const EngineReloadRequest& request);
+
   // For testing only.
   engine::Modules& GetModulesForTesting() const {
     DCHECK(converter_);
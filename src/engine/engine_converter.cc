@@ -32,8 +32,10 @@
 #include "engine/engine_converter.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cstddef>
 #include <cstdint>
+#include <limits>
 #include <memory>
 #include <optional>
 #include <string>
@@ -42,8 +44,12 @@
 
 #include "absl/log/check.h"
 #include "absl/log/log.h"
+#include "absl/random/random.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+#include "base/clock.h"
+#include "base/metrics.h"
 #include "base/text_normalizer.h"
 #include "base/util.h"
 #include "base/vlog.h"
@@ -59,6 +65,7 @@
 #include "protocol/candidate_window.pb.h"
 #include "protocol/commands.pb.h"
 #include "protocol/config.pb.h"
+#include "protocol/session_snapshot.pb.h"
 #include "request/conversion_request.h"
 #include "transliteration/transliteration.h"
 
@@ -93,11 +100,42 @@ absl::string_view GetCandidateShortcuts(
   return shortcut;
 }
 
+// Returns a new all_candidate_words version. Versions are unique in the
+// process and start at a random value, so that a version the client got from
+// another session or an earlier server process does not match.
+uint64_t NextCandidateListVersion() {
+  static std::atomic<uint64_t> next_version = [] {
+    absl::BitGen gen;
+    return absl::Uniform<uint64_t>(gen);
+  }();
+  uint64_t version = 0;
+  while (version == 0) {
+    version = next_version.fetch_add(1, std::memory_order_relaxed);
+  }
+  return version;
+}
+
 // Calculate cursor offset for committed text.
 int32_t CalculateCursorOffset(absl::string_view committed_text) {
   // If committed_text is a bracket pair, set the cursor in the middle.
   return Util::IsBracketPairText(committed_text) ? -1 : 0;
 }
+
+// Records the overrun of the deadline of |request| in
+// MetricsRegistry::DEADLINE_EXCEEDED. Called once per request after the
+// converter returns, as the converter and the predictor only check the
+// deadline.
+void MaybeRecordDeadlineOverrun(const ConversionRequest& request) {
+  const absl::Time deadline = request.options().deadline;
+  if (deadline == absl::InfiniteFuture()) {
+    return;
+  }
+  const absl::Time now = Clock::GetAbslTime();
+  if (request.options().IsDeadlineExceeded(now)) {
+    MetricsRegistry::GetStage(MetricsRegistry::DEADLINE_EXCEEDED)
+        .Record(now - deadline);
+  }
+}
 }  // namespace
 
 EngineConverter::EngineConverter(
@@ -165,7 +203,10 @@ bool EngineConverter::ConvertWithPreferences(
           .SetOptions(std::move(options))
           .Build();
 
-  if (!converter_->StartConversion(conversion_request, &segments_)) {
+  const bool result =
+      converter_->StartConversion(conversion_request, &segments_);
+  MaybeRecordDeadlineOverrun(conversion_request);
+  if (!result) {
     LOG(WARNING) << "StartConversion() failed";
     ResetState();
     return false;
@@ -555,6 +596,7 @@ bool EngineConverter::SuggestWithPreferences(
 
   // Start actual suggestion/prediction.
   bool result = converter_->StartPrediction(conversion_request, &segments_);
+  MaybeRecordDeadlineOverrun(conversion_request);
   if (!result) {
     MOZC_VLOG(1)
         << "Start(Partial?)(Suggestion|Prediction)ForRequest() returns no "
@@ -654,6 +696,7 @@ bool EngineConverter::PredictWithPreferences(
   if (predict_expand || predict_first) {
     const bool result = converter_->StartPredictionWithPreviousSuggestion(
         conversion_request, previous_suggestions_, &segments_);
+    MaybeRecordDeadlineOverrun(conversion_request);
     if (!result && predict_first) {
       // Returns false if we failed at the first prediction.
       // If predict_expand is true, it means we have prevous_suggestions_.
@@ -698,6 +741,30 @@ void EngineConverter::MaybeExpandPrediction(
   UpdateSelectedCandidateIndex();
 }
 
+void EngineConverter::MaybeExpandFocusedSegment() {
+  if (!CheckState(CONVERSION) ||
+      segment_index_ >= segments_.conversion_segments_size() ||
+      !segments_.conversion_segment(segment_index_).has_more_candidates()) {
+    return;
+  }
+
+  ConversionRequest::Options options;
+  options.enable_user_history_for_conversion =
+      conversion_preferences_.use_history;
+  SetRequestType(ConversionRequest::CONVERSION, options);
+  const ConversionRequest conversion_request =
+      ConversionRequestBuilder()
+          .SetRequestView(*request_)
+          .SetConfigView(*config_)
+          .SetOptions(std::move(options))
+          .Build();
+  if (!converter_->ExpandSegmentCandidates(&segments_, conversion_request,
+                                           segment_index_)) {
+    MOZC_VLOG(1) << "No more candidates for segment " << segment_index_;
+  }
+  MaybeRecordDeadlineOverrun(conversion_request);
+}
+
 void EngineConverter::Cancel() {
   DCHECK(CheckState(SUGGESTION | PREDICTION | CONVERSION));
   ResetResult();
@@ -1182,11 +1249,28 @@ void EngineConverter::SetCandidateListVisible(bool visible) {
 
 void EngineConverter::PopOutput(const composer::Composer& composer,
                                 commands::Output* output) {
+  ScopedLatency latency(
+      MetricsRegistry::GetStage(MetricsRegistry::OUTPUT_FILLING));
   FillOutput(composer, output);
+  if (client_candidate_list_version_.has_value() &&
+      output->has_all_candidate_words() &&
+      segment_index_ < segments_.conversion_segments_size()) {
+    // The full list becomes the base of the next delta.
+    candidate_list_fingerprint_ = output::AllCandidateWordsFingerprint(
+        segments_.conversion_segment(segment_index_), candidate_list_,
+        GetAllCandidateWordsCategory());
+    candidate_list_version_ = NextCandidateListVersion();
+    output->set_candidate_list_version(candidate_list_version_);
+  }
+  client_candidate_list_version_.reset();
   updated_command_ = converter::Candidate::DEFAULT_COMMAND;
   ResetResult();
 }
 
+void EngineConverter::EnableCandidateListDelta(uint64_t client_version) {
+  client_candidate_list_version_ = client_version;
+}
+
 namespace {
 void MaybeFillConfig(converter::Candidate::Command command,
                      const config::Config& base_config,
@@ -1261,7 +1345,9 @@ void EngineConverter::FillOutput(const composer::Composer& composer,
 
   // All candidate words
   if (CheckState(SUGGESTION | PREDICTION | CONVERSION)) {
-    FillAllCandidateWords(output->mutable_all_candidate_words());
+    if (!FillAllCandidateWordsDelta(output)) {
+      FillAllCandidateWords(output->mutable_all_candidate_words());
+    }
     if (request_->fill_incognito_candidate_words()) {
       FillIncognitoCandidateWords(output->mutable_incognito_candidate_words());
     }
@@ -1275,6 +1361,147 @@ void EngineConverter::FillOutput(const composer::Composer& composer,
   }
 }
 
+void EngineConverter::SaveSnapshot(
+    commands::ConverterSnapshot* snapshot) const {
+  DCHECK(snapshot);
+  snapshot->Clear();
+  snapshot->set_state(state_);
+  if (!CheckState(SUGGESTION | PREDICTION | CONVERSION)) {
+    return;
+  }
+  for (size_t i = 0; i < segments_.conversion_segments_size(); ++i) {
+    commands::ConverterSnapshot::Segment* segment = snapshot->add_segments();
+    segment->set_key_length(segments_.conversion_segment(i).key_len());
+    segment->set_value(GetSelectedCandidateValue(i));
+  }
+  snapshot->set_focused_segment(segment_index_);
+  snapshot->set_candidate_list_visible(candidate_list_visible_);
+}
+
+bool EngineConverter::RestoreSnapshot(
+    const commands::ConverterSnapshot& snapshot,
+    const composer::Composer& composer) {
+  if (IsActive()) {
+    Cancel();
+  }
+  ResetResult();
+
+  switch (snapshot.state()) {
+    case CONVERSION: {
+      const size_t segments_size = snapshot.segments_size();
+      if (segments_size == 0 || snapshot.focused_segment() >= segments_size) {
+        return false;
+      }
+      if (!Convert(composer)) {
+        return false;
+      }
+      if (!RestoreSegmentBoundaries(snapshot, composer)) {
+        Cancel();
+        return false;
+      }
+      // Only the segments whose selection differs from the top candidate are
+      // visited, so that untouched segments are not fixed by SegmentFix().
+      for (size_t i = 0; i < segments_.conversion_segments_size(); ++i) {
+        const absl::string_view value = snapshot.segments(i).value();
+        if (i != snapshot.focused_segment() &&
+            GetSelectedCandidateValue(i) == value) {
+          continue;
+        }
+        SegmentFocusInternal(i);
+        if (!CandidateMoveToValue(value)) {
+          LOG(WARNING) << "Candidate is not found in segment " << i;
+        }
+      }
+      SegmentFocusInternal(snapshot.focused_segment());
+      SegmentFocus();
+      candidate_list_visible_ = snapshot.candidate_list_visible();
+      return true;
+    }
+    case PREDICTION: {
+      if (snapshot.segments_size() != 1 || !Predict(composer)) {
+        return false;
+      }
+      if (!CandidateMoveToValue(snapshot.segments(0).value())) {
+        Cancel();
+        return false;
+      }
+      SegmentFocus();
+      candidate_list_visible_ = snapshot.candidate_list_visible();
+      return true;
+    }
+    case COMPOSITION:
+    case SUGGESTION:
+      // Suggestions are regenerated by the next key event.
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool EngineConverter::RestoreSegmentBoundaries(
+    const commands::ConverterSnapshot& snapshot,
+    const composer::Composer& composer) {
+  const size_t segments_size = snapshot.segments_size();
+  bool same_boundaries =
+      segments_.conversion_segments_size() == segments_size;
+  std::vector<uint8_t> new_sizes;
+  new_sizes.reserve(segments_size);
+  for (size_t i = 0; i < segments_size; ++i) {
+    const uint32_t key_length = snapshot.segments(i).key_length();
+    if (key_length == 0 ||
+        key_length > std::numeric_limits<uint8_t>::max()) {
+      return false;
+    }
+    new_sizes.push_back(key_length);
+    if (same_boundaries &&
+        segments_.conversion_segment(i).key_len() != key_length) {
+      same_boundaries = false;
+    }
+  }
+  if (same_boundaries) {
+    return true;
+  }
+
+  DCHECK(request_);
+  DCHECK(config_);
+  const ConversionRequest conversion_request = ConversionRequestBuilder()
+                                                   .SetComposer(composer)
+                                                   .SetRequestView(*request_)
+                                                   .SetConfigView(*config_)
+                                                   .Build();
+  if (!converter_->ResizeSegments(&segments_, conversion_request, 0,
+                                  new_sizes) ||
+      segments_.conversion_segments_size() != segments_size) {
+    LOG(WARNING) << "ResizeSegments failed for the snapshot.";
+    return false;
+  }
+  UpdateCandidateList();
+  InitializeSelectedCandidateIndices();
+  return true;
+}
+
+bool EngineConverter::CandidateMoveToValue(absl::string_view value) {
+  const Segment& segment = segments_.conversion_segment(segment_index_);
+  std::optional<int> id;
+  for (size_t i = 0; i < segment.candidates_size(); ++i) {
+    if (segment.candidate(i).value == value) {
+      id = static_cast<int>(i);
+      break;
+    }
+  }
+  for (size_t i = 0; !id.has_value() && i < segment.meta_candidates_size();
+       ++i) {
+    if (segment.meta_candidate(i).value == value) {
+      id = -1 - static_cast<int>(i);
+    }
+  }
+  if (!id.has_value() || !candidate_list_.MoveToId(*id)) {
+    return false;
+  }
+  UpdateSelectedCandidateIndex();
+  return true;
+}
+
 EngineConverter* EngineConverter::Clone() const {
   EngineConverter* engine_converter =
       new EngineConverter(converter_, request_, config_);
@@ -1558,6 +1785,7 @@ void EngineConverter::AppendCandidateList() {
 
 void EngineConverter::UpdateCandidateList() {
   DCHECK(CheckState(SUGGESTION | PREDICTION | CONVERSION));
+  MaybeExpandFocusedSegment();
   candidate_list_.Clear();
   AppendCandidateList();
 }
@@ -1691,37 +1919,59 @@ void EngineConverter::FillCandidateWindow(
 void EngineConverter::FillAllCandidateWords(
     commands::CandidateList* candidates) const {
   DCHECK(CheckState(SUGGESTION | PREDICTION | CONVERSION));
-  commands::Category category;
+  const commands::Category category = GetAllCandidateWordsCategory();
+  if (segment_index_ >= segments_.conversion_segments_size()) {
+    LOG(WARNING) << "Invalid segment_index_: " << segment_index_
+                 << ", segments_size: " << segments_.conversion_segments_size();
+    return;
+  }
+  const Segment& segment = segments_.conversion_segment(segment_index_);
+  output::FillAllCandidateWords(segment, candidate_list_, category, candidates);
+}
+
+bool EngineConverter::FillAllCandidateWordsDelta(
+    commands::Output* output) const {
+  if (!client_candidate_list_version_.has_value() ||
+      candidate_list_version_ == 0 ||
+      *client_candidate_list_version_ != candidate_list_version_ ||
+      segment_index_ >= segments_.conversion_segments_size()) {
+    return false;
+  }
+  const Segment& segment = segments_.conversion_segment(segment_index_);
+  if (output::AllCandidateWordsFingerprint(segment, candidate_list_,
+                                           GetAllCandidateWordsCategory()) !=
+      candidate_list_fingerprint_) {
+    return false;
+  }
+  commands::CandidateListDelta* delta =
+      output->mutable_all_candidate_words_delta();
+  delta->set_base_version(candidate_list_version_);
+  if (const std::optional<uint32_t> focused_index =
+          output::AllCandidateWordsFocusedIndex(segment, candidate_list_);
+      focused_index.has_value()) {
+    delta->set_focused_index(*focused_index);
+  }
+  output->set_candidate_list_version(candidate_list_version_);
+  return true;
+}
+
+commands::Category EngineConverter::GetAllCandidateWordsCategory() const {
   switch (request_type_) {
     case ConversionRequest::CONVERSION:
-      category = commands::CONVERSION;
-      break;
+      return commands::CONVERSION;
     case ConversionRequest::PREDICTION:
-      category = commands::PREDICTION;
-      break;
+      return commands::PREDICTION;
     case ConversionRequest::SUGGESTION:
-      category = commands::SUGGESTION;
-      break;
+      return commands::SUGGESTION;
     case ConversionRequest::PARTIAL_PREDICTION:
       // Not PREDICTION because we do not want to get focused candidate.
-      category = commands::SUGGESTION;
-      break;
+      return commands::SUGGESTION;
     case ConversionRequest::PARTIAL_SUGGESTION:
-      category = commands::SUGGESTION;
-      break;
+      return commands::SUGGESTION;
     default:
       LOG(WARNING) << "Unknown request type: " << request_type_;
-      category = commands::CONVERSION;
-      break;
+      return commands::CONVERSION;
   }
-
-  if (segment_index_ >= segments_.conversion_segments_size()) {
-    LOG(WARNING) << "Invalid segment_index_: " << segment_index_
-                 << ", segments_size: " << segments_.conversion_segments_size();
-    return;
-  }
-  const Segment& segment = segments_.conversion_segment(segment_index_);
-  output::FillAllCandidateWords(segment, candidate_list_, category, candidates);
 }
 
 void EngineConverter::FillIncognitoCandidateWords(
@@ -1886,6 +2136,12 @@ void EngineConverter::SetRequestType(
     ConversionRequest::Options& options) {
   request_type_ = request_type;
   options.request_type = request_type;
+  if (request_->conversion_time_budget_msec() > 0) {
+    options.deadline =
+        Clock::GetAbslTime() +
+        absl::Milliseconds(request_->conversion_time_budget_msec());
+  }
+  options.lazy_candidate_expansion = request_->lazy_conversion_candidates();
 }
 
 }  // namespace engine
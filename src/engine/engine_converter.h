@@ -48,6 +48,7 @@
 #include "engine/engine_converter_interface.h"
 #include "protocol/commands.pb.h"
 #include "protocol/config.pb.h"
+#include "protocol/session_snapshot.pb.h"
 #include "request/conversion_request.h"
 #include "transliteration/transliteration.h"
 
@@ -232,6 +233,8 @@ class EngineConverter : public EngineConverterInterface {
   void PopOutput(const composer::Composer& composer,
                  commands::Output* output) override;
 
+  void EnableCandidateListDelta(uint64_t client_version) override;
+
   // Fills preedit
   void FillPreedit(const composer::Composer& composer,
                    commands::Preedit* preedit) const override;
@@ -249,6 +252,10 @@ class EngineConverter : public EngineConverterInterface {
   // Set setting by the context.
   void OnStartComposition(const commands::Context& context) override;
 
+  void SaveSnapshot(commands::ConverterSnapshot* snapshot) const override;
+  bool RestoreSnapshot(const commands::ConverterSnapshot& snapshot,
+                       const composer::Composer& composer) override;
+
   // Copies EngineConverter
   EngineConverter* Clone() const override;
 
@@ -327,6 +334,10 @@ class EngineConverter : public EngineConverterInterface {
   // call StartPrediction().
   void MaybeExpandPrediction(const composer::Composer& composer);
 
+  // If the focused segment has only its top candidates because of lazy
+  // candidate expansion, generates the rest of them.
+  void MaybeExpandFocusedSegment();
+
   // Returns the value of candidate to be used by the converter.
   std::string GetSelectedCandidateValue(size_t segment_index) const;
 
@@ -342,12 +353,22 @@ class EngineConverter : public EngineConverterInterface {
   void SegmentFocusInternal(size_t segment_index);
   void ResizeSegmentWidth(const composer::Composer& composer, int delta);
 
+  // Helpers of RestoreSnapshot.
+  bool RestoreSegmentBoundaries(const commands::ConverterSnapshot& snapshot,
+                                const composer::Composer& composer);
+  // Moves the focus to the candidate of |value| in the focused segment.
+  // Returns false if no such candidate is in the candidate list.
+  bool CandidateMoveToValue(absl::string_view value);
+
   void FillConversion(commands::Preedit* preedit) const;
   void FillResult(commands::Result* result) const;
   void FillCandidateWindow(commands::CandidateWindow* candidate_window) const;
 
   // Fills protocol buffers with all flatten candidate words.
   void FillAllCandidateWords(commands::CandidateList* candidates) const;
+  // Fills all_candidate_words_delta instead if the client can apply it.
+  bool FillAllCandidateWordsDelta(commands::Output* output) const;
+  commands::Category GetAllCandidateWordsCategory() const;
   void FillIncognitoCandidateWords(commands::CandidateList* candidates) const;
 
   bool IsEmptySegment(const Segment& segment) const;
@@ -360,7 +381,8 @@ class EngineConverter : public EngineConverterInterface {
                           const commands::Context& context);
   void CommitSegmentsSize(size_t commit_segments_size);
 
-  // Sets request type and update the engine_converter's state
+  // Sets request type and update the engine_converter's state. Also sets the
+  // deadline from Request.conversion_time_budget_msec.
   void SetRequestType(ConversionRequest::RequestType request_type,
                       ConversionRequest::Options& options);
 
@@ -416,6 +438,12 @@ class EngineConverter : public EngineConverterInterface {
   // Mutable values of |config_|.  These values may be changed temporarily per
   // session.
   bool use_cascading_window_;
+
+  // Version and fingerprint of the all_candidate_words last sent in full.
+  uint64_t candidate_list_version_ = 0;
+  uint64_t candidate_list_fingerprint_ = 0;
+  // The version the client holds, set only for the next PopOutput().
+  std::optional<uint64_t> client_candidate_list_version_;
 };
 
 }  // namespace engine
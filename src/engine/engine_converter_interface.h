@@ -33,6 +33,7 @@
 #define MOZC_ENGINE_SESSION_CONVERTER_INTERFACE_H_
 
 #include <cstddef>
+#include <cstdint>
 #include <memory>
 #include <optional>
 #include <string>
@@ -41,6 +42,7 @@
 #include "composer/composer.h"
 #include "protocol/commands.pb.h"
 #include "protocol/config.pb.h"
+#include "protocol/session_snapshot.pb.h"
 #include "transliteration/transliteration.h"
 
 namespace mozc {
@@ -216,6 +218,11 @@ class EngineConverterInterface {
   virtual void PopOutput(const composer::Composer& composer,
                          commands::Output* output) = 0;
 
+  // Lets the next PopOutput() send all_candidate_words_delta instead of
+  // all_candidate_words if the candidate words of |client_version|, which the
+  // client holds, are still current. 0 means the client holds none.
+  virtual void EnableCandidateListDelta(uint64_t client_version) = 0;
+
   // Fill preedit
   virtual void FillPreedit(const composer::Composer& composer,
                            commands::Preedit* preedit) const = 0;
@@ -235,6 +242,16 @@ class EngineConverterInterface {
   // Update the internal state by the context.
   virtual void OnStartComposition(const commands::Context& context) = 0;
 
+  // Records the segment boundaries, the selected candidates and the focus
+  // into |snapshot|.
+  virtual void SaveSnapshot(commands::ConverterSnapshot* snapshot) const = 0;
+
+  // Reconverts |composer| and reapplies the state recorded in |snapshot|.
+  // Returns false if the state could not be reproduced; the converter is left
+  // in the COMPOSITION state in that case.
+  virtual bool RestoreSnapshot(const commands::ConverterSnapshot& snapshot,
+                               const composer::Composer& composer) = 0;
+
   // Clone instance.
   // Callee object doesn't have the ownership of the cloned instance.
   virtual EngineConverterInterface* Clone() const = 0;
@@ -47,7 +47,11 @@
 
 #include "absl/log/check.h"
 #include "absl/strings/string_view.h"
+#include "absl/time/time.h"
 #include "absl/types/span.h"
+#include "base/clock.h"
+#include "base/clock_mock.h"
+#include "base/metrics.h"
 #include "base/util.h"
 #include "composer/composer.h"
 #include "composer/table.h"
@@ -475,6 +479,59 @@ TEST_F(EngineConverterTest, Convert) {
   EXPECT_FALSE(IsCandidateListVisible(converter));
 }
 
+TEST_F(EngineConverterTest, AllCandidateWordsDelta) {
+  auto mock_converter = std::make_shared<MockConverter>();
+  EngineConverter converter(mock_converter, request_, config_);
+  {
+    Segments segments;
+    SetAiueo(&segments);
+    composer_->InsertCharacterPreedit("あいうえお");
+    FillT13Ns(&segments, composer_.get());
+    EXPECT_CALL(*mock_converter, StartConversion(_, _))
+        .WillOnce(DoAll(SetArgPointee<1>(segments), Return(true)));
+  }
+  EXPECT_TRUE(converter.Convert(*composer_));
+
+  // Without a version on the client, the full list is sent with a version.
+  commands::Output output;
+  converter.EnableCandidateListDelta(0);
+  converter.PopOutput(*composer_, &output);
+  ASSERT_TRUE(output.has_all_candidate_words());
+  EXPECT_FALSE(output.has_all_candidate_words_delta());
+  const uint64_t version = output.candidate_list_version();
+  EXPECT_NE(version, 0);
+
+  // Moving the focus sends only the new focused index.
+  converter.CandidateNext(*composer_);
+  output.Clear();
+  converter.EnableCandidateListDelta(version);
+  converter.PopOutput(*composer_, &output);
+  EXPECT_FALSE(output.has_all_candidate_words());
+  ASSERT_TRUE(output.has_all_candidate_words_delta());
+  EXPECT_EQ(output.all_candidate_words_delta().base_version(), version);
+  EXPECT_EQ(output.candidate_list_version(), version);
+  commands::Output full_output;
+  converter.FillOutput(*composer_, &full_output);
+  ASSERT_TRUE(full_output.has_all_candidate_words());
+  EXPECT_EQ(output.all_candidate_words_delta().focused_index(),
+            full_output.all_candidate_words().focused_index());
+  EXPECT_EQ(output.all_candidate_words_delta().focused_index(), 1);
+
+  // A version the converter does not know gets the full list.
+  output.Clear();
+  converter.EnableCandidateListDelta(version + 1);
+  converter.PopOutput(*composer_, &output);
+  EXPECT_TRUE(output.has_all_candidate_words());
+  EXPECT_FALSE(output.has_all_candidate_words_delta());
+  EXPECT_NE(output.candidate_list_version(), version);
+
+  // Clients without the capability get neither versions nor deltas.
+  output.Clear();
+  converter.PopOutput(*composer_, &output);
+  EXPECT_TRUE(output.has_all_candidate_words());
+  EXPECT_FALSE(output.has_candidate_list_version());
+}
+
 TEST_F(EngineConverterTest, ConvertWithSpellingCorrection) {
   auto mock_converter = std::make_shared<MockConverter>();
   EngineConverter converter(mock_converter, request_, config_);
@@ -496,6 +553,34 @@ TEST_F(EngineConverterTest, ConvertWithSpellingCorrection) {
   EXPECT_TRUE(IsCandidateListVisible(converter));
 }
 
+TEST_F(EngineConverterTest, ConvertRecordsDeadlineOverrunOnce) {
+  ScopedClockMock clock(absl::FromUnixSeconds(1000));
+  request_->set_conversion_time_budget_msec(10);
+  auto mock_converter = std::make_shared<MockConverter>();
+  EngineConverter converter(mock_converter, request_, config_);
+  Segments segments;
+  SetAiueo(&segments);
+  EXPECT_CALL(*mock_converter, StartConversion(_, _))
+      .WillOnce([&](const ConversionRequest& request, Segments* result) {
+        // Checking the deadline doesn't record anything.
+        clock->Advance(absl::Milliseconds(30));
+        EXPECT_TRUE(
+            request.options().IsDeadlineExceeded(Clock::GetAbslTime()));
+        EXPECT_TRUE(
+            request.options().IsDeadlineExceeded(Clock::GetAbslTime()));
+        *result = segments;
+        return true;
+      });
+
+  MetricsRegistry::Reset();
+  composer_->InsertCharacterPreedit(kChars_Aiueo);
+  EXPECT_TRUE(converter.Convert(*composer_));
+  const LatencyHistogram& histogram =
+      MetricsRegistry::GetStage(MetricsRegistry::DEADLINE_EXCEEDED);
+  EXPECT_EQ(histogram.count(), 1);
+  EXPECT_EQ(histogram.total(), absl::Milliseconds(20));
+}
+
 TEST_F(EngineConverterTest, ConvertWithA11yTalkbackEnabled) {
   request_->set_is_a11y_talkback_enabled(true);
   auto mock_converter = std::make_shared<MockConverter>();
@@ -34,11 +34,13 @@
 #include <algorithm>
 #include <cstddef>
 #include <cstdint>
+#include <optional>
 #include <string>
 #include <utility>
 #include <vector>
 
 #include "absl/container/flat_hash_map.h"
+#include "absl/hash/hash.h"
 #include "absl/log/check.h"
 #include "absl/log/log.h"
 #include "absl/strings/str_split.h"
@@ -173,6 +175,58 @@ void FillAllCandidateWordsInternal(
                       candidate_word_proto);
   }
 }
+void HashAllCandidateWordsInternal(const Segment& segment,
+                                   const CandidateList& candidate_list,
+                                   uint64_t* fingerprint) {
+  for (size_t i = 0; i < candidate_list.size(); ++i) {
+    const Candidate& candidate = candidate_list.candidate(i);
+    if (candidate.HasSubcandidateList()) {
+      HashAllCandidateWordsInternal(segment, candidate.subcandidate_list(),
+                                    fingerprint);
+      continue;
+    }
+    const int id = candidate.id();
+    *fingerprint = absl::HashOf(*fingerprint, id);
+    if (!segment.is_valid_index(id)) {
+      return;
+    }
+    // Every field FillCandidateWord() reads.
+    const converter::Candidate& c = segment.candidate(id);
+    *fingerprint = absl::HashOf(
+        *fingerprint, c.content_key, c.value, c.prefix, c.suffix,
+        c.description, c.a11y_description, c.display_value, c.attributes,
+        c.inner_segment_boundary.size());
+#ifndef NDEBUG
+    *fingerprint = absl::HashOf(*fingerprint, c.DebugString(), c.log);
+#endif  // NDEBUG
+  }
+}
+
+// Mirrors the traversal of FillAllCandidateWordsInternal().
+bool FindAllCandidateWordsFocusedIndex(const Segment& segment,
+                                       const CandidateList& candidate_list,
+                                       const int focused_id, uint32_t* index,
+                                       std::optional<uint32_t>* focused_index) {
+  for (size_t i = 0; i < candidate_list.size(); ++i) {
+    const Candidate& candidate = candidate_list.candidate(i);
+    if (candidate.HasSubcandidateList()) {
+      if (!FindAllCandidateWordsFocusedIndex(
+              segment, candidate.subcandidate_list(), focused_id, index,
+              focused_index)) {
+        return false;
+      }
+      continue;
+    }
+    if (candidate.id() == focused_id && candidate_list.focused()) {
+      *focused_index = *index;
+    }
+    ++*index;
+    if (!segment.is_valid_index(candidate.id())) {
+      return false;
+    }
+  }
+  return true;
+}
 }  // namespace
 
 namespace output {
@@ -255,6 +309,24 @@ void FillAllCandidateWords(const Segment& segment,
                                 candidate_list_proto);
 }
 
+uint64_t AllCandidateWordsFingerprint(const Segment& segment,
+                                      const CandidateList& candidate_list,
+                                      const commands::Category category) {
+  uint64_t fingerprint = absl::HashOf(category, segment.key());
+  HashAllCandidateWordsInternal(segment, candidate_list, &fingerprint);
+  return fingerprint;
+}
+
+std::optional<uint32_t> AllCandidateWordsFocusedIndex(
+    const Segment& segment, const CandidateList& candidate_list) {
+  uint32_t index = 0;
+  std::optional<uint32_t> focused_index;
+  FindAllCandidateWordsFocusedIndex(segment, candidate_list,
+                                    candidate_list.focused_id(), &index,
+                                    &focused_index);
+  return focused_index;
+}
+
 void FillRemovedCandidates(const Segment& segment,
                            commands::CandidateList* candidate_list_proto) {
   int index = 1000;
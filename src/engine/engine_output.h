@@ -34,6 +34,7 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <optional>
 #include <string>
 
 #include "absl/strings/string_view.h"
@@ -64,6 +65,18 @@ void FillAllCandidateWords(const Segment& segment,
                            commands::Category category,
                            commands::CandidateList* candidate_list_proto);
 
+// Returns a fingerprint of the contents FillAllCandidateWords() would fill,
+// except the focused index. Equal fingerprints mean the same candidate words,
+// so the client only needs the new focus. This is much cheaper than filling
+// and comparing the protobufs.
+uint64_t AllCandidateWordsFingerprint(const Segment& segment,
+                                      const CandidateList& candidate_list,
+                                      commands::Category category);
+
+// Returns the focused_index FillAllCandidateWords() would set.
+std::optional<uint32_t> AllCandidateWordsFocusedIndex(
+    const Segment& segment, const CandidateList& candidate_list);
+
 // For debug. Fill the CandidateList protobuf with the
 // removed_candidates_for_debug in the segment.
 void FillRemovedCandidates(const Segment& segment,
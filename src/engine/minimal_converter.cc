@@ -161,6 +161,12 @@ class MinimalConverter : public ConverterInterface {
     return true;
   }
 
+  bool ExpandSegmentCandidates(Segments* segments,
+                               const ConversionRequest& request,
+                               size_t segment_index) const override {
+    return false;
+  }
+
   void CommitContext(const ConversionRequest& request) const override {}
 };
 }  // namespace
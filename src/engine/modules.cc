@@ -56,6 +56,7 @@
 #include "dictionary/user_pos.h"
 #include "engine/supplemental_model_interface.h"
 #include "prediction/suggestion_filter.h"
+#include "prediction/typing_correction_cache.h"
 #include "prediction/user_history_storage.h"
 
 
@@ -184,6 +185,9 @@ absl::Status Modules::Init(std::unique_ptr<const DataManager> data_manager) {
     supplemental_model_ = g_supplemental_model;
   }
 
+  typing_correction_cache_ =
+      std::make_unique<prediction::TypingCorrectionCache>();
+
   // All modules must not be non-null.
   RETURN_IF_NULL(pos_matcher_);
   RETURN_IF_NULL(segmenter_);
@@ -193,6 +197,7 @@ absl::Status Modules::Init(std::unique_ptr<const DataManager> data_manager) {
   RETURN_IF_NULL(single_kanji_dictionary_);
   RETURN_IF_NULL(user_history_storage_);
   RETURN_IF_NULL(supplemental_model_);
+  RETURN_IF_NULL(typing_correction_cache_);
 
   return absl::Status();
 #undef RETURN_IF_NULL
@@ -43,6 +43,7 @@
 #include "dictionary/single_kanji_dictionary.h"
 #include "engine/supplemental_model_interface.h"
 #include "prediction/suggestion_filter.h"
+#include "prediction/typing_correction_cache.h"
 #include "prediction/user_history_storage.h"
 #include "prediction/zero_query_dict.h"
 
@@ -121,6 +122,13 @@ class Modules {
     return *supplemental_model_;
   }
 
+  // Shared by the predictors so that a composition is passed to
+  // SupplementalModelInterface::CorrectComposition() only once.
+  prediction::TypingCorrectionCache& GetTypingCorrectionCache() const {
+    DCHECK(typing_correction_cache_);
+    return *typing_correction_cache_;
+  }
+
  private:
   friend class ModulesPresetBuilder;
   // For the constructor.
@@ -150,6 +158,7 @@ class Modules {
   // by a PresetBuilder. Since singleton object cannot be deallocated,
   // `supplemental_model_` is managed using a shared_ptr.
   std::shared_ptr<engine::SupplementalModelInterface> supplemental_model_;
+  std::unique_ptr<prediction::TypingCorrectionCache> typing_correction_cache_;
 };
 
 class ModulesPresetBuilder {
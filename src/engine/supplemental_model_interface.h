@@ -58,8 +58,10 @@ class SupplementalModelInterface {
     return EngineReloadResponse();
   }
 
-  // Destroys old models that were replaced during reload.
-  virtual void ClearOldModels() {}
+  // Destroys old models that were replaced during reload. Returns true if any
+  // model was destroyed, i.e. a new model has been swapped in since the last
+  // call.
+  virtual bool ClearOldModels() { return false; }
 
   // Returns true if supplemental model is available.
   // Useful to run intensive operations before using supplemental model.
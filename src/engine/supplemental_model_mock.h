@@ -52,6 +52,7 @@ class MockSupplementalModel : public SupplementalModelInterface {
               (override));
   MOCK_METHOD(EngineReloadResponse, Load, (const EngineReloadRequest& request),
               (override));
+  MOCK_METHOD(bool, ClearOldModels, (), (override));
   MOCK_METHOD(std::optional<std::vector<composer::TypeCorrectedQuery>>,
               CorrectComposition, (const ConversionRequest& request),
               (const, override));
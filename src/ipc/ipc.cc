@@ -32,11 +32,14 @@
 #include <cstdint>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "absl/base/no_destructor.h"
 #include "absl/log/check.h"
 #include "absl/log/log.h"
 #include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
 #include "base/thread.h"
 #include "ipc/ipc_path_manager.h"
 
@@ -99,6 +102,21 @@ uint32_t IPCClient::GetServerProcessId() const {
   return ipc_path_manager_->GetServerProcessId();
 }
 
+#if defined(_WIN32) || defined(__APPLE__)
+// Framed connections are implemented only in unix_ipc.cc.
+bool IPCClient::CallPipelined(absl::Span<const absl::string_view> requests,
+                              std::vector<std::string> *responses,
+                              absl::Duration timeout) {
+  responses->clear();
+  if (requests.size() != 1) {
+    LOG(ERROR) << "Pipelined calls are not supported on this platform";
+    return false;
+  }
+  responses->emplace_back();
+  return Call(requests.front(), &responses->back(), timeout);
+}
+#endif  // _WIN32 || __APPLE__
+
 // static
 bool IPCClient::TerminateServer(absl::string_view name) {
   IPCClient client(name);
@@ -34,10 +34,12 @@
 #include <cstdint>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "absl/strings/string_view.h"
 #include "absl/synchronization/notification.h"
 #include "absl/time/time.h"
+#include "absl/types/span.h"
 #include "base/thread.h"
 
 #ifdef __APPLE__
@@ -87,6 +89,9 @@ class IPCClientInterface {
 
   // return last error
   virtual IPCErrorType GetLastIPCError() const = 0;
+
+  // Returns true if Call() can be invoked again on this connection.
+  virtual bool IsReusable() const { return false; }
 };
 
 #ifdef __APPLE__
@@ -144,13 +149,27 @@ class IPCClient : public IPCClientInterface {
   // Return true when IPC finishes successfully.
   // When Server doesn't send response within timeout, 'Call' returns false.
   // When timeout (in msec) is set -1, 'Call' waits forever.
-  // Note that on Linux and Windows, Call() closes the socket_. This means you
-  // cannot call the Call() function more than once.
+  // Note that on Windows, and on Linux when the server doesn't advertise
+  // framed connections in the IPC path file, Call() closes the socket_. This
+  // means you cannot call the Call() function more than once. Check
+  // IsReusable().
   bool Call(absl::string_view request, std::string* response,
             absl::Duration timeout) override;
 
+  // Sends all the requests before reading any response, so that the server
+  // can work on the next request while the previous response is in flight.
+  // Responses are returned in the order of the requests. Without a framed
+  // connection only a single request can be sent.
+  // Keep batches small: the server writes each response before reading the
+  // next request, so a batch larger than the socket buffers times out.
+  bool CallPipelined(absl::Span<const absl::string_view> requests,
+                     std::vector<std::string>* responses,
+                     absl::Duration timeout);
+
   IPCErrorType GetLastIPCError() const override { return last_ipc_error_; }
 
+  bool IsReusable() const override { return connected_ && framed_; }
+
   // terminate the server process named |name|
   // Do not use it unless version mismatch happens
   static bool TerminateServer(absl::string_view name);
@@ -173,8 +192,12 @@ class IPCClient : public IPCClientInterface {
   MachPortManagerInterface* mach_port_manager_;
 #else   // _WIN32
   int socket_;
+  // True once the framed-connection preamble has been sent.
+  bool preamble_sent_ = false;
 #endif  // _WIN32
   bool connected_;
+  // True if the connection uses length-prefixed frames.
+  bool framed_ = false;
   IPCPathManager* ipc_path_manager_;
   IPCErrorType last_ipc_error_;
 };
@@ -208,6 +231,8 @@ class IPCClientFactory : public IPCClientFactoryInterface {
 };
 
 // Synchronous, Single-thread IPC Server
+// On Linux, the server also keeps framed connections open and serves them
+// along with new connections, one request at a time.
 // Usage:
 // class MyEchoServer: public IPCServer {
 //  public:
@@ -32,6 +32,7 @@
 #include "ipc/ipc_mock.h"
 
 #include <cstdint>
+#include <deque>
 #include <memory>
 #include <string>
 
@@ -101,6 +102,10 @@ void IPCClientFactoryMock::SetMockResponse(absl::string_view response) {
   response_ = response;
 }
 
+void IPCClientFactoryMock::AddMockResponse(absl::string_view response) {
+  queued_responses_.emplace_back(response);
+}
+
 void IPCClientFactoryMock::SetConnection(const bool connection) {
   connection_ = connection;
 }
@@ -126,7 +131,12 @@ std::unique_ptr<IPCClientMock> IPCClientFactoryMock::NewClientMock() {
   auto client = std::make_unique<IPCClientMock>(this);
   client->set_connection(connection_);
   client->set_result(result_);
-  client->set_response(response_);
+  if (queued_responses_.empty()) {
+    client->set_response(response_);
+  } else {
+    client->set_response(queued_responses_.front());
+    queued_responses_.pop_front();
+  }
   client->set_server_protocol_version(server_protocol_version_);
   client->set_server_product_version(server_product_version_);
   return client;
@@ -31,6 +31,7 @@
 #define MOZC_IPC_IPC_MOCK_H_
 
 #include <cstdint>
+#include <deque>
 #include <memory>
 #include <string>
 
@@ -100,6 +101,10 @@ class IPCClientFactoryMock : public IPCClientFactoryInterface {
   // This function is for unit tests.
   void SetMockResponse(absl::string_view response);
 
+  // This function is for unit tests. The queued responses are returned by the
+  // next clients in order, before the one set by SetMockResponse().
+  void AddMockResponse(absl::string_view response);
+
   // This function is for unit tests.
   void SetConnection(bool connection);
 
@@ -125,6 +130,7 @@ class IPCClientFactoryMock : public IPCClientFactoryInterface {
   uint32_t server_process_id_;
   std::string request_;
   std::string response_;
+  std::deque<std::string> queued_responses_;
 };
 
 }  // namespace mozc
@@ -212,6 +212,10 @@ bool IPCPathManager::SavePathName() {
   ipc_path_info_.set_process_id(static_cast<uint32_t>(getpid()));
   ipc_path_info_.set_thread_id(0);
 #endif  // _WIN32
+#ifdef __linux__
+  // Only the Unix-socket server in unix_ipc.cc serves framed connections.
+  ipc_path_info_.set_framed_connection(true);
+#endif  // __linux__
 
   std::string buf;
   if (!ipc_path_info_.SerializeToString(&buf)) {
@@ -305,6 +309,10 @@ uint32_t IPCPathManager::GetServerProcessId() const {
   return ipc_path_info_.process_id();
 }
 
+bool IPCPathManager::ServerSupportsFramedConnection() const {
+  return ipc_path_info_.framed_connection();
+}
+
 void IPCPathManager::Clear() {
   absl::MutexLock l(mutex_);
   ipc_path_info_.Clear();
@@ -93,6 +93,11 @@ class IPCPathManager {
   // return process id of the server
   uint32_t GetServerProcessId() const;
 
+  // Returns true if the server accepts framed connections. Framing is
+  // negotiated apart from the protocol version so that older clients and
+  // servers keep working with the one-shot connections.
+  bool ServerSupportsFramedConnection() const;
+
   // Checks the server pid is the valid server specified with server_path.
   // server pid can be obtained by OS dependent method.
   // This API is only available on Windows Vista or Linux.
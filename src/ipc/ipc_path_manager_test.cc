@@ -148,6 +148,11 @@ TEST_F(IPCPathManagerTest, PathNameTest) {
   EXPECT_TRUE(original_path.has_key());
   EXPECT_TRUE(original_path.has_process_id());
   EXPECT_TRUE(original_path.has_thread_id());
+#ifdef __linux__
+  EXPECT_TRUE(original_path.framed_connection());
+#else   // __linux__
+  EXPECT_FALSE(original_path.framed_connection());
+#endif  // __linux__
 
   manager_peer.ipc_path_info_().Clear();
   EXPECT_TRUE(manager->LoadPathName());
@@ -158,5 +163,7 @@ TEST_F(IPCPathManagerTest, PathNameTest) {
   EXPECT_EQ(loaded_path.key(), original_path.key());
   EXPECT_EQ(loaded_path.process_id(), original_path.process_id());
   EXPECT_EQ(loaded_path.thread_id(), original_path.thread_id());
+  EXPECT_EQ(loaded_path.framed_connection(),
+            original_path.framed_connection());
 }
 }  // namespace mozc
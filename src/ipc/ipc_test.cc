@@ -31,6 +31,7 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -163,5 +164,93 @@ TEST_F(IPCTest, IPCTest) {
   con.Wait();
 }
 
+#if defined(__linux__)
+TEST_F(IPCTest, FramedConnection) {
+  EchoServer con(kServerAddress, 10, absl::Milliseconds(1000));
+  con.LoopAndReturn();
+
+  // Legacy one-shot connections and framed connections are served together.
+  IPCClient framed(kServerAddress, "");
+  ASSERT_TRUE(framed.Connected());
+  EXPECT_TRUE(framed.IsReusable());
+  for (int i = 0; i < 20; ++i) {
+    const std::string input = GenerateInputData(i);
+    std::string output;
+    ASSERT_TRUE(framed.Call(input, &output, absl::Milliseconds(1000)))
+        << "size=" << input.size();
+    EXPECT_EQ(output, input);
+    EXPECT_TRUE(framed.IsReusable());
+
+    IPCClient one_shot(kServerAddress, "");
+    ASSERT_TRUE(one_shot.Connected());
+    ASSERT_TRUE(one_shot.Call(input, &output, absl::Milliseconds(1000)));
+    EXPECT_EQ(output, input);
+  }
+
+  // Small requests only; see the comment of CallPipelined().
+  std::vector<std::string> inputs;
+  for (int i = 0; i < 4; ++i) {
+    inputs.push_back(GenerateInputData(i));
+  }
+  const std::vector<absl::string_view> requests(inputs.begin(), inputs.end());
+  std::vector<std::string> outputs;
+  ASSERT_TRUE(
+      framed.CallPipelined(requests, &outputs, absl::Milliseconds(1000)));
+  EXPECT_EQ(outputs, inputs);
+
+  // An empty response closes the connection as on a legacy connection.
+  std::string output = "dummy";
+  ASSERT_TRUE(framed.Call("", &output, absl::Milliseconds(1000)));
+  EXPECT_TRUE(output.empty());
+  EXPECT_FALSE(framed.IsReusable());
+  IPCClient one_shot(kServerAddress, "");
+  ASSERT_TRUE(one_shot.Connected());
+  output = "dummy";
+  ASSERT_TRUE(one_shot.Call("", &output, absl::Milliseconds(1000)));
+  EXPECT_TRUE(output.empty());
+
+  IPCClient kill(kServerAddress, "");
+  std::string kill_output;
+  kill.Call("kill", &kill_output, absl::Milliseconds(1000));
+  EXPECT_FALSE(kill.IsReusable());
+  con.Wait();
+}
+
+TEST_F(IPCTest, ManyFramedConnections) {
+  EchoServer con(kServerAddress, 10, absl::Milliseconds(1000));
+  con.LoopAndReturn();
+
+  // More clients than the framed connections the server keeps open. A client
+  // whose connection is closed reconnects on IPC_WRITE_ERROR, as Client does,
+  // and no request is lost or answered twice.
+  constexpr int kNumClients = 24;
+  std::vector<Thread> threads;
+  for (int t = 0; t < kNumClients; ++t) {
+    threads.push_back(Thread([t] {
+      auto client = std::make_unique<IPCClient>(kServerAddress, "");
+      for (int i = 0; i < 50; ++i) {
+        const std::string input = GenerateInputData(t * 50 + i);
+        std::string output;
+        if (!client->Call(input, &output, absl::Milliseconds(1000))) {
+          ASSERT_EQ(client->GetLastIPCError(), IPC_WRITE_ERROR);
+          client = std::make_unique<IPCClient>(kServerAddress, "");
+          ASSERT_TRUE(client->Call(input, &output, absl::Milliseconds(1000)));
+        }
+        EXPECT_EQ(output, input);
+        ASSERT_TRUE(client->IsReusable());
+      }
+    }));
+  }
+  for (Thread &thread : threads) {
+    thread.Join();
+  }
+
+  IPCClient kill(kServerAddress, "");
+  std::string kill_output;
+  kill.Call("kill", &kill_output, absl::Milliseconds(1000));
+  con.Wait();
+}
+#endif  // __linux__
+
 }  // namespace
 }  // namespace mozc
@@ -31,18 +31,23 @@
 #if defined(__linux__)
 
 #include <fcntl.h>
+#include <poll.h>
 #include <sys/select.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/time.h>
+#include <sys/uio.h>
 #include <sys/un.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <cerrno>
 #include <cstddef>
 #include <cstdint>
 #include <cstring>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "absl/log/check.h"
 #include "absl/log/log.h"
@@ -50,6 +55,7 @@
 #include "absl/strings/str_format.h"
 #include "absl/strings/string_view.h"
 #include "absl/time/time.h"
+#include "absl/types/span.h"
 #include "base/file_util.h"
 #include "base/vlog.h"
 #include "ipc/ipc.h"
@@ -64,6 +70,19 @@ namespace {
 
 constexpr int kInvalidSocket = -1;
 
+// A framed connection starts with this preamble, followed by frames of a
+// 4-byte little-endian payload length and the payload. Responses use the same
+// frames without the preamble. 0xFF can never be the first byte of a
+// serialized protocol buffer (wire type 7 is invalid), so the server tells the
+// framings apart by the first byte of a connection.
+constexpr char kFramedPreamble[] = {'\xFF', 'M', 'Z', 'F'};
+constexpr size_t kFrameHeaderSize = 4;
+constexpr uint32_t kMaxFrameSize = 64 * 1024 * 1024;
+
+// The least recently used idle framed connection is closed when more are
+// open. The client reconnects transparently on the next call.
+constexpr size_t kMaxFramedConnections = 16;
+
 absl::Status mkdir_p(absl::string_view dirname) {
   const std::string parent_dir(FileUtil::Dirname(dirname));
   struct stat st;
@@ -192,6 +211,124 @@ IPCErrorType RecvMessage(int socket, std::string *msg, absl::Duration timeout) {
   return IPC_NO_ERROR;
 }
 
+// Receives exactly |size| bytes. Returns IPC_NO_CONNECTION if the peer has
+// closed the connection. Returns IPC_WRITE_ERROR if the peer has closed it
+// without reading the data sent to it, which Linux reports as ECONNRESET on a
+// Unix socket.
+IPCErrorType RecvBytes(int socket, char *buf, size_t size,
+                       absl::Duration timeout) {
+  size_t offset = 0;
+  while (offset < size) {
+    if (IsReadTimeout(socket, timeout)) {
+      LOG(WARNING) << "Read timeout " << timeout;
+      return IPC_TIMEOUT_ERROR;
+    }
+    const ssize_t l = ::recv(socket, buf + offset, size - offset,
+                             /* flags */ 0);
+    if (l < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno == ECONNRESET) {
+        LOG(WARNING) << "connection reset by the peer";
+        return IPC_WRITE_ERROR;
+      }
+      LOG(ERROR) << "an error occurred during recv(): " << strerror(errno);
+      return IPC_READ_ERROR;
+    }
+    if (l == 0) {
+      return IPC_NO_CONNECTION;
+    }
+    offset += l;
+  }
+  return IPC_NO_ERROR;
+}
+
+void EncodeFrameHeader(uint32_t size, char header[kFrameHeaderSize]) {
+  for (size_t i = 0; i < kFrameHeaderSize; ++i) {
+    header[i] = static_cast<char>((size >> (8 * i)) & 0xFF);
+  }
+}
+
+void AppendFrame(absl::string_view payload, std::string *buffer) {
+  char header[kFrameHeaderSize];
+  EncodeFrameHeader(payload.size(), header);
+  buffer->append(header, kFrameHeaderSize);
+  buffer->append(payload.data(), payload.size());
+}
+
+// Sends a frame without copying |payload| into a separate buffer.
+IPCErrorType SendFrame(int socket, absl::string_view payload,
+                       absl::Duration timeout) {
+  char header[kFrameHeaderSize];
+  EncodeFrameHeader(payload.size(), header);
+  iovec iov[2] = {
+      {header, kFrameHeaderSize},
+      {const_cast<char *>(payload.data()), payload.size()},
+  };
+  msghdr msg = {};
+  msg.msg_iov = iov;
+  msg.msg_iovlen = 2;
+  size_t remaining = kFrameHeaderSize + payload.size();
+  while (remaining > 0) {
+    if (IsWriteTimeout(socket, timeout)) {
+      LOG(WARNING) << "Write timeout " << timeout;
+      return IPC_TIMEOUT_ERROR;
+    }
+    ssize_t l = ::sendmsg(socket, &msg, MSG_NOSIGNAL);
+    if (l < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      LOG(ERROR) << "an error occurred during sendmsg(): " << strerror(errno);
+      return IPC_WRITE_ERROR;
+    }
+    remaining -= l;
+    // Skip the bytes already sent.
+    while (l > 0 && msg.msg_iovlen > 0) {
+      const size_t n = std::min<size_t>(l, msg.msg_iov->iov_len);
+      msg.msg_iov->iov_base = static_cast<char *>(msg.msg_iov->iov_base) + n;
+      msg.msg_iov->iov_len -= n;
+      l -= n;
+      if (msg.msg_iov->iov_len == 0) {
+        ++msg.msg_iov;
+        --msg.msg_iovlen;
+      }
+    }
+  }
+  return IPC_NO_ERROR;
+}
+
+IPCErrorType RecvFrame(int socket, std::string *payload,
+                       absl::Duration timeout) {
+  unsigned char header[kFrameHeaderSize];
+  if (const IPCErrorType error =
+          RecvBytes(socket, reinterpret_cast<char *>(header), sizeof(header),
+                    timeout);
+      error != IPC_NO_ERROR) {
+    payload->clear();
+    return error;
+  }
+  uint32_t size = 0;
+  for (size_t i = 0; i < kFrameHeaderSize; ++i) {
+    size |= static_cast<uint32_t>(header[i]) << (8 * i);
+  }
+  if (size > kMaxFrameSize) {
+    LOG(ERROR) << "Too large frame: " << size;
+    payload->clear();
+    return IPC_READ_ERROR;
+  }
+  payload->resize(size);
+  const IPCErrorType error = RecvBytes(socket, payload->data(), size, timeout);
+  if (error != IPC_NO_ERROR) {
+    payload->clear();
+    // EOF in the middle of a frame is an error, not a graceful close.
+    return error == IPC_NO_CONNECTION ? IPC_READ_ERROR : error;
+  }
+  MOZC_VLOG(1) << size << " bytes frame received";
+  return IPC_NO_ERROR;
+}
+
 void SetCloseOnExecFlag(int fd) {
   int flags = ::fcntl(fd, F_GETFD, 0);
   if (flags < 0) {
@@ -287,6 +424,7 @@ void IPCClient::Init(absl::string_view name,
       }
       last_ipc_error_ = IPC_NO_ERROR;
       connected_ = true;
+      framed_ = manager->ServerSupportsFramedConnection();
       break;
     }
   }
@@ -310,6 +448,14 @@ bool IPCClient::Call(absl::string_view request, std::string *response,
     LOG(ERROR) << "Call failed: not connected";
     return false;
   }
+  if (framed_) {
+    std::vector<std::string> responses;
+    if (!CallPipelined({request}, &responses, timeout)) {
+      return false;
+    }
+    *response = std::move(responses.front());
+    return true;
+  }
   last_ipc_error_ = SendMessage(socket_, request, timeout);
   if (last_ipc_error_ != IPC_NO_ERROR) {
     LOG(ERROR) << "SendMessage failed";
@@ -333,6 +479,70 @@ bool IPCClient::Call(absl::string_view request, std::string *response,
   return true;
 }
 
+bool IPCClient::CallPipelined(absl::Span<const absl::string_view> requests,
+                              std::vector<std::string> *responses,
+                              absl::Duration timeout) {
+  responses->clear();
+  if (!connected_) {
+    LOG(ERROR) << "Call failed: not connected";
+    return false;
+  }
+  if (!framed_) {
+    if (requests.size() != 1) {
+      LOG(ERROR) << "The server does not support pipelined calls";
+      return false;
+    }
+    responses->emplace_back();
+    return Call(requests.front(), &responses->back(), timeout);
+  }
+
+  // Write everything with a single send() where possible.
+  std::string buffer;
+  if (!preamble_sent_) {
+    buffer.append(kFramedPreamble, sizeof(kFramedPreamble));
+  }
+  for (const absl::string_view request : requests) {
+    AppendFrame(request, &buffer);
+  }
+  last_ipc_error_ = SendMessage(socket_, buffer, timeout);
+  if (last_ipc_error_ != IPC_NO_ERROR) {
+    LOG(ERROR) << "SendMessage failed";
+    connected_ = false;
+    return false;
+  }
+  preamble_sent_ = true;
+
+  responses->resize(requests.size());
+  for (std::string &response : *responses) {
+    last_ipc_error_ = RecvFrame(socket_, &response, timeout);
+    if (last_ipc_error_ == IPC_NO_CONNECTION && requests.size() == 1) {
+      // The server closes the connection without a reply when the response
+      // is empty. It is an empty response as on a legacy connection.
+      MOZC_VLOG(1) << "connection closed without a response";
+      last_ipc_error_ = IPC_NO_ERROR;
+      connected_ = false;
+      return true;
+    }
+    if (last_ipc_error_ != IPC_NO_ERROR) {
+      LOG(ERROR) << "RecvFrame failed: " << last_ipc_error_;
+      // The responses of the remaining requests may still arrive, so the
+      // stream is out of sync and cannot be used any more.
+      // IPC_WRITE_ERROR means that the server has closed the connection
+      // without reading the request, e.g. to close an idle connection. A
+      // single request is then reported as unsent so that it can be retried.
+      if (last_ipc_error_ == IPC_NO_CONNECTION ||
+          (last_ipc_error_ == IPC_WRITE_ERROR && requests.size() != 1)) {
+        last_ipc_error_ = IPC_READ_ERROR;
+      }
+      connected_ = false;
+      responses->clear();
+      return false;
+    }
+  }
+  MOZC_VLOG(1) << "Call succeeded";
+  return true;
+}
+
 bool IPCClient::Connected() const { return connected_; }
 
 // Server
@@ -427,13 +637,151 @@ void IPCServer::Loop() {
   pid_t pid = 0;
   std::string request;
   std::string response;
+  // Open framed connections and the request count when each of them was
+  // last served.
+  struct FramedConnection {
+    int sock;
+    uint64_t last_served;
+  };
+  std::vector<FramedConnection> framed_connections;
+  uint64_t num_served = 0;
+  std::vector<pollfd> fds;
+
+  // Closes the least recently served framed connection that has no pending
+  // request. If every connection has one, the least recently served one is
+  // closed anyway. Its request is discarded unread, and the client gets
+  // ECONNRESET and retries it on a new connection.
+  auto evict_framed_connection = [&]() {
+    std::vector<pollfd> pending;
+    pending.reserve(framed_connections.size());
+    for (const FramedConnection &conn : framed_connections) {
+      pending.push_back({conn.sock, POLLIN, 0});
+    }
+    if (::poll(pending.data(), pending.size(), 0) < 0) {
+      pending.clear();
+    }
+    // Idle connections first, then the least recently served one.
+    auto eviction_order = [&](size_t i) {
+      const bool busy = !pending.empty() && pending[i].revents != 0;
+      return std::make_pair(busy, framed_connections[i].last_served);
+    };
+    size_t victim = 0;
+    for (size_t i = 1; i < framed_connections.size(); ++i) {
+      if (eviction_order(i) < eviction_order(victim)) {
+        victim = i;
+      }
+    }
+    MOZC_VLOG(1) << "closing a framed connection, busy="
+                 << eviction_order(victim).first;
+    ::close(framed_connections[victim].sock);
+    framed_connections.erase(framed_connections.begin() + victim);
+  };
+
+  // Serves one request of a framed connection. Returns false if the
+  // connection should be closed.
+  auto serve_frame = [&](int sock) {
+    const IPCErrorType recv_error = RecvFrame(sock, &request, timeout_);
+    if (recv_error == IPC_NO_CONNECTION) {
+      MOZC_VLOG(1) << "framed connection closed by the client";
+      return false;
+    }
+    if (recv_error != IPC_NO_ERROR) {
+      LOG(WARNING) << "RecvFrame() failed";
+      return false;
+    }
+    if (!Process(request, &response)) {
+      LOG(WARNING) << "Process() failed";
+      error = true;
+      return false;
+    }
+    // The connection is closed without a reply as a legacy one is. The client
+    // receives it as an empty response.
+    if (response.empty()) {
+      LOG(WARNING) << "response is empty";
+      return false;
+    }
+    if (SendFrame(sock, response, timeout_) != IPC_NO_ERROR) {
+      LOG(WARNING) << "SendFrame() failed";
+      return false;
+    }
+    ++num_served;
+    return true;
+  };
+
   while (!error && !terminate_.HasBeenNotified()) {
+    fds.clear();
+    fds.push_back({socket_, POLLIN, 0});
+    for (const FramedConnection &conn : framed_connections) {
+      fds.push_back({conn.sock, POLLIN, 0});
+    }
+    if (::poll(fds.data(), fds.size(), -1) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      LOG(FATAL) << "poll() failed: " << strerror(errno);
+      return;
+    }
+
+    // Framed connections first, so that a typing client is not delayed by
+    // new connections.
+    std::vector<int> closed_sockets;
+    for (size_t i = 1; i < fds.size() && !error; ++i) {
+      if (fds[i].revents == 0) {
+        continue;
+      }
+      if (serve_frame(fds[i].fd)) {
+        // |framed_connections| is in the same order as |fds|.
+        framed_connections[i - 1].last_served = num_served;
+      } else {
+        closed_sockets.push_back(fds[i].fd);
+      }
+    }
+    for (const int sock : closed_sockets) {
+      ::close(sock);
+      std::erase_if(framed_connections, [sock](const FramedConnection &conn) {
+        return conn.sock == sock;
+      });
+    }
+    if (error || (fds[0].revents & POLLIN) == 0) {
+      continue;
+    }
+
     const int new_sock = ::accept(socket_, nullptr, nullptr);
     if (new_sock < 0) {
       LOG(FATAL) << "accept() failed: " << strerror(errno);
       return;
     }
     if (!IsPeerValid(new_sock, &pid)) {
+      ::close(new_sock);
+      continue;
+    }
+
+    // Peek the first byte to tell a framed connection from a legacy one.
+    char first_byte = 0;
+    if (IsReadTimeout(new_sock, timeout_) ||
+        ::recv(new_sock, &first_byte, 1, MSG_PEEK) < 0) {
+      LOG(WARNING) << "Cannot read the first byte";
+      ::close(new_sock);
+      continue;
+    }
+    if (first_byte == kFramedPreamble[0]) {
+      char preamble[sizeof(kFramedPreamble)];
+      if (RecvBytes(new_sock, preamble, sizeof(preamble), timeout_) !=
+              IPC_NO_ERROR ||
+          memcmp(preamble, kFramedPreamble, sizeof(preamble)) != 0) {
+        LOG(WARNING) << "Invalid preamble";
+        ::close(new_sock);
+        continue;
+      }
+      if (framed_connections.size() >= kMaxFramedConnections) {
+        evict_framed_connection();
+      }
+      // The first request is usually already buffered.
+      if (serve_frame(new_sock)) {
+        framed_connections.push_back({new_sock, num_served});
+      } else {
+        ::close(new_sock);
+      }
       continue;
     }
 
@@ -462,6 +810,9 @@ void IPCServer::Loop() {
     ::close(new_sock);
   }
 
+  for (const FramedConnection &conn : framed_connections) {
+    ::close(conn.sock);
+  }
   ::shutdown(socket_, SHUT_RDWR);
   ::close(socket_);
   if (!IsAbstractSocket(server_address_)) {
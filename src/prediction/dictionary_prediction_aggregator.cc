@@ -42,15 +42,18 @@
 
 #include "absl/algorithm/container.h"
 #include "absl/container/btree_set.h"
+#include "absl/flags/flag.h"
 #include "absl/log/check.h"
 #include "absl/log/log.h"
 #include "absl/strings/ascii.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
 #include "absl/types/span.h"
+#include "base/clock.h"
 #include "base/japanese_util.h"
 #include "base/number_util.h"
 #include "base/strings/unicode.h"
+#include "base/thread.h"
 #include "base/util.h"
 #include "composer/query.h"
 #include "config/character_form_manager.h"
@@ -72,6 +75,10 @@
 #include "request/request_util.h"
 #include "transliteration/transliteration.h"
 
+ABSL_FLAG(bool, concurrent_prediction_aggregation, false,
+          "Runs the realtime decoding on a background thread while the "
+          "dictionary candidates are aggregated.");
+
 namespace mozc::prediction {
 namespace {
 
@@ -82,6 +89,7 @@ using ::mozc::composer::TypeCorrectedQuery;
 using ::mozc::converter::Attribute;
 using ::mozc::dictionary::DictionaryInterface;
 using ::mozc::dictionary::Token;
+using ::mozc::dictionary::TokenView;
 
 // Note that PREDICTION mode is much slower than SUGGESTION.
 // Number of prediction calls should be minimized.
@@ -122,6 +130,11 @@ bool IsMixedConversionEnabled(const ConversionRequest& request) {
   return request.request().mixed_conversion();
 }
 
+bool IsPartialRequest(const ConversionRequest& request) {
+  return request.request_type() == ConversionRequest::PARTIAL_SUGGESTION ||
+         request.request_type() == ConversionRequest::PARTIAL_PREDICTION;
+}
+
 bool HasHistoryKeyLongerThanOrEqualTo(const ConversionRequest& request,
                                       size_t utf8_len) {
   return Util::CharsLen(request.converter_history_key(1)) >= utf8_len;
@@ -212,22 +225,16 @@ class PredictiveLookupCallback : public DictionaryInterface::Callback {
     return TRAVERSE_CONTINUE;
   }
 
+  bool ShouldDecodeToken(absl::string_view key, absl::string_view actual_key,
+                         const TokenView& token) override {
+    return !IsRestrictedToExactKey(key, token.key, token.lid,
+                                   token.attributes);
+  }
+
   ResultType OnToken(absl::string_view key, absl::string_view actual_key,
                      const Token& token) override {
-    // If the token is from user dictionary and its POS is unknown, it is
-    // suggest-only words.  Such words are looked up only when their keys
-    // exactly match |key|.  Otherwise, unigram suggestion can be annoying.  For
-    // example, suppose a user registers their email address as める.  Then,
-    // we don't want to show the email address from め but exactly from める.
-    //
-    // We also want to show ZIP_CODE entries only for the exact input key.
-    if (((token.attributes & Token::USER_DICTIONARY) != 0 &&
-         token.lid == unknown_id_) ||
-        token.lid == zip_code_id_) {
-      const auto orig_key = absl::ClippedSubstr(key, 0, original_key_len_);
-      if (token.key != orig_key) {
-        return TRAVERSE_CONTINUE;
-      }
+    if (IsRestrictedToExactKey(key, token.key, token.lid, token.attributes)) {
+      return TRAVERSE_CONTINUE;
     }
     if (IsNoisyNumberToken(key, token)) {
       return TRAVERSE_CONTINUE;
@@ -253,6 +260,23 @@ class PredictiveLookupCallback : public DictionaryInterface::Callback {
   std::vector<Result>* results_ = nullptr;
 
  private:
+  // If the token is from user dictionary and its POS is unknown, it is
+  // suggest-only words.  Such words are looked up only when their keys
+  // exactly match |key|.  Otherwise, unigram suggestion can be annoying.  For
+  // example, suppose a user registers their email address as める.  Then,
+  // we don't want to show the email address from め but exactly from める.
+  //
+  // We also want to show ZIP_CODE entries only for the exact input key.
+  bool IsRestrictedToExactKey(absl::string_view key,
+                              absl::string_view token_key, uint16_t lid,
+                              Token::AttributesBitfield attributes) const {
+    if (((attributes & Token::USER_DICTIONARY) != 0 && lid == unknown_id_) ||
+        lid == zip_code_id_) {
+      return token_key != absl::ClippedSubstr(key, 0, original_key_len_);
+    }
+    return false;
+  }
+
   // When the key is number, number token will be noisy if
   // - the key predicts number ("十月[10がつ]" for the key, "1")
   // - the value predicts number ("12時" for the key, "1")
@@ -430,21 +454,19 @@ DictionaryPredictionAggregator::AggregateResultsForMixedConversion(
   }
 
   // Always aggregate realtime results when mixed conversion mode.
-  AggregateRealtime(
-      request, GetRealtimeCandidateMaxSize(request),
-      request.options().use_actual_converter_for_realtime_conversion, &results);
+  // TODO(taku): Removes the dependency to `min_unigram_key_len`.
+  // This variable is only used in this method.
+  int min_unigram_key_len = 0;
+  AggregateRealtimeAndUnigram(request, /*aggregate_realtime=*/true, &results,
+                              &min_unigram_key_len);
 
   // In partial suggestion or prediction, only realtime candidates are used.
-  if (request.request_type() == ConversionRequest::PARTIAL_SUGGESTION ||
-      request.request_type() == ConversionRequest::PARTIAL_PREDICTION) {
+  // The remaining sources are skipped when running out of time.
+  if (IsPartialRequest(request) ||
+      request.options().IsDeadlineExceeded(Clock::GetAbslTime())) {
     return results;
   }
 
-  // TODO(taku): Removes the dependency to `min_unigram_key_len`.
-  // This variable is only used in this method.
-  int min_unigram_key_len = 0;
-  AggregateUnigram(request, &results, &min_unigram_key_len);
-
   if (IsNotExceedingCutoffThreshold(request, results)) {
     AggregateNumber(request, &results);
   }
@@ -489,23 +511,18 @@ std::vector<Result> DictionaryPredictionAggregator::AggregateResultsForDesktop(
     return results;
   }
 
-  if (ShouldAggregateRealTimeConversionResults(request)) {
-    AggregateRealtime(
-        request, GetRealtimeCandidateMaxSize(request),
-        request.options().use_actual_converter_for_realtime_conversion,
-        &results);
-  }
+  int min_unigram_key_len = 0;
+  AggregateRealtimeAndUnigram(request,
+                              ShouldAggregateRealTimeConversionResults(request),
+                              &results, &min_unigram_key_len);
 
   // Desktop mode never sets PARTIAL mode, so we may use DCHECK after the
   // refactoring.
-  if (request.request_type() == ConversionRequest::PARTIAL_SUGGESTION ||
-      request.request_type() == ConversionRequest::PARTIAL_PREDICTION) {
+  if (IsPartialRequest(request) ||
+      request.options().IsDeadlineExceeded(Clock::GetAbslTime())) {
     return results;
   }
 
-  int min_unigram_key_len = 0;
-  AggregateUnigram(request, &results, &min_unigram_key_len);
-
   if (IsNotExceedingCutoffThreshold(request, results)) {
     AggregateNumber(request, &results);
   }
@@ -521,8 +538,12 @@ std::vector<Result> DictionaryPredictionAggregator::AggregateResultsForDesktop(
 std::vector<Result> DictionaryPredictionAggregator::
     AggregateTypingCorrectedResultsForMixedConversion(
         const ConversionRequest& request) const {
+  if (request.options().IsDeadlineExceeded(Clock::GetAbslTime())) {
+    return {};
+  }
   const std::optional<std::vector<TypeCorrectedQuery>> corrected =
-      modules_.GetSupplementalModel().CorrectComposition(request);
+      modules_.GetTypingCorrectionCache().CorrectComposition(
+          modules_.GetSupplementalModel(), request);
   if (!corrected) {
     return {};
   }
@@ -532,6 +553,10 @@ std::vector<Result> DictionaryPredictionAggregator::
   bool number_added = false;
 
   for (const auto& query : corrected.value()) {
+    // The supplemental model may be slow, so the budget is checked again.
+    if (request.options().IsDeadlineExceeded(Clock::GetAbslTime())) {
+      break;
+    }
     absl::string_view key = query.correction;
 
     // Make ConversionRequest that uses conversion_segment(0).key() as typing
@@ -747,6 +772,61 @@ void DictionaryPredictionAggregator::AggregateRealtime(
   absl::c_move(realtime_results, std::back_inserter(*results));
 }
 
+void DictionaryPredictionAggregator::AggregateRealtimeAndUnigram(
+    const ConversionRequest& request, bool aggregate_realtime,
+    std::vector<Result>* results, int* min_unigram_key_len) const {
+  DCHECK(results);
+  DCHECK(min_unigram_key_len);
+  *min_unigram_key_len = 0;
+
+  const bool is_partial = IsPartialRequest(request);
+  // The English decoder of the supplemental model may update the existing
+  // results, so it always sees the realtime results.
+  if (!aggregate_realtime || is_partial || IsLatinInputMode(request) ||
+      !absl::GetFlag(FLAGS_concurrent_prediction_aggregation)) {
+    if (aggregate_realtime) {
+      AggregateRealtime(
+          request, GetRealtimeCandidateMaxSize(request),
+          request.options().use_actual_converter_for_realtime_conversion,
+          results);
+    }
+    if (!is_partial) {
+      AggregateUnigram(request, results, min_unigram_key_len);
+    }
+    return;
+  }
+
+  // The realtime decoding is the most expensive source and independent of the
+  // dictionary lookup, so it runs in the background with its own buffer. The
+  // buffers are merged in the sequential order to keep the output identical.
+  BackgroundFuture<std::vector<Result>> realtime([this, &request] {
+    std::vector<Result> realtime_results;
+    AggregateRealtime(
+        request, GetRealtimeCandidateMaxSize(request),
+        request.options().use_actual_converter_for_realtime_conversion,
+        &realtime_results);
+    return realtime_results;
+  });
+  std::vector<Result> unigram_results;
+  AggregateUnigram(request, &unigram_results, min_unigram_key_len);
+  std::vector<Result> realtime_results = std::move(realtime).Get();
+  absl::c_move(realtime_results, std::back_inserter(*results));
+
+  // The unigram lookup stops and ResultsSizeAdjuster drops its results by the
+  // size of the buffer, which includes the realtime results in the sequential
+  // order. While the merged count stays below the cutoff, none of these
+  // decisions differ. Otherwise, or if the results might have been dropped,
+  // the lookup is done again after the realtime results. It happens only for
+  // keys with too many candidates, which are mostly dropped anyway.
+  if (unigram_results.empty() ||
+      realtime_results.size() + unigram_results.size() >=
+          GetCandidateCutoffThreshold(request.request_type())) {
+    AggregateUnigram(request, results, min_unigram_key_len);
+    return;
+  }
+  absl::c_move(unigram_results, std::back_inserter(*results));
+}
+
 void DictionaryPredictionAggregator::AggregateUnigramForDictionary(
     const ConversionRequest& request, std::vector<Result>* results) const {
   DCHECK(results);
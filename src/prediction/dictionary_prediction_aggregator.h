@@ -134,6 +134,14 @@ class DictionaryPredictionAggregator
                          bool insert_realtime_top_from_actual_converter,
                          std::vector<Result>* results) const;
 
+  // Aggregates the realtime results (if `aggregate_realtime`) followed by the
+  // unigram results. Unigram is skipped for partial requests. With
+  // --concurrent_prediction_aggregation, both sources run concurrently.
+  void AggregateRealtimeAndUnigram(const ConversionRequest& request,
+                                   bool aggregate_realtime,
+                                   std::vector<Result>* results,
+                                   int* min_unigram_key_len) const;
+
   // Aggregate zero query candidates. Current key must be empty.
   void AggregateZeroQuery(const ConversionRequest& request,
                           std::vector<Result>* results) const;
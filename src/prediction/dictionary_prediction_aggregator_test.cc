@@ -39,8 +39,12 @@
 #include <utility>
 #include <vector>
 
+#include "absl/flags/declare.h"
+#include "absl/flags/flag.h"
+#include "absl/flags/reflection.h"
 #include "absl/log/check.h"
 #include "absl/log/log.h"
+#include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
 #include "absl/strings/str_join.h"
 #include "absl/strings/string_view.h"
@@ -74,6 +78,8 @@
 #include "testing/mozctest.h"
 #include "transliteration/transliteration.h"
 
+ABSL_DECLARE_FLAG(bool, concurrent_prediction_aggregation);
+
 namespace mozc {
 namespace prediction {
 
@@ -596,6 +602,91 @@ TEST_F(DictionaryPredictionAggregatorTest,
   EXPECT_TRUE(GetMergedTypes(results) & REALTIME);
 }
 
+TEST_F(DictionaryPredictionAggregatorTest, ConcurrentAggregation) {
+  std::unique_ptr<MockDataAndAggregator> data_and_aggregator =
+      CreateAggregatorWithMockData();
+  const DictionaryPredictionAggregatorTestPeer& aggregator =
+      data_and_aggregator->aggregator();
+
+  config_->set_use_dictionary_suggest(true);
+  config_->set_use_realtime_conversion(true);
+
+  absl::FlagSaver flag_saver;
+  for (const bool mixed_conversion : {false, true}) {
+    request_->set_mixed_conversion(mixed_conversion);
+    const ConversionRequest convreq =
+        CreatePredictionConversionRequest("ぐーぐるあ");
+
+    absl::SetFlag(&FLAGS_concurrent_prediction_aggregation, false);
+    const std::vector<Result> sequential =
+        aggregator.AggregateResultsForTesting(convreq);
+    absl::SetFlag(&FLAGS_concurrent_prediction_aggregation, true);
+    const std::vector<Result> concurrent =
+        aggregator.AggregateResultsForTesting(convreq);
+
+    // Each source fills its own buffer, so the merged order is deterministic.
+    ASSERT_FALSE(sequential.empty());
+    ASSERT_EQ(concurrent.size(), sequential.size());
+    for (size_t i = 0; i < sequential.size(); ++i) {
+      EXPECT_EQ(concurrent[i].key, sequential[i].key);
+      EXPECT_EQ(concurrent[i].value, sequential[i].value);
+      EXPECT_EQ(concurrent[i].attributes, sequential[i].attributes);
+    }
+    EXPECT_TRUE(GetMergedTypes(concurrent) & REALTIME);
+  }
+}
+
+TEST_F(DictionaryPredictionAggregatorTest, ConcurrentAggregationAtCutoff) {
+  std::unique_ptr<MockDataAndAggregator> data_and_aggregator =
+      CreateAggregatorWithMockData();
+  const DictionaryPredictionAggregatorTestPeer& aggregator =
+      data_and_aggregator->aggregator();
+
+  config_->set_use_dictionary_suggest(true);
+  config_->set_use_realtime_conversion(true);
+  request_->set_mixed_conversion(false);
+
+  absl::FlagSaver flag_saver;
+  // The cutoff threshold of SUGGESTION is 256.
+  for (const int num_tokens : {100, 254, 300}) {
+    for (const int num_realtime : {0, 3}) {
+      SCOPED_TRACE(absl::StrCat(num_tokens, " tokens, ", num_realtime,
+                                " realtime results"));
+      std::vector<Token> tokens;
+      for (int i = 0; i < num_tokens; ++i) {
+        tokens.push_back({"よそう", absl::StrCat("予想", i), 100, 1, 1,
+                          Token::NONE});
+      }
+      MockDictionary* mock_dict = data_and_aggregator->mutable_dictionary();
+      EXPECT_CALL(*mock_dict, LookupPredictive(StrEq("よそう"), _, _))
+          .WillRepeatedly(InvokeCallbackWithTokens{tokens});
+      std::vector<Result> realtime_results(num_realtime);
+      for (int i = 0; i < num_realtime; ++i) {
+        realtime_results[i].key = "よそう";
+        realtime_results[i].value = absl::StrCat("余走", i);
+        realtime_results[i].attributes = REALTIME;
+      }
+      EXPECT_CALL(*data_and_aggregator->mutable_realtime_decoder(), Decode(_))
+          .WillRepeatedly(Return(realtime_results));
+
+      const ConversionRequest convreq =
+          CreateSuggestionConversionRequest("よそう");
+      absl::SetFlag(&FLAGS_concurrent_prediction_aggregation, false);
+      const std::vector<Result> sequential =
+          aggregator.AggregateResultsForTesting(convreq);
+      absl::SetFlag(&FLAGS_concurrent_prediction_aggregation, true);
+      const std::vector<Result> concurrent =
+          aggregator.AggregateResultsForTesting(convreq);
+
+      ASSERT_EQ(concurrent.size(), sequential.size());
+      for (size_t i = 0; i < sequential.size(); ++i) {
+        EXPECT_EQ(concurrent[i].value, sequential[i].value);
+        EXPECT_EQ(concurrent[i].attributes, sequential[i].attributes);
+      }
+    }
+  }
+}
+
 TEST_F(DictionaryPredictionAggregatorTest, BigramTest) {
   std::unique_ptr<MockDataAndAggregator> data_and_aggregator =
       CreateAggregatorWithMockData();
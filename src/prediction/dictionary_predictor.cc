@@ -48,6 +48,7 @@
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
 #include "absl/types/span.h"
+#include "base/metrics.h"
 #include "base/util.h"
 #include "base/vlog.h"
 #include "composer/composer.h"
@@ -162,18 +163,23 @@ std::vector<Result> DictionaryPredictor::Predict(
 
   std::vector<Result> results;
 
-  // TODO(taku): Separate DesktopPredictor and MixedDecodingPredictor.
-  if (IsMixedConversionEnabled(request)) {
-    std::vector<Result> literal_results =
-        aggregator_->AggregateResultsForMixedConversion(request);
-    std::vector<Result> tc_results =
-        AggregateTypingCorrectedResultsForMixedConversion(request);
-    absl::c_move(literal_results, std::back_inserter(results));
-    absl::c_move(tc_results, std::back_inserter(results));
-  } else {
-    results = aggregator_->AggregateResultsForDesktop(request);
+  {
+    ScopedLatency latency(
+        MetricsRegistry::GetStage(MetricsRegistry::PREDICTION_AGGREGATION));
+    // TODO(taku): Separate DesktopPredictor and MixedDecodingPredictor.
+    if (IsMixedConversionEnabled(request)) {
+      std::vector<Result> literal_results =
+          aggregator_->AggregateResultsForMixedConversion(request);
+      std::vector<Result> tc_results =
+          AggregateTypingCorrectedResultsForMixedConversion(request);
+      absl::c_move(literal_results, std::back_inserter(results));
+      absl::c_move(tc_results, std::back_inserter(results));
+    } else {
+      results = aggregator_->AggregateResultsForDesktop(request);
+    }
   }
 
+  ScopedLatency latency(MetricsRegistry::GetStage(MetricsRegistry::RANKING));
   RewriteResultsForPrediction(request, absl::MakeSpan(results));
 
   MaybeRescoreResults(request, absl::MakeSpan(results));
@@ -223,10 +229,25 @@ std::vector<Result> DictionaryPredictor::RerankAndFilterResults(
   // Instead of sorting all the results, we construct a heap.
   // This is done in linear time and
   // we can pop as many results as we need efficiently.
-  std::make_heap(results.begin(), results.end(),
-                 [](const Result& lhs, const Result& rhs) {
-                   return ResultCostLess()(rhs, lhs);
-                 });
+  // The heap holds compact (cost, index) pairs so that no Result is moved
+  // until it is selected. Results with the invalid cost are never selected,
+  // so they are dropped here.
+  std::vector<std::pair<int, uint32_t>> ranking;
+  ranking.reserve(results.size());
+  for (uint32_t i = 0; i < results.size(); ++i) {
+    if (results[i].cost < Result::kInvalidCost) {
+      ranking.emplace_back(results[i].cost, i);
+    }
+  }
+  // Breaks ties in the same way as ResultCostLess.
+  const auto greater = [&results](const std::pair<int, uint32_t>& lhs,
+                                  const std::pair<int, uint32_t>& rhs) {
+    if (lhs.first != rhs.first) {
+      return lhs.first > rhs.first;
+    }
+    return ResultCostLess()(results[rhs.second], results[lhs.second]);
+  };
+  std::make_heap(ranking.begin(), ranking.end(), greater);
 
   const size_t max_candidates_size = std::min<size_t>(
       request.options().max_dictionary_prediction_candidates_size,
@@ -247,16 +268,12 @@ std::vector<Result> DictionaryPredictor::RerankAndFilterResults(
   std::shared_ptr<Result> prev_top_result;
   std::vector<Result> final_results;
 
-  for (size_t i = 0; i < results.size(); ++i) {
-    std::pop_heap(results.begin(), results.end() - i,
-                  [](const Result& lhs, const Result& rhs) {
-                    return ResultCostLess()(rhs, lhs);
-                  });
-    Result& result = results[results.size() - i - 1];
-    if (final_results.size() >= max_candidates_size ||
-        result.cost >= Result::kInvalidCost) {
+  for (size_t i = 0; i < ranking.size(); ++i) {
+    if (final_results.size() >= max_candidates_size) {
       break;
     }
+    std::pop_heap(ranking.begin(), ranking.end() - i, greater);
+    Result& result = results[ranking[ranking.size() - i - 1].second];
 
     if (i == 0 && (prev_top_result =
                        MaybeGetPreviousTopResult(result, request)) != nullptr) {
@@ -343,12 +360,10 @@ int DictionaryPredictor::CalculateSingleKanjiCostOffset(
     if (result.attributes & Attribute::PARTIALLY_KEY_CONSUMED) {
       lm_cost += CalculatePrefixPenalty(request, result);
     }
-    const auto it = min_cost_map.find(result.value);
-    if (it == min_cost_map.end()) {
-      min_cost_map[result.value] = lm_cost;
-      continue;
+    const auto [it, inserted] = min_cost_map.try_emplace(result.value, lm_cost);
+    if (!inserted) {
+      it->second = std::min(it->second, lm_cost);
     }
-    min_cost_map[result.value] = std::min(it->second, lm_cost);
   }
 
   // Use the wcost of the highest cost to calculate the single kanji cost
@@ -837,6 +837,43 @@ TEST_F(DictionaryPredictorTest, PredictNCandidates) {
   }
 }
 
+TEST_F(DictionaryPredictorTest, RerankTiesFollowResultCostLess) {
+  auto data_and_predictor = std::make_unique<MockDataAndPredictor>();
+  DictionaryPredictorTestPeer predictor_peer =
+      data_and_predictor->predictor_peer();
+
+  // Only two distinct costs, so the order is mostly decided by the ties.
+  constexpr int kTestSize = 10;
+  std::vector<Result> results(kTestSize);
+  for (size_t i = 0; i < kTestSize; ++i) {
+    Result* result = &results[i];
+    result->key = std::string(1, 'a' + i);
+    result->value = std::string(i % 3 + 1, 'A' + i);
+    result->wcost = i;
+    result->cost = 1000 + i % 2;
+    result->SetTypesAndTokenAttributes(prediction::REALTIME, Token::NONE);
+  }
+  absl::BitGen urbg;
+  std::shuffle(results.begin(), results.end(), urbg);
+
+  std::vector<Result> expected = results;
+  std::sort(expected.begin(), expected.end(), ResultCostLess());
+
+  const ConversionRequest convreq = CreateConversionRequestWithOptions(
+      {
+          .request_type = ConversionRequest::SUGGESTION,
+          .max_dictionary_prediction_candidates_size = kTestSize,
+      },
+      "test");
+
+  results = predictor_peer.RerankAndFilterResults(convreq, results);
+
+  ASSERT_EQ(results.size(), kTestSize);
+  for (size_t i = 0; i < results.size(); ++i) {
+    EXPECT_EQ(results[i].value, expected[i].value);
+  }
+}
+
 TEST_F(DictionaryPredictorTest, SuggestFilteredwordForExactMatchOnMobile) {
   auto data_and_predictor = std::make_unique<MockDataAndPredictor>();
   const DictionaryPredictor& predictor = data_and_predictor->predictor();
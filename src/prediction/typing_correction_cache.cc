@@ -0,0 +1,88 @@
+// Copyright 2010-2021, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "prediction/typing_correction_cache.h"
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "composer/query.h"
+#include "engine/supplemental_model_interface.h"
+#include "request/conversion_request.h"
+
+namespace mozc::prediction {
+namespace {
+
+// Only a few compositions are alive at the same time, so a small number of
+// shards is enough to avoid contention.
+constexpr size_t kNumShards = 4;
+
+}  // namespace
+
+TypingCorrectionCache::TypingCorrectionCache(size_t capacity)
+    : cache_(capacity, kNumShards) {}
+
+std::optional<std::vector<composer::TypeCorrectedQuery>>
+TypingCorrectionCache::CorrectComposition(
+    const engine::SupplementalModelInterface& model,
+    const ConversionRequest& request) {
+  const std::string key = MakeCacheKey(request);
+  if (std::optional<std::vector<composer::TypeCorrectedQuery>> cached =
+          cache_.Lookup(key);
+      cached.has_value()) {
+    hits_.fetch_add(1, std::memory_order_relaxed);
+    return cached;
+  }
+  misses_.fetch_add(1, std::memory_order_relaxed);
+  std::optional<std::vector<composer::TypeCorrectedQuery>> corrected =
+      model.CorrectComposition(request);
+  if (corrected.has_value()) {
+    cache_.Insert(key, *corrected);
+  }
+  return corrected;
+}
+
+void TypingCorrectionCache::Clear() { cache_.Clear(); }
+
+// static
+std::string TypingCorrectionCache::MakeCacheKey(
+    const ConversionRequest& request) {
+  // The spellchecker reads the raw input as well as the composition, and the
+  // left context may change the corrections.
+  return absl::StrCat(static_cast<int>(request.request_type()), "\t",
+                      request.composer().GetStringForTypeCorrection(), "\t",
+                      request.composer().GetRawString(), "\t", request.key(),
+                      "\t", request.converter_history_value());
+}
+
+}  // namespace mozc::prediction
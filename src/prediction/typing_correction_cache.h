@@ -0,0 +1,93 @@
+// Copyright 2010-2021, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef MOZC_PREDICTION_TYPING_CORRECTION_CACHE_H_
+#define MOZC_PREDICTION_TYPING_CORRECTION_CACHE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "composer/query.h"
+#include "engine/supplemental_model_interface.h"
+#include "request/conversion_request.h"
+#include "storage/sharded_lru_cache.h"
+
+namespace mozc::prediction {
+
+// Memoizes SupplementalModelInterface::CorrectComposition().
+//
+// The composition spellchecker is invoked by both the user history predictor
+// and the dictionary predictor for the same keystroke, and the same
+// compositions reappear while the user deletes and retypes the tail of the
+// preedit. The cache is keyed by the composition and its left context, so
+// each distinct composition is corrected only once. The model cannot resume
+// from a previous hypothesis, so a new keystroke is still a cache miss.
+//
+// The cache is thread safe. It must be cleared when the supplemental model is
+// reloaded, since cached corrections are tied to the model that made them.
+class TypingCorrectionCache {
+ public:
+  static constexpr size_t kDefaultCapacity = 64;
+
+  explicit TypingCorrectionCache(size_t capacity = kDefaultCapacity);
+
+  TypingCorrectionCache(const TypingCorrectionCache&) = delete;
+  TypingCorrectionCache& operator=(const TypingCorrectionCache&) = delete;
+
+  // Returns the cached corrections for `request`, or calls
+  // `model.CorrectComposition(request)` and caches its result. std::nullopt,
+  // meaning that the spellchecker is not available yet, is never cached.
+  std::optional<std::vector<composer::TypeCorrectedQuery>> CorrectComposition(
+      const engine::SupplementalModelInterface& model,
+      const ConversionRequest& request);
+
+  // Removes all the cached corrections.
+  void Clear();
+
+  size_t Size() const { return cache_.Size(); }
+  uint64_t hits() const { return hits_.load(std::memory_order_relaxed); }
+  uint64_t misses() const { return misses_.load(std::memory_order_relaxed); }
+
+ private:
+  static std::string MakeCacheKey(const ConversionRequest& request);
+
+  storage::ShardedLruCache<std::string,
+                           std::vector<composer::TypeCorrectedQuery>>
+      cache_;
+  std::atomic<uint64_t> hits_ = 0;
+  std::atomic<uint64_t> misses_ = 0;
+};
+
+}  // namespace mozc::prediction
+
+#endif  // MOZC_PREDICTION_TYPING_CORRECTION_CACHE_H_
@@ -0,0 +1,113 @@
+// Copyright 2010-2021, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "prediction/typing_correction_cache.h"
+
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "composer/composer.h"
+#include "composer/query.h"
+#include "engine/supplemental_model_mock.h"
+#include "request/conversion_request.h"
+#include "testing/gmock.h"
+#include "testing/gunit.h"
+
+namespace mozc::prediction {
+namespace {
+
+using ::mozc::composer::TypeCorrectedQuery;
+using ::testing::_;
+using ::testing::Return;
+
+ConversionRequest MakeRequest(const composer::Composer& composer) {
+  return ConversionRequestBuilder()
+      .SetComposer(composer)
+      .SetOptions({.request_type = ConversionRequest::SUGGESTION})
+      .Build();
+}
+
+TEST(TypingCorrectionCacheTest, CorrectComposition) {
+  engine::MockSupplementalModel model;
+  TypingCorrectionCache cache;
+
+  const std::vector<TypeCorrectedQuery> corrected = {
+      {"がっこう", TypeCorrectedQuery::CORRECTION, 1.0},
+  };
+  EXPECT_CALL(model, CorrectComposition(_))
+      .Times(2)
+      .WillRepeatedly(Return(corrected));
+
+  composer::Composer composer;
+  composer.SetPreeditTextForTestOnly("かつこう");
+  // The second lookup of the same composition doesn't call the model.
+  for (int i = 0; i < 2; ++i) {
+    const std::optional<std::vector<TypeCorrectedQuery>> result =
+        cache.CorrectComposition(model, MakeRequest(composer));
+    ASSERT_TRUE(result.has_value());
+    ASSERT_EQ(result->size(), 1);
+    EXPECT_EQ((*result)[0].correction, "がっこう");
+  }
+  EXPECT_EQ(cache.hits(), 1);
+  EXPECT_EQ(cache.misses(), 1);
+
+  // Another composition is corrected separately.
+  composer.SetPreeditTextForTestOnly("かつこ");
+  EXPECT_TRUE(cache.CorrectComposition(model, MakeRequest(composer)));
+  EXPECT_EQ(cache.misses(), 2);
+  EXPECT_EQ(cache.Size(), 2);
+
+  cache.Clear();
+  EXPECT_EQ(cache.Size(), 0);
+}
+
+TEST(TypingCorrectionCacheTest, UnavailableModelIsNotCached) {
+  engine::MockSupplementalModel model;
+  TypingCorrectionCache cache;
+
+  composer::Composer composer;
+  composer.SetPreeditTextForTestOnly("かつこう");
+  EXPECT_CALL(model, CorrectComposition(_)).WillOnce(Return(std::nullopt));
+  EXPECT_EQ(cache.CorrectComposition(model, MakeRequest(composer)),
+            std::nullopt);
+  EXPECT_EQ(cache.Size(), 0);
+
+  // The model is consulted again once it becomes available.
+  EXPECT_CALL(model, CorrectComposition(_))
+      .WillOnce(Return(std::vector<TypeCorrectedQuery>()));
+  const std::optional<std::vector<TypeCorrectedQuery>> result =
+      cache.CorrectComposition(model, MakeRequest(composer));
+  ASSERT_TRUE(result.has_value());
+  EXPECT_TRUE(result->empty());
+  EXPECT_EQ(cache.Size(), 1);
+}
+
+}  // namespace
+}  // namespace mozc::prediction
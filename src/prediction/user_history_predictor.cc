@@ -536,6 +536,10 @@ bool UserHistoryPredictor::ClearHistoryEntry(absl::string_view key,
   key = maybe_normalize_prefix_space(key, normalized_key);
   value = maybe_normalize_prefix_space(value, normalized_value);
 
+  // The entries being loaded are not visible until the loading finishes.
+  // Waits for it so that the deleted entry doesn't come back.
+  storage_.Wait();
+
   {
     // Finds the history entry that has the exactly same key and value and has
     // not been removed yet. If exists, remove it.
@@ -640,8 +644,9 @@ std::vector<TypeCorrectedQuery> UserHistoryPredictor::GetTypingCorrectedQueries(
                        .typing_correction_apply_user_history_size();
   if (size == 0 || !request.config().use_typing_correction()) return {};
 
-  const std::optional<std::vector<TypeCorrectedQuery>> corrected =
-      modules_.GetSupplementalModel().CorrectComposition(request);
+  std::optional<std::vector<TypeCorrectedQuery>> corrected =
+      modules_.GetTypingCorrectionCache().CorrectComposition(
+          modules_.GetSupplementalModel(), request);
   if (!corrected) return {};
 
   std::vector<TypeCorrectedQuery> result = std::move(corrected.value());
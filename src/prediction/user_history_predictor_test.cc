@@ -5051,6 +5051,8 @@ TEST_F(UserHistoryPredictorTest, TypingCorrection) {
   EXPECT_EQ(results[2].value, "学校");
 
   ::testing::Mock::VerifyAndClearExpectations(mock_ptr);
+  // Drops the corrections cached for "かつこ" as if the model was reloaded.
+  modules->GetTypingCorrectionCache().Clear();
   const ConversionRequest convreq6 =
       SetUpInputForSuggestion("かつこ", &composer_, &segments_proxy);
   results = predictor->Predict(convreq6);
@@ -33,13 +33,16 @@
 #include <atomic>
 #include <cstddef>
 #include <cstdint>
+#include <iterator>
 #include <memory>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "absl/algorithm/container.h"
 #include "absl/base/nullability.h"
 #include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
 #include "absl/functional/function_ref.h"
 #include "absl/log/check.h"
 #include "absl/log/log.h"
@@ -105,7 +108,8 @@ bool UserHistoryStorage::IsSyncerRunning() const {
 
 bool UserHistoryStorage::IsSyncerInCriticalSection() const {
   // syncer is running, and mutex is owned by syncer thread.
-  return !mutex_.owns_lock() && task_manager_.IsRunning();
+  return !mutex_.owns_lock() && task_manager_.IsRunning() &&
+         in_critical_section_.load(std::memory_order_relaxed);
 }
 
 void UserHistoryStorage::AsyncSave() {
@@ -123,6 +127,10 @@ void UserHistoryStorage::AsyncLoad() {
 void UserHistoryStorage::Clear() {
   auto lock = AcquireUniqueLock();
   dic_ = std::make_unique<DicCache>(kLruCacheSize);
+  if (loading_) {
+    // The entries being loaded must not come back.
+    cleared_while_loading_ = true;
+  }
   needs_sync_ = true;
   Save();
 }
@@ -148,20 +156,42 @@ bool UserHistoryStorage::Load() {
 }
 
 bool UserHistoryStorage::Load(user_history_predictor::UserHistory&& proto) {
+  StartLoading();
+
+  // Lookups and insertions are not blocked while building the cache.
+  std::unique_ptr<DicCache> dic = BuildDicCache(std::move(proto));
+  if (dic == nullptr) {
+    auto lock = AcquireUniqueLock();
+    loading_ = false;
+    erased_while_loading_.clear();
+    // Don't overwrite the file with the entries inserted while loading.
+    needs_sync_ = false;
+    return false;
+  }
+  SwapDicCache(std::move(dic));
+  return true;
+}
+
+void UserHistoryStorage::StartLoading() {
   // Enters syncer's critical section.
   auto lock = AcquireUniqueLock();
-
   dic_->Clear();
-
   // 1) After loading `dic_` no need to sync.
   // 2) When AsyncLoad is canceled, `dic_` has incomplete data,
   //    so must not be synced.
   needs_sync_ = false;
+  loading_ = true;
+  cleared_while_loading_ = false;
+  erased_while_loading_.clear();
+}
 
+std::unique_ptr<UserHistoryStorage::DicCache> UserHistoryStorage::BuildDicCache(
+    user_history_predictor::UserHistory&& proto) const {
+  auto dic = std::make_unique<DicCache>(kLruCacheSize);
   for (Entry& entry : *proto.mutable_entries()) {
     if (canceled_) {
       LOG(ERROR) << "Loading thread is canceled";
-      return false;
+      return nullptr;
     }
 
     if (entry.value().empty() || entry.key().empty()) {
@@ -181,10 +211,40 @@ bool UserHistoryStorage::Load(user_history_predictor::UserHistory&& proto) {
     // Avoid std::move() is called before Fingerprint.
 
     const uint64_t fp = Fingerprint(entry);
-    dic_->Insert(fp, std::move(entry));
+    dic->Insert(fp, std::move(entry));
   }
+  return dic;
+}
 
-  return true;
+void UserHistoryStorage::SwapDicCache(std::unique_ptr<DicCache> dic) {
+  // Enters syncer's critical section.
+  auto lock = AcquireUniqueLock();
+  CriticalSection critical_section(in_critical_section_);
+
+  const bool cleared = cleared_while_loading_;
+  loading_ = false;
+  cleared_while_loading_ = false;
+  if (cleared) {
+    // `dic_` only has the entries inserted after Clear().
+    erased_while_loading_.clear();
+    return;
+  }
+  for (const uint64_t fp : erased_while_loading_) {
+    dic->Erase(fp);
+  }
+  erased_while_loading_.clear();
+
+  // Entries inserted while loading are newer than the loaded ones. Moves them
+  // to the new cache from the least recently used one.
+  std::vector<DicElement*> inserted;
+  inserted.reserve(dic_->Size());
+  for (DicElement& elm : *dic_) {
+    inserted.push_back(&elm);
+  }
+  for (auto it = inserted.rbegin(); it != inserted.rend(); ++it) {
+    dic->Insert((*it)->key, std::move((*it)->value));
+  }
+  dic_ = std::move(dic);
 }
 
 bool UserHistoryStorage::Save() {
@@ -196,6 +256,7 @@ bool UserHistoryStorage::Save() {
   {
     // Enters syncer's critical section.
     auto lock = AcquireUniqueLock();
+    CriticalSection critical_section(in_critical_section_);
 
     proto.mutable_entries()->Reserve(dic_->Size());
 
@@ -298,9 +359,11 @@ UserHistoryStorage::ConstEntrySnapshot UserHistoryStorage::Head() const {
 
 UserHistoryStorage::ConstEntrySnapshot UserHistoryStorage::HeadNext() const {
   auto lock = AcquireUniqueLock();
-  const DicElement* elm = dic_->Head();
-  return ConstEntrySnapshot((elm && elm->next) ? &elm->next->value : nullptr,
-                            std::move(lock));
+  if (dic_->Size() < 2) {
+    return ConstEntrySnapshot(nullptr, std::move(lock));
+  }
+  const DicElement& elm = *std::next(std::as_const(*dic_).begin());
+  return ConstEntrySnapshot(&elm.value, std::move(lock));
 }
 
 UserHistoryStorage::ConstEntrySnapshot UserHistoryStorage::NullEntry() const {
@@ -334,6 +397,10 @@ void UserHistoryStorage::Erase(absl::Span<const uint64_t> fps) const {
 
   for (const uint64_t fp : fps) {
     dic_->Erase(fp);
+    if (loading_) {
+      // The entry may be in the cache being loaded.
+      erased_while_loading_.insert(fp);
+    }
   }
 }
 
@@ -41,6 +41,7 @@
 #include <vector>
 
 #include "absl/base/nullability.h"
+#include "absl/container/flat_hash_set.h"
 #include "absl/functional/function_ref.h"
 #include "absl/strings/string_view.h"
 #include "absl/synchronization/mutex.h"
@@ -243,9 +244,46 @@ class UserHistoryStorage {
   using DicCache = storage::LruCache<uint64_t, Entry>;
   using DicElement = DicCache::Element;
 
+  // Clears `dic_` and starts tracking Clear() and Erase() until the loaded
+  // cache is swapped in.
+  void StartLoading();
+
+  // Validates the entries of `proto` and builds a new cache without
+  // acquiring the lock. Returns nullptr when the loading is canceled.
+  std::unique_ptr<DicCache> BuildDicCache(
+      user_history_predictor::UserHistory&& proto) const;
+
+  // Replaces `dic_` with `dic`. The entries inserted into `dic_` after the
+  // loading started are moved on top of `dic` as the most recent ones. The
+  // entries erased meanwhile are removed from `dic`, and `dic` is discarded
+  // if the storage was cleared.
+  void SwapDicCache(std::unique_ptr<DicCache> dic);
+
+  // Marks the scope where the syncer holds `mutex_` for a whole pass over
+  // the entries.
+  class CriticalSection {
+   public:
+    explicit CriticalSection(std::atomic<bool>& flag) : flag_(flag) {
+      flag_.store(true, std::memory_order_relaxed);
+    }
+    ~CriticalSection() { flag_.store(false, std::memory_order_relaxed); }
+
+   private:
+    std::atomic<bool>& flag_;
+  };
+
+  // Sets true while the syncer is in its critical section.
+  std::atomic<bool> in_critical_section_ = false;
+
   // Sets true if the internal data must be synced.
   mutable std::atomic<bool> needs_sync_ = false;
 
+  // Clear() and Erase() called while the entries are loaded without the lock.
+  // Guarded by `mutex_`.
+  bool loading_ = false;
+  bool cleared_while_loading_ = false;
+  mutable absl::flat_hash_set<uint64_t> erased_while_loading_;
+
   // Sets true to cancel the syncer threads.
   std::atomic<bool> canceled_ = false;
 
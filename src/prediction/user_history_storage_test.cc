@@ -47,6 +47,8 @@
 
 namespace mozc::prediction {
 
+using ::testing::ElementsAre;
+
 using Entry = UserHistoryStorage::Entry;
 
 Entry MakeEntry(int i) {
@@ -61,6 +63,12 @@ class UserHistoryStorageTest : public testing::TestWithTempUserProfile {};
 class UserHistoryStorageTestPeer
     : public testing::TestPeer<UserHistoryStorage> {
  public:
+  explicit UserHistoryStorageTestPeer(UserHistoryStorage& storage)
+      : testing::TestPeer<UserHistoryStorage>(storage) {}
+
+  PEER_METHOD(StartLoading);
+  PEER_METHOD(BuildDicCache);
+  PEER_METHOD(SwapDicCache);
   PEER_STATIC_METHOD(FingerprintDepereated);
   PEER_STATIC_METHOD(MigrateNextEntries);
 };
@@ -354,6 +362,106 @@ TEST_F(UserHistoryStorageTest, CancelTest) {
   check_serialized_data();
 }
 
+TEST_F(UserHistoryStorageTest, InsertWhileLoadingTest) {
+  const TempFile file = testing::MakeTempFileOrDie();
+  UserHistoryStorage storage(file.path());
+  storage.Wait();
+
+  user_history_predictor::UserHistory proto;
+  for (int i = 0; i < 5; ++i) {
+    *proto.add_entries() = MakeEntry(i);
+  }
+
+  // Inserts entries between building the cache and swapping it in, as the
+  // predictor does while the syncer loads the file.
+  UserHistoryStorageTestPeer peer(storage);
+  peer.StartLoading();
+  auto dic = peer.BuildDicCache(std::move(proto));
+  ASSERT_NE(dic, nullptr);
+  storage.Insert(MakeEntry(100));
+  storage.Insert(MakeEntry(2));  // Also in the loaded entries.
+  storage.Insert(MakeEntry(101));
+  peer.SwapDicCache(std::move(dic));
+
+  // The inserted entries survive and stay on top in MRU order.
+  std::vector<std::string> keys;
+  storage.ForEach([&keys](uint64_t fp, const Entry& entry) {
+    keys.push_back(entry.key());
+    return true;
+  });
+  EXPECT_THAT(keys, ElementsAre("key101", "key2", "key100", "key4", "key3",
+                                "key1", "key0"));
+}
+
+TEST_F(UserHistoryStorageTest, EraseWhileLoadingTest) {
+  const TempFile file = testing::MakeTempFileOrDie();
+  UserHistoryStorage storage(file.path());
+  storage.Wait();
+
+  constexpr int kSize = 5000;
+  user_history_predictor::UserHistory proto;
+  for (int i = 0; i < kSize; ++i) {
+    *proto.add_entries() = MakeEntry(i);
+  }
+
+  UserHistoryStorageTestPeer peer(storage);
+  peer.StartLoading();
+  const uint64_t erased_fp = UserHistoryStorage::Fingerprint(MakeEntry(10));
+  const uint64_t reinserted_fp = UserHistoryStorage::Fingerprint(MakeEntry(20));
+  Thread thread([&] {
+    storage.Erase({erased_fp, reinserted_fp});
+    storage.Insert(MakeEntry(20));
+  });
+  auto dic = peer.BuildDicCache(std::move(proto));
+  thread.Join();
+  ASSERT_NE(dic, nullptr);
+  peer.SwapDicCache(std::move(dic));
+
+  // The erased entry doesn't come back from the loaded ones.
+  EXPECT_FALSE(storage.Contains(erased_fp));
+  EXPECT_TRUE(storage.Contains(reinserted_fp));
+  EXPECT_TRUE(storage.Contains(MakeEntry(0)));
+  EXPECT_EQ(storage.Head()->key(), "key20");
+}
+
+TEST_F(UserHistoryStorageTest, ClearWhileLoadingTest) {
+  const TempFile file = testing::MakeTempFileOrDie();
+  UserHistoryStorage storage(file.path());
+  storage.Wait();
+
+  constexpr int kSize = 5000;
+  user_history_predictor::UserHistory proto;
+  for (int i = 0; i < kSize; ++i) {
+    *proto.add_entries() = MakeEntry(i);
+  }
+
+  UserHistoryStorageTestPeer peer(storage);
+  peer.StartLoading();
+  Thread thread([&] {
+    storage.Clear();
+    storage.Insert(MakeEntry(kSize));
+  });
+  auto dic = peer.BuildDicCache(std::move(proto));
+  thread.Join();
+  ASSERT_NE(dic, nullptr);
+  peer.SwapDicCache(std::move(dic));
+
+  // None of the loaded entries come back after Clear().
+  std::vector<std::string> keys;
+  storage.ForEach([&keys](uint64_t fp, const Entry& entry) {
+    keys.push_back(entry.key());
+    return true;
+  });
+  EXPECT_THAT(keys, ElementsAre(absl::StrCat("key", kSize)));
+
+  // Nor from the file.
+  storage.Save();
+  UserHistoryStorage reloaded(file.path());
+  reloaded.Wait();
+  EXPECT_FALSE(reloaded.Contains(MakeEntry(0)));
+  EXPECT_TRUE(reloaded.Contains(MakeEntry(kSize)));
+}
+
 TEST_F(UserHistoryStorageTest, MigrateNextEntriesTest) {
   mozc::user_history_predictor::UserHistory proto;
 
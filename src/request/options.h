@@ -35,6 +35,8 @@
 #include <ostream>
 #include <type_traits>
 
+#include "absl/time/time.h"
+
 namespace mozc {
 
 inline constexpr size_t kMaxConversionCandidatesSize = 200;
@@ -69,7 +71,7 @@ enum ComposerKeySelection {
 };
 
 // Options must be trivially copyable to get hash value directly.
-// Since it is small (~40 bytes), passing and returning by value is preferred
+// Since it is small (~56 bytes), passing and returning by value is preferred
 // to avoid reference lifetime issues.
 struct ConversionOptions {
   RequestType request_type = RequestType::CONVERSION;
@@ -142,6 +144,22 @@ struct ConversionOptions {
 
   // This conversion request is called by predictor for realtime conversion.
   bool used_in_predictor_realtime_conversion = false;
+
+  // If true, only the first segment of a conversion gets the full candidate
+  // list. The other segments get their top candidates only and are marked
+  // with Segment::has_more_candidates(). Populated from
+  // Request.lazy_conversion_candidates.
+  bool lazy_candidate_expansion = false;
+
+  // The converter, the rewriters and the predictor return the best-so-far
+  // results once this time has passed. Populated from
+  // Request.conversion_time_budget_msec.
+  absl::Time deadline = absl::InfiniteFuture();
+
+  // Returns true if `deadline` has passed at `now`. Callers are expected to
+  // give up the remaining work once this returns true. The overrun is
+  // recorded once per request by EngineConverter.
+  bool IsDeadlineExceeded(absl::Time now) const { return now >= deadline; }
 };
 
 static_assert(std::is_trivially_copyable<ConversionOptions>::value,
@@ -37,6 +37,7 @@
 #include <vector>
 
 #include "absl/log/check.h"
+#include "base/clock.h"
 #include "converter/segments.h"
 #include "protocol/commands.pb.h"
 #include "protocol/config.pb.h"
@@ -96,10 +97,26 @@ class MergerRewriter : public RewriterInterface {
       }
     }();
 
+    // Once the deadline has passed, the remaining rewriters run with
+    // `skip_slow_rewriters` instead of being skipped, as the later ones (e.g.
+    // EnvironmentalFilterRewriter) are necessary for correctness.
+    std::optional<ConversionRequest> degraded_request;
     bool is_updated = false;
     for (const std::unique_ptr<RewriterInterface>& rewriter : rewriters_) {
-      if (rewriter->capability(request) & capability_type) {
-        is_updated |= rewriter->Rewrite(request, segments);
+      if (!degraded_request.has_value() &&
+          !request.options().skip_slow_rewriters &&
+          request.options().IsDeadlineExceeded(Clock::GetAbslTime())) {
+        ConversionRequest::Options options = request.options();
+        options.skip_slow_rewriters = true;
+        degraded_request.emplace(ConversionRequestBuilder()
+                                     .SetConversionRequestView(request)
+                                     .SetOptions(std::move(options))
+                                     .Build());
+      }
+      const ConversionRequest& current_request =
+          degraded_request.has_value() ? *degraded_request : request;
+      if (rewriter->capability(current_request) & capability_type) {
+        is_updated |= rewriter->Rewrite(current_request, segments);
       }
     }
 
@@ -32,8 +32,11 @@
 #include <cstddef>
 #include <memory>
 #include <string>
+#include <utility>
 
 #include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+#include "base/metrics.h"
 #include "converter/segments.h"
 #include "protocol/commands.pb.h"
 #include "protocol/config.pb.h"
@@ -109,6 +112,21 @@ class TestRewriter : public RewriterInterface {
   int capability_;
 };
 
+// Records whether each call is made with `skip_slow_rewriters`.
+class SkipSlowRewritersRecorder : public RewriterInterface {
+ public:
+  explicit SkipSlowRewritersRecorder(std::string* buffer) : buffer_(buffer) {}
+
+  bool Rewrite(const ConversionRequest& request,
+               Segments* segments) const override {
+    buffer_->append(request.options().skip_slow_rewriters ? "skip;" : "full;");
+    return false;
+  }
+
+ private:
+  std::string* buffer_;
+};
+
 class MergerRewriterTest : public testing::TestWithTempUserProfile {};
 
 ConversionRequest ConvReq(ConversionRequest::RequestType request_type) {
@@ -139,6 +157,35 @@ TEST_F(MergerRewriterTest, Rewrite) {
             "d.Rewrite();");
 }
 
+TEST_F(MergerRewriterTest, RewriteAfterDeadline) {
+  std::string call_result;
+  MergerRewriter merger;
+  Segments segments;
+  merger.AddRewriter(std::make_unique<SkipSlowRewritersRecorder>(&call_result));
+  merger.AddRewriter(std::make_unique<SkipSlowRewritersRecorder>(&call_result));
+
+  {
+    const ConversionRequest request;
+    merger.Rewrite(request, &segments);
+    EXPECT_EQ(call_result, "full;full;");
+  }
+  {
+    // The remaining rewriters still run, but without the slow ones.
+    MetricsRegistry::Reset();
+    ConversionRequest::Options options;
+    options.deadline = absl::UnixEpoch();
+    const ConversionRequest request =
+        ConversionRequestBuilder().SetOptions(std::move(options)).Build();
+    call_result.clear();
+    merger.Rewrite(request, &segments);
+    EXPECT_EQ(call_result, "skip;skip;");
+    // The overrun is recorded by the caller, not by the rewriters.
+    EXPECT_EQ(
+        MetricsRegistry::GetStage(MetricsRegistry::DEADLINE_EXCEEDED).count(),
+        0);
+  }
+}
+
 TEST_F(MergerRewriterTest, RewriteSuggestion) {
   std::string call_result;
   MergerRewriter merger;
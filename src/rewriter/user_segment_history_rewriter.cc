@@ -44,7 +44,6 @@
 #include "absl/log/log.h"
 #include "absl/status/status.h"
 #include "absl/strings/str_cat.h"
-#include "absl/strings/str_join.h"
 #include "absl/strings/string_view.h"
 #include "absl/types/span.h"
 #include "base/config_file_stream.h"
@@ -146,160 +145,10 @@ inline int GetDefaultCandidateIndex(const Segment& segment) {
   return 0;
 }
 
-template <typename... Strings>
-std::string StrJoinWithTabs(const Strings&... strings) {
-  // Make sure we use the string_view overload so the buffer is preallocated.
-  return absl::StrJoin({static_cast<absl::string_view>(strings)...}, "\t");
-}
-
-class FeatureKey {
- public:
-  FeatureKey(const Segments& segments, const PosMatcher& pos_matcher,
-             size_t index)
-      : segments_(segments), pos_matcher_(pos_matcher), index_(index) {}
-
-  std::string LeftRight(absl::string_view base_key,
-                        absl::string_view base_value) const;
-  std::string LeftLeft(absl::string_view base_key,
-                       absl::string_view base_value) const;
-  std::string RightRight(absl::string_view base_key,
-                         absl::string_view base_value) const;
-  std::string Left(absl::string_view base_key,
-                   absl::string_view base_value) const;
-  std::string Right(absl::string_view base_key,
-                    absl::string_view base_value) const;
-  std::string Current(absl::string_view base_key,
-                      absl::string_view base_value) const;
-  std::string Single(absl::string_view base_key,
-                     absl::string_view base_value) const;
-  std::string LeftNumber(absl::string_view base_key,
-                         absl::string_view base_value) const;
-  std::string RightNumber(absl::string_view base_key,
-                          absl::string_view base_value) const;
-
-  static std::string Number(uint16_t type);
-
- private:
-  const Segments& segments_;
-  const PosMatcher& pos_matcher_;
-  const size_t index_;
-};
-
-// Feature "Left Right"
-std::string FeatureKey::LeftRight(absl::string_view base_key,
-                                  absl::string_view base_value) const {
-  if (index_ + 1 >= segments_.segments_size() || index_ <= 0) {
-    return "";
-  }
-  const int j1 = GetDefaultCandidateIndex(segments_.segment(index_ - 1));
-  const int j2 = GetDefaultCandidateIndex(segments_.segment(index_ + 1));
-  return StrJoinWithTabs(
-      "LR", base_key, segments_.segment(index_ - 1).candidate(j1).value,
-      base_value, segments_.segment(index_ + 1).candidate(j2).value);
-}
-
-// Feature "Left Left"
-std::string FeatureKey::LeftLeft(absl::string_view base_key,
-                                 absl::string_view base_value) const {
-  if (index_ < 2) {
-    return "";
-  }
-  const int j1 = GetDefaultCandidateIndex(segments_.segment(index_ - 2));
-  const int j2 = GetDefaultCandidateIndex(segments_.segment(index_ - 1));
-  return StrJoinWithTabs(
-      "LL", base_key, segments_.segment(index_ - 2).candidate(j1).value,
-      segments_.segment(index_ - 1).candidate(j2).value, base_value);
-}
-
-// Feature "Right Right"
-std::string FeatureKey::RightRight(absl::string_view base_key,
-                                   absl::string_view base_value) const {
-  if (index_ + 2 >= segments_.segments_size()) {
-    return "";
-  }
-  const int j1 = GetDefaultCandidateIndex(segments_.segment(index_ + 1));
-  const int j2 = GetDefaultCandidateIndex(segments_.segment(index_ + 2));
-  return StrJoinWithTabs("RR", base_key, base_value,
-                         segments_.segment(index_ + 1).candidate(j1).value,
-                         segments_.segment(index_ + 2).candidate(j2).value);
-}
-
-// Feature "Left"
-std::string FeatureKey::Left(absl::string_view base_key,
-                             absl::string_view base_value) const {
-  if (index_ < 1) {
-    return "";
-  }
-  const int j = GetDefaultCandidateIndex(segments_.segment(index_ - 1));
-  return StrJoinWithTabs("L", base_key,
-                         segments_.segment(index_ - 1).candidate(j).value,
-                         base_value);
-}
-
-// Feature "Right"
-std::string FeatureKey::Right(absl::string_view base_key,
-                              absl::string_view base_value) const {
-  if (index_ + 1 >= segments_.segments_size()) {
-    return "";
-  }
-  const int j = GetDefaultCandidateIndex(segments_.segment(index_ + 1));
-  return StrJoinWithTabs("R", base_key, base_value,
-                         segments_.segment(index_ + 1).candidate(j).value);
-}
-
-// Feature "Current"
-std::string FeatureKey::Current(absl::string_view base_key,
-                                absl::string_view base_value) const {
-  return StrJoinWithTabs("C", base_key, base_value);
-}
-
-// Feature "Single"
-std::string FeatureKey::Single(absl::string_view base_key,
-                               absl::string_view base_value) const {
-  if (segments_.conversion_segments_size() != 1) {
-    return "";
-  }
-  return StrJoinWithTabs("S", base_key, base_value);
-}
-
-// Feature "Left Number"
-std::string FeatureKey::LeftNumber(absl::string_view base_key,
-                                   absl::string_view base_value) const {
-  if (index_ < 1) {
-    return "";
-  }
-  const int j = GetDefaultCandidateIndex(segments_.segment(index_ - 1));
-  const converter::Candidate& candidate =
-      segments_.segment(index_ - 1).candidate(j);
-  if (pos_matcher_.IsNumber(candidate.rid) ||
-      pos_matcher_.IsKanjiNumber(candidate.rid) ||
-      Util::GetScriptType(candidate.value) == Util::NUMBER) {
-    return StrJoinWithTabs("LN", base_key, base_value);
-  }
-  return "";
-}
-
-// Feature "Right Number"
-std::string FeatureKey::RightNumber(absl::string_view base_key,
-                                    absl::string_view base_value) const {
-  if (index_ + 1 >= segments_.segments_size()) {
-    return "";
-  }
-  const int j = GetDefaultCandidateIndex(segments_.segment(index_ + 1));
-  const converter::Candidate& candidate =
-      segments_.segment(index_ + 1).candidate(j);
-  if (pos_matcher_.IsNumber(candidate.lid) ||
-      pos_matcher_.IsKanjiNumber(candidate.lid) ||
-      Util::GetScriptType(candidate.value) == Util::NUMBER) {
-    return StrJoinWithTabs("RN", base_key, base_value);
-  }
-  return "";
-}
-
-// Feature "Number"
-// used for number rewrite
-std::string FeatureKey::Number(uint16_t type) {
-  return StrJoinWithTabs("N", absl::StrCat(type));
+bool IsNumberCandidate(const PosMatcher& pos_matcher, uint16_t pos_id,
+                       const converter::Candidate& candidate) {
+  return pos_matcher.IsNumber(pos_id) || pos_matcher.IsKanjiNumber(pos_id) ||
+         Util::GetScriptType(candidate.value) == Util::NUMBER;
 }
 
 bool IsNumberSegment(const Segment& segment) {
@@ -405,6 +254,234 @@ bool IsT13NCandidate(const converter::Candidate& cand) {
 
 }  // namespace
 
+// Builds the feature keys of the candidates of a segment. The default
+// candidates of the neighboring segments are resolved once per segment.
+class UserSegmentHistoryRewriter::FeatureKey {
+ public:
+  enum Type {
+    LEFT_RIGHT,
+    LEFT_LEFT,
+    RIGHT_RIGHT,
+    LEFT,
+    RIGHT,
+    CURRENT,
+    SINGLE,
+    LEFT_NUMBER,
+    RIGHT_NUMBER,
+  };
+
+  FeatureKey(const Segments& segments, const PosMatcher& pos_matcher,
+             size_t index);
+
+  // Appends the key of the feature |type| to |key|. Returns false and leaves
+  // |key| unchanged if the feature is not available for the segment.
+  bool Append(Type type, absl::string_view base_key,
+              absl::string_view base_value, std::string& key) const;
+
+  std::string LeftRight(absl::string_view base_key,
+                        absl::string_view base_value) const {
+    return Get(LEFT_RIGHT, base_key, base_value);
+  }
+  std::string LeftLeft(absl::string_view base_key,
+                       absl::string_view base_value) const {
+    return Get(LEFT_LEFT, base_key, base_value);
+  }
+  std::string RightRight(absl::string_view base_key,
+                         absl::string_view base_value) const {
+    return Get(RIGHT_RIGHT, base_key, base_value);
+  }
+  std::string Left(absl::string_view base_key,
+                   absl::string_view base_value) const {
+    return Get(LEFT, base_key, base_value);
+  }
+  std::string Right(absl::string_view base_key,
+                    absl::string_view base_value) const {
+    return Get(RIGHT, base_key, base_value);
+  }
+  std::string Current(absl::string_view base_key,
+                      absl::string_view base_value) const {
+    return Get(CURRENT, base_key, base_value);
+  }
+  std::string Single(absl::string_view base_key,
+                     absl::string_view base_value) const {
+    return Get(SINGLE, base_key, base_value);
+  }
+  std::string LeftNumber(absl::string_view base_key,
+                         absl::string_view base_value) const {
+    return Get(LEFT_NUMBER, base_key, base_value);
+  }
+  std::string RightNumber(absl::string_view base_key,
+                          absl::string_view base_value) const {
+    return Get(RIGHT_NUMBER, base_key, base_value);
+  }
+
+  // Feature "Number"
+  // used for number rewrite
+  static std::string Number(uint16_t type) {
+    return absl::StrCat("N\t", type);
+  }
+
+ private:
+  std::string Get(Type type, absl::string_view base_key,
+                  absl::string_view base_value) const {
+    std::string key;
+    Append(type, base_key, base_value, key);
+    return key;
+  }
+
+  // Default candidates of the segments at index - 2, index - 1, index + 1 and
+  // index + 2, or nullptr if the segment doesn't exist.
+  const converter::Candidate* left2_ = nullptr;
+  const converter::Candidate* left1_ = nullptr;
+  const converter::Candidate* right1_ = nullptr;
+  const converter::Candidate* right2_ = nullptr;
+  bool single_ = false;
+  bool left_number_ = false;
+  bool right_number_ = false;
+};
+
+UserSegmentHistoryRewriter::FeatureKey::FeatureKey(
+    const Segments& segments, const PosMatcher& pos_matcher, size_t index)
+    : single_(segments.conversion_segments_size() == 1) {
+  auto default_candidate = [&segments](size_t i) {
+    const Segment& segment = segments.segment(i);
+    return &segment.candidate(GetDefaultCandidateIndex(segment));
+  };
+  if (index >= 1) {
+    left1_ = default_candidate(index - 1);
+    left_number_ = IsNumberCandidate(pos_matcher, left1_->rid, *left1_);
+  }
+  if (index >= 2) {
+    left2_ = default_candidate(index - 2);
+  }
+  if (index + 1 < segments.segments_size()) {
+    right1_ = default_candidate(index + 1);
+    right_number_ = IsNumberCandidate(pos_matcher, right1_->lid, *right1_);
+  }
+  if (index + 2 < segments.segments_size()) {
+    right2_ = default_candidate(index + 2);
+  }
+}
+
+bool UserSegmentHistoryRewriter::FeatureKey::Append(
+    Type type, absl::string_view base_key, absl::string_view base_value,
+    std::string& key) const {
+  switch (type) {
+    case LEFT_RIGHT:
+      if (left1_ == nullptr || right1_ == nullptr) {
+        return false;
+      }
+      absl::StrAppend(&key, "LR\t", base_key, "\t", left1_->value, "\t",
+                      base_value, "\t", right1_->value);
+      return true;
+    case LEFT_LEFT:
+      if (left2_ == nullptr) {
+        return false;
+      }
+      absl::StrAppend(&key, "LL\t", base_key, "\t", left2_->value, "\t",
+                      left1_->value, "\t", base_value);
+      return true;
+    case RIGHT_RIGHT:
+      if (right2_ == nullptr) {
+        return false;
+      }
+      absl::StrAppend(&key, "RR\t", base_key, "\t", base_value, "\t",
+                      right1_->value, "\t", right2_->value);
+      return true;
+    case LEFT:
+      if (left1_ == nullptr) {
+        return false;
+      }
+      absl::StrAppend(&key, "L\t", base_key, "\t", left1_->value, "\t",
+                      base_value);
+      return true;
+    case RIGHT:
+      if (right1_ == nullptr) {
+        return false;
+      }
+      absl::StrAppend(&key, "R\t", base_key, "\t", base_value, "\t",
+                      right1_->value);
+      return true;
+    case CURRENT:
+      absl::StrAppend(&key, "C\t", base_key, "\t", base_value);
+      return true;
+    case SINGLE:
+      if (!single_) {
+        return false;
+      }
+      absl::StrAppend(&key, "S\t", base_key, "\t", base_value);
+      return true;
+    case LEFT_NUMBER:
+      if (!left_number_) {
+        return false;
+      }
+      absl::StrAppend(&key, "LN\t", base_key, "\t", base_value);
+      return true;
+    case RIGHT_NUMBER:
+      if (!right_number_) {
+        return false;
+      }
+      absl::StrAppend(&key, "RN\t", base_key, "\t", base_value);
+      return true;
+  }
+  return false;
+}
+
+// Feature keys of a candidate and their weights. The keys are built in one
+// buffer, which is reused across the candidates of a segment, and looked up
+// in one batch.
+class UserSegmentHistoryRewriter::FeatureBatch {
+ public:
+  void Clear() {
+    buffer_.clear();
+    ends_.clear();
+    weights_.clear();
+  }
+
+  void Add(const FeatureKey& fkey, FeatureKey::Type type,
+           absl::string_view base_key, absl::string_view base_value,
+           uint32_t weight) {
+    if (fkey.Append(type, base_key, base_value, buffer_)) {
+      ends_.push_back(buffer_.size());
+      weights_.push_back(weight);
+    }
+  }
+
+  // Looks up all the features and returns the best score.
+  Score Fetch(const LruStorage& storage);
+
+ private:
+  std::string buffer_;
+  std::vector<size_t> ends_;
+  std::vector<uint32_t> weights_;
+  std::vector<absl::string_view> keys_;
+  std::vector<const char*> values_;
+  std::vector<uint32_t> last_access_times_;
+};
+
+UserSegmentHistoryRewriter::Score
+UserSegmentHistoryRewriter::FeatureBatch::Fetch(const LruStorage& storage) {
+  const size_t size = ends_.size();
+  keys_.resize(size);
+  values_.resize(size);
+  last_access_times_.resize(size);
+  for (size_t i = 0, begin = 0; i < size; begin = ends_[i++]) {
+    keys_[i] = absl::string_view(buffer_).substr(begin, ends_[i] - begin);
+  }
+  storage.LookupBatch(keys_, absl::MakeSpan(values_),
+                      absl::MakeSpan(last_access_times_));
+
+  Score score = {0, 0};
+  for (size_t i = 0; i < size; ++i) {
+    const FeatureValue* v =
+        std::launder(reinterpret_cast<const FeatureValue*>(values_[i]));
+    if (v && v->IsValid()) {
+      score.Update({weights_[i], last_access_times_[i]});
+    }
+  }
+  return score;
+}
+
 bool UserSegmentHistoryRewriter::SortCandidates(
     absl::Span<const ScoreCandidate> sorted_scores, Segment* segment) const {
   const uint32_t top_score = sorted_scores[0].score;
@@ -498,7 +575,8 @@ UserSegmentHistoryRewriter::UserSegmentHistoryRewriter(
 
 UserSegmentHistoryRewriter::Score UserSegmentHistoryRewriter::GetScore(
     const ConversionRequest& request, const Segments& segments,
-    size_t segment_index, int candidate_index) const {
+    size_t segment_index, int candidate_index, const FeatureKey& fkey,
+    FeatureBatch& batch) const {
   const size_t segments_size = segments.conversion_segments_size();
   const converter::Candidate& top_candidate =
       segments.segment(segment_index).candidate(0);
@@ -523,50 +601,46 @@ UserSegmentHistoryRewriter::Score UserSegmentHistoryRewriter::GetScore(
   const uint32_t unigram_weight = (segments_size == 1) ? 36 : 6;
   const uint32_t single_weight = (segments_size == 1) ? 90 : 15;
 
-  Score score = {0, 0};
-  FeatureKey fkey(segments, *pos_matcher_, segment_index);
-  score.Update(Fetch(fkey.LeftRight(all_key, all_value), trigram_weight));
-  score.Update(Fetch(fkey.LeftLeft(all_key, all_value), trigram_weight));
-  score.Update(Fetch(fkey.RightRight(all_key, all_value), trigram_weight));
-  score.Update(Fetch(fkey.Left(all_key, all_value), bigram_weight));
-  score.Update(Fetch(fkey.Right(all_key, all_value), bigram_weight));
-  score.Update(Fetch(fkey.Single(all_key, all_value), single_weight));
-  score.Update(
-      Fetch(fkey.LeftNumber(content_key, content_value), bigram_number_weight));
-  score.Update(Fetch(fkey.RightNumber(content_key, content_value),
-                     bigram_number_weight));
+  batch.Clear();
+  auto add = [&](FeatureKey::Type type, absl::string_view key,
+                 absl::string_view value, uint32_t weight) {
+    batch.Add(fkey, type, key, value, weight);
+  };
+  add(FeatureKey::LEFT_RIGHT, all_key, all_value, trigram_weight);
+  add(FeatureKey::LEFT_LEFT, all_key, all_value, trigram_weight);
+  add(FeatureKey::RIGHT_RIGHT, all_key, all_value, trigram_weight);
+  add(FeatureKey::LEFT, all_key, all_value, bigram_weight);
+  add(FeatureKey::RIGHT, all_key, all_value, bigram_weight);
+  add(FeatureKey::SINGLE, all_key, all_value, single_weight);
+  add(FeatureKey::LEFT_NUMBER, content_key, content_value,
+      bigram_number_weight);
+  add(FeatureKey::RIGHT_NUMBER, content_key, content_value,
+      bigram_number_weight);
 
   const bool is_replaceable = Replaceable(request, top_candidate, candidate);
   if (!context_sensitive && is_replaceable) {
-    score.Update(Fetch(fkey.Current(all_key, all_value), unigram_weight));
-  }
-
-  if (!is_replaceable) {
-    return score;
+    add(FeatureKey::CURRENT, all_key, all_value, unigram_weight);
   }
 
-  score.Update(
-      Fetch(fkey.LeftRight(content_key, content_value), trigram_weight / 2));
-  score.Update(
-      Fetch(fkey.LeftLeft(content_key, content_value), trigram_weight / 2));
-  score.Update(
-      Fetch(fkey.RightRight(content_key, content_value), trigram_weight / 2));
-  score.Update(Fetch(fkey.Left(content_key, content_value), bigram_weight / 2));
-  score.Update(
-      Fetch(fkey.Right(content_key, content_value), bigram_weight / 2));
-  score.Update(
-      Fetch(fkey.Single(content_key, content_value), single_weight / 2));
-  score.Update(Fetch(fkey.LeftNumber(content_key, content_value),
-                     bigram_number_weight / 2));
-  score.Update(Fetch(fkey.RightNumber(content_key, content_value),
-                     bigram_number_weight / 2));
-
-  if (!context_sensitive) {
-    score.Update(
-        Fetch(fkey.Current(content_key, content_value), unigram_weight / 2));
+  if (is_replaceable) {
+    add(FeatureKey::LEFT_RIGHT, content_key, content_value,
+        trigram_weight / 2);
+    add(FeatureKey::LEFT_LEFT, content_key, content_value, trigram_weight / 2);
+    add(FeatureKey::RIGHT_RIGHT, content_key, content_value,
+        trigram_weight / 2);
+    add(FeatureKey::LEFT, content_key, content_value, bigram_weight / 2);
+    add(FeatureKey::RIGHT, content_key, content_value, bigram_weight / 2);
+    add(FeatureKey::SINGLE, content_key, content_value, single_weight / 2);
+    add(FeatureKey::LEFT_NUMBER, content_key, content_value,
+        bigram_number_weight / 2);
+    add(FeatureKey::RIGHT_NUMBER, content_key, content_value,
+        bigram_number_weight / 2);
+    if (!context_sensitive) {
+      add(FeatureKey::CURRENT, content_key, content_value, unigram_weight / 2);
+    }
   }
 
-  return score;
+  return batch.Fetch(*storage_);
 }
 
 // Returns true if |best_candidate| can be replaceable with |target_candidate|.
@@ -945,6 +1019,7 @@ bool UserSegmentHistoryRewriter::Rewrite(const ConversionRequest& request,
   }
 
   bool modified = false;
+  FeatureBatch batch;
   for (size_t i = segments->history_segments_size();
        i < segments->segments_size(); ++i) {
     Segment* segment = segments->mutable_segment(i);
@@ -979,6 +1054,7 @@ bool UserSegmentHistoryRewriter::Rewrite(const ConversionRequest& request,
     }
 
     // for each all candidates expanded
+    const FeatureKey fkey(*segments, *pos_matcher_, i);
     std::vector<ScoreCandidate> scores;
     for (size_t l = 0;
          l < segment->candidates_size() + segment->meta_candidates_size();
@@ -989,7 +1065,7 @@ bool UserSegmentHistoryRewriter::Rewrite(const ConversionRequest& request,
                               transliteration::NUM_T13N_TYPES);
       }
 
-      const Score score = GetScore(request, *segments, i, j);
+      const Score score = GetScore(request, *segments, i, j, fkey, batch);
       if (score.score > 0) {
         scores.emplace_back(score, &segment->candidate(j));
       }
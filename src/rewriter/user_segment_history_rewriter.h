@@ -86,6 +86,9 @@ class UserSegmentHistoryRewriter : public RewriterInterface {
     uint32_t score, last_access_time;
   };
 
+  class FeatureKey;
+  class FeatureBatch;
+
   struct ScoreCandidate : public Score {
     ScoreCandidate(const Score s, const converter::Candidate* candidate)
         : Score(s), candidate(candidate) {}
@@ -99,7 +102,8 @@ class UserSegmentHistoryRewriter : public RewriterInterface {
   bool IsAvailable(const ConversionRequest& request,
                    const Segments& segments) const;
   Score GetScore(const ConversionRequest& request, const Segments& segments,
-                 size_t segment_index, int candidate_index) const;
+                 size_t segment_index, int candidate_index,
+                 const FeatureKey& fkey, FeatureBatch& batch) const;
   bool Replaceable(const ConversionRequest& request,
                    const converter::Candidate& best_candidate,
                    const converter::Candidate& target_candidate) const;
@@ -52,6 +52,7 @@
 #include "engine/engine_interface.h"
 #include "protocol/commands.pb.h"
 #include "protocol/config.pb.h"
+#include "protocol/session_snapshot.pb.h"
 #include "session/ime_context.h"
 #include "session/key_event_transformer.h"
 #include "session/keymap.h"
@@ -344,6 +345,9 @@ bool Session::SendCommand(commands::Command* command) {
     case commands::SessionCommand::GET_STATUS:
       result = GetStatus(command);
       break;
+    case commands::SessionCommand::GET_CANDIDATE_LIST:
+      result = GetCandidateList(command);
+      break;
     case commands::SessionCommand::CONVERT_REVERSE:
       result = ConvertReverse(command);
       break;
@@ -1200,6 +1204,13 @@ bool Session::GetStatus(commands::Command* command) {
   return true;
 }
 
+bool Session::GetCandidateList(commands::Command* command) {
+  // Input.candidate_list_version is ignored so that the full list is sent.
+  command->mutable_input()->clear_candidate_list_version();
+  Output(command);
+  return true;
+}
+
 bool Session::RequestConvertReverse(commands::Command* command) {
   if (context_->state() != ImeContext::PRECOMPOSITION &&
       context_->state() != ImeContext::DIRECT) {
@@ -1455,6 +1466,58 @@ bool Session::MaybeSelectCandidate(commands::Command* command) {
   return context_->mutable_converter()->CandidateMoveToShortcut(shortcut);
 }
 
+void Session::SaveSnapshot(commands::SessionSnapshot* snapshot) const {
+  DCHECK(snapshot);
+  snapshot->Clear();
+  snapshot->set_state(context_->state());
+  context_->composer().SaveSnapshot(snapshot->mutable_composer());
+  context_->converter().SaveSnapshot(snapshot->mutable_converter());
+  *snapshot->mutable_client_capability() = context_->client_capability();
+  *snapshot->mutable_application_info() = context_->application_info();
+}
+
+bool Session::RestoreSnapshot(const commands::SessionSnapshot& snapshot) {
+  ImeContext::State state;
+  switch (snapshot.state()) {
+    case ImeContext::DIRECT:
+    case ImeContext::PRECOMPOSITION:
+    case ImeContext::COMPOSITION:
+    case ImeContext::CONVERSION:
+      state = static_cast<ImeContext::State>(snapshot.state());
+      break;
+    default:
+      LOG(ERROR) << "Invalid state in the snapshot: " << snapshot.state();
+      return false;
+  }
+
+  // The snapshot is validated before the session is modified.
+  ClearUndoContext();
+  *context_->mutable_client_capability() = snapshot.client_capability();
+  *context_->mutable_application_info() = snapshot.application_info();
+
+  composer::Composer* composer = context_->mutable_composer();
+  if (!composer->RestoreSnapshot(snapshot.composer())) {
+    SetStateToPredompositionAndCancel(context_.get());
+    return false;
+  }
+  if (state == ImeContext::COMPOSITION && composer->Empty()) {
+    state = ImeContext::PRECOMPOSITION;
+  }
+  context_->set_state(state);
+
+  if (!context_->mutable_converter()->RestoreSnapshot(snapshot.converter(),
+                                                      *composer)) {
+    // The composition is still usable, so the session falls back to it
+    // rather than being dropped.
+    LOG(WARNING) << "Conversion is not restored from the snapshot";
+    if (state == ImeContext::CONVERSION) {
+      context_->set_state(composer->Empty() ? ImeContext::PRECOMPOSITION
+                                            : ImeContext::COMPOSITION);
+    }
+  }
+  return true;
+}
+
 void Session::set_client_capability(commands::Capability capability) {
   *context_->mutable_client_capability() = std::move(capability);
 }
@@ -2709,6 +2772,10 @@ void Session::OutputFromState(commands::Command* command) {
 
 void Session::Output(commands::Command* command) {
   OutputMode(command);
+  if (context_->client_capability().candidate_list_delta()) {
+    context_->mutable_converter()->EnableCandidateListDelta(
+        command->input().candidate_list_version());
+  }
   context_->mutable_converter()->PopOutput(context_->composer(),
                                            command->mutable_output());
 }
@@ -44,6 +44,7 @@
 #include "engine/engine_interface.h"
 #include "protocol/commands.pb.h"
 #include "protocol/config.pb.h"
+#include "protocol/session_snapshot.pb.h"
 #include "session/ime_context.h"
 #include "session/keymap.h"
 #include "transliteration/transliteration.h"
@@ -106,6 +107,9 @@ class Session {
   // Returns the current status such as a composition string, input mode, etc.
   bool GetStatus(mozc::commands::Command* command);
 
+  // Returns the current output including the full candidate list.
+  bool GetCandidateList(mozc::commands::Command* command);
+
   // Fills Output::Callback with the CONVERT_REVERSE SessionCommand to
   // ask the client to send back the SessionCommand to the server.
   // This function is called when the key event representing the
@@ -260,6 +264,17 @@ class Session {
   // Get application information
   const mozc::commands::ApplicationInfo& application_info() const;
 
+  // Records the in-flight state of this session (the composition, the
+  // conversion segments and the candidate focus) into |snapshot|. The id is
+  // left to the caller.
+  void SaveSnapshot(mozc::commands::SessionSnapshot* snapshot) const;
+
+  // Restores the state recorded by SaveSnapshot(). The config, the request
+  // and the table should be set beforehand. Returns false if the composition
+  // is not restored. When only the conversion is not restored, the session is
+  // left in the restored composition and true is returned.
+  bool RestoreSnapshot(const mozc::commands::SessionSnapshot& snapshot);
+
   // Return the time when this instance was created.
   absl::Time create_session_time() const;
 
@@ -43,8 +43,11 @@
 #include "absl/flags/flag.h"
 #include "absl/log/log.h"
 #include "absl/random/random.h"
+#include "absl/strings/string_view.h"
 #include "absl/time/time.h"
 #include "base/clock.h"
+#include "base/metrics.h"
+#include "base/protobuf/repeated_ptr_field.h"
 #include "base/stopwatch.h"
 #include "base/version.h"
 #include "base/vlog.h"
@@ -55,6 +58,7 @@
 #include "protocol/commands.pb.h"
 #include "protocol/config.pb.h"
 #include "protocol/engine_builder.pb.h"
+#include "protocol/session_snapshot.pb.h"
 #include "protocol/user_dictionary_storage.pb.h"
 #include "session/common.h"
 #include "session/keymap.h"
@@ -122,6 +126,45 @@ bool IsApplicationAlive(const session::Session* session) {
 #endif  // MOZC_DISABLE_SESSION_WATCHDOG
   return true;
 }
+
+void RecordCommandLatency(const commands::Input& input,
+                          absl::Duration latency) {
+  if (LatencyHistogram* histogram = MetricsRegistry::GetCommand(input.type());
+      histogram != nullptr) {
+    histogram->Record(latency);
+  }
+  if (input.type() != commands::Input::SEND_COMMAND) {
+    return;
+  }
+  if (LatencyHistogram* histogram =
+          MetricsRegistry::GetSessionCommand(input.command().type());
+      histogram != nullptr) {
+    histogram->Record(latency);
+  }
+}
+
+void MaybeFillLatencyHistogram(
+    absl::string_view name, const LatencyHistogram& histogram,
+    protobuf::RepeatedPtrField<commands::LatencyHistogram>* output) {
+  if (histogram.count() == 0) {
+    return;
+  }
+  commands::LatencyHistogram* out = output->Add();
+  out->set_name(name);
+  out->set_count(histogram.count());
+  out->set_total_micros(absl::ToInt64Microseconds(histogram.total()));
+  out->set_max_micros(absl::ToInt64Microseconds(histogram.max()));
+  out->set_p50_micros(absl::ToInt64Microseconds(histogram.Percentile(0.5)));
+  out->set_p90_micros(absl::ToInt64Microseconds(histogram.Percentile(0.9)));
+  out->set_p99_micros(absl::ToInt64Microseconds(histogram.Percentile(0.99)));
+  for (size_t i = 0; i < LatencyHistogram::kNumBuckets; ++i) {
+    if (const uint64_t count = histogram.bucket_count(i); count > 0) {
+      commands::LatencyHistogram::Bucket* bucket = out->add_buckets();
+      bucket->set_lower_bound_micros(LatencyHistogram::GetBucketLowerBound(i));
+      bucket->set_count(count);
+    }
+  }
+}
 }  // namespace
 
 SessionHandler::SessionHandler(std::unique_ptr<EngineInterface> engine)
@@ -383,6 +426,9 @@ bool SessionHandler::EvalCommand(commands::Command* command) {
     case commands::Input::GET_SERVER_VERSION:
       eval_succeeded = GetServerVersion(command);
       break;
+    case commands::Input::GET_METRICS:
+      eval_succeeded = GetMetrics(command);
+      break;
     default:
       eval_succeeded = false;
   }
@@ -400,6 +446,7 @@ bool SessionHandler::EvalCommand(commands::Command* command) {
   }
 
   stopwatch.Stop();
+  RecordCommandLatency(command->input(), stopwatch.GetElapsed());
 
   return is_available_;
 }
@@ -409,6 +456,51 @@ std::unique_ptr<session::Session> SessionHandler::NewSession() {
   return std::make_unique<session::Session>(*engine_);
 }
 
+bool SessionHandler::SaveSessionSnapshot(
+    SessionID id, commands::SessionSnapshot* snapshot) const {
+  const std::unique_ptr<session::Session>* session =
+      session_map_->LookupWithoutInsert(id);
+  if (session == nullptr || !*session) {
+    return false;
+  }
+  (*session)->SaveSnapshot(snapshot);
+  snapshot->set_id(id);
+  return true;
+}
+
+bool SessionHandler::RestoreSessionSnapshot(
+    const commands::SessionSnapshot& snapshot) {
+  // Don't allow id == 0, as it is reserved for "invalid id".
+  if (snapshot.id() == 0) {
+    return false;
+  }
+
+  std::unique_ptr<session::Session> session = NewSession();
+  if (!session) {
+    LOG(ERROR) << "Cannot allocate new Session";
+    return false;
+  }
+
+  // Replacing the session of the same id doesn't need a new slot.
+  if (session_map_->LookupWithoutInsert(snapshot.id()) == nullptr &&
+      !MaybeEvictOldestSession()) {
+    return false;
+  }
+  SessionElement* element = session_map_->Insert(snapshot.id());
+  element->value = std::move(session);
+  // Sets the config, the request and the table before restoring.
+  UpdateSessions();
+
+  if (!element->value->RestoreSnapshot(snapshot)) {
+    LOG(WARNING) << "Cannot restore the snapshot of SessionID "
+                 << snapshot.id();
+    DeleteSessionID(snapshot.id());
+    return false;
+  }
+  last_session_empty_time_ = absl::InfinitePast();
+  return true;
+}
+
 void SessionHandler::MaybeUpdateConfig(commands::Command* command) {
   if (!command->output().has_config()) {
     return;
@@ -479,6 +571,33 @@ bool SessionHandler::GetServerVersion(mozc::commands::Command* command) const {
   return true;
 }
 
+bool SessionHandler::GetMetrics(commands::Command* command) const {
+  commands::EngineMetrics* metrics =
+      command->mutable_output()->mutable_metrics();
+  for (int type = 0; type < MetricsRegistry::kMaxCommandTypes; ++type) {
+    if (commands::Input::CommandType_IsValid(type)) {
+      MaybeFillLatencyHistogram(
+          commands::Input::CommandType_Name(
+              static_cast<commands::Input::CommandType>(type)),
+          *MetricsRegistry::GetCommand(type), metrics->mutable_commands());
+    }
+    if (commands::SessionCommand::CommandType_IsValid(type)) {
+      MaybeFillLatencyHistogram(
+          commands::SessionCommand::CommandType_Name(
+              static_cast<commands::SessionCommand::CommandType>(type)),
+          *MetricsRegistry::GetSessionCommand(type),
+          metrics->mutable_session_commands());
+    }
+  }
+  for (int stage = 0; stage < MetricsRegistry::NUM_STAGES; ++stage) {
+    const auto stage_enum = static_cast<MetricsRegistry::Stage>(stage);
+    MaybeFillLatencyHistogram(MetricsRegistry::GetStageName(stage_enum),
+                              MetricsRegistry::GetStage(stage_enum),
+                              metrics->mutable_stages());
+  }
+  return true;
+}
+
 bool SessionHandler::CreateSession(commands::Command* command) {
   // prevent DOS attack
   // don't allow CreateSession in very short period.
@@ -499,18 +618,8 @@ bool SessionHandler::CreateSession(commands::Command* command) {
 
   last_create_session_time_ = current_time;
 
-  // if session map is FULL, remove the oldest item from the LRU
-  if (session_map_->Size() >= max_session_size_) {
-    SessionElement* oldest_element = session_map_->MutableTail();
-    if (oldest_element == nullptr) {
-      LOG(ERROR) << "oldest SessionElement is NULL";
-      return false;
-    }
-
-    oldest_element->value.reset();
-    session_map_->Erase(oldest_element->key);
-    MOZC_VLOG(1) << "Session is FULL, oldest SessionID " << oldest_element->key
-                 << " is removed";
+  if (!MaybeEvictOldestSession()) {
+    return false;
   }
 
   // CreateSession is called on a relatively safer timing to reload engine_.
@@ -717,4 +826,23 @@ bool SessionHandler::DeleteSessionID(SessionID id) {
 
   return true;
 }
+
+bool SessionHandler::MaybeEvictOldestSession() {
+  // if session map is FULL, remove the oldest item from the LRU
+  if (session_map_->Size() < max_session_size_) {
+    return true;
+  }
+  SessionElement* oldest_element = session_map_->MutableTail();
+  if (oldest_element == nullptr) {
+    LOG(ERROR) << "oldest SessionElement is NULL";
+    return false;
+  }
+
+  const SessionID oldest_id = oldest_element->key;
+  oldest_element->value.reset();
+  session_map_->Erase(oldest_id);
+  MOZC_VLOG(1) << "Session is FULL, oldest SessionID " << oldest_id
+               << " is removed";
+  return true;
+}
 }  // namespace mozc
@@ -43,6 +43,7 @@
 #include "engine/engine_interface.h"
 #include "protocol/commands.pb.h"
 #include "protocol/config.pb.h"
+#include "protocol/session_snapshot.pb.h"
 #include "session/common.h"
 #include "session/keymap.h"
 #include "session/session.h"
@@ -72,6 +73,18 @@ class SessionHandler {
   // NewSession returns new Session.
   std::unique_ptr<session::Session> NewSession();
 
+  // Checkpoints the session of |id| into |snapshot| so that a supervisor can
+  // restore it into another process. Returns false if |id| is unknown.
+  bool SaveSessionSnapshot(SessionID id,
+                           commands::SessionSnapshot* snapshot) const;
+
+  // Restores the session checkpointed by SaveSessionSnapshot() under the same
+  // id, replacing the existing session of the id if any. The oldest session is
+  // removed if the map is full, as CreateSession() does. Nothing is kept for
+  // the id if the snapshot can't be restored. A snapshot whose conversion
+  // can't be restored still restores the session in its composition.
+  bool RestoreSessionSnapshot(const commands::SessionSnapshot& snapshot);
+
   absl::string_view GetDataVersion() const { return engine_->GetDataVersion(); }
 
   const EngineInterface& engine() const { return *engine_; }
@@ -118,12 +131,17 @@ class SessionHandler {
   bool NoOperation(commands::Command* command);
   bool ReloadSupplementalModel(commands::Command* command);
   bool GetServerVersion(commands::Command* command) const;
+  // Fills Output.metrics with the histograms in MetricsRegistry.
+  bool GetMetrics(commands::Command* command) const;
 
   // Replaces engine_ with a new instance if it is ready.
   void MaybeReloadEngine(commands::Command* command);
 
   SessionID CreateNewSessionID();
   bool DeleteSessionID(SessionID id);
+  // Removes the least recently used session if the map is full. Returns false
+  // on failure.
+  bool MaybeEvictOldestSession();
 
   std::unique_ptr<SessionMap> session_map_;
 #ifndef MOZC_DISABLE_SESSION_WATCHDOG
@@ -47,6 +47,9 @@
 #include "absl/time/time.h"
 #include "base/clock.h"
 #include "base/clock_mock.h"
+#include "base/metrics.h"
+#include "composer/composer.h"
+#include "composer/query.h"
 #include "config/config_handler.h"
 #include "data_manager/data_manager.h"
 #include "data_manager/testing/mock_data_manager.h"
@@ -54,8 +57,14 @@
 #include "engine/engine_interface.h"
 #include "engine/engine_mock.h"
 #include "engine/mock_data_engine_factory.h"
+#include "engine/modules.h"
+#include "engine/supplemental_model_mock.h"
+#include "prediction/typing_correction_cache.h"
 #include "protocol/commands.pb.h"
 #include "protocol/config.pb.h"
+#include "protocol/session_snapshot.pb.h"
+#include "request/conversion_request.h"
+#include "session/ime_context.h"
 #include "session/keymap.h"
 #include "session/session_handler.h"
 #include "session/session_handler_test_util.h"
@@ -82,6 +91,7 @@ class KeyMapManagerAccessorTestPeer : public testing::TestPeer<SessionHandler> {
 namespace {
 
 using ::mozc::session::testing::SessionHandlerTestBase;
+using ::testing::_;
 using ::testing::Return;
 
 EngineReloadResponse::Status SendMockEngineReloadRequest(
@@ -564,6 +574,251 @@ TEST_F(SessionHandlerTest, UpdateComposition) {
   }
 }
 
+TEST_F(SessionHandlerTest, RestoreSessionSnapshot) {
+  SessionHandler handler(CreateMockDataEngine());
+
+  uint64_t session_id = 0;
+  EXPECT_TRUE(CreateSession(handler, &session_id));
+  {
+    // On Windows, its initial mode is DIRECT.
+    commands::Command command;
+    commands::Input* input = command.mutable_input();
+    input->set_id(session_id);
+    input->set_type(commands::Input::SEND_KEY);
+    input->mutable_key()->set_special_key(commands::KeyEvent::ON);
+    EXPECT_TRUE(handler.EvalCommand(&command));
+  }
+  std::string preedit;
+  for (const char key : {'a', 'i'}) {
+    commands::Command command;
+    commands::Input* input = command.mutable_input();
+    input->set_id(session_id);
+    input->set_type(commands::Input::SEND_KEY);
+    input->mutable_key()->set_key_code(key);
+    EXPECT_TRUE(handler.EvalCommand(&command));
+    preedit = command.output().preedit().segment(0).value();
+  }
+
+  commands::SessionSnapshot snapshot;
+  EXPECT_FALSE(handler.SaveSessionSnapshot(session_id + 1, &snapshot));
+  ASSERT_TRUE(handler.SaveSessionSnapshot(session_id, &snapshot));
+  EXPECT_EQ(snapshot.id(), session_id);
+
+  // Restores the session into another handler as if the server restarted.
+  SessionHandler restarted(CreateMockDataEngine());
+  ASSERT_TRUE(restarted.RestoreSessionSnapshot(snapshot));
+
+  commands::Command command;
+  commands::Input* input = command.mutable_input();
+  input->set_id(session_id);
+  input->set_type(commands::Input::SEND_KEY);
+  input->mutable_key()->set_key_code('u');
+  EXPECT_TRUE(restarted.EvalCommand(&command));
+  EXPECT_EQ(command.output().preedit().segment(0).value(), preedit + "う");
+}
+
+TEST_F(SessionHandlerTest, RestoreInvalidSessionSnapshot) {
+  SessionHandler handler(CreateMockDataEngine());
+
+  uint64_t session_id = 0;
+  ASSERT_TRUE(CreateSession(handler, &session_id));
+  commands::SessionSnapshot snapshot;
+  ASSERT_TRUE(handler.SaveSessionSnapshot(session_id, &snapshot));
+
+  // A snapshot with an unknown state is rejected and leaves no session.
+  snapshot.set_id(session_id + 1);
+  snapshot.set_state(100);
+  EXPECT_FALSE(handler.RestoreSessionSnapshot(snapshot));
+  EXPECT_FALSE(IsGoodSession(handler, session_id + 1));
+  EXPECT_TRUE(IsGoodSession(handler, session_id));
+
+  // Restoring over an existing id removes the session on failure.
+  snapshot.set_id(session_id);
+  EXPECT_FALSE(handler.RestoreSessionSnapshot(snapshot));
+  EXPECT_FALSE(IsGoodSession(handler, session_id));
+}
+
+TEST_F(SessionHandlerTest, RestoreSessionSnapshotWithoutConversion) {
+  SessionHandler handler(CreateMockDataEngine());
+
+  uint64_t session_id = 0;
+  ASSERT_TRUE(CreateSession(handler, &session_id));
+  {
+    // On Windows, its initial mode is DIRECT.
+    commands::Command command;
+    commands::Input* input = command.mutable_input();
+    input->set_id(session_id);
+    input->set_type(commands::Input::SEND_KEY);
+    input->mutable_key()->set_special_key(commands::KeyEvent::ON);
+    EXPECT_TRUE(handler.EvalCommand(&command));
+  }
+  std::string preedit;
+  for (const char key : {'a', 'i'}) {
+    commands::Command command;
+    commands::Input* input = command.mutable_input();
+    input->set_id(session_id);
+    input->set_type(commands::Input::SEND_KEY);
+    input->mutable_key()->set_key_code(key);
+    EXPECT_TRUE(handler.EvalCommand(&command));
+    preedit = command.output().preedit().segment(0).value();
+  }
+  {
+    commands::Command command;
+    commands::Input* input = command.mutable_input();
+    input->set_id(session_id);
+    input->set_type(commands::Input::SEND_KEY);
+    input->mutable_key()->set_special_key(commands::KeyEvent::SPACE);
+    EXPECT_TRUE(handler.EvalCommand(&command));
+  }
+
+  commands::SessionSnapshot snapshot;
+  ASSERT_TRUE(handler.SaveSessionSnapshot(session_id, &snapshot));
+  ASSERT_EQ(snapshot.state(), session::ImeContext::CONVERSION);
+  // The focus out of the segments fails only the conversion.
+  snapshot.mutable_converter()->set_focused_segment(
+      snapshot.converter().segments_size());
+
+  // The session is restored in the composition instead of being dropped.
+  SessionHandler restarted(CreateMockDataEngine());
+  ASSERT_TRUE(restarted.RestoreSessionSnapshot(snapshot));
+  EXPECT_TRUE(IsGoodSession(restarted, session_id));
+
+  commands::Command command;
+  commands::Input* input = command.mutable_input();
+  input->set_id(session_id);
+  input->set_type(commands::Input::SEND_KEY);
+  input->mutable_key()->set_key_code('u');
+  EXPECT_TRUE(restarted.EvalCommand(&command));
+  EXPECT_EQ(command.output().preedit().segment(0).value(), preedit + "う");
+}
+
+TEST_F(SessionHandlerTest, RestoreSessionSnapshotEvictsOldestSession) {
+  const int32_t interval_time = 10;  // 10 sec
+  absl::SetFlag(&FLAGS_create_session_min_interval, interval_time);
+  ClockMock clock(absl::FromUnixSeconds(1000));
+  Clock::SetClockForUnitTest(&clock);
+
+  const size_t session_size = 3;
+  absl::SetFlag(&FLAGS_max_session_size, static_cast<int32_t>(session_size));
+  SessionHandler handler(CreateMockDataEngine());
+
+  std::vector<uint64_t> ids;
+  for (size_t i = 0; i < session_size; ++i) {
+    uint64_t id = 0;
+    ASSERT_TRUE(CreateSession(handler, &id));
+    ids.push_back(id);
+    clock.Advance(absl::Seconds(interval_time));
+  }
+
+  commands::SessionSnapshot snapshot;
+  ASSERT_TRUE(handler.SaveSessionSnapshot(ids.back(), &snapshot));
+
+  // Replacing an existing id keeps all the sessions.
+  ASSERT_TRUE(handler.RestoreSessionSnapshot(snapshot));
+  for (const uint64_t id : ids) {
+    EXPECT_TRUE(IsGoodSession(handler, id));
+  }
+
+  // A new id evicts the oldest session as CreateSession() does.
+  const uint64_t new_id = ids.back() + 1;
+  snapshot.set_id(new_id);
+  ASSERT_TRUE(handler.RestoreSessionSnapshot(snapshot));
+  EXPECT_TRUE(IsGoodSession(handler, new_id));
+  EXPECT_FALSE(IsGoodSession(handler, ids[0]));
+  EXPECT_TRUE(IsGoodSession(handler, ids[1]));
+  EXPECT_TRUE(IsGoodSession(handler, ids[2]));
+
+  Clock::SetClockForUnitTest(nullptr);
+}
+
+TEST_F(SessionHandlerTest, GetMetrics) {
+  MetricsRegistry::Reset();
+  SessionHandler handler(CreateMockDataEngine());
+
+  uint64_t session_id = 0;
+  EXPECT_TRUE(CreateSession(handler, &session_id));
+  {
+    // On Windows, its initial mode is DIRECT.
+    commands::Command command;
+    commands::Input* input = command.mutable_input();
+    input->set_id(session_id);
+    input->set_type(commands::Input::SEND_KEY);
+    input->mutable_key()->set_special_key(commands::KeyEvent::ON);
+    EXPECT_TRUE(handler.EvalCommand(&command));
+  }
+  {
+    commands::Command command;
+    commands::Input* input = command.mutable_input();
+    input->set_id(session_id);
+    input->set_type(commands::Input::SEND_KEY);
+    input->mutable_key()->set_key_code('a');
+    EXPECT_TRUE(handler.EvalCommand(&command));
+  }
+
+  commands::Command command;
+  command.mutable_input()->set_type(commands::Input::GET_METRICS);
+  ASSERT_TRUE(handler.EvalCommand(&command));
+  ASSERT_TRUE(command.output().has_metrics());
+  const commands::EngineMetrics& metrics = command.output().metrics();
+
+  // The GET_METRICS command itself is recorded after its output is filled.
+  bool has_send_key = false;
+  for (const commands::LatencyHistogram& histogram : metrics.commands()) {
+    EXPECT_NE(histogram.name(), "GET_METRICS");
+    EXPECT_GT(histogram.count(), 0);
+    if (histogram.name() == "SEND_KEY") {
+      has_send_key = true;
+      EXPECT_EQ(histogram.count(), 2);
+    }
+  }
+  EXPECT_TRUE(has_send_key);
+  EXPECT_FALSE(metrics.stages().empty());
+}
+
+TEST_F(SessionHandlerTest, TypingCorrectionCacheIsKeptAcrossCommands) {
+  auto supplemental_model = std::make_unique<engine::MockSupplementalModel>();
+  engine::MockSupplementalModel* model = supplemental_model.get();
+  std::unique_ptr<Engine> engine =
+      Engine::CreateEngine(
+          engine::ModulesPresetBuilder()
+              .PresetSupplementalModel(std::move(supplemental_model))
+              .Build(std::make_unique<testing::MockDataManager>())
+              .value())
+          .value();
+  prediction::TypingCorrectionCache& cache =
+      engine->GetModulesForTesting().GetTypingCorrectionCache();
+  SessionHandler handler(std::move(engine));
+
+  composer::Composer composer;
+  composer.SetPreeditTextForTestOnly("かつこう");
+  const ConversionRequest request =
+      ConversionRequestBuilder()
+          .SetComposer(composer)
+          .SetOptions({.request_type = ConversionRequest::SUGGESTION})
+          .Build();
+  EXPECT_CALL(*model, CorrectComposition(_))
+      .WillOnce(Return(std::vector<composer::TypeCorrectedQuery>()));
+  EXPECT_TRUE(cache.CorrectComposition(*model, request).has_value());
+
+  // No model is swapped in, so the next keystrokes hit the cache.
+  auto eval_command = [&handler] {
+    commands::Command command;
+    command.mutable_input()->set_type(commands::Input::GET_SERVER_VERSION);
+    EXPECT_TRUE(handler.EvalCommand(&command));
+  };
+  EXPECT_CALL(*model, ClearOldModels()).WillRepeatedly(Return(false));
+  eval_command();
+  eval_command();
+  EXPECT_TRUE(cache.CorrectComposition(*model, request).has_value());
+  EXPECT_EQ(cache.hits(), 1);
+  EXPECT_EQ(cache.Size(), 1);
+
+  // The corrections of the old model are dropped once it is replaced.
+  EXPECT_CALL(*model, ClearOldModels()).WillOnce(Return(true));
+  eval_command();
+  EXPECT_EQ(cache.Size(), 0);
+}
+
 TEST_F(SessionHandlerTest, KeyMapTest) {
   const keymap::KeyMapManager* msime_keymap;
 
@@ -33,18 +33,43 @@
 
 #include "session/session_server.h"
 
+#include <algorithm>
+#include <bit>
+#include <cstddef>
 #include <memory>
 #include <string>
 
+#include "absl/cleanup/cleanup.h"
+#include "absl/flags/flag.h"
 #include "absl/log/log.h"
+#include "absl/status/statusor.h"
 #include "absl/strings/string_view.h"
 #include "absl/time/time.h"
+#include "base/clock.h"
+#include "base/protobuf/arena.h"
+#include "base/protobuf/protobuf.h"
 #include "base/vlog.h"
+#include "data_manager/data_manager.h"
+#include "engine/engine.h"
 #include "engine/engine_factory.h"
+#include "engine/engine_interface.h"
 #include "ipc/ipc.h"
 #include "ipc/named_event.h"
 #include "protocol/commands.pb.h"
 #include "session/session_handler.h"
+#include "session/session_trace.h"
+
+// Only the data set is read from the file. The modules built from it, e.g.
+// the connector cache and the dictionary indexes, are still per process.
+ABSL_FLAG(std::string, engine_data_path, "",
+          "Path to the data set file to build the engine from. The embedded "
+          "data set is used if empty or if the file is broken.");
+ABSL_FLAG(std::string, engine_data_type, "oss",
+          "Type of the data set in --engine_data_path.");
+ABSL_FLAG(std::string, session_trace_path, "",
+          "If set, the requests are recorded to this file with their text "
+          "scrubbed, so that the load can be replayed by "
+          "session_trace_replay_main.");
 
 namespace {
 
@@ -61,14 +86,55 @@ constexpr absl::Duration kTimeOut = absl::Milliseconds(5000);
 constexpr char kSessionName[] = "session";
 constexpr char kEventName[] = "session";
 
+// Bounds of the arena block reused by every request.
+constexpr size_t kInitialArenaBlockSize = 64 * 1024;
+constexpr size_t kMaxArenaBlockSize = 4 * 1024 * 1024;
+
 }  // namespace
 
 namespace mozc {
 
+// static
+std::unique_ptr<EngineInterface> SessionServer::CreateEngine(
+    absl::string_view data_path, absl::string_view magic_number) {
+  if (!data_path.empty()) {
+    absl::StatusOr<std::unique_ptr<const DataManager>> data_manager =
+        DataManager::CreateFromFile(data_path, magic_number);
+    if (data_manager.ok()) {
+      absl::StatusOr<std::unique_ptr<Engine>> engine =
+          Engine::CreateEngine(*std::move(data_manager));
+      if (engine.ok()) {
+        MOZC_VLOG(1) << "Engine is created from " << data_path;
+        return *std::move(engine);
+      }
+      LOG(ERROR) << "Failed to create the engine: " << engine.status();
+    } else {
+      LOG(ERROR) << "Failed to map " << data_path << ": "
+                 << data_manager.status();
+    }
+  }
+  return EngineFactory::Create().value();
+}
+
 SessionServer::SessionServer()
     : IPCServer(kSessionName, kNumConnections, kTimeOut),
-      session_handler_(
-          std::make_unique<SessionHandler>(EngineFactory::Create().value())) {
+      session_handler_(std::make_unique<SessionHandler>(
+          CreateEngine(absl::GetFlag(FLAGS_engine_data_path),
+                       DataManager::GetDataSetMagicNumber(
+                           absl::GetFlag(FLAGS_engine_data_type))))) {
+  AllocateArena(kInitialArenaBlockSize);
+
+  if (const std::string path = absl::GetFlag(FLAGS_session_trace_path);
+      !path.empty()) {
+    absl::StatusOr<std::unique_ptr<session::SessionTraceWriter>> writer =
+        session::SessionTraceWriter::Create(path);
+    if (writer.ok()) {
+      trace_writer_ = *std::move(writer);
+    } else {
+      LOG(ERROR) << "Session trace is disabled: " << writer.status();
+    }
+  }
+
   // start session watch dog timer
   session_handler_->StartWatchDog();
 
@@ -90,28 +156,66 @@ bool SessionServer::Process(absl::string_view request, std::string* response) {
     return false;  // shutdown the server if handler doesn't exist
   }
 
-  commands::Command command;
-  if (!command.mutable_input()->ParseFromString(request)) {
+  // The command and its output are allocated on the arena. They are freed at
+  // once after the response is serialized.
+  absl::Cleanup reset_arena = [this] { ResetArena(); };
+  commands::Command* command =
+      protobuf::Arena::Create<commands::Command>(arena_.get());
+  if (!command->mutable_input()->ParseFromString(request)) {
     LOG(WARNING) << "Invalid request";
     response->clear();
     return true;
   }
 
-  if (!session_handler_->EvalCommand(&command)) {
+  const absl::Time received = Clock::GetAbslTime();
+  const bool evaluated = session_handler_->EvalCommand(command);
+  if (trace_writer_) {
+    // EvalCommand() may rewrite the input, so the original request is parsed
+    // again.
+    commands::Input input;
+    input.ParseFromString(request);
+    trace_writer_->Record(input, command->output(), received,
+                          Clock::GetAbslTime() - received);
+  }
+  if (!evaluated) {
     LOG(WARNING) << "EvalCommand() returned false. Exiting the loop.";
     response->clear();
     return false;
   }
 
-  if (!command.output().SerializeToString(response)) {
+  // |response| is reused across requests by IPCServer, so this only
+  // reallocates when the output is larger than any previous one.
+  if (!command->output().SerializeToString(response)) {
     LOG(WARNING) << "SerializeToString() failed";
     response->clear();
     return true;
   }
 
   // debug message
-  MOZC_VLOG(2) << command;
+  MOZC_VLOG(2) << *command;
 
   return true;
 }
+
+void SessionServer::ResetArena() {
+  const size_t used = arena_->SpaceAllocated();
+  if (used <= arena_block_size_ || arena_block_size_ >= kMaxArenaBlockSize) {
+    arena_->Reset();
+    return;
+  }
+  // The arena has spilled into heap blocks. Replace the initial block with a
+  // larger one so that the next request of the same size fits in it.
+  AllocateArena(std::min(std::bit_ceil(used), kMaxArenaBlockSize));
+  MOZC_VLOG(1) << "Arena block is resized to " << arena_block_size_;
+}
+
+void SessionServer::AllocateArena(size_t block_size) {
+  arena_.reset();
+  arena_block_size_ = block_size;
+  arena_block_ = std::make_unique<char[]>(arena_block_size_);
+  protobuf::ArenaOptions options;
+  options.initial_block = arena_block_.get();
+  options.initial_block_size = arena_block_size_;
+  arena_ = std::make_unique<protobuf::Arena>(options);
+}
 }  // namespace mozc
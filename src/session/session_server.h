@@ -32,12 +32,17 @@
 #ifndef MOZC_SESSION_SESSION_SERVER_H_
 #define MOZC_SESSION_SESSION_SERVER_H_
 
+#include <cstddef>
 #include <memory>
 #include <string>
 
 #include "absl/strings/string_view.h"
+#include "base/protobuf/arena.h"
+#include "base/protobuf/protobuf.h"
+#include "engine/engine_interface.h"
 #include "ipc/ipc.h"
 #include "session/session_handler.h"
+#include "session/session_trace.h"
 
 namespace mozc {
 
@@ -61,8 +66,25 @@ class SessionServer : public IPCServer {
 
   bool Process(absl::string_view request, std::string* response) override;
 
+  // Creates the engine from the data set file at `data_path`. Falls back to
+  // the embedded data set if `data_path` is empty or the file can't be used.
+  static std::unique_ptr<EngineInterface> CreateEngine(
+      absl::string_view data_path, absl::string_view magic_number);
+
  private:
+  // Clears the arena for the next request. The initial block grows to the
+  // largest request seen so far (up to a limit), so that steady-state
+  // requests are served without heap allocations for the messages.
+  void ResetArena();
+  void AllocateArena(size_t block_size);
+
   std::unique_ptr<SessionHandler> session_handler_;
+  // Backing store of `arena_`. Must outlive it.
+  std::unique_ptr<char[]> arena_block_;
+  size_t arena_block_size_ = 0;
+  std::unique_ptr<protobuf::Arena> arena_;
+  // Records the requests when --session_trace_path is set.
+  std::unique_ptr<session::SessionTraceWriter> trace_writer_;
 };
 
 }  // namespace mozc
@@ -0,0 +1,102 @@
+// Copyright 2010-2021, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "session/session_server.h"
+
+#include <memory>
+#include <string>
+
+#include "absl/strings/string_view.h"
+#include "base/file/temp_dir.h"
+#include "base/file_util.h"
+#include "data_manager/data_manager.h"
+#include "engine/engine_factory.h"
+#include "engine/engine_interface.h"
+#include "testing/gunit.h"
+#include "testing/mozctest.h"
+
+namespace mozc {
+namespace {
+
+constexpr absl::string_view kMockMagicNumber = "MOCK";
+
+class SessionServerTest : public testing::TestWithTempUserProfile {
+ protected:
+  static std::string EmbeddedDataVersion() {
+    return std::string(EngineFactory::Create().value()->GetDataVersion());
+  }
+};
+
+TEST_F(SessionServerTest, CreateEngineFromFile) {
+  const std::string mock_path =
+      testing::GetSourcePath({"data_manager", "testing", "mock_mozc.data"});
+  const std::unique_ptr<EngineInterface> engine =
+      SessionServer::CreateEngine(mock_path, kMockMagicNumber);
+  ASSERT_NE(engine, nullptr);
+  const std::string mock_version(
+      DataManager::CreateFromFile(mock_path, kMockMagicNumber)
+          .value()
+          ->GetDataVersion());
+  EXPECT_EQ(engine->GetDataVersion(), mock_version);
+  EXPECT_NE(engine->GetDataVersion(), EmbeddedDataVersion());
+}
+
+TEST_F(SessionServerTest, CreateEngineFallsBackToEmbeddedDataSet) {
+  const std::string embedded_version = EmbeddedDataVersion();
+
+  // No file.
+  std::unique_ptr<EngineInterface> engine =
+      SessionServer::CreateEngine("", kMockMagicNumber);
+  ASSERT_NE(engine, nullptr);
+  EXPECT_EQ(engine->GetDataVersion(), embedded_version);
+
+  // Broken file.
+  const TempFile file = testing::MakeTempFileOrDie();
+  ASSERT_OK(FileUtil::SetContents(file.path(), "broken data set"));
+  engine = SessionServer::CreateEngine(file.path(), kMockMagicNumber);
+  ASSERT_NE(engine, nullptr);
+  EXPECT_EQ(engine->GetDataVersion(), embedded_version);
+
+  // Missing file.
+  engine = SessionServer::CreateEngine(file.path() + ".missing",
+                                       kMockMagicNumber);
+  ASSERT_NE(engine, nullptr);
+  EXPECT_EQ(engine->GetDataVersion(), embedded_version);
+
+  // Wrong magic number.
+  engine = SessionServer::CreateEngine(
+      testing::GetSourcePath({"data_manager", "testing", "mock_mozc.data"}),
+      DataManager::GetDataSetMagicNumber("oss"));
+  ASSERT_NE(engine, nullptr);
+  EXPECT_EQ(engine->GetDataVersion(), embedded_version);
+}
+
+}  // namespace
+}  // namespace mozc
@@ -0,0 +1,162 @@
+// Copyright 2010-2021, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+// Measures the cost of checkpointing a session with SaveSnapshot() and of
+// restoring it into a fresh session with RestoreSnapshot(), in composition and
+// in conversion.
+//
+// session_snapshot_benchmark_main
+//  --keys=watasinonamaehanakanodesu,kyouhaiitenkidesune
+//  --iterations=1000
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "absl/flags/flag.h"
+#include "absl/log/check.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/str_split.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+#include "base/init_mozc.h"
+#include "base/stopwatch.h"
+#include "composer/table.h"
+#include "config/config_handler.h"
+#include "engine/engine.h"
+#include "engine/mock_data_engine_factory.h"
+#include "protocol/commands.pb.h"
+#include "protocol/session_snapshot.pb.h"
+#include "session/session.h"
+
+ABSL_FLAG(std::string, keys,
+          "watasinonamaehanakanodesu,kyouhaiitenkidesune,"
+          "asitanokaigihajuujikarakaisisimasu",
+          "comma separated romaji key sequences to type");
+ABSL_FLAG(int32_t, iterations, 1000, "number of snapshots for each setting");
+
+namespace mozc {
+namespace {
+
+void InitSession(session::Session& session) {
+  const commands::Request& request = commands::Request::default_instance();
+  session.SetRequest(request);
+  auto table = std::make_shared<composer::Table>();
+  table->InitializeWithRequestAndConfig(
+      request, config::ConfigHandler::DefaultConfig());
+  session.SetTable(std::move(table));
+}
+
+void SendKeys(absl::string_view keys, session::Session& session) {
+  commands::Command command;
+  for (const char key : keys) {
+    command.Clear();
+    command.mutable_input()->set_type(commands::Input::SEND_KEY);
+    command.mutable_input()->mutable_key()->set_key_code(key);
+    session.SendKey(&command);
+  }
+}
+
+struct SnapshotResult {
+  size_t bytes = 0;
+  absl::Duration save_time;
+  absl::Duration restore_time;
+};
+
+SnapshotResult Measure(const Engine& engine, session::Session& session,
+                       int iterations) {
+  SnapshotResult result;
+  commands::SessionSnapshot snapshot;
+  std::string serialized;
+  for (int i = 0; i < iterations; ++i) {
+    Stopwatch stopwatch = Stopwatch::StartNew();
+    session.SaveSnapshot(&snapshot);
+    serialized = snapshot.SerializeAsString();
+    result.save_time += stopwatch.GetElapsed();
+
+    session::Session restored(engine);
+    InitSession(restored);
+    stopwatch = Stopwatch::StartNew();
+    commands::SessionSnapshot parsed;
+    CHECK(parsed.ParseFromString(serialized));
+    CHECK(restored.RestoreSnapshot(parsed));
+    result.restore_time += stopwatch.GetElapsed();
+  }
+  result.bytes = serialized.size();
+  return result;
+}
+
+}  // namespace
+}  // namespace mozc
+
+int main(int argc, char** argv) {
+  mozc::InitMozc(argv[0], &argc, &argv);
+
+  absl::StatusOr<std::unique_ptr<mozc::Engine>> engine =
+      mozc::MockDataEngineFactory::Create();
+  CHECK_OK(engine);
+
+  const int iterations = absl::GetFlag(FLAGS_iterations);
+  auto average_us = [iterations](absl::Duration d) {
+    return absl::ToDoubleMicroseconds(d) / iterations;
+  };
+
+  std::cout << absl::StreamFormat("%-40s %-12s %8s %12s %12s\n", "keys",
+                                  "state", "bytes", "save[us]", "restore[us]");
+  for (absl::string_view keys : absl::StrSplit(
+           absl::GetFlag(FLAGS_keys), ',', absl::SkipWhitespace())) {
+    mozc::session::Session session(**engine);
+    mozc::InitSession(session);
+    mozc::SendKeys(keys, session);
+    mozc::SnapshotResult result =
+        mozc::Measure(**engine, session, iterations);
+    std::cout << absl::StreamFormat("%-40s %-12s %8d %12.2f %12.2f\n", keys,
+                                    "composition", result.bytes,
+                                    average_us(result.save_time),
+                                    average_us(result.restore_time));
+
+    mozc::commands::Command command;
+    session.Convert(&command);
+    command.Clear();
+    session.SegmentFocusRight(&command);
+    command.Clear();
+    session.ConvertNext(&command);
+    result = mozc::Measure(**engine, session, iterations);
+    std::cout << absl::StreamFormat("%-40s %-12s %8d %12.2f %12.2f\n", keys,
+                                    "conversion", result.bytes,
+                                    average_us(result.save_time),
+                                    average_us(result.restore_time));
+  }
+  return 0;
+}
@@ -62,6 +62,7 @@
 #include "protocol/candidate_window.pb.h"
 #include "protocol/commands.pb.h"
 #include "protocol/config.pb.h"
+#include "protocol/session_snapshot.pb.h"
 #include "request/conversion_request.h"
 #include "request/request_test_util.h"
 #include "rewriter/transliteration_rewriter.h"
@@ -10279,5 +10280,111 @@ TEST_F(SessionTest, RequestNWP) {
   EXPECT_FALSE(command.output().has_all_candidate_words());
 }
 
+TEST_F(SessionTest, RestoreSnapshotOfComposition) {
+  Session session(*mock_data_engine_);
+  InitSessionToPrecomposition(&session);
+
+  commands::Command command;
+  InsertCharacterChars("kanj", &session, &command);
+  command.Clear();
+  session.MoveCursorLeft(&command);
+
+  commands::SessionSnapshot snapshot;
+  session.SaveSnapshot(&snapshot);
+  EXPECT_EQ(snapshot.state(), ImeContext::COMPOSITION);
+
+  Session restored(*mock_data_engine_);
+  InitSessionToPrecomposition(&restored);
+  ASSERT_TRUE(restored.RestoreSnapshot(snapshot));
+  EXPECT_EQ(restored.context().state(), ImeContext::COMPOSITION);
+  EXPECT_EQ(restored.context().composer().GetStringForPreedit(),
+            session.context().composer().GetStringForPreedit());
+  EXPECT_EQ(restored.context().composer().GetCursor(),
+            session.context().composer().GetCursor());
+
+  // The pending "j" is still composed with the next input.
+  InsertCharacterChars("a", &session, &command);
+  const std::string expected = GetComposition(command);
+  InsertCharacterChars("a", &restored, &command);
+  EXPECT_EQ(GetComposition(command), expected);
+}
+
+TEST_F(SessionTest, RestoreSnapshotOfConversion) {
+  Session session(*mock_data_engine_);
+  InitSessionToPrecomposition(&session);
+
+  commands::Command command;
+  InsertCharacterChars("watasinonamaehanakanodesu", &session, &command);
+  command.Clear();
+  session.Convert(&command);
+  ASSERT_EQ(session.context().state(), ImeContext::CONVERSION);
+  command.Clear();
+  session.SegmentFocusRight(&command);
+  command.Clear();
+  session.ConvertNext(&command);
+
+  commands::SessionSnapshot snapshot;
+  session.SaveSnapshot(&snapshot);
+  EXPECT_EQ(snapshot.state(), ImeContext::CONVERSION);
+  EXPECT_GT(snapshot.converter().segments_size(), 1);
+
+  Session restored(*mock_data_engine_);
+  InitSessionToPrecomposition(&restored);
+  ASSERT_TRUE(restored.RestoreSnapshot(snapshot));
+  EXPECT_EQ(restored.context().state(), ImeContext::CONVERSION);
+
+  commands::SessionSnapshot restored_snapshot;
+  restored.SaveSnapshot(&restored_snapshot);
+  EXPECT_EQ(restored_snapshot.SerializeAsString(),
+            snapshot.SerializeAsString());
+
+  command.Clear();
+  session.Commit(&command);
+  const std::string expected = command.output().result().value();
+  command.Clear();
+  restored.Commit(&command);
+  EXPECT_EQ(command.output().result().value(), expected);
+}
+
+TEST_F(SessionTest, RestoreSnapshotKeepsCompositionOnConversionFailure) {
+  Session session(*mock_data_engine_);
+  InitSessionToPrecomposition(&session);
+
+  commands::Command command;
+  InsertCharacterChars("watasinonamae", &session, &command);
+  command.Clear();
+  session.Convert(&command);
+  ASSERT_EQ(session.context().state(), ImeContext::CONVERSION);
+
+  commands::SessionSnapshot snapshot;
+  session.SaveSnapshot(&snapshot);
+  // The focus out of the segments fails only the conversion.
+  snapshot.mutable_converter()->set_focused_segment(
+      snapshot.converter().segments_size());
+
+  Session restored(*mock_data_engine_);
+  InitSessionToPrecomposition(&restored);
+  ASSERT_TRUE(restored.RestoreSnapshot(snapshot));
+  EXPECT_EQ(restored.context().state(), ImeContext::COMPOSITION);
+  EXPECT_EQ(restored.context().composer().GetStringForPreedit(),
+            session.context().composer().GetStringForPreedit());
+}
+
+TEST_F(SessionTest, RestoreSnapshotWithInvalidState) {
+  Session session(*mock_data_engine_);
+  InitSessionToPrecomposition(&session);
+
+  commands::SessionSnapshot snapshot;
+  snapshot.set_state(ImeContext::NONE);
+  EXPECT_FALSE(session.RestoreSnapshot(snapshot));
+
+  // Cursor is out of the composition.
+  snapshot.set_state(ImeContext::COMPOSITION);
+  snapshot.mutable_composer()->set_position(3);
+  EXPECT_FALSE(session.RestoreSnapshot(snapshot));
+  EXPECT_EQ(session.context().state(), ImeContext::PRECOMPOSITION);
+  EXPECT_TRUE(session.context().composer().Empty());
+}
+
 }  // namespace session
 }  // namespace mozc
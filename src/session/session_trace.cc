@@ -0,0 +1,420 @@
+// Copyright 2010-2021, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "session/session_trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ios>
+#include <limits>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/log/log.h"
+#include "absl/memory/memory.h"
+#include "absl/random/distributions.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
+#include "base/clock.h"
+#include "base/file_stream.h"
+#include "base/file_util.h"
+#include "base/strings/unicode.h"
+#include "base/thread.h"
+#include "base/util.h"
+#include "protocol/commands.pb.h"
+#include "protocol/session_trace.pb.h"
+#include "session/session_handler.h"
+
+namespace mozc {
+namespace session {
+namespace {
+
+constexpr absl::string_view kTraceMagic = "MOZCTRC1";
+constexpr size_t kRecordSizeBytes = 4;
+
+// Letters are replaced within the vowels or the consonants, so that romaji
+// input keeps forming syllables.
+constexpr absl::string_view kLetterClasses[] = {
+    "aeiou",
+    "bcdfghjklmnpqrstvwxyz",
+    "AEIOU",
+    "BCDFGHJKLMNPQRSTVWXYZ",
+};
+
+struct CodepointRange {
+  char32_t first;
+  char32_t last;
+};
+
+// Other classes of the characters kept by the scrubber. Characters in none of
+// them are replaced with a random kanji if they are not ASCII.
+constexpr CodepointRange kCodepointClasses[] = {
+    {'0', '9'},
+    {0x3041, 0x3093},  // Hiragana ぁ..ん
+    {0x30A1, 0x30F3},  // Katakana ァ..ン
+};
+constexpr CodepointRange kKanjiRange = {0x4E00, 0x9FFF};
+
+void AppendUint32(uint32_t value, std::string* output) {
+  for (size_t i = 0; i < kRecordSizeBytes; ++i) {
+    output->push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+  }
+}
+
+uint32_t ReadUint32(absl::string_view data) {
+  uint32_t value = 0;
+  for (size_t i = 0; i < kRecordSizeBytes; ++i) {
+    value |= static_cast<uint32_t>(static_cast<uint8_t>(data[i])) << (8 * i);
+  }
+  return value;
+}
+
+}  // namespace
+
+// ========================================
+// SessionTraceScrubber
+// ========================================
+char32_t SessionTraceScrubber::ScrubCodepoint(const char32_t codepoint) {
+  for (const absl::string_view letters : kLetterClasses) {
+    if (codepoint < 0x80 &&
+        letters.find(static_cast<char>(codepoint)) != absl::string_view::npos) {
+      return letters[absl::Uniform<size_t>(bitgen_, 0, letters.size())];
+    }
+  }
+  for (const CodepointRange& range : kCodepointClasses) {
+    if (range.first <= codepoint && codepoint <= range.last) {
+      return absl::Uniform<char32_t>(absl::IntervalClosed, bitgen_,
+                                     range.first, range.last);
+    }
+  }
+  if (codepoint < 0x80) {
+    // Control keys, spaces and symbols tell little about the contents.
+    return codepoint;
+  }
+  return absl::Uniform<char32_t>(absl::IntervalClosed, bitgen_,
+                                 kKanjiRange.first, kKanjiRange.last);
+}
+
+std::string SessionTraceScrubber::ScrubText(const absl::string_view text) {
+  std::string result;
+  result.reserve(text.size());
+  for (const char32_t codepoint : Utf8AsChars32(text)) {
+    Util::CodepointToUtf8Append(ScrubCodepoint(codepoint), &result);
+  }
+  return result;
+}
+
+void SessionTraceScrubber::ScrubKeyEvent(commands::KeyEvent& key) {
+  if (key.has_key_code()) {
+    key.set_key_code(ScrubCodepoint(key.key_code()));
+  }
+  if (key.has_key_string()) {
+    key.set_key_string(ScrubText(key.key_string()));
+  }
+  for (commands::KeyEvent::ProbableKeyEvent& probable :
+       *key.mutable_probable_key_event()) {
+    if (probable.has_key_code()) {
+      probable.set_key_code(ScrubCodepoint(probable.key_code()));
+    }
+  }
+}
+
+void SessionTraceScrubber::Scrub(commands::Input& input) {
+  if (input.has_key()) {
+    ScrubKeyEvent(*input.mutable_key());
+  }
+  if (input.has_command()) {
+    commands::SessionCommand* command = input.mutable_command();
+    if (command->has_text()) {
+      command->set_text(ScrubText(command->text()));
+    }
+    for (commands::SessionCommand::CompositionEvent& event :
+         *command->mutable_composition_events()) {
+      event.set_composition_string(ScrubText(event.composition_string()));
+    }
+  }
+  if (input.has_context()) {
+    input.mutable_context()->clear_preceding_text();
+    input.mutable_context()->clear_following_text();
+  }
+  // Touch positions reveal the keys on software keyboards.
+  input.clear_touch_events();
+  input.clear_application_info();
+  input.clear_user_dictionary_import_data();
+  input.clear_user_history_data();
+}
+
+// ========================================
+// SessionTraceWriter
+// ========================================
+SessionTraceWriter::SessionTraceWriter(const absl::string_view path)
+    : stream_(path, std::ios_base::out | std::ios_base::binary |
+                        std::ios_base::trunc) {}
+
+// static
+absl::StatusOr<std::unique_ptr<SessionTraceWriter>> SessionTraceWriter::Create(
+    const absl::string_view path) {
+  auto writer = absl::WrapUnique(new SessionTraceWriter(path));
+  absl::MutexLock lock(&writer->mutex_);
+  writer->stream_ << kTraceMagic;
+  writer->stream_.flush();
+  if (!writer->stream_.good()) {
+    return absl::UnavailableError(absl::StrCat("Failed to create ", path));
+  }
+  return writer;
+}
+
+void SessionTraceWriter::Record(const commands::Input& input,
+                                const commands::Output& output,
+                                const absl::Time received,
+                                const absl::Duration latency) {
+  commands::SessionTraceRecord record;
+  *record.mutable_input() = input;
+  record.set_latency_usec(
+      std::max<int64_t>(absl::ToInt64Microseconds(latency), 0));
+  if (input.type() == commands::Input::CREATE_SESSION) {
+    record.set_created_session_id(output.id());
+  }
+
+  absl::MutexLock lock(&mutex_);
+  if (origin_ == absl::InfinitePast()) {
+    origin_ = received;
+  }
+  record.set_timestamp_usec(
+      std::max<int64_t>(absl::ToInt64Microseconds(received - origin_), 0));
+  scrubber_.Scrub(*record.mutable_input());
+
+  std::string data;
+  AppendUint32(record.ByteSizeLong(), &data);
+  record.AppendToString(&data);
+  stream_.write(data.data(), data.size());
+  // The server may be terminated at any time.
+  stream_.flush();
+}
+
+absl::StatusOr<std::vector<commands::SessionTraceRecord>> ReadSessionTrace(
+    const absl::string_view path) {
+  absl::StatusOr<std::string> contents = FileUtil::GetContents(path);
+  if (!contents.ok()) {
+    return contents.status();
+  }
+  absl::string_view data = *contents;
+  if (!data.starts_with(kTraceMagic)) {
+    return absl::InvalidArgumentError(
+        absl::StrCat(path, " is not a session trace"));
+  }
+  data.remove_prefix(kTraceMagic.size());
+
+  std::vector<commands::SessionTraceRecord> records;
+  while (!data.empty()) {
+    if (data.size() < kRecordSizeBytes ||
+        data.size() - kRecordSizeBytes < ReadUint32(data)) {
+      // The last record is being written or the server was terminated.
+      LOG(WARNING) << "Ignoring the truncated record at the end of " << path;
+      break;
+    }
+    const uint32_t size = ReadUint32(data);
+    data.remove_prefix(kRecordSizeBytes);
+    if (!records.emplace_back().ParseFromArray(data.data(), size)) {
+      return absl::DataLossError(
+          absl::StrCat("Broken record #", records.size(), " in ", path));
+    }
+    data.remove_prefix(size);
+  }
+  return records;
+}
+
+// ========================================
+// SessionTraceReplayer
+// ========================================
+// static
+std::vector<std::vector<const commands::SessionTraceRecord*>>
+SessionTraceReplayer::SplitIntoStreams(
+    absl::Span<const commands::SessionTraceRecord> records) {
+  std::vector<const commands::SessionTraceRecord*> global_stream;
+  std::vector<std::vector<const commands::SessionTraceRecord*>> streams;
+  // Recorded session ID to the index of its stream.
+  absl::flat_hash_map<uint64_t, size_t> session_streams;
+  for (const commands::SessionTraceRecord& record : records) {
+    const commands::Input& input = record.input();
+    uint64_t session_id = input.id();
+    if (input.type() == commands::Input::CREATE_SESSION) {
+      session_id = record.created_session_id();
+    }
+    if (session_id == 0) {
+      global_stream.push_back(&record);
+      continue;
+    }
+    // Sessions created before the recording started have no CREATE_SESSION.
+    const auto [it, inserted] =
+        session_streams.try_emplace(session_id, streams.size());
+    if (inserted) {
+      streams.emplace_back();
+    }
+    streams[it->second].push_back(&record);
+  }
+  if (!global_stream.empty()) {
+    streams.insert(streams.begin(), std::move(global_stream));
+  }
+  return streams;
+}
+
+// static
+bool SessionTraceReplayer::IsReplayable(const commands::Input& input) {
+  switch (input.type()) {
+    case commands::Input::SHUTDOWN:
+    case commands::Input::SEND_ENGINE_RELOAD_REQUEST:
+    case commands::Input::RELOAD_SUPPLEMENTAL_MODEL:
+    case commands::Input::IMPORT_USER_DICTIONARY:
+    case commands::Input::ADD_USER_HISTORY:
+    case commands::Input::GET_METRICS:
+      return false;
+    default:
+      return true;
+  }
+}
+
+void SessionTraceReplayer::EvalCommand(commands::Command& command) {
+  absl::MutexLock lock(&handler_mutex_);
+  handler_.EvalCommand(&command);
+}
+
+void SessionTraceReplayer::ReplayStream(
+    absl::Span<const commands::SessionTraceRecord* const> stream,
+    const Options& options, uint64_t origin_usec, absl::Time start,
+    Stats& stats) {
+  if (stream.empty()) {
+    return;
+  }
+  uint64_t session_id = 0;
+  const commands::Input& first_input = stream.front()->input();
+  if (first_input.type() != commands::Input::CREATE_SESSION &&
+      first_input.id() != 0) {
+    commands::Command command;
+    command.mutable_input()->set_type(commands::Input::CREATE_SESSION);
+    EvalCommand(command);
+    session_id = command.output().id();
+  }
+
+  for (const commands::SessionTraceRecord* record : stream) {
+    if (!IsReplayable(record->input())) {
+      ++stats.num_skipped;
+      continue;
+    }
+    if (options.speedup > 0 && record->timestamp_usec() > origin_usec) {
+      const absl::Duration offset =
+          absl::Microseconds(record->timestamp_usec() - origin_usec) /
+          options.speedup;
+      absl::SleepFor(start + offset - Clock::GetAbslTime());
+    }
+
+    commands::Command command;
+    *command.mutable_input() = record->input();
+    if (command.input().id() != 0) {
+      command.mutable_input()->set_id(session_id);
+    }
+    EvalCommand(command);
+    ++stats.num_commands;
+    if (command.output().error_code() != commands::Output::SESSION_SUCCESS) {
+      ++stats.num_failures;
+    }
+    if (command.input().type() == commands::Input::CREATE_SESSION) {
+      session_id = command.output().id();
+    }
+  }
+}
+
+SessionTraceReplayer::Stats SessionTraceReplayer::Replay(
+    absl::Span<const commands::SessionTraceRecord> records,
+    const Options& options) {
+  const std::vector<std::vector<const commands::SessionTraceRecord*>> streams =
+      SplitIntoStreams(records);
+  // The records of all the streams are scheduled at their offsets from the
+  // start of the trace, so that the sessions also start at the recorded
+  // intervals. The repetitions follow one another.
+  uint64_t origin_usec = std::numeric_limits<uint64_t>::max();
+  uint64_t last_usec = 0;
+  for (const commands::SessionTraceRecord& record : records) {
+    origin_usec = std::min<uint64_t>(origin_usec, record.timestamp_usec());
+    last_usec = std::max<uint64_t>(last_usec, record.timestamp_usec());
+  }
+  const absl::Duration repeat_interval =
+      records.empty() || options.speedup <= 0
+          ? absl::ZeroDuration()
+          : absl::Microseconds(last_usec - origin_usec) / options.speedup;
+
+  struct Task {
+    const std::vector<const commands::SessionTraceRecord*>* stream;
+    int repetition;
+  };
+  std::vector<Task> queue;
+  for (int i = 0; i < options.repeat; ++i) {
+    for (const auto& stream : streams) {
+      queue.push_back({&stream, i});
+    }
+  }
+
+  const size_t num_workers = std::max(options.num_threads, 1);
+  std::vector<Stats> worker_stats(num_workers);
+  std::atomic<size_t> next = 0;
+  const absl::Time start = Clock::GetAbslTime();
+  ParallelForRanges(num_workers, num_workers, [&](size_t begin, size_t end) {
+    for (size_t worker = begin; worker < end; ++worker) {
+      for (size_t i = next.fetch_add(1, std::memory_order_relaxed);
+           i < queue.size(); i = next.fetch_add(1, std::memory_order_relaxed)) {
+        ReplayStream(*queue[i].stream, options, origin_usec,
+                     start + repeat_interval * queue[i].repetition,
+                     worker_stats[worker]);
+      }
+    }
+  });
+
+  Stats stats;
+  for (const Stats& worker : worker_stats) {
+    stats.num_commands += worker.num_commands;
+    stats.num_failures += worker.num_failures;
+    stats.num_skipped += worker.num_skipped;
+  }
+  stats.elapsed = Clock::GetAbslTime() - start;
+  return stats;
+}
+
+}  // namespace session
+}  // namespace mozc
@@ -0,0 +1,185 @@
+// Copyright 2010-2021, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Recording and replaying of the commands sent to the session server.
+//
+// SessionServer appends every input to a trace file when --session_trace_path
+// is given. The typed text is replaced with random characters of the same
+// class (lowercase, uppercase, digit, hiragana, katakana, or other), so the
+// trace keeps the length and the shape of the input without its contents.
+// SessionTraceReplayer drives a SessionHandler with the trace to reproduce
+// the load of real usage.
+
+#ifndef MOZC_SESSION_SESSION_TRACE_H_
+#define MOZC_SESSION_SESSION_TRACE_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/random/random.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
+#include "base/file_stream.h"
+#include "protocol/commands.pb.h"
+#include "protocol/session_trace.pb.h"
+#include "session/session_handler.h"
+
+namespace mozc {
+namespace session {
+
+// Removes the user content from inputs.
+//
+// Each character is replaced with a random one of the same class, drawn anew
+// for every occurrence so that equal inputs in a trace are not linkable. The
+// replayed load is therefore an approximation: vowels and consonants are kept
+// apart, but random consonant pairs such as "tk" often don't form kana in
+// romaji input, so fewer of them are converted than in the recording, and the
+// hit rates of the caches are lower since the compositions rarely repeat.
+class SessionTraceScrubber {
+ public:
+  SessionTraceScrubber() = default;
+  template <typename Rng>
+  explicit SessionTraceScrubber(Rng&& rng) : bitgen_(std::forward<Rng>(rng)) {}
+
+  // Replaces the typed text in the key events and the session commands, and
+  // clears the surrounding text, the touch positions, the application
+  // information and the user data to be imported.
+  void Scrub(commands::Input& input);
+
+  // Replaces each character of |text| with a random one of the same class:
+  // ASCII vowels, ASCII consonants (per case), digits, hiragana or katakana.
+  // Other ASCII characters are kept and other characters become kanji.
+  std::string ScrubText(absl::string_view text);
+
+ private:
+  char32_t ScrubCodepoint(char32_t codepoint);
+  void ScrubKeyEvent(commands::KeyEvent& key);
+
+  absl::BitGen bitgen_;
+};
+
+// Appends the inputs evaluated by the server to a trace file. Thread safe.
+class SessionTraceWriter {
+ public:
+  // Creates the trace file |path|, overwriting the existing one.
+  static absl::StatusOr<std::unique_ptr<SessionTraceWriter>> Create(
+      absl::string_view path);
+
+  SessionTraceWriter(const SessionTraceWriter&) = delete;
+  SessionTraceWriter& operator=(const SessionTraceWriter&) = delete;
+
+  // Records |input| received at |received| and its |latency|. |output| is
+  // used to remember the session ID assigned by CREATE_SESSION.
+  void Record(const commands::Input& input, const commands::Output& output,
+              absl::Time received, absl::Duration latency);
+
+ private:
+  explicit SessionTraceWriter(absl::string_view path);
+
+  absl::Mutex mutex_;
+  OutputFileStream stream_ ABSL_GUARDED_BY(mutex_);
+  SessionTraceScrubber scrubber_ ABSL_GUARDED_BY(mutex_);
+  absl::Time origin_ ABSL_GUARDED_BY(mutex_) = absl::InfinitePast();
+};
+
+// Reads all the records of the trace file |path|.
+absl::StatusOr<std::vector<commands::SessionTraceRecord>> ReadSessionTrace(
+    absl::string_view path);
+
+// Replays a trace against a SessionHandler.
+//
+// The records are split into streams, one for each session and one for the
+// commands without a session. The streams are replayed concurrently by the
+// worker threads, and each record is replayed at its offset from the start of
+// the trace. A stream waiting for a free worker starts late and replays its
+// records without waiting until it catches up. SessionHandler is not thread
+// safe, so the commands are evaluated one at a time as the IPC server does.
+// The latencies of the commands are recorded to MetricsRegistry by
+// SessionHandler.
+class SessionTraceReplayer {
+ public:
+  struct Options {
+    // Number of the streams replayed concurrently.
+    int num_threads = 1;
+    // Factor to shorten the intervals between the records. Zero or negative
+    // replays the records without waiting.
+    double speedup = 1.0;
+    // Number of times to replay the trace. Each repetition creates new
+    // sessions and starts when the previous one is scheduled to end.
+    int repeat = 1;
+  };
+
+  struct Stats {
+    uint64_t num_commands = 0;
+    uint64_t num_failures = 0;
+    uint64_t num_skipped = 0;
+    absl::Duration elapsed;
+  };
+
+  explicit SessionTraceReplayer(SessionHandler& handler) : handler_(handler) {}
+
+  SessionTraceReplayer(const SessionTraceReplayer&) = delete;
+  SessionTraceReplayer& operator=(const SessionTraceReplayer&) = delete;
+
+  Stats Replay(absl::Span<const commands::SessionTraceRecord> records,
+               const Options& options);
+
+  // Splits |records| into the streams. Exposed for testing.
+  static std::vector<std::vector<const commands::SessionTraceRecord*>>
+  SplitIntoStreams(absl::Span<const commands::SessionTraceRecord> records);
+
+  // Returns true if the command of |input| is replayed. Commands which stop
+  // the server, read local files or user data, or read the metrics are not.
+  static bool IsReplayable(const commands::Input& input);
+
+ private:
+  // Replays |stream| and adds the counts to |stats|. A record is replayed
+  // at |start| plus its offset from |origin_usec| divided by the speedup.
+  void ReplayStream(
+      absl::Span<const commands::SessionTraceRecord* const> stream,
+      const Options& options, uint64_t origin_usec, absl::Time start,
+      Stats& stats);
+  void EvalCommand(commands::Command& command);
+
+  SessionHandler& handler_;
+  // Serializes the calls of SessionHandler::EvalCommand().
+  absl::Mutex handler_mutex_;
+};
+
+}  // namespace session
+}  // namespace mozc
+
+#endif  // MOZC_SESSION_SESSION_TRACE_H_
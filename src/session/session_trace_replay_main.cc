@@ -0,0 +1,132 @@
+// Copyright 2010-2021, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Replays a session trace recorded with --session_trace_path to generate the
+// recorded load on a SessionHandler, and reports the throughput and the
+// latency histograms of the commands.
+//
+// session_trace_replay_main
+//  --trace=/tmp/session.trace --num_threads=4 --speedup=0 --repeat=10
+
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/log/check.h"
+#include "absl/log/log.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/time/time.h"
+#include "base/file/temp_dir.h"
+#include "base/file_util.h"
+#include "base/init_mozc.h"
+#include "base/metrics.h"
+#include "base/protobuf/message.h"
+#include "base/system_util.h"
+#include "engine/engine_factory.h"
+#include "protocol/commands.pb.h"
+#include "protocol/session_trace.pb.h"
+#include "session/session_handler.h"
+#include "session/session_trace.h"
+
+ABSL_FLAG(std::string, trace, "", "Session trace file to replay");
+ABSL_FLAG(int32_t, num_threads, 1,
+          "Number of sessions replayed concurrently. Sessions overlapping in "
+          "the trace need as many threads, or they start late and replay "
+          "their commands without waiting until they catch up");
+ABSL_FLAG(double, speedup, 1.0,
+          "Replay speed relative to the recording. Each command is scheduled "
+          "at its offset from the start of the trace divided by this factor. "
+          "Commands are still evaluated one at a time, so a slow command "
+          "delays the others. 0 replays the commands without waiting");
+ABSL_FLAG(int32_t, repeat, 1, "Number of times each session is replayed");
+ABSL_FLAG(std::string, profile_dir, "",
+          "Profile dir. The replayed commands overwrite the config and the "
+          "user history there. A new temporary directory is used if empty.");
+
+int main(int argc, char** argv) {
+  mozc::InitMozc(argv[0], &argc, &argv);
+
+  // The trace contains commands like SET_CONFIG and CLEAR_USER_HISTORY, so the
+  // real profile is used only when it is given explicitly.
+  std::string profile_dir = absl::GetFlag(FLAGS_profile_dir);
+  std::optional<mozc::TempDirectory> temp_dir;
+  if (profile_dir.empty()) {
+    absl::StatusOr<mozc::TempDirectory> created =
+        mozc::TempDirectory::Default().CreateTempDirectory();
+    CHECK_OK(created);
+    temp_dir = *std::move(created);
+    profile_dir = temp_dir->path();
+  } else if (absl::Status s = mozc::FileUtil::CreateDirectory(profile_dir);
+             !s.ok() && !absl::IsAlreadyExists(s)) {
+    LOG(ERROR) << s;
+    return 1;
+  }
+  mozc::SystemUtil::SetUserProfileDirectory(profile_dir);
+
+  const std::string trace = absl::GetFlag(FLAGS_trace);
+  absl::StatusOr<std::vector<mozc::commands::SessionTraceRecord>> records =
+      mozc::session::ReadSessionTrace(trace);
+  if (!records.ok()) {
+    LOG(ERROR) << "Failed to read " << trace << ": " << records.status();
+    return 1;
+  }
+
+  mozc::SessionHandler handler(mozc::EngineFactory::Create().value());
+  // Excludes the initialization from the histograms.
+  mozc::MetricsRegistry::Reset();
+
+  mozc::session::SessionTraceReplayer replayer(handler);
+  const mozc::session::SessionTraceReplayer::Stats stats = replayer.Replay(
+      *records, {
+                    .num_threads = absl::GetFlag(FLAGS_num_threads),
+                    .speedup = absl::GetFlag(FLAGS_speedup),
+                    .repeat = absl::GetFlag(FLAGS_repeat),
+                });
+
+  const double seconds = absl::ToDoubleSeconds(stats.elapsed);
+  std::cout << "commands: " << stats.num_commands
+            << "\nfailures: " << stats.num_failures
+            << "\nskipped: " << stats.num_skipped << "\nelapsed: "
+            << stats.elapsed << "\nthroughput: "
+            << (seconds > 0 ? stats.num_commands / seconds : 0)
+            << " commands/s" << std::endl;
+
+  mozc::commands::Command command;
+  command.mutable_input()->set_type(mozc::commands::Input::GET_METRICS);
+  handler.EvalCommand(&command);
+  std::cout << mozc::protobuf::Utf8Format(command.output().metrics())
+            << std::endl;
+  return 0;
+}
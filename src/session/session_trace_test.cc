@@ -0,0 +1,244 @@
+// Copyright 2010-2021, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "session/session_trace.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/random/random.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/ascii.h"
+#include "absl/time/time.h"
+#include "base/file/temp_dir.h"
+#include "base/file_util.h"
+#include "base/util.h"
+#include "engine/mock_data_engine_factory.h"
+#include "protocol/commands.pb.h"
+#include "protocol/session_trace.pb.h"
+#include "session/session_handler.h"
+#include "testing/gmock.h"
+#include "testing/gunit.h"
+#include "testing/mozctest.h"
+
+namespace mozc {
+namespace session {
+namespace {
+
+using ::testing::AnyOf;
+using ::testing::AnyOfArray;
+using ::testing::ElementsAre;
+using ::testing::IsEmpty;
+
+commands::Input MakeInput(commands::Input::CommandType type, uint64_t id) {
+  commands::Input input;
+  input.set_type(type);
+  if (id != 0) {
+    input.set_id(id);
+  }
+  return input;
+}
+
+commands::SessionTraceRecord MakeRecord(commands::Input::CommandType type,
+                                        uint64_t id,
+                                        uint64_t created_session_id = 0) {
+  commands::SessionTraceRecord record;
+  *record.mutable_input() = MakeInput(type, id);
+  if (created_session_id != 0) {
+    record.set_created_session_id(created_session_id);
+  }
+  return record;
+}
+
+TEST(SessionTraceScrubberTest, ScrubText) {
+  SessionTraceScrubber scrubber((absl::BitGen()));
+  const std::string scrubbed = scrubber.ScrubText("kaZE9あア漢 -");
+  const std::vector<std::string> chars = Util::SplitStringToUtf8Chars(scrubbed);
+  ASSERT_EQ(chars.size(), 10);
+  EXPECT_THAT(chars[0], AnyOfArray(Util::SplitStringToUtf8Chars(
+                            "bcdfghjklmnpqrstvwxyz")));
+  EXPECT_THAT(chars[1], AnyOf("a", "e", "i", "o", "u"));
+  EXPECT_THAT(chars[2], AnyOfArray(Util::SplitStringToUtf8Chars(
+                            "BCDFGHJKLMNPQRSTVWXYZ")));
+  EXPECT_THAT(chars[3], AnyOf("A", "E", "I", "O", "U"));
+  EXPECT_TRUE(absl::ascii_isdigit(chars[4][0]));
+  EXPECT_EQ(Util::GetScriptType(chars[5]), Util::HIRAGANA);
+  EXPECT_EQ(Util::GetScriptType(chars[6]), Util::KATAKANA);
+  EXPECT_EQ(Util::GetScriptType(chars[7]), Util::KANJI);
+  EXPECT_EQ(chars[8], " ");
+  EXPECT_EQ(chars[9], "-");
+}
+
+TEST(SessionTraceScrubberTest, Scrub) {
+  SessionTraceScrubber scrubber((absl::BitGen()));
+  commands::Input input = MakeInput(commands::Input::SEND_KEY, 1);
+  input.mutable_key()->set_key_code('a');
+  input.mutable_key()->set_key_string("あいう");
+  input.mutable_key()->set_special_key(commands::KeyEvent::ENTER);
+  input.mutable_context()->set_preceding_text("secret");
+  input.mutable_context()->set_following_text("text");
+  input.mutable_application_info()->set_process_id(1);
+
+  scrubber.Scrub(input);
+  EXPECT_EQ(input.type(), commands::Input::SEND_KEY);
+  EXPECT_EQ(input.id(), 1);
+  EXPECT_THAT(input.key().key_code(), AnyOf('a', 'e', 'i', 'o', 'u'));
+  EXPECT_EQ(Util::CharsLen(input.key().key_string()), 3);
+  EXPECT_EQ(Util::GetScriptType(input.key().key_string()), Util::HIRAGANA);
+  EXPECT_EQ(input.key().special_key(), commands::KeyEvent::ENTER);
+  EXPECT_FALSE(input.context().has_preceding_text());
+  EXPECT_FALSE(input.context().has_following_text());
+  EXPECT_FALSE(input.has_application_info());
+}
+
+TEST(SessionTraceWriterTest, RoundTrip) {
+  TempDirectory temp_dir = testing::MakeTempDirectoryOrDie();
+  const std::string path = FileUtil::JoinPath(temp_dir.path(), "trace");
+  {
+    absl::StatusOr<std::unique_ptr<SessionTraceWriter>> writer =
+        SessionTraceWriter::Create(path);
+    ASSERT_OK(writer);
+
+    const absl::Time start = absl::FromUnixSeconds(1000);
+    commands::Output output;
+    output.set_id(5);
+    (*writer)->Record(MakeInput(commands::Input::CREATE_SESSION, 0), output,
+                      start, absl::Milliseconds(2));
+    commands::Input input = MakeInput(commands::Input::SEND_KEY, 5);
+    input.mutable_key()->set_key_code('k');
+    (*writer)->Record(input, output, start + absl::Milliseconds(100),
+                      absl::Microseconds(300));
+  }
+
+  absl::StatusOr<std::vector<commands::SessionTraceRecord>> records =
+      ReadSessionTrace(path);
+  ASSERT_OK(records);
+  ASSERT_EQ(records->size(), 2);
+  EXPECT_EQ((*records)[0].input().type(), commands::Input::CREATE_SESSION);
+  EXPECT_EQ((*records)[0].created_session_id(), 5);
+  EXPECT_EQ((*records)[0].timestamp_usec(), 0);
+  EXPECT_EQ((*records)[0].latency_usec(), 2000);
+  EXPECT_EQ((*records)[1].input().type(), commands::Input::SEND_KEY);
+  EXPECT_EQ((*records)[1].input().id(), 5);
+  EXPECT_FALSE((*records)[1].has_created_session_id());
+  EXPECT_EQ((*records)[1].timestamp_usec(), 100000);
+  EXPECT_EQ((*records)[1].latency_usec(), 300);
+
+  // A truncated record at the end is ignored.
+  absl::StatusOr<std::string> contents = FileUtil::GetContents(path);
+  ASSERT_OK(contents);
+  contents->resize(contents->size() - 1);
+  ASSERT_OK(FileUtil::SetContents(path, *contents));
+  records = ReadSessionTrace(path);
+  ASSERT_OK(records);
+  EXPECT_EQ(records->size(), 1);
+
+  ASSERT_OK(FileUtil::SetContents(path, "broken"));
+  EXPECT_FALSE(ReadSessionTrace(path).ok());
+}
+
+TEST(SessionTraceReplayerTest, SplitIntoStreams) {
+  const std::vector<commands::SessionTraceRecord> records = {
+      MakeRecord(commands::Input::CREATE_SESSION, 0, 1),
+      MakeRecord(commands::Input::SEND_KEY, 2),
+      MakeRecord(commands::Input::SEND_KEY, 1),
+      MakeRecord(commands::Input::SET_CONFIG, 0),
+      MakeRecord(commands::Input::DELETE_SESSION, 1),
+  };
+  const std::vector<std::vector<const commands::SessionTraceRecord*>> streams =
+      SessionTraceReplayer::SplitIntoStreams(records);
+  EXPECT_THAT(streams, ElementsAre(ElementsAre(&records[3]),
+                                   ElementsAre(&records[0], &records[2],
+                                               &records[4]),
+                                   ElementsAre(&records[1])));
+  EXPECT_THAT(SessionTraceReplayer::SplitIntoStreams({}), IsEmpty());
+}
+
+TEST(SessionTraceReplayerTest, IsReplayable) {
+  EXPECT_TRUE(SessionTraceReplayer::IsReplayable(
+      MakeInput(commands::Input::SEND_KEY, 1)));
+  EXPECT_TRUE(SessionTraceReplayer::IsReplayable(
+      MakeInput(commands::Input::CREATE_SESSION, 0)));
+  EXPECT_FALSE(SessionTraceReplayer::IsReplayable(
+      MakeInput(commands::Input::SHUTDOWN, 0)));
+  EXPECT_FALSE(SessionTraceReplayer::IsReplayable(
+      MakeInput(commands::Input::IMPORT_USER_DICTIONARY, 0)));
+}
+
+class SessionTraceReplayerReplayTest
+    : public testing::TestWithTempUserProfile {};
+
+TEST_F(SessionTraceReplayerReplayTest, Replay) {
+  std::vector<commands::SessionTraceRecord> records = {
+      MakeRecord(commands::Input::CREATE_SESSION, 0, 1),
+      MakeRecord(commands::Input::SEND_KEY, 1),
+      MakeRecord(commands::Input::DELETE_SESSION, 1),
+      // A session created before the recording.
+      MakeRecord(commands::Input::SEND_KEY, 2),
+      MakeRecord(commands::Input::SHUTDOWN, 0),
+  };
+  records[1].mutable_input()->mutable_key()->set_key_code('a');
+  records[3].mutable_input()->mutable_key()->set_key_code('k');
+
+  SessionHandler handler(MockDataEngineFactory::Create().value());
+  SessionTraceReplayer replayer(handler);
+  const SessionTraceReplayer::Stats stats =
+      replayer.Replay(records, {.num_threads = 2, .speedup = 0, .repeat = 3});
+  EXPECT_EQ(stats.num_commands, 12);
+  EXPECT_EQ(stats.num_failures, 0);
+  EXPECT_EQ(stats.num_skipped, 3);
+  EXPECT_TRUE(handler.IsAvailable());
+}
+
+TEST_F(SessionTraceReplayerReplayTest, ReplayAtOffsetsFromTraceStart) {
+  // The second session starts one second after the first one.
+  std::vector<commands::SessionTraceRecord> records = {
+      MakeRecord(commands::Input::SEND_KEY, 1),
+      MakeRecord(commands::Input::SEND_KEY, 2),
+  };
+  records[0].mutable_input()->mutable_key()->set_key_code('a');
+  records[1].mutable_input()->mutable_key()->set_key_code('k');
+  records[1].set_timestamp_usec(1000000);
+
+  SessionHandler handler(MockDataEngineFactory::Create().value());
+  SessionTraceReplayer replayer(handler);
+  const SessionTraceReplayer::Stats stats =
+      replayer.Replay(records, {.num_threads = 2, .speedup = 10, .repeat = 2});
+  EXPECT_EQ(stats.num_commands, 4);
+  EXPECT_EQ(stats.num_failures, 0);
+  // The second repetition starts after the first one, and its second session
+  // starts 100 ms later.
+  EXPECT_GE(stats.elapsed, absl::Milliseconds(200));
+}
+
+}  // namespace
+}  // namespace session
+}  // namespace mozc
@@ -30,13 +30,20 @@
 #ifndef MOZC_STORAGE_LRU_CACHE_H_
 #define MOZC_STORAGE_LRU_CACHE_H_
 
+#include <algorithm>
+#include <array>
+#include <bit>
 #include <cstddef>
+#include <cstdint>
 #include <iterator>
+#include <limits>
 #include <memory>
 #include <type_traits>
+#include <utility>
 
 #include "absl/base/nullability.h"
-#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/hash/hash.h"
 #include "absl/log/check.h"
 
 namespace mozc {
@@ -44,16 +51,19 @@ namespace storage {
 
 // Note: this class keeps some resources inside of the Key/Value, even if
 // such a entry is erased. Be careful to use for such classes.
-// TODO(yukawa): Make this class final once we stop supporting GCC 4.6.
+//
+// Elements are stored in slots of a few contiguous blocks and linked by 32-bit
+// indices instead of pointers. The hash table only stores slot indices and
+// hashes keys through the slots, so each entry costs two indices in the slot
+// and one index in the table besides the key and the value. Elements never
+// move once allocated, so pointers to them stay valid until they are erased.
 template <typename Key, typename Value>
 class LruCache {
+ private:
+  struct Slot;
+
  public:
-  // Every Element is either on the free list or the lru list.  The
-  // free list is singly-linked and only uses the next pointer, while
-  // the LRU list is doubly-linked and uses both next and prev.
   struct Element {
-    Element* absl_nullable next;
-    Element* absl_nullable prev;
     Key key;
     Value value;
   };
@@ -66,17 +76,20 @@ class LruCache {
     using difference_type = ptrdiff_t;
     using pointer = value_type*;
     using reference = value_type&;
+    using cache_type = std::conditional_t<is_const, const LruCache, LruCache>;
 
-    explicit Iterator(pointer element)
-        : current_(element), next_(element ? element->next : nullptr) {}
+    Iterator(cache_type* cache, uint32_t index)
+        : cache_(cache),
+          current_(index),
+          next_(index == kNil ? kNil : cache->slot(index).next) {}
 
-    reference operator*() const { return *current_; }
-    pointer operator->() const { return current_; }
+    reference operator*() const { return cache_->slot(current_).element; }
+    pointer operator->() const { return &cache_->slot(current_).element; }
 
     Iterator& operator++() {
       current_ = next_;
       // Capture `next` for when it's changed before the next increment.
-      next_ = current_ ? current_->next : nullptr;
+      next_ = current_ == kNil ? kNil : cache_->slot(current_).next;
       return *this;
     }
 
@@ -88,8 +101,9 @@ class LruCache {
     }
 
    private:
-    pointer current_;
-    pointer next_;
+    cache_type* cache_;
+    uint32_t current_;
+    uint32_t next_;
   };
   using iterator = Iterator</*is_const=*/false>;
   using const_iterator = Iterator</*is_const=*/true>;
@@ -102,10 +116,10 @@ class LruCache {
   LruCache& operator=(const LruCache&) = delete;
 
   // Iterators
-  iterator begin() { return iterator{lru_head_}; }
-  iterator end() { return iterator{nullptr}; }
-  const_iterator begin() const { return const_iterator{lru_head_}; }
-  const_iterator end() const { return const_iterator{nullptr}; }
+  iterator begin() { return iterator{this, lru_head_}; }
+  iterator end() { return iterator{this, kNil}; }
+  const_iterator begin() const { return const_iterator{this, lru_head_}; }
+  const_iterator end() const { return const_iterator{this, kNil}; }
 
   // Adds the specified key/value pair into the cache, putting it at the head
   // of the LRU list. Can pass rvalue reference to move the ownership.
@@ -144,203 +158,233 @@ class LruCache {
 
   // Returns the number of entries currently in the cache.
   size_t Size() const { return table_.size(); }
-  bool empty() const { return lru_head_ == nullptr; }
+  bool empty() const { return lru_head_ == kNil; }
 
-  bool HasKey(const Key& key) const { return table_.find(key) != table_.end(); }
+  bool HasKey(const Key& key) const { return table_.contains(key); }
 
   // Returns the head of LRU list
-  const Element* absl_nullable Head() const { return lru_head_; }
-  Element* absl_nullable MutableHead() { return lru_head_; }
+  const Element* absl_nullable Head() const { return ElementAt(lru_head_); }
+  Element* absl_nullable MutableHead() { return ElementAt(lru_head_); }
 
   // Returns the tail of LRU list
-  const Element* absl_nullable Tail() const { return lru_tail_; }
-  Element* absl_nullable MutableTail() { return lru_tail_; }
+  const Element* absl_nullable Tail() const { return ElementAt(lru_tail_); }
+  Element* absl_nullable MutableTail() { return ElementAt(lru_tail_); }
 
-  // Expose the free list only for testing purposes.
-  const Element* absl_nullable FreeListForTesting() const { return free_list_; }
+  // Returns the number of allocated elements not in use. Only for testing.
+  size_t FreeListSizeForTesting() const;
 
  private:
-  // Allocates a new block containing next_block_size_ elements, updates
-  // next_block_size_ appropriately, and pushes the elements in the new block
-  // onto the free list.
+  static constexpr uint32_t kNil = std::numeric_limits<uint32_t>::max();
+  // Blocks after the first one are allocated with the doubling sizes starting
+  // from this size, so that the cache uses a small amount of memory when it
+  // contains few items but still has low malloc overhead per insert.
+  static constexpr int kLog2BaseBlockSize = 6;
+  static constexpr size_t kBaseBlockSize = size_t{1} << kLog2BaseBlockSize;
+  static constexpr size_t kMaxBlocks = 32 - kLog2BaseBlockSize + 1;
+
+  // Every Slot is either on the free list or the lru list.  The
+  // free list is singly-linked and only uses the next index, while
+  // the LRU list is doubly-linked and uses both next and prev.
+  struct Slot {
+    Element element;
+    uint32_t prev = kNil;
+    uint32_t next = kNil;
+  };
+
+  // The hash table stores slot indices. Keys are compared and hashed through
+  // the slots, so they are not duplicated in the table.
+  struct SlotIndex {
+    uint32_t index;
+  };
+  struct SlotIndexHash {
+    using is_transparent = void;
+    size_t operator()(SlotIndex i) const {
+      return absl::Hash<Key>()(cache->slot(i.index).element.key);
+    }
+    size_t operator()(const Key& key) const { return absl::Hash<Key>()(key); }
+    const LruCache* cache;
+  };
+  struct SlotIndexEq {
+    using is_transparent = void;
+    bool operator()(SlotIndex a, SlotIndex b) const {
+      return a.index == b.index;
+    }
+    bool operator()(SlotIndex a, const Key& key) const {
+      return cache->slot(a.index).element.key == key;
+    }
+    bool operator()(const Key& key, SlotIndex b) const {
+      return (*this)(b, key);
+    }
+    const LruCache* cache;
+  };
+
+  Slot& slot(uint32_t index) {
+    return const_cast<Slot&>(std::as_const(*this).slot(index));
+  }
+  const Slot& slot(uint32_t index) const {
+    DCHECK_LT(index, capacity_);
+    if (index < first_block_size_) {
+      return blocks_[0][index];
+    }
+    // Only reached when the first block has kBaseBlockSize slots. Block b
+    // (b >= 1) starts at kBaseBlockSize << (b - 1).
+    const int block = std::bit_width(index >> kLog2BaseBlockSize);
+    return blocks_[block][index - (kBaseBlockSize << (block - 1))];
+  }
+
+  Element* absl_nullable ElementAt(uint32_t index) {
+    return index == kNil ? nullptr : &slot(index).element;
+  }
+  const Element* absl_nullable ElementAt(uint32_t index) const {
+    return index == kNil ? nullptr : &slot(index).element;
+  }
+
+  // Allocates the next block and pushes its slots onto the free list.
   void AddBlock();
 
-  // Pushes an element onto the head of the free list.
-  void PushFreeList(Element* absl_nonnull element);
-
-  // Pops an element from the head of the free list.
-  Element* absl_nullable PopFreeList();
-
-  // Returns a free element, popping from the free list if possible, or
-  // allocating a new element if the free list is empty.  If there are already
-  // max_elements_ in use this will return NULL.
-  Element* absl_nullable NextFreeElement();
-
-  // Returns the Element* associated with key, or NULL if no element with this
-  // key is found.
-  Element* absl_nullable LookupInternal(const Key& key) const;
-
-  // Removes the specified element from the LRU list.
-  void RemoveFromLRU(Element* absl_nonnull element);
-
-  // Adds the specified element to the head of the LRU list.
-  void PushLRUHead(Element* absl_nonnull element);
-
-  // Evict is similar to Erase, except that it adds the eviction callback and
-  // element to a list of eviction calls, and takes an element so that another
-  // lookup is not necessary.
-  bool Evict(Element* absl_nullable element);
-
-  absl::flat_hash_map<Key, Element*> table_;
-  Element* free_list_ = nullptr;  // singly linked list of Element
-  Element* lru_head_ = nullptr;   // head of doubly linked list of Element
-  Element* lru_tail_ = nullptr;   // tail of doubly linked list of Element
-  std::unique_ptr<Element[]> blocks_[10];  // blocks of Element, with each
-  //   block being twice as big as the previous block.  This allows the cache to
-  //   use a small amount of memory when it contains few items, but still have
-  //   low malloc overhead per insert.  The number of blocks is arbitrary, but
-  //   10 blocks allows the largest block to be 2^10 times as large as the
-  //   smallest block, which seems like more than enough.
-  size_t block_count_ = 0;      // how many entries in blocks_ have been used
-  size_t block_capacity_ = 0;   // num elements the current blocks can hold
-  size_t next_block_size_ = 0;  // size of the next block to allocate
-  const size_t max_elements_;   // maximum elements to hold
+  // Pushes a slot onto the head of the free list.
+  void PushFreeList(uint32_t index);
+
+  // Returns a free slot, popping from the free list if possible, or
+  // allocating a new block if the free list is empty.  If there are already
+  // max_elements_ in use this will return kNil.
+  uint32_t NextFreeSlot();
+
+  // Returns the index of the slot associated with key, or kNil if no element
+  // with this key is found.
+  uint32_t LookupInternal(const Key& key) const;
+
+  // Removes the specified slot from the LRU list.
+  void RemoveFromLRU(uint32_t index);
+
+  // Adds the specified slot to the head of the LRU list.
+  void PushLRUHead(uint32_t index);
+
+  // Removes the slot from the table and the LRU list, and pushes it onto the
+  // free list.
+  bool Evict(uint32_t index);
+
+  absl::flat_hash_set<SlotIndex, SlotIndexHash, SlotIndexEq> table_;
+  uint32_t free_list_ = kNil;  // singly linked list of Slot
+  uint32_t lru_head_ = kNil;   // head of doubly linked list of Slot
+  uint32_t lru_tail_ = kNil;   // tail of doubly linked list of Slot
+  std::array<std::unique_ptr<Slot[]>, kMaxBlocks> blocks_;
+  size_t block_count_ = 0;  // how many entries in blocks_ have been used
+  size_t capacity_ = 0;     // num slots the current blocks can hold
+  // The first block holds all the elements for small caches. Otherwise it is
+  // kBaseBlockSize.
+  const size_t first_block_size_;
+  const size_t max_elements_;  // maximum elements to hold
 };
 
 template <typename Key, typename Value>
-void LruCache<Key, Value>::AddBlock() {
-  const size_t max_blocks = sizeof(blocks_) / sizeof(blocks_[0]);
-  if (block_count_ < max_blocks && block_capacity_ < max_elements_) {
-    blocks_[block_count_] = std::make_unique<Element[]>(next_block_size_);
-    block_capacity_ += next_block_size_;
-    // Add new elements to free list
-    for (size_t i = 0; i < next_block_size_; ++i) {
-      Element* e = &((blocks_[block_count_])[i]);
-      e->prev = nullptr;  // free list is not doubly linked
-      e->next = free_list_;
-      free_list_ = e;
-    }
-    block_count_++;
-    size_t blocks_remaining = max_blocks - block_count_;
-    if (blocks_remaining > 0) {
-      next_block_size_ = (next_block_size_ << 1);
-      size_t elements_remaining = max_elements_ - block_capacity_;
-      if (next_block_size_ > (elements_remaining / blocks_remaining)) {
-        next_block_size_ = elements_remaining / blocks_remaining;
-      }
-      if (block_capacity_ + next_block_size_ > max_elements_) {
-        next_block_size_ = max_elements_ - block_capacity_;
-      }
-    }
-  }
+LruCache<Key, Value>::LruCache(size_t max_elements)
+    : table_(0, SlotIndexHash{this}, SlotIndexEq{this}),
+      first_block_size_(max_elements <= 2 * kBaseBlockSize ? max_elements
+                                                           : kBaseBlockSize),
+      max_elements_(max_elements) {
+  CHECK_LT(max_elements_, kNil);
 }
 
 template <typename Key, typename Value>
-void LruCache<Key, Value>::PushFreeList(Element* absl_nonnull element) {
-  element->prev = nullptr;
-  element->next = free_list_;
-  free_list_ = element;
+void LruCache<Key, Value>::AddBlock() {
+  if (capacity_ >= max_elements_) {
+    return;
+  }
+  DCHECK_LT(block_count_, kMaxBlocks);
+  // Block b (b >= 1) has kBaseBlockSize << (b - 1) slots, which is the same
+  // as the total size of the previous blocks. The last block is truncated at
+  // max_elements_.
+  size_t block_size = block_count_ == 0 ? first_block_size_ : capacity_;
+  block_size = std::min(block_size, max_elements_ - capacity_);
+  blocks_[block_count_] = std::make_unique<Slot[]>(block_size);
+  ++block_count_;
+  const size_t begin = capacity_;
+  capacity_ += block_size;
+  // Push in the reverse order so that slots are used from the lower indices.
+  for (size_t i = block_size; i > 0; --i) {
+    PushFreeList(begin + i - 1);
+  }
 }
 
 template <typename Key, typename Value>
-typename LruCache<Key, Value>::Element* absl_nullable
-LruCache<Key, Value>::PopFreeList() {
-  Element* r = free_list_;
-  if (r != nullptr) {
-    CHECK(r->prev == nullptr);
-    free_list_ = r->next;
-    if (free_list_ != nullptr) {
-      free_list_->prev = nullptr;
-    }
-    r->next = nullptr;
-  }
-  return r;
+void LruCache<Key, Value>::PushFreeList(uint32_t index) {
+  Slot& s = slot(index);
+  s.prev = kNil;  // free list is not doubly linked
+  s.next = free_list_;
+  free_list_ = index;
 }
 
 template <typename Key, typename Value>
-typename LruCache<Key, Value>::Element* absl_nullable
-LruCache<Key, Value>::NextFreeElement() {
-  Element* r = PopFreeList();
-  if (r == nullptr) {
+uint32_t LruCache<Key, Value>::NextFreeSlot() {
+  if (free_list_ == kNil) {
     AddBlock();
-    r = PopFreeList();
   }
-  return r;
+  const uint32_t index = free_list_;
+  if (index != kNil) {
+    Slot& s = slot(index);
+    free_list_ = s.next;
+    s.next = kNil;
+  }
+  return index;
 }
 
 template <typename Key, typename Value>
-typename LruCache<Key, Value>::Element* absl_nullable
-LruCache<Key, Value>::LookupInternal(const Key& key) const {
+uint32_t LruCache<Key, Value>::LookupInternal(const Key& key) const {
   if (auto iter = table_.find(key); iter != table_.end()) {
-    return iter->second;
+    return iter->index;
   }
-  return nullptr;
+  return kNil;
 }
 
 template <typename Key, typename Value>
-void LruCache<Key, Value>::RemoveFromLRU(Element* absl_nonnull element) {
-  if (lru_head_ == element) {
-    lru_head_ = element->next;
+void LruCache<Key, Value>::RemoveFromLRU(uint32_t index) {
+  Slot& s = slot(index);
+  if (lru_head_ == index) {
+    lru_head_ = s.next;
   }
-  if (lru_tail_ == element) {
-    lru_tail_ = element->prev;
+  if (lru_tail_ == index) {
+    lru_tail_ = s.prev;
   }
-  if (element->prev != nullptr) {
-    element->prev->next = element->next;
+  if (s.prev != kNil) {
+    slot(s.prev).next = s.next;
   }
-  if (element->next != nullptr) {
-    element->next->prev = element->prev;
+  if (s.next != kNil) {
+    slot(s.next).prev = s.prev;
   }
-  element->prev = nullptr;
-  element->next = nullptr;
+  s.prev = kNil;
+  s.next = kNil;
 }
 
 template <typename Key, typename Value>
-void LruCache<Key, Value>::PushLRUHead(Element* absl_nonnull element) {
-  if (lru_head_ == element) {
+void LruCache<Key, Value>::PushLRUHead(uint32_t index) {
+  if (lru_head_ == index) {
     // element is already at head, so do nothing.
     return;
   }
-  RemoveFromLRU(element);
-  element->next = lru_head_;
-  lru_head_ = element;
-  if (element->next != nullptr) {
-    element->next->prev = element;
+  RemoveFromLRU(index);
+  Slot& s = slot(index);
+  s.next = lru_head_;
+  lru_head_ = index;
+  if (s.next != kNil) {
+    slot(s.next).prev = index;
   }
-  if (lru_tail_ == nullptr) {
-    lru_tail_ = element;
+  if (lru_tail_ == kNil) {
+    lru_tail_ = index;
   }
 }
 
 template <typename Key, typename Value>
-bool LruCache<Key, Value>::Evict(Element* absl_nullable e) {
-  if (e != nullptr) {
-    const int erased = table_.erase(e->key);
-    CHECK_EQ(erased, 1);
-    RemoveFromLRU(e);
-    PushFreeList(e);
-    return true;
-  }
-  return false;
-}
-
-template <typename Key, typename Value>
-LruCache<Key, Value>::LruCache(size_t max_elements)
-    : max_elements_(max_elements) {
-  if (max_elements_ <= 128) {
-    next_block_size_ = max_elements_;
-  } else {
-    next_block_size_ = 64;
-    size_t num_blocks = sizeof(blocks_) / sizeof(blocks_[0]);
-    // The default starting block size is 64, which is 2^6.  Every block is
-    // twice as big as the previous (see AddBlock()), so the size of the last
-    // block would be 2^(6 + num_blocks) if the first block was of size 64.  If
-    // max_elements is large enough that 64 is too low of a starting size,
-    // figure that out here.
-    while ((next_block_size_ << num_blocks) < max_elements) {
-      next_block_size_ = (next_block_size_ << 1);
-    }
+bool LruCache<Key, Value>::Evict(uint32_t index) {
+  if (index == kNil) {
+    return false;
   }
+  // Erase from the table first as it hashes the key stored in the slot.
+  const size_t erased = table_.erase(SlotIndex{index});
+  CHECK_EQ(erased, 1);
+  RemoveFromLRU(index);
+  PushFreeList(index);
+  return true;
 }
 
 template <typename Key, typename Value>
@@ -355,34 +399,34 @@ template <typename Key, typename Value>
 typename LruCache<Key, Value>::Element* absl_nonnull
 LruCache<Key, Value>::Insert(const Key& key) {
   bool erased = false;
-  Element* e = LookupInternal(key);
-  if (e != nullptr) {
-    erased = Evict(e);
+  uint32_t index = LookupInternal(key);
+  if (index != kNil) {
+    erased = Evict(index);
     CHECK(erased);
   }
 
-  e = NextFreeElement();
-  if (e == nullptr) {
+  index = NextFreeSlot();
+  if (index == kNil) {
     // no free elements, I have to replace an existing element
-    e = lru_tail_;
-    erased = Evict(e);
+    erased = Evict(lru_tail_);
     CHECK(erased);
-    e = NextFreeElement();
-    CHECK(e != nullptr);
+    index = NextFreeSlot();
+    CHECK_NE(index, kNil);
   }
-  e->key = key;
-  table_[key] = e;
-  PushLRUHead(e);
+  Slot& s = slot(index);
+  s.element.key = key;
+  table_.insert(SlotIndex{index});
+  PushLRUHead(index);
 
-  return e;
+  return &s.element;
 }
 
 template <typename Key, typename Value>
 Value* absl_nullable LruCache<Key, Value>::MutableLookup(const Key& key) {
-  Element* e = LookupInternal(key);
-  if (e != nullptr) {
-    PushLRUHead(e);
-    return &(e->value);
+  const uint32_t index = LookupInternal(key);
+  if (index != kNil) {
+    PushLRUHead(index);
+    return &slot(index).element.value;
   }
   return nullptr;
 }
@@ -390,9 +434,9 @@ Value* absl_nullable LruCache<Key, Value>::MutableLookup(const Key& key) {
 template <typename Key, typename Value>
 Value* absl_nullable LruCache<Key, Value>::MutableLookupWithoutInsert(
     const Key& key) {
-  Element* e = LookupInternal(key);
-  if (e != nullptr) {
-    return &(e->value);
+  const uint32_t index = LookupInternal(key);
+  if (index != kNil) {
+    return &slot(index).element.value;
   }
   return nullptr;
 }
@@ -400,26 +444,36 @@ Value* absl_nullable LruCache<Key, Value>::MutableLookupWithoutInsert(
 template <typename Key, typename Value>
 const Value* absl_nullable LruCache<Key, Value>::LookupWithoutInsert(
     const Key& key) const {
-  Element* e = LookupInternal(key);
-  if (e != nullptr) {
-    return &(e->value);
+  const uint32_t index = LookupInternal(key);
+  if (index != kNil) {
+    return &slot(index).element.value;
   }
   return nullptr;
 }
 
 template <typename Key, typename Value>
 bool LruCache<Key, Value>::Erase(const Key& key) {
-  Element* e = LookupInternal(key);
-  return Evict(e);
+  return Evict(LookupInternal(key));
 }
 
 template <typename Key, typename Value>
 void LruCache<Key, Value>::Clear() {
   table_.clear();
-  for (Element& e : *this) {
-    PushFreeList(&e);
+  for (uint32_t index = lru_head_; index != kNil;) {
+    const uint32_t next = slot(index).next;
+    PushFreeList(index);
+    index = next;
+  }
+  lru_head_ = lru_tail_ = kNil;
+}
+
+template <typename Key, typename Value>
+size_t LruCache<Key, Value>::FreeListSizeForTesting() const {
+  size_t size = 0;
+  for (uint32_t index = free_list_; index != kNil; index = slot(index).next) {
+    ++size;
   }
-  lru_head_ = lru_tail_ = nullptr;
+  return size;
 }
 
 }  // namespace storage
@@ -30,8 +30,10 @@
 #include "storage/lru_cache.h"
 
 #include <cstddef>
+#include <string>
 #include <vector>
 
+#include "absl/strings/str_cat.h"
 #include "testing/gmock.h"
 #include "testing/gunit.h"
 
@@ -43,13 +45,7 @@ using ::testing::ElementsAre;
 
 template <typename Key, typename Value>
 size_t SizeOfFreeList(const LruCache<Key, Value>& cache) {
-  size_t size = 0;
-  for (const typename LruCache<Key, Value>::Element* e =
-           cache.FreeListForTesting();
-       e; e = e->next) {
-    ++size;
-  }
-  return size;
+  return cache.FreeListSizeForTesting();
 }
 
 template <typename Key, typename Value>
@@ -144,6 +140,51 @@ TEST(LruCacheTest, Clear) {
   EXPECT_EQ(SizeOfFreeList(cache), 5);
 }
 
+TEST(LruCacheTest, StringKey) {
+  LruCache<std::string, int> cache(100);
+  for (int i = 0; i < 200; ++i) {
+    cache.Insert(absl::StrCat("key", i), i);
+  }
+  EXPECT_EQ(cache.Size(), 100);
+  EXPECT_EQ(cache.Lookup("key99"), nullptr);
+  ASSERT_NE(cache.Lookup("key100"), nullptr);
+  EXPECT_EQ(*cache.Lookup("key100"), 100);
+  EXPECT_EQ(cache.Head()->key, "key100");
+  EXPECT_EQ(cache.Tail()->key, "key101");
+}
+
+TEST(LruCacheTest, ElementsDoNotMove) {
+  // Covers several blocks.
+  LruCache<int, int> cache(1000);
+  std::vector<const LruCache<int, int>::Element*> elements;
+  for (int i = 0; i < 1000; ++i) {
+    elements.push_back(cache.Insert(i));
+    cache.MutableHead()->value = i;
+  }
+  for (int i = 0; i < 1000; ++i) {
+    EXPECT_EQ(cache.LookupWithoutInsert(i), &elements[i]->value);
+    EXPECT_EQ(elements[i]->value, i);
+  }
+  EXPECT_EQ(SizeOfFreeList(cache), 0);
+
+  // Erased elements are reused by the following insertions.
+  EXPECT_TRUE(cache.Erase(500));
+  EXPECT_EQ(cache.Insert(1000), elements[500]);
+}
+
+TEST(LruCacheTest, EraseWhileIterating) {
+  LruCache<int, int> cache(10);
+  for (int i = 0; i < 10; ++i) {
+    cache.Insert(i, i);
+  }
+  for (const LruCache<int, int>::Element& elem : cache) {
+    if (elem.key % 2 == 0) {
+      cache.Erase(elem.key);
+    }
+  }
+  EXPECT_THAT(GetOrderedKeys(cache), ElementsAre(9, 7, 5, 3, 1));
+}
+
 TEST(LruCacheTest, LargeCapacity) {
   constexpr int kCapacity = 1000000;
   LruCache<int, int> cache(kCapacity);
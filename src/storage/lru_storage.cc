@@ -44,13 +44,16 @@
 
 #include "absl/algorithm/container.h"
 #include "absl/base/nullability.h"
+#include "absl/container/fixed_array.h"
 #include "absl/container/flat_hash_set.h"
 #include "absl/log/check.h"
 #include "absl/log/log.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
 #include "absl/time/time.h"
+#include "absl/types/span.h"
 #include "base/bits.h"
 #include "base/clock.h"
 #include "base/file_stream.h"
@@ -67,10 +70,30 @@ constexpr size_t kMaxLruSize = 1000000;  // 1M
 constexpr size_t kMaxValueSize = 1024;   // 1024 byte
 
 // The byte length used to store LRU properties.
+// * 4 bytes for kFileMagic
+// * 4 bytes for the format version
 // * 4 bytes for user specified value size
 // * 4 bytes for LRU capacity
 // * 4 bytes for fingerprint seed
-constexpr size_t kFileHeaderSize = 12;
+constexpr size_t kFileHeaderSize = 20;
+
+// The legacy format has no magic nor version, and starts with the value size.
+// The magic is larger than kMaxValueSize so that the formats are told apart.
+constexpr uint32_t kFileMagic = 0x55524c4d;  // "MLRU"
+
+// Version 1 uses CityFingerprintWithSeed. The legacy format (version 0) used
+// LegacyFingerprintWithSeed, which is several times slower.
+constexpr uint32_t kFormatVersion = 1;
+constexpr size_t kLegacyFileHeaderSize = 12;
+
+// Fingerprints are stored with the top bit cleared. Entries migrated from the
+// legacy format keep their legacy fingerprint with the top bit set until they
+// are accessed again, as the keys are not stored.
+constexpr uint64_t kLegacyFingerprintBit = uint64_t{1} << 63;
+
+bool IsLegacyFingerprint(uint64_t fp) {
+  return (fp & kLegacyFingerprintBit) != 0;
+}
 
 uint64_t GetFP(const char* ptr) { return LoadUnaligned<uint64_t>(ptr); }
 
@@ -150,6 +173,9 @@ bool LruStorage::CreateStorageFile(const char* filename, size_t value_size,
   const uint32_t value_size_uint32 = static_cast<uint32_t>(value_size);
   const uint32_t size_uint32 = static_cast<uint32_t>(size);
 
+  ofs.write(reinterpret_cast<const char*>(&kFileMagic), sizeof(kFileMagic));
+  ofs.write(reinterpret_cast<const char*>(&kFormatVersion),
+            sizeof(kFormatVersion));
   ofs.write(reinterpret_cast<const char*>(&value_size_uint32),
             sizeof(value_size_uint32));
   ofs.write(reinterpret_cast<const char*>(&size_uint32), sizeof(size_uint32));
@@ -175,7 +201,7 @@ bool LruStorage::Clear() {
   if (mmap_.empty() || lru_list_.empty()) {
     return true;
   }
-  const size_t offset = sizeof(value_size_) + sizeof(size_) + sizeof(seed_);
+  const size_t offset = kFileHeaderSize;
   if (offset >= mmap_.size()) {  // should not happen
     return false;
   }
@@ -323,14 +349,94 @@ bool LruStorage::Open(const char* filename) {
     return false;
   }
 
+  if (LoadUnaligned<uint32_t>(mmap_.begin()) != kFileMagic) {
+    mmap_.Close();
+    if (!MigrateLegacyFile(filename)) {
+      return false;
+    }
+    mmap = Mmap::Map(filename, Mmap::READ_WRITE);
+    if (!mmap.ok()) {
+      LOG(ERROR) << "Cannot open " << filename << ": " << mmap.status();
+      return false;
+    }
+    mmap_ = *std::move(mmap);
+  }
+
   filename_ = filename;
   return Open(mmap_.begin(), mmap_.size());
 }
 
+bool LruStorage::MigrateLegacyFile(const char* filename) {
+  absl::StatusOr<std::string> contents = FileUtil::GetContents(filename);
+  if (!contents.ok()) {
+    LOG(ERROR) << "Cannot read " << filename << ": " << contents.status();
+    return false;
+  }
+  if (contents->size() < kLegacyFileHeaderSize) {
+    LOG(ERROR) << "file size is too small";
+    return false;
+  }
+  const char* ptr = contents->data();
+  const uint32_t value_size = LoadUnalignedAdvance<uint32_t>(ptr);
+  const uint32_t size = LoadUnalignedAdvance<uint32_t>(ptr);
+  const uint32_t seed = LoadUnalignedAdvance<uint32_t>(ptr);
+  const size_t item_size = value_size + kItemHeaderSize;
+  if (value_size == 0 || value_size > kMaxValueSize || value_size % 4 != 0 ||
+      size == 0 || size > kMaxLruSize ||
+      contents->size() != kLegacyFileHeaderSize + item_size * size) {
+    LOG(ERROR) << "LRU file is broken";
+    return false;
+  }
+
+  std::string migrated;
+  migrated.reserve(kFileHeaderSize + item_size * size);
+  for (const uint32_t field :
+       {kFileMagic, kFormatVersion, value_size, size, seed}) {
+    migrated.append(reinterpret_cast<const char*>(&field), sizeof(field));
+  }
+  for (const char* item = ptr; item < contents->data() + contents->size();
+       item += item_size) {
+    char header[sizeof(uint64_t)];
+    uint64_t fp = GetFP(item);
+    if (GetTimeStamp(item) != 0) {
+      fp |= kLegacyFingerprintBit;
+    }
+    StoreUnaligned<uint64_t>(fp, header);
+    migrated.append(header, sizeof(header));
+    migrated.append(item + sizeof(header), item_size - sizeof(header));
+  }
+
+  const std::string tmp_filename = absl::StrCat(filename, ".tmp");
+  if (absl::Status s = FileUtil::SetContents(tmp_filename, migrated);
+      !s.ok()) {
+    LOG(ERROR) << "Cannot write " << tmp_filename << ": " << s;
+    return false;
+  }
+  if (absl::Status s = FileUtil::AtomicRename(tmp_filename, filename);
+      !s.ok()) {
+    LOG(ERROR) << "Cannot rename " << tmp_filename << ": " << s;
+    FileUtil::UnlinkOrLogError(tmp_filename);
+    return false;
+  }
+  MOZC_VLOG(1) << filename << " is migrated to format version "
+               << kFormatVersion;
+  return true;
+}
+
 bool LruStorage::Open(char* ptr, size_t ptr_size) {
   begin_ = ptr;
   end_ = ptr + ptr_size;
 
+  if (ptr_size < kFileHeaderSize) {
+    LOG(ERROR) << "file size is too small";
+    return false;
+  }
+  const uint32_t magic = LoadUnalignedAdvance<uint32_t>(begin_);
+  const uint32_t version = LoadUnalignedAdvance<uint32_t>(begin_);
+  if (magic != kFileMagic || version != kFormatVersion) {
+    LOG(ERROR) << "Unsupported LRU file version: " << version;
+    return false;
+  }
   value_size_ = LoadUnalignedAdvance<uint32_t>(begin_);
   size_ = LoadUnalignedAdvance<uint32_t>(begin_);
   seed_ = LoadUnalignedAdvance<uint32_t>(begin_);
@@ -363,11 +469,15 @@ bool LruStorage::Open(char* ptr, size_t ptr_size) {
 
   lru_list_.clear();
   lru_map_.clear();
+  num_legacy_entries_ = 0;
   char* next = nullptr;
   for (size_t i = 0; i < ary.size(); ++i) {
     if (GetTimeStamp(ary[i]) != 0) {
       lru_list_.push_back(ary[i]);
       lru_map_[GetFP(ary[i])] = std::prev(lru_list_.end());
+      if (IsLegacyFingerprint(GetFP(ary[i]))) {
+        ++num_legacy_entries_;
+      }
     } else if (next == nullptr) {
       next = ary[i];
     }
@@ -383,12 +493,53 @@ void LruStorage::Close() {
   mmap_.Close();
   lru_list_.clear();
   lru_map_.clear();
+  num_legacy_entries_ = 0;
+}
+
+uint64_t LruStorage::Fingerprint(absl::string_view key) const {
+  return CityFingerprintWithSeed(key, seed_) & ~kLegacyFingerprintBit;
+}
+
+LruStorage::LruMap::const_iterator LruStorage::Find(absl::string_view key,
+                                                    uint64_t fp) const {
+  const auto it = lru_map_.find(fp);
+  if (it != lru_map_.end() || num_legacy_entries_ == 0) {
+    return it;
+  }
+  return lru_map_.find(LegacyFingerprintWithSeed(key, seed_) |
+                       kLegacyFingerprintBit);
+}
+
+LruStorage::LruMap::iterator LruStorage::FindAndMigrate(absl::string_view key,
+                                                        uint64_t fp) {
+  auto it = lru_map_.find(fp);
+  if (it != lru_map_.end() || num_legacy_entries_ == 0) {
+    return it;
+  }
+  const uint64_t legacy_fp =
+      LegacyFingerprintWithSeed(key, seed_) | kLegacyFingerprintBit;
+  const auto legacy_it = lru_map_.find(legacy_fp);
+  if (legacy_it == lru_map_.end()) {
+    return legacy_it;
+  }
+  // Move the entry to the current fingerprint.
+  const std::list<char*>::iterator list_it = legacy_it->second;
+  StoreUnaligned<uint64_t>(fp, *list_it);
+  lru_map_.erase(legacy_it);
+  --num_legacy_entries_;
+  return lru_map_.emplace(fp, list_it).first;
+}
+
+void LruStorage::EraseFromMap(uint64_t fp) {
+  if (lru_map_.erase(fp) != 0 && IsLegacyFingerprint(fp)) {
+    --num_legacy_entries_;
+  }
 }
 
 const char* absl_nullable LruStorage::Lookup(const absl::string_view key,
                                              uint32_t* last_access_time) const {
-  const uint64_t fp = LegacyFingerprintWithSeed(key, seed_);
-  const auto it = lru_map_.find(fp);
+  const uint64_t fp = Fingerprint(key);
+  const auto it = Find(key, fp);
   if (it == lru_map_.end()) {
     return nullptr;
   }
@@ -410,9 +561,33 @@ void LruStorage::GetAllValues(std::vector<std::string>* values) const {
   }
 }
 
+void LruStorage::LookupBatch(absl::Span<const absl::string_view> keys,
+                             absl::Span<const char*> values,
+                             absl::Span<uint32_t> last_access_times) const {
+  DCHECK_EQ(keys.size(), values.size());
+  DCHECK_EQ(keys.size(), last_access_times.size());
+  // Computes all the fingerprints first so that the probes of the index are
+  // issued back to back instead of waiting for each cache miss in turn.
+  absl::FixedArray<uint64_t, 32> fps(keys.size());
+  for (size_t i = 0; i < keys.size(); ++i) {
+    fps[i] = Fingerprint(keys[i]);
+    lru_map_.prefetch(fps[i]);
+  }
+  for (size_t i = 0; i < keys.size(); ++i) {
+    const auto it = Find(keys[i], fps[i]);
+    if (it == lru_map_.end()) {
+      values[i] = nullptr;
+      last_access_times[i] = 0;
+      continue;
+    }
+    values[i] = GetValue(*it->second);
+    last_access_times[i] = GetTimeStamp(*it->second);
+  }
+}
+
 bool LruStorage::Touch(const absl::string_view key) {
-  const uint64_t fp = LegacyFingerprintWithSeed(key, seed_);
-  auto it = lru_map_.find(fp);
+  const uint64_t fp = Fingerprint(key);
+  auto it = FindAndMigrate(key, fp);
   if (it == lru_map_.end()) {
     return false;
   }
@@ -426,11 +601,11 @@ bool LruStorage::Insert(const absl::string_view key, const char* value) {
   if (value == nullptr) {
     return false;
   }
-  const uint64_t fp = LegacyFingerprintWithSeed(key, seed_);
+  const uint64_t fp = Fingerprint(key);
 
   // If the data corresponding to |key| already exists in LRU, update it.
   {
-    auto it = lru_map_.find(fp);
+    auto it = FindAndMigrate(key, fp);
     if (it != lru_map_.end()) {
       // Overwrite the data pointed to by it->second and move it to the front.
       Update(*it->second, fp, value, value_size_);
@@ -444,8 +619,7 @@ bool LruStorage::Insert(const absl::string_view key, const char* value) {
   // overwritten with new data).
   if (lru_map_.size() >= size_ || next_item_ == end_) {
     auto it = std::prev(lru_list_.end());  // Least recently used data.
-    const uint64_t old_fp = GetFP(*it);
-    lru_map_.erase(old_fp);
+    EraseFromMap(GetFP(*it));
     lru_list_.splice(lru_list_.begin(), lru_list_, it);  // Move to front.
     Update(*it, fp, value, value_size_);
     lru_map_[fp] = it;
@@ -468,8 +642,8 @@ bool LruStorage::Insert(const absl::string_view key, const char* value) {
 }
 
 bool LruStorage::TryInsert(const absl::string_view key, const char* value) {
-  const uint64_t fp = LegacyFingerprintWithSeed(key, seed_);
-  auto it = lru_map_.find(fp);
+  const uint64_t fp = Fingerprint(key);
+  auto it = FindAndMigrate(key, fp);
   if (it != lru_map_.end()) {
     Update(*it->second, fp, value, value_size_);
     lru_list_.splice(lru_list_.begin(), lru_list_, it->second);
@@ -478,8 +652,9 @@ bool LruStorage::TryInsert(const absl::string_view key, const char* value) {
 }
 
 bool LruStorage::Delete(const absl::string_view key) {
-  const uint64_t fp = LegacyFingerprintWithSeed(key, seed_);
-  return Delete(fp);
+  const uint64_t fp = Fingerprint(key);
+  auto it = FindAndMigrate(key, fp);
+  return (it == lru_map_.end() || Delete(fp, it->second));
 }
 
 bool LruStorage::Delete(uint64_t fp) {
@@ -503,7 +678,7 @@ bool LruStorage::Delete(uint64_t fp, std::list<char*>::iterator it) {
   char* deleted_item_pos = *it;
 
   // Erase the LRU structure for (fp, it).
-  lru_map_.erase(fp);
+  EraseFromMap(fp);
   lru_list_.erase(it);
 
   if (next_item_ != deleted_item_pos) {
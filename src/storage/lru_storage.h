@@ -40,6 +40,7 @@
 #include "absl/base/nullability.h"
 #include "absl/container/flat_hash_map.h"
 #include "absl/strings/string_view.h"
+#include "absl/types/span.h"
 #include "base/mmap.h"
 
 namespace mozc {
@@ -52,6 +53,9 @@ class LruStorage {
   LruStorage& operator=(LruStorage&&) = default;
   ~LruStorage() { Close(); }
 
+  // Opens an existing database. A file in the legacy format, which has no
+  // version header, is rewritten into the current format first; its entries
+  // are moved to the new fingerprint when they are accessed.
   bool Open(const char* filename);
   void Close();
 
@@ -69,6 +73,13 @@ class LruStorage {
     return Lookup(key, &last_access_time);
   }
 
+  // Looks up the elements of |keys| at once, which is faster than calling
+  // Lookup() for each key. |values| and |last_access_times| must have the
+  // same size as |keys|. Missing elements get nullptr and 0.
+  void LookupBatch(absl::Span<const absl::string_view> keys,
+                   absl::Span<const char*> values,
+                   absl::Span<uint32_t> last_access_times) const;
+
   // A safer lookup for string values (the pointers returned by above Lookup()'s
   // are not null terminated.)
   absl::string_view LookupAsString(const absl::string_view key) const {
@@ -124,6 +135,9 @@ class LruStorage {
   // Returns the seed used for fingerprinting.
   uint32_t seed() const { return seed_; }
 
+  // Returns the number of items still keyed by the legacy fingerprint.
+  size_t legacy_size() const { return num_legacy_entries_; }
+
   absl::string_view filename() const { return filename_; }
 
   // Writes one entry at |i| th index.
@@ -155,9 +169,28 @@ class LruStorage {
   static constexpr size_t kItemHeaderSize = 12;
 
  private:
+  using LruMap = absl::flat_hash_map<uint64_t, std::list<char*>::iterator>;
+
   // Initializes this LRU from memory buffer.
   bool Open(char* ptr, size_t ptr_size);
 
+  // Rewrites the legacy format file into the current format.
+  static bool MigrateLegacyFile(const char* filename);
+
+  uint64_t Fingerprint(absl::string_view key) const;
+
+  // Finds the element of |key| whose fingerprint is |fp|, falling back to the
+  // legacy fingerprint of |key|.
+  LruMap::const_iterator Find(absl::string_view key, uint64_t fp) const;
+
+  // Same as Find(), but an element stored with the legacy fingerprint is
+  // moved to |fp|. Used by the methods updating the storage, so lookups stay
+  // read-only.
+  LruMap::iterator FindAndMigrate(absl::string_view key, uint64_t fp);
+
+  // Removes |fp| from |lru_map_|.
+  void EraseFromMap(uint64_t fp);
+
   // Deletes the element from |fp| or |it|.
   bool Delete(uint64_t fp);
   bool Delete(std::list<char*>::iterator it);
@@ -173,7 +206,8 @@ class LruStorage {
   char* end_ = nullptr;
   std::string filename_;
   std::list<char*> lru_list_;  // Front is the most recently used data.
-  absl::flat_hash_map<uint64_t, std::list<char*>::iterator> lru_map_;
+  LruMap lru_map_;
+  size_t num_legacy_entries_ = 0;
   Mmap mmap_;
 };
 
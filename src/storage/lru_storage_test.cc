@@ -42,10 +42,14 @@
 
 #include "absl/log/check.h"
 #include "absl/random/random.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
 #include "absl/time/time.h"
 #include "base/clock_mock.h"
 #include "base/file/temp_dir.h"
 #include "base/file_util.h"
+#include "base/hash.h"
 #include "base/random.h"
 #include "storage/lru_cache.h"
 #include "testing/gmock.h"
@@ -342,6 +346,113 @@ TEST_F(LruStorageTest, OpenOrCreateTest) {
   }
 }
 
+TEST_F(LruStorageTest, LookupBatch) {
+  TempFile file(testing::MakeTempFileOrDie());
+  LruStorage storage;
+  ASSERT_TRUE(storage.OpenOrCreate(file.path().c_str(), 4, 10, kSeed));
+  const uint32_t v1 = 1, v2 = 2;
+  ASSERT_TRUE(storage.Insert("foo", reinterpret_cast<const char*>(&v1)));
+  ASSERT_TRUE(storage.Insert("bar", reinterpret_cast<const char*>(&v2)));
+
+  const std::vector<absl::string_view> keys = {"bar", "baz", "foo"};
+  std::vector<const char*> values(keys.size());
+  std::vector<uint32_t> last_access_times(keys.size());
+  storage.LookupBatch(keys, absl::MakeSpan(values),
+                      absl::MakeSpan(last_access_times));
+  for (size_t i = 0; i < keys.size(); ++i) {
+    uint32_t last_access_time = 0;
+    EXPECT_EQ(values[i], storage.Lookup(keys[i], &last_access_time));
+    if (values[i] != nullptr) {
+      EXPECT_EQ(last_access_times[i], last_access_time);
+    }
+  }
+  ASSERT_NE(values[0], nullptr);
+  EXPECT_EQ(*reinterpret_cast<const uint32_t*>(values[0]), 2);
+  EXPECT_EQ(values[1], nullptr);
+  EXPECT_EQ(last_access_times[1], 0);
+}
+
+TEST_F(LruStorageTest, MigrateLegacyFormat) {
+  TempFile file(testing::MakeTempFileOrDie());
+  constexpr uint32_t kValueSize = 4;
+  constexpr uint32_t kSize = 4;
+  const std::vector<std::string> keys = {"foo", "bar", "baz"};
+
+  // Writes the legacy format: no magic nor version, and the entries are keyed
+  // by LegacyFingerprintWithSeed.
+  std::string contents;
+  auto append_uint32 = [&contents](uint32_t v) {
+    contents.append(reinterpret_cast<const char*>(&v), sizeof(v));
+  };
+  append_uint32(kValueSize);
+  append_uint32(kSize);
+  append_uint32(kSeed);
+  for (size_t i = 0; i < kSize; ++i) {
+    const uint64_t fp =
+        i < keys.size() ? LegacyFingerprintWithSeed(keys[i], kSeed) : 0;
+    contents.append(reinterpret_cast<const char*>(&fp), sizeof(fp));
+    append_uint32(i < keys.size() ? 100 + i : 0);  // timestamp
+    append_uint32(i < keys.size() ? i + 1 : 0);    // value
+  }
+  ASSERT_OK(FileUtil::SetContents(file.path(), contents));
+
+  {
+    LruStorage storage;
+    ASSERT_TRUE(storage.Open(file.path().c_str()));
+    EXPECT_EQ(storage.used_size(), 3);
+    EXPECT_EQ(storage.legacy_size(), 3);
+
+    // Lookup finds the legacy entry without modifying the storage.
+    const char* value = storage.Lookup("foo");
+    ASSERT_NE(value, nullptr);
+    EXPECT_EQ(*reinterpret_cast<const uint32_t*>(value), 1);
+    EXPECT_EQ(storage.legacy_size(), 3);
+
+    // Touch moves the entry to the new fingerprint.
+    EXPECT_TRUE(storage.Touch("foo"));
+    EXPECT_EQ(storage.legacy_size(), 2);
+    EXPECT_EQ(storage.Lookup("foo"), value);
+
+    const uint32_t v = 20;
+    EXPECT_TRUE(storage.Insert("bar", reinterpret_cast<const char*>(&v)));
+    EXPECT_EQ(storage.legacy_size(), 1);
+    EXPECT_EQ(storage.used_size(), 3);
+
+    EXPECT_TRUE(storage.Delete("baz"));
+    EXPECT_EQ(storage.legacy_size(), 0);
+    EXPECT_EQ(storage.used_size(), 2);
+    EXPECT_EQ(storage.Lookup("baz"), nullptr);
+  }
+
+  // The file has been rewritten in the current format, and migrated entries
+  // persist.
+  absl::StatusOr<std::string> migrated = FileUtil::GetContents(file.path());
+  ASSERT_OK(migrated);
+  EXPECT_EQ(migrated->size(), contents.size() + 8);
+  {
+    LruStorage storage;
+    ASSERT_TRUE(storage.Open(file.path().c_str()));
+    EXPECT_EQ(storage.used_size(), 2);
+    EXPECT_EQ(storage.legacy_size(), 0);
+    const char* value = storage.Lookup("bar");
+    ASSERT_NE(value, nullptr);
+    EXPECT_EQ(*reinterpret_cast<const uint32_t*>(value), 20);
+    EXPECT_NE(storage.Lookup("foo"), nullptr);
+  }
+}
+
+TEST_F(LruStorageTest, UnsupportedVersion) {
+  TempFile file(testing::MakeTempFileOrDie());
+  ASSERT_TRUE(LruStorage::CreateStorageFile(file.path().c_str(), 4, 10, kSeed));
+  absl::StatusOr<std::string> contents = FileUtil::GetContents(file.path());
+  ASSERT_OK(contents);
+  (*contents)[4] = 0x7f;  // Format version.
+  ASSERT_OK(FileUtil::SetContents(file.path(), *contents));
+
+  LruStorage storage;
+  EXPECT_FALSE(storage.Open(file.path().c_str()));
+}
+
 TEST_F(LruStorageTest, Delete) {
   ScopedClockMock clock(absl::FromUnixSeconds(1));
   clock->AutoAdvance(absl::Seconds(1));
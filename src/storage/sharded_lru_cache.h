@@ -0,0 +1,215 @@
+// Copyright 2010-2021, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef MOZC_STORAGE_SHARDED_LRU_CACHE_H_
+#define MOZC_STORAGE_SHARDED_LRU_CACHE_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/hash/hash.h"
+#include "absl/log/check.h"
+#include "absl/synchronization/mutex.h"
+#include "storage/lru_cache.h"
+
+namespace mozc {
+namespace storage {
+
+// A thread-safe variant of LruCache. Keys are distributed to `num_shards`
+// LruCaches by their hash values and each shard is guarded by its own mutex,
+// so lookups of different keys rarely contend. The LRU order is maintained
+// per shard, and the capacity is divided evenly among the shards. The number
+// of shards is reduced to `max_elements` for small caches, and the cache holds
+// at least one element.
+//
+// Values are returned by copy because references would be invalidated once
+// the lock of the shard is released. Use Mutate() to update a value in place.
+template <typename Key, typename Value>
+class ShardedLruCache {
+ public:
+  static constexpr size_t kDefaultNumShards = 16;
+
+  explicit ShardedLruCache(size_t max_elements,
+                           size_t num_shards = kDefaultNumShards);
+
+  ShardedLruCache(const ShardedLruCache&) = delete;
+  ShardedLruCache& operator=(const ShardedLruCache&) = delete;
+
+  // Adds the specified key/value pair into the cache, putting it at the head
+  // of the LRU list of its shard.
+  void Insert(const Key& key, Value value);
+
+  // Returns a copy of the cached value associated with the key, or nullopt.
+  // Lookup() moves the entry to the head of the LRU list, while
+  // LookupWithoutInsert() doesn't change the LRU order.
+  std::optional<Value> Lookup(const Key& key);
+  std::optional<Value> LookupWithoutInsert(const Key& key) const;
+
+  // Calls `func(Value&)` with the cached value under the lock of the shard.
+  // Returns false if the cache doesn't contain the key. The LRU order is not
+  // changed.
+  template <typename Func>
+  bool Mutate(const Key& key, Func func);
+
+  // Removes the cache entry specified by key.  Returns true if the entry was
+  // in the cache, otherwise returns false.
+  bool Erase(const Key& key);
+
+  // Removes all entries from the cache.
+  void Clear();
+
+  // Returns the number of entries currently in the cache. The value may be
+  // stale when other threads update the cache concurrently.
+  size_t Size() const;
+
+  bool HasKey(const Key& key) const;
+
+  size_t num_shards() const { return shards_.size(); }
+
+ private:
+  struct Shard {
+    explicit Shard(size_t max_elements) : cache(max_elements) {}
+
+    mutable absl::Mutex mutex;
+    LruCache<Key, Value> cache ABSL_GUARDED_BY(mutex);
+  };
+
+  Shard& GetShard(const Key& key) const {
+    // LruCache hashes keys with the same function, so the hash is mixed
+    // before choosing the shard to make it less correlated with the probe
+    // positions there. The multiplication also spreads a 32-bit size_t hash
+    // to the upper bits.
+    const uint64_t hash = static_cast<uint64_t>(absl::Hash<Key>()(key)) *
+                          uint64_t{0x9E3779B97F4A7C15};
+    return *shards_[(hash >> 32) % shards_.size()];
+  }
+
+  std::vector<std::unique_ptr<Shard>> shards_;
+};
+
+template <typename Key, typename Value>
+ShardedLruCache<Key, Value>::ShardedLruCache(size_t max_elements,
+                                             size_t num_shards) {
+  CHECK_GT(num_shards, 0);
+  // Every shard holds at least one element, so small caches have fewer shards.
+  num_shards = std::min(num_shards, std::max<size_t>(max_elements, 1));
+  shards_.reserve(num_shards);
+  for (size_t i = 0; i < num_shards; ++i) {
+    // Distributes the remainder to the first shards.
+    const size_t shard_size = std::max<size_t>(
+        max_elements / num_shards + (i < max_elements % num_shards ? 1 : 0),
+        1);
+    shards_.push_back(std::make_unique<Shard>(shard_size));
+  }
+}
+
+template <typename Key, typename Value>
+void ShardedLruCache<Key, Value>::Insert(const Key& key, Value value) {
+  Shard& shard = GetShard(key);
+  absl::MutexLock lock(&shard.mutex);
+  shard.cache.Insert(key, std::move(value));
+}
+
+template <typename Key, typename Value>
+std::optional<Value> ShardedLruCache<Key, Value>::Lookup(const Key& key) {
+  Shard& shard = GetShard(key);
+  absl::MutexLock lock(&shard.mutex);
+  if (const Value* value = shard.cache.Lookup(key); value != nullptr) {
+    return *value;
+  }
+  return std::nullopt;
+}
+
+template <typename Key, typename Value>
+std::optional<Value> ShardedLruCache<Key, Value>::LookupWithoutInsert(
+    const Key& key) const {
+  const Shard& shard = GetShard(key);
+  absl::MutexLock lock(&shard.mutex);
+  if (const Value* value = shard.cache.LookupWithoutInsert(key);
+      value != nullptr) {
+    return *value;
+  }
+  return std::nullopt;
+}
+
+template <typename Key, typename Value>
+template <typename Func>
+bool ShardedLruCache<Key, Value>::Mutate(const Key& key, Func func) {
+  Shard& shard = GetShard(key);
+  absl::MutexLock lock(&shard.mutex);
+  Value* value = shard.cache.MutableLookupWithoutInsert(key);
+  if (value == nullptr) {
+    return false;
+  }
+  func(*value);
+  return true;
+}
+
+template <typename Key, typename Value>
+bool ShardedLruCache<Key, Value>::Erase(const Key& key) {
+  Shard& shard = GetShard(key);
+  absl::MutexLock lock(&shard.mutex);
+  return shard.cache.Erase(key);
+}
+
+template <typename Key, typename Value>
+void ShardedLruCache<Key, Value>::Clear() {
+  for (const std::unique_ptr<Shard>& shard : shards_) {
+    absl::MutexLock lock(&shard->mutex);
+    shard->cache.Clear();
+  }
+}
+
+template <typename Key, typename Value>
+size_t ShardedLruCache<Key, Value>::Size() const {
+  size_t size = 0;
+  for (const std::unique_ptr<Shard>& shard : shards_) {
+    absl::MutexLock lock(&shard->mutex);
+    size += shard->cache.Size();
+  }
+  return size;
+}
+
+template <typename Key, typename Value>
+bool ShardedLruCache<Key, Value>::HasKey(const Key& key) const {
+  const Shard& shard = GetShard(key);
+  absl::MutexLock lock(&shard.mutex);
+  return shard.cache.HasKey(key);
+}
+
+}  // namespace storage
+}  // namespace mozc
+
+#endif  // MOZC_STORAGE_SHARDED_LRU_CACHE_H_
@@ -0,0 +1,128 @@
+// Copyright 2010-2021, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "storage/sharded_lru_cache.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <optional>
+#include <vector>
+
+#include "base/thread.h"
+#include "testing/gunit.h"
+
+namespace mozc {
+namespace storage {
+namespace {
+
+TEST(ShardedLruCacheTest, InsertAndLookup) {
+  ShardedLruCache<int, int> cache(100, 4);
+  EXPECT_EQ(cache.num_shards(), 4);
+  for (int i = 0; i < 50; ++i) {
+    cache.Insert(i, i * 10);
+  }
+  EXPECT_EQ(cache.Size(), 50);
+  for (int i = 0; i < 50; ++i) {
+    EXPECT_TRUE(cache.HasKey(i));
+    EXPECT_EQ(cache.Lookup(i), i * 10);
+    EXPECT_EQ(cache.LookupWithoutInsert(i), i * 10);
+  }
+  EXPECT_EQ(cache.Lookup(50), std::nullopt);
+
+  EXPECT_TRUE(cache.Mutate(1, [](int& value) { value = -1; }));
+  EXPECT_EQ(cache.Lookup(1), -1);
+  EXPECT_FALSE(cache.Mutate(50, [](int& value) { value = -1; }));
+
+  EXPECT_TRUE(cache.Erase(1));
+  EXPECT_FALSE(cache.Erase(1));
+  EXPECT_EQ(cache.Size(), 49);
+
+  cache.Clear();
+  EXPECT_EQ(cache.Size(), 0);
+}
+
+TEST(ShardedLruCacheTest, Capacity) {
+  ShardedLruCache<int, int> cache(10, 3);
+  for (int i = 0; i < 1000; ++i) {
+    cache.Insert(i, i);
+    EXPECT_TRUE(cache.HasKey(i));
+  }
+  // Each shard is full since 1000 keys are distributed to all the shards.
+  EXPECT_EQ(cache.Size(), 10);
+}
+
+TEST(ShardedLruCacheTest, SmallCapacity) {
+  for (size_t max_elements : {0, 1, 3, 15}) {
+    ShardedLruCache<int, int> cache(max_elements);
+    EXPECT_EQ(cache.num_shards(), std::max<size_t>(max_elements, 1));
+    for (int i = 0; i < 100; ++i) {
+      cache.Insert(i, i);
+      EXPECT_EQ(cache.Lookup(i), i);
+    }
+    EXPECT_EQ(cache.Size(), std::max<size_t>(max_elements, 1));
+  }
+}
+
+TEST(ShardedLruCacheTest, KeysAreDistributed) {
+  // Fails if all the keys go to a few shards, where entries would be evicted
+  // before the cache is full.
+  ShardedLruCache<int, int> cache(64, 8);
+  for (int i = 0; i < 1000; ++i) {
+    cache.Insert(i, i);
+  }
+  EXPECT_EQ(cache.Size(), 64);
+}
+
+TEST(ShardedLruCacheTest, ConcurrentAccess) {
+  constexpr int kNumThreads = 8;
+  constexpr int kNumKeys = 1000;
+  ShardedLruCache<int, int> cache(kNumKeys);
+  std::vector<Thread> threads;
+  for (int t = 0; t < kNumThreads; ++t) {
+    threads.push_back(Thread([&cache, t] {
+      for (int i = 0; i < kNumKeys; ++i) {
+        const int key = (i + t * 100) % kNumKeys;
+        cache.Insert(key, key);
+        const std::optional<int> value = cache.Lookup(key);
+        // The entry may be evicted by other threads, but is never broken.
+        if (value.has_value()) {
+          EXPECT_EQ(*value, key);
+        }
+      }
+    }));
+  }
+  for (Thread& thread : threads) {
+    thread.Join();
+  }
+  EXPECT_LE(cache.Size(), kNumKeys);
+}
+
+}  // namespace
+}  // namespace storage
+}  // namespace mozc